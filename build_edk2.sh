@@ -119,6 +119,7 @@ fi
 
 # Copy to project directory
 cp "$OUTPUT_EFI" "$PROJECT_PATH/ApplesSmcEfi.efi"
+cp "$OUTPUT_DIR/ApplesSmcDxe.efi" "$PROJECT_PATH/ApplesSmcDxe.efi"
 
 # Display build info
 echo ""
@@ -129,6 +130,7 @@ echo ""
 echo "Output file: $PROJECT_PATH/ApplesSmcEfi.efi"
 file "$PROJECT_PATH/ApplesSmcEfi.efi"
 ls -lh "$PROJECT_PATH/ApplesSmcEfi.efi"
+echo "Resident driver: $PROJECT_PATH/ApplesSmcDxe.efi"
 echo ""
 echo "To install:"
 echo "  sudo mkdir -p /boot/efi/EFI/tools"
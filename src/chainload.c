@@ -0,0 +1,325 @@
+#include "chainload.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+  #include <Library/DevicePathLib.h>
+  #include <Library/MemoryAllocationLib.h>
+  #include <Library/UefiRuntimeServicesTableLib.h>
+  #include <Protocol/DevicePath.h>
+  #include <Protocol/LoadedImage.h>
+  #include <Protocol/SimpleFileSystem.h>
+  #include <Guid/GlobalVariable.h>
+#endif
+
+#ifdef _GNU_EFI
+static EFI_GUID global_variable_guid = EFI_GLOBAL_VARIABLE;
+#else
+#define global_variable_guid gEfiGlobalVariableGuid
+#endif
+
+#ifndef LOAD_OPTION_ACTIVE
+#define LOAD_OPTION_ACTIVE 0x00000001
+#endif
+
+// EFI_LOAD_OPTION fixed part: Attributes (UINT32) and FilePathListLength (UINT16)
+#define LOAD_OPTION_HEADER_SIZE 6
+
+/**
+ * Device path node helpers
+ * Spelled out here because gnu-efi and EDK2 disagree on the macro names.
+ */
+static UINTN node_length(const EFI_DEVICE_PATH_PROTOCOL *node) {
+    return node->Length[0] | ((UINTN)node->Length[1] << 8);
+}
+
+static BOOLEAN node_is_end(const EFI_DEVICE_PATH_PROTOCOL *node) {
+    return node->Type == END_DEVICE_PATH_TYPE;
+}
+
+static EFI_DEVICE_PATH_PROTOCOL *node_next(const EFI_DEVICE_PATH_PROTOCOL *node) {
+    return (EFI_DEVICE_PATH_PROTOCOL *)((UINT8 *)node + node_length(node));
+}
+
+// Size of a device path without its end node
+static UINTN path_size(const EFI_DEVICE_PATH_PROTOCOL *path) {
+    const EFI_DEVICE_PATH_PROTOCOL *node = path;
+
+    while (!node_is_end(node) && node_length(node) >= sizeof(EFI_DEVICE_PATH_PROTOCOL)) {
+        node = node_next(node);
+    }
+    return (UINTN)((const UINT8 *)node - (const UINT8 *)path);
+}
+
+/**
+ * Read a global variable into a pool buffer (caller frees)
+ */
+static void *read_global_variable(const CHAR16 *name, UINTN *size) {
+    void *buffer;
+    EFI_STATUS status;
+
+    *size = 0;
+    status = gRT->GetVariable((CHAR16 *)name, &global_variable_guid, NULL, size, NULL);
+    if (status != EFI_BUFFER_TOO_SMALL || *size == 0) {
+        return NULL;
+    }
+
+    buffer = AllocatePool(*size);
+    if (!buffer) {
+        return NULL;
+    }
+
+    status = gRT->GetVariable((CHAR16 *)name, &global_variable_guid, NULL, size, buffer);
+    if (EFI_ERROR(status)) {
+        FreePool(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+/**
+ * Does `path` end with the nodes of `tail`?
+ * Used to spot boot entries that point back at this application.
+ */
+static BOOLEAN path_ends_with(const EFI_DEVICE_PATH_PROTOCOL *path,
+                              const EFI_DEVICE_PATH_PROTOCOL *tail) {
+    UINTN size = path_size(path);
+    UINTN tail_size = tail ? path_size(tail) : 0;
+
+    if (tail_size == 0 || tail_size > size) {
+        return FALSE;
+    }
+    return CompareMem((UINT8 *)path + size - tail_size, (void *)tail, tail_size) == 0;
+}
+
+/**
+ * Expand a short-form HD(...)/File path against the partitions present
+ * Returns a full device path (caller frees), or NULL if no partition matches
+ */
+static EFI_DEVICE_PATH_PROTOCOL *expand_partition_path(const EFI_DEVICE_PATH_PROTOCOL *path) {
+    EFI_DEVICE_PATH_PROTOCOL *expanded = NULL;
+    EFI_HANDLE *handles = NULL;
+    UINTN handle_count = 0;
+    UINTN i;
+
+    if (path->Type != MEDIA_DEVICE_PATH || path->SubType != MEDIA_HARDDRIVE_DP) {
+        return NULL;
+    }
+
+    if (EFI_ERROR(gBS->LocateHandleBuffer(ByProtocol, &gEfiSimpleFileSystemProtocolGuid,
+                                          NULL, &handle_count, &handles))) {
+        return NULL;
+    }
+
+    for (i = 0; i < handle_count && !expanded; i++) {
+        EFI_DEVICE_PATH_PROTOCOL *volume_path = NULL;
+        EFI_DEVICE_PATH_PROTOCOL *node, *last = NULL;
+
+        if (EFI_ERROR(gBS->HandleProtocol(handles[i], &gEfiDevicePathProtocolGuid,
+                                          (void **)&volume_path))) {
+            continue;
+        }
+
+        // The partition node is the last one of the volume's path
+        for (node = volume_path; !node_is_end(node); node = node_next(node)) {
+            last = node;
+        }
+        if (last && node_length(last) == node_length(path) &&
+            CompareMem(last, (void *)path, node_length(path)) == 0) {
+            expanded = AppendDevicePath(volume_path, node_next(path));
+        }
+    }
+
+    FreePool(handles);
+    return expanded;
+}
+
+/**
+ * Load an image from a device path, expanding short-form partition paths
+ */
+static EFI_STATUS load_from_path(EFI_HANDLE image_handle, EFI_DEVICE_PATH_PROTOCOL *path,
+                                 EFI_HANDLE *child) {
+    EFI_DEVICE_PATH_PROTOCOL *full;
+    EFI_STATUS status;
+
+    status = gBS->LoadImage(FALSE, image_handle, path, NULL, 0, child);
+    if (status == EFI_SECURITY_VIOLATION) {
+        // Loaded but not allowed to run (Secure Boot)
+        gBS->UnloadImage(*child);
+        return status;
+    }
+    if (!EFI_ERROR(status)) {
+        return status;
+    }
+
+    full = expand_partition_path(path);
+    if (!full) {
+        return status;
+    }
+    status = gBS->LoadImage(FALSE, image_handle, full, NULL, 0, child);
+    FreePool(full);
+
+    return status;
+}
+
+/**
+ * Start a loaded image with the given LoadOptions
+ */
+static EFI_STATUS start_child(EFI_HANDLE child, void *load_options, UINT32 load_options_size) {
+    EFI_LOADED_IMAGE_PROTOCOL *loaded_image = NULL;
+
+    if (load_options_size > 0 &&
+        !EFI_ERROR(gBS->HandleProtocol(child, &gEfiLoadedImageProtocolGuid,
+                                       (void **)&loaded_image))) {
+        loaded_image->LoadOptions = load_options;
+        loaded_image->LoadOptionsSize = load_options_size;
+    }
+
+    return gBS->StartImage(child, NULL, NULL);
+}
+
+/**
+ * Locate the device path list in an active EFI_LOAD_OPTION
+ * FALSE if the entry is inactive or malformed
+ */
+static BOOLEAN parse_load_option(const UINT8 *option, UINTN size,
+                                 UINTN *path_offset, UINT16 *path_length) {
+    UINT32 attributes;
+    UINTN offset;
+
+    if (size < LOAD_OPTION_HEADER_SIZE) {
+        return FALSE;
+    }
+
+    CopyMem(&attributes, (void *)option, sizeof(attributes));
+    CopyMem(path_length, (void *)(option + 4), sizeof(*path_length));
+    if (!(attributes & LOAD_OPTION_ACTIVE) || *path_length < sizeof(EFI_DEVICE_PATH_PROTOCOL)) {
+        return FALSE;
+    }
+
+    // Skip the NUL-terminated description
+    offset = LOAD_OPTION_HEADER_SIZE;
+    while (offset + sizeof(CHAR16) <= size &&
+           (option[offset] != 0 || option[offset + 1] != 0)) {
+        offset += sizeof(CHAR16);
+    }
+    offset += sizeof(CHAR16);
+    if (offset + *path_length > size) {
+        return FALSE;
+    }
+
+    *path_offset = offset;
+    return TRUE;
+}
+
+/**
+ * Try one Boot#### entry
+ * EFI_NOT_FOUND if it is inactive, malformed, this application, or cannot
+ * be loaded; otherwise the loader's exit status.
+ */
+static EFI_STATUS try_boot_option(EFI_HANDLE image_handle, UINT16 number,
+                                  const EFI_DEVICE_PATH_PROTOCOL *self_path) {
+    CHAR16 name[9];
+    UINT8 *option;
+    UINTN size, path_offset, data_offset;
+    UINT16 path_length;
+    EFI_DEVICE_PATH_PROTOCOL *path = NULL;
+    EFI_HANDLE child = NULL;
+    EFI_STATUS status = EFI_NOT_FOUND;
+
+    UnicodeSPrint(name, sizeof(name), L"Boot%04X", number);
+    option = read_global_variable(name, &size);
+    if (!option) {
+        return EFI_NOT_FOUND;
+    }
+
+    // Copied out of the variable data so the nodes are aligned
+    if (parse_load_option(option, size, &path_offset, &path_length)) {
+        path = AllocatePool(path_length);
+    }
+    if (path) {
+        CopyMem(path, option + path_offset, path_length);
+
+        if (!path_ends_with(path, self_path) &&
+            !EFI_ERROR(load_from_path(image_handle, path, &child))) {
+            // Optional data after the device path list becomes the loader's LoadOptions
+            data_offset = path_offset + path_length;
+            status = start_child(child, option + data_offset, (UINT32)(size - data_offset));
+        }
+        FreePool(path);
+    }
+
+    FreePool(option);
+    return status;
+}
+
+/**
+ * Start the next BootOrder entry after BootCurrent
+ */
+static EFI_STATUS start_next_boot_option(EFI_HANDLE image_handle,
+                                         const EFI_DEVICE_PATH_PROTOCOL *self_path) {
+    UINT16 *order;
+    UINT16 *current;
+    UINTN order_size, current_size;
+    UINTN count, i, first = 0;
+    EFI_STATUS status = EFI_NOT_FOUND;
+
+    order = read_global_variable(L"BootOrder", &order_size);
+    if (!order) {
+        return EFI_NOT_FOUND;
+    }
+    count = order_size / sizeof(UINT16);
+
+    // Continue after the entry that started us; from the top when run from the Shell
+    current = read_global_variable(L"BootCurrent", &current_size);
+    if (current) {
+        if (current_size == sizeof(UINT16)) {
+            for (i = 0; i < count; i++) {
+                if (order[i] == *current) {
+                    first = i + 1;
+                    break;
+                }
+            }
+        }
+        FreePool(current);
+    }
+
+    for (i = first; i < count && status == EFI_NOT_FOUND; i++) {
+        status = try_boot_option(image_handle, order[i], self_path);
+    }
+
+    FreePool(order);
+    return status;
+}
+
+/**
+ * Start the OS loader
+ */
+EFI_STATUS chainload_start(EFI_HANDLE image_handle, const CHAR16 *path) {
+    EFI_LOADED_IMAGE_PROTOCOL *loaded_image = NULL;
+    EFI_DEVICE_PATH_PROTOCOL *file_path;
+    EFI_HANDLE child = NULL;
+    EFI_STATUS status;
+
+    status = gBS->HandleProtocol(image_handle, &gEfiLoadedImageProtocolGuid,
+                                 (void **)&loaded_image);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    if (!path || path[0] == L'\0') {
+        return start_next_boot_option(image_handle, loaded_image->FilePath);
+    }
+
+    file_path = FileDevicePath(loaded_image->DeviceHandle, (CHAR16 *)path);
+    if (!file_path) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+    status = gBS->LoadImage(FALSE, image_handle, file_path, NULL, 0, &child);
+    FreePool(file_path);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    return start_child(child, NULL, 0);
+}
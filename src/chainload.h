@@ -0,0 +1,30 @@
+#ifndef CHAINLOAD_H
+#define CHAINLOAD_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+
+/**
+ * Chainloading the OS loader
+ *
+ * For the boot path (--boot): after the fans are set up, the next loader is
+ * started with LoadImage()/StartImage() while this image stays loaded.
+ * Either an explicit path on this image's volume, or the first active
+ * BootOrder entry after BootCurrent that is not this application. Short-form
+ * (HD(...)/File) boot entries are expanded against the partitions present.
+ * The entry's optional data is passed to the loader as its LoadOptions.
+ */
+
+// Start the OS loader at `path` on the image's volume, or the next BootOrder
+// entry if path is NULL or empty. Returns only if no loader could be started
+// (EFI_NOT_FOUND if none was found) or the loader exited (its status).
+EFI_STATUS chainload_start(EFI_HANDLE image_handle, const CHAR16 *path);
+
+#endif // CHAINLOAD_H
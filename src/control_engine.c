@@ -0,0 +1,474 @@
+#include "control_engine.h"
+#include "sensor_sched.h"
+#include "telemetry.h"
+#include "smc_protocol.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+  #include <Library/MemoryAllocationLib.h>
+  #include <Protocol/MpService.h>
+#endif
+
+/**
+ * EFI_MP_SERVICES_PROTOCOL (PI spec, Vol. 2)
+ * gnu-efi does not ship it, so declare the parts we call.
+ */
+#ifdef _GNU_EFI
+typedef VOID (EFIAPI *MP_AP_PROCEDURE)(VOID *argument);
+
+typedef struct _MP_SERVICES_PROTOCOL MP_SERVICES_PROTOCOL;
+
+struct _MP_SERVICES_PROTOCOL {
+    EFI_STATUS (EFIAPI *GetNumberOfProcessors)(MP_SERVICES_PROTOCOL *This,
+                                               UINTN *NumberOfProcessors,
+                                               UINTN *NumberOfEnabledProcessors);
+    EFI_STATUS (EFIAPI *GetProcessorInfo)(MP_SERVICES_PROTOCOL *This, UINTN ProcessorNumber,
+                                          VOID *ProcessorInfoBuffer);
+    EFI_STATUS (EFIAPI *StartupAllAPs)(MP_SERVICES_PROTOCOL *This, MP_AP_PROCEDURE Procedure,
+                                       BOOLEAN SingleThread, EFI_EVENT WaitEvent,
+                                       UINTN TimeoutInMicroSeconds, VOID *ProcedureArgument,
+                                       UINTN **FailedCpuList);
+    EFI_STATUS (EFIAPI *StartupThisAP)(MP_SERVICES_PROTOCOL *This, MP_AP_PROCEDURE Procedure,
+                                       UINTN ProcessorNumber, EFI_EVENT WaitEvent,
+                                       UINTN TimeoutInMicroseconds, VOID *ProcedureArgument,
+                                       BOOLEAN *Finished);
+    EFI_STATUS (EFIAPI *SwitchBSP)(MP_SERVICES_PROTOCOL *This, UINTN ProcessorNumber,
+                                   BOOLEAN EnableOldBSP);
+    EFI_STATUS (EFIAPI *EnableDisableAP)(MP_SERVICES_PROTOCOL *This, UINTN ProcessorNumber,
+                                         BOOLEAN EnableAP, UINT32 *HealthFlag);
+    EFI_STATUS (EFIAPI *WhoAmI)(MP_SERVICES_PROTOCOL *This, UINTN *ProcessorNumber);
+};
+
+static EFI_GUID mp_services_guid = {
+    0x3fdda605, 0xa76e, 0x4f46, {0xad, 0x29, 0x12, 0xf4, 0x53, 0x1b, 0x3d, 0x08}
+};
+#else
+typedef EFI_MP_SERVICES_PROTOCOL MP_SERVICES_PROTOCOL;
+typedef EFI_AP_PROCEDURE MP_AP_PROCEDURE;
+
+#define mp_services_guid gEfiMpServiceProtocolGuid
+#endif
+
+// Command types
+typedef enum {
+    CMD_SET_FAN = 0,
+    CMD_REFRESH_ALL
+} CONTROL_CMD_TYPE;
+
+// One command in the BSP -> AP ring
+typedef struct {
+    UINT8 type;
+    UINT8 slot;               // Position in the fan array
+    FAN_INFO config;          // CMD_SET_FAN: desired settings
+} CONTROL_CMD;
+
+// Engine state: written by the BSP before start, owned by the AP while running
+static FAN_INFO engine_fans[MAX_FANS];
+static UINT8 engine_fan_count = 0;
+static TEMP_SENSOR *engine_sensors = NULL;
+static UINT64 *sensor_due_us = NULL;
+static UINT16 engine_sensor_count = 0;
+static UINT16 sensor_cursor = 0;
+
+// Command ring: BSP writes head, AP writes tail
+static CONTROL_CMD cmd_ring[CONTROL_CMD_QUEUE];
+static volatile UINT32 cmd_head = 0;
+static volatile UINT32 cmd_tail = 0;
+
+static volatile BOOLEAN stop_requested = FALSE;
+static volatile BOOLEAN engine_running = FALSE;
+static EFI_EVENT ap_done_event = NULL;
+
+/**
+ * Is a sensor bound to a sensor-based fan?
+ */
+static BOOLEAN sensor_is_bound(UINT16 sensor) {
+    UINT8 i;
+
+    for (i = 0; i < engine_fan_count; i++) {
+        if (engine_fans[i].mode == FAN_MODE_SENSOR_BASED &&
+            engine_fans[i].sensor_based_enabled &&
+            engine_fans[i].sensor_index == sensor) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Sampling period for a sensor (fast while it drives a fan curve)
+ */
+static UINT64 sensor_period_us(UINT16 sensor) {
+    UINT32 period_ms;
+
+    if (sensor_is_bound(sensor)) {
+        period_ms = SENSOR_PERIOD_FAST_MS;
+    } else {
+        switch (sensor_sched_classify(engine_sensors[sensor].smc_key)) {
+            case SENSOR_RATE_FAST:
+                period_ms = SENSOR_PERIOD_FAST_MS;
+                break;
+            case SENSOR_RATE_SLOW:
+                period_ms = SENSOR_PERIOD_SLOW_MS;
+                break;
+            default:
+                period_ms = SENSOR_PERIOD_MEDIUM_MS;
+                break;
+        }
+    }
+    return (UINT64)period_ms * 1000;
+}
+
+/**
+ * Read one sensor and schedule its next read
+ */
+static void sample_sensor(UINT16 i, UINT64 now) {
+    TEMP_SENSOR *sensor = &engine_sensors[i];
+    INT16 temp;
+
+    if (!EFI_ERROR(temp_read_sensor(sensor->smc_key, &temp))) {
+        sensor->temperature = temp;
+        sensor->valid = TRUE;
+    } else {
+        sensor->valid = FALSE;
+    }
+    sensor_due_us[i] = now + sensor_period_us(i);
+}
+
+/**
+ * Read due sensors within the per-iteration budget, curve inputs first
+ */
+static void sample_sensors(void) {
+    UINT64 start = timer_now_us();
+    UINT16 n;
+    UINT8 i;
+
+    for (i = 0; i < engine_fan_count; i++) {
+        UINT16 idx = engine_fans[i].sensor_index;
+
+        if (engine_fans[i].mode == FAN_MODE_SENSOR_BASED &&
+            engine_fans[i].sensor_based_enabled &&
+            idx < engine_sensor_count && start >= sensor_due_us[idx]) {
+            sample_sensor(idx, start);
+        }
+    }
+
+    for (n = 0; n < engine_sensor_count; n++) {
+        UINT64 now = timer_now_us();
+        UINT16 idx = sensor_cursor;
+
+        if (now - start >= CONTROL_BUDGET_US) {
+            break;
+        }
+
+        sensor_cursor = (UINT16)((sensor_cursor + 1) % engine_sensor_count);
+        if (now >= sensor_due_us[idx]) {
+            sample_sensor(idx, now);
+        }
+    }
+}
+
+/**
+ * Apply queued commands from the BSP
+ */
+static void drain_commands(void) {
+    while (cmd_tail != cmd_head) {
+        CONTROL_CMD *cmd = &cmd_ring[cmd_tail % CONTROL_CMD_QUEUE];
+        UINT16 i;
+
+        memory_fence();
+
+        switch (cmd->type) {
+            case CMD_SET_FAN:
+                if (cmd->slot < engine_fan_count) {
+                    fan_apply_config(&engine_fans[cmd->slot], &cmd->config);
+                }
+                break;
+
+            case CMD_REFRESH_ALL:
+                for (i = 0; i < engine_sensor_count; i++) {
+                    sensor_due_us[i] = 0;
+                }
+                break;
+        }
+
+        memory_fence();
+        cmd_tail++;
+    }
+}
+
+/**
+ * Publish fan and sensor values as a telemetry frame
+ */
+static void publish(void) {
+    TELEMETRY_FRAME *frame = telemetry_working_frame();
+    UINT16 i;
+
+    for (i = 0; i < engine_fan_count; i++) {
+        frame->fan_rpm[i] = engine_fans[i].current_rpm;
+        frame->fan_target[i] = engine_fans[i].target_rpm;
+    }
+    for (i = 0; i < engine_sensor_count; i++) {
+        frame->temperature[i] = engine_sensors[i].temperature;
+        frame->sensor_valid[i] = engine_sensors[i].valid;
+    }
+
+    telemetry_publish();
+}
+
+/**
+ * AP entry point: the control loop
+ * Runs without Boot Services; only port I/O and the TSC.
+ */
+static VOID EFIAPI engine_main(VOID *argument) {
+    UINT64 next = timer_now_us();
+    UINT8 i;
+
+    while (!stop_requested) {
+        drain_commands();
+
+        for (i = 0; i < engine_fan_count; i++) {
+            fan_read_rpm(engine_fans[i].index, &engine_fans[i].current_rpm);
+        }
+
+        if (engine_sensor_count > 0) {
+            sample_sensors();
+        }
+
+        for (i = 0; i < engine_fan_count; i++) {
+            FAN_INFO *fan = &engine_fans[i];
+
+            if (fan->mode == FAN_MODE_SENSOR_BASED && fan->sensor_based_enabled &&
+                fan->sensor_index < engine_sensor_count &&
+                engine_sensors[fan->sensor_index].valid) {
+                fan_update_sensor_based(fan, engine_sensors[fan->sensor_index].temperature);
+            }
+        }
+
+        publish();
+
+        // Sleep until the next period, waking early for a stop request
+        next += (UINT64)CONTROL_PERIOD_MS * 1000;
+        while (!stop_requested && timer_now_us() < next) {
+            timer_spin_us(100);
+        }
+    }
+
+    memory_fence();
+    engine_running = FALSE;
+}
+
+/**
+ * Start the loop on the first AP that accepts it
+ */
+EFI_STATUS control_engine_start(const FAN_INFO fans[], UINT8 fan_count,
+                                const TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    MP_SERVICES_PROTOCOL *mp = NULL;
+    UINTN cpu_count, enabled_count, bsp, cpu;
+    EFI_STATUS status;
+
+    if (engine_running) {
+        return EFI_ALREADY_STARTED;
+    }
+    if (!fans || fan_count > MAX_FANS || sensor_count > MAX_TEMP_SENSORS) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (smc_get_service()) {
+        return EFI_ACCESS_DENIED;
+    }
+
+    status = gBS->LocateProtocol(&mp_services_guid, NULL, (void **)&mp);
+    if (EFI_ERROR(status)) {
+        return EFI_UNSUPPORTED;
+    }
+
+    status = mp->GetNumberOfProcessors(mp, &cpu_count, &enabled_count);
+    if (EFI_ERROR(status) || enabled_count < 2) {
+        return EFI_UNSUPPORTED;
+    }
+
+    status = mp->WhoAmI(mp, &bsp);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    // Engine state is copied so the UI's arrays stay BSP-private
+    CopyMem(engine_fans, (void *)fans, fan_count * sizeof(FAN_INFO));
+    engine_fan_count = fan_count;
+    engine_sensor_count = 0;
+    sensor_cursor = 0;
+    if (sensor_count > 0) {
+        engine_sensors = AllocatePool(sensor_count * sizeof(TEMP_SENSOR));
+        sensor_due_us = AllocateZeroPool(sensor_count * sizeof(UINT64));
+        if (!engine_sensors || !sensor_due_us) {
+            control_engine_stop();
+            return EFI_OUT_OF_RESOURCES;
+        }
+        CopyMem(engine_sensors, (void *)sensors, sensor_count * sizeof(TEMP_SENSOR));
+        engine_sensor_count = sensor_count;
+    }
+
+    cmd_head = 0;
+    cmd_tail = 0;
+    telemetry_reset(fan_count, sensor_count, TRUE);
+    publish();
+
+    // Non-blocking StartupThisAP needs a wait event; it is signaled when the AP returns
+    status = gBS->CreateEvent(0, 0, NULL, NULL, &ap_done_event);
+    if (EFI_ERROR(status)) {
+        ap_done_event = NULL;
+        control_engine_stop();
+        return status;
+    }
+
+    smc_set_exclusive(TRUE);
+    stop_requested = FALSE;
+    engine_running = TRUE;
+    memory_fence();
+
+    // Prefer the highest-numbered AP (least likely to be used by firmware)
+    status = EFI_NOT_READY;
+    for (cpu = cpu_count; cpu-- > 0;) {
+        if (cpu == bsp) {
+            continue;
+        }
+        status = mp->StartupThisAP(mp, engine_main, cpu, ap_done_event,
+                                   0, NULL, NULL);
+        if (!EFI_ERROR(status)) {
+            break;
+        }
+    }
+
+    if (EFI_ERROR(status)) {
+        engine_running = FALSE;
+        control_engine_stop();
+        return EFI_UNSUPPORTED;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Stop the loop and release the SMC
+ */
+void control_engine_stop(void) {
+    UINT32 waited_ms = 0;
+
+    stop_requested = TRUE;
+    memory_fence();
+
+    while (engine_running && waited_ms < CONTROL_STOP_TIMEOUT_MS) {
+        gBS->Stall(1000);
+        waited_ms++;
+    }
+
+    // A stuck AP keeps the bus; don't touch the SMC under it
+    if (!engine_running) {
+        smc_set_exclusive(FALSE);
+
+        if (engine_sensors) {
+            FreePool(engine_sensors);
+            engine_sensors = NULL;
+        }
+        if (sensor_due_us) {
+            FreePool(sensor_due_us);
+            sensor_due_us = NULL;
+        }
+        engine_sensor_count = 0;
+        engine_fan_count = 0;
+    }
+
+    if (ap_done_event && !engine_running) {
+        gBS->CloseEvent(ap_done_event);
+        ap_done_event = NULL;
+    }
+}
+
+/**
+ * Stop the loop from a notify context
+ * Only the stop flag, the TSC and port state are touched: nothing is freed
+ * or closed, so it is safe in an ExitBootServices notification.
+ */
+BOOLEAN control_engine_halt(void) {
+    UINT32 waited_ms = 0;
+
+    if (!engine_running) {
+        return TRUE;
+    }
+
+    stop_requested = TRUE;
+    memory_fence();
+
+    while (engine_running && waited_ms < CONTROL_STOP_TIMEOUT_MS) {
+        timer_spin_us(1000);
+        waited_ms++;
+    }
+
+    if (engine_running) {
+        return FALSE;  // Stuck AP still owns the bus
+    }
+    smc_set_exclusive(FALSE);
+    return TRUE;
+}
+
+/**
+ * Is the AP loop running?
+ */
+BOOLEAN control_engine_running(void) {
+    return engine_running && !stop_requested;
+}
+
+/**
+ * Are commands still queued for the AP?
+ */
+BOOLEAN control_engine_pending(void) {
+    return cmd_tail != cmd_head;
+}
+
+/**
+ * Queue a command for the AP
+ */
+static EFI_STATUS post_command(const CONTROL_CMD *cmd) {
+    if (!control_engine_running()) {
+        return EFI_NOT_STARTED;
+    }
+    if (cmd_head - cmd_tail >= CONTROL_CMD_QUEUE) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    cmd_ring[cmd_head % CONTROL_CMD_QUEUE] = *cmd;
+    memory_fence();
+    cmd_head++;
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Ask the engine to apply a fan's settings
+ */
+EFI_STATUS control_engine_set_fan(UINT8 slot, const FAN_INFO *config) {
+    CONTROL_CMD cmd;
+
+    if (!config || slot >= engine_fan_count) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    cmd.type = CMD_SET_FAN;
+    cmd.slot = slot;
+    cmd.config = *config;
+
+    return post_command(&cmd);
+}
+
+/**
+ * Ask the engine to read every sensor
+ */
+EFI_STATUS control_engine_refresh_all(void) {
+    CONTROL_CMD cmd;
+
+    cmd.type = CMD_REFRESH_ALL;
+    cmd.slot = 0;
+
+    return post_command(&cmd);
+}
@@ -0,0 +1,70 @@
+#ifndef CONTROL_ENGINE_H
+#define CONTROL_ENGINE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Control engine on an application processor
+ *
+ * Sensor sampling, fan RPM reads and sensor-based fan curves run in a loop
+ * on a dedicated AP started through EFI_MP_SERVICES_PROTOCOL. The AP owns
+ * the SMC exclusively while running. The BSP sends fan changes through a
+ * single-producer command ring and reads results as telemetry frames
+ * (telemetry.h), so console output never delays control and vice versa.
+ */
+
+// Loop period and SMC time spent on sensor reads per iteration
+#define CONTROL_PERIOD_MS       100
+#define CONTROL_BUDGET_US       5000
+
+// Command ring size (power of two)
+#define CONTROL_CMD_QUEUE       16
+
+// How long control_engine_stop() waits for the AP to leave its loop
+#define CONTROL_STOP_TIMEOUT_MS 1000
+
+/**
+ * Lifecycle (BSP only)
+ */
+
+// Copy fans/sensors into engine state and start the loop on a free AP
+// EFI_UNSUPPORTED if there is no MP services protocol or no AP;
+// EFI_ACCESS_DENIED while the resident driver owns the SMC (an AP cannot
+// call it, and must not drive the ports behind its back)
+EFI_STATUS control_engine_start(const FAN_INFO fans[], UINT8 fan_count,
+                                const TEMP_SENSOR sensors[], UINT16 sensor_count);
+
+// Stop the loop and give the SMC back to the BSP
+void control_engine_stop(void);
+
+// Stop the loop without freeing anything (safe at TPL_NOTIFY, e.g. ExitBootServices)
+// FALSE if the AP did not stop and still owns the SMC
+BOOLEAN control_engine_halt(void);
+
+// TRUE while the AP loop is running
+BOOLEAN control_engine_running(void);
+
+/**
+ * Commands and results (BSP only)
+ */
+
+// Ask the engine to apply a fan's mode/target/curve (see fan_apply_config)
+EFI_STATUS control_engine_set_fan(UINT8 slot, const FAN_INFO *config);
+
+// Ask the engine to read every sensor on its next iteration
+EFI_STATUS control_engine_refresh_all(void);
+
+// TRUE while queued commands have not been taken by the AP yet
+BOOLEAN control_engine_pending(void);
+
+#endif // CONTROL_ENGINE_H
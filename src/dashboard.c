@@ -0,0 +1,580 @@
+#include "dashboard.h"
+#include "dash_font.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+  #include <Protocol/GraphicsOutput.h>
+#endif
+
+#ifdef _GNU_EFI
+static EFI_GUID gop_guid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+#else
+#define gop_guid gEfiGraphicsOutputProtocolGuid
+#endif
+
+typedef EFI_GRAPHICS_OUTPUT_BLT_PIXEL PIXEL;
+
+// Colours (Blt pixels are stored blue, green, red)
+#define COLOR(r, g, b)  { (b), (g), (r), 0 }
+static const PIXEL color_background = COLOR(0x14, 0x18, 0x1E);
+static const PIXEL color_panel      = COLOR(0x24, 0x2A, 0x32);
+static const PIXEL color_select     = COLOR(0x30, 0x40, 0x58);
+static const PIXEL color_text       = COLOR(0xD8, 0xDC, 0xE0);
+static const PIXEL color_dim        = COLOR(0x80, 0x88, 0x90);
+static const PIXEL color_cool       = COLOR(0x40, 0xC0, 0x60);
+static const PIXEL color_warm       = COLOR(0xE0, 0xA0, 0x30);
+static const PIXEL color_hot        = COLOR(0xE0, 0x40, 0x30);
+static const PIXEL color_marker     = COLOR(0xFF, 0xFF, 0xFF);
+static const PIXEL color_trace      = COLOR(0x50, 0xA0, 0xF0);
+
+// Layout, in pixels within the dashboard area
+#define SCALE           2
+#define CHAR_W          ((DASH_FONT_WIDTH + 1) * SCALE)
+#define CHAR_H          ((DASH_FONT_HEIGHT + 3) * SCALE)
+#define MARGIN          12
+#define GAP             8
+#define FAN_ROW_H       (CHAR_H + 6)
+#define MODE_COL        13                      // Characters from the row start
+#define GAUGE_COL       18
+#define NUMBERS_CHARS   10                      // "rpm/target" after the gauge
+#define GAUGE_H         12
+#define PLOT_H          60
+#define PANEL_H         (CHAR_H + PLOT_H + 8)
+#define MIN_WIDTH       (2 * MARGIN + (GAUGE_COL + NUMBERS_CHARS) * CHAR_W + 160)
+#define MIN_HEIGHT      360
+
+// Changed rectangles per frame before the whole area is copied instead
+#define MAX_RECTS       32
+
+// Graph samples with no reading
+#define NO_SAMPLE       ((INT16)0x8000)
+
+typedef struct {
+    UINTN x, y, w, h;
+} RECT;
+
+// What a fan row last showed
+typedef struct {
+    BOOLEAN drawn;
+    BOOLEAN selected;
+    FAN_MODE mode;
+    UINT16 rpm;
+    UINT16 target;
+} FAN_ROW;
+
+// A sensor's history, oldest sample first from next - count
+typedef struct {
+    UINT16 slot;              // Index in the sensor table
+    INT16 samples[DASHBOARD_HISTORY];
+    UINTN count;
+    UINTN next;
+    BOOLEAN changed;          // New sample or new sensor since the last frame
+} GRAPH;
+
+static EFI_GRAPHICS_OUTPUT_PROTOCOL *gop = NULL;
+static PIXEL *back = NULL;                   // area_w x area_h
+static UINTN area_x, area_y, area_w, area_h; // Dashboard area on the screen
+
+// Rows and panels, set on the first frame (the fan count is fixed by then)
+static UINT8 shown_fans;
+static UINTN fans_y, graphs_y, status_y, help_y, panel_w;
+
+static FAN_ROW fan_rows[MAX_FANS];
+static GRAPH graphs[DASHBOARD_GRAPHS];
+static UINT16 graph_count;
+static CHAR16 drawn_status[128];
+
+static RECT dirty[MAX_RECTS];
+static UINTN dirty_count;
+static BOOLEAN dirty_all;
+
+static BOOLEAN full_redraw;
+static BOOLEAN pending;
+static UINT64 frame_us;
+static UINT64 sample_due_us;
+
+/**
+ * Drawing into the back buffer
+ * Everything is clipped to the area.
+ */
+
+static void fill_rect(UINTN x, UINTN y, UINTN w, UINTN h, const PIXEL *color) {
+    UINTN row, col;
+
+    if (x >= area_w || y >= area_h) {
+        return;
+    }
+    if (w > area_w - x) {
+        w = area_w - x;
+    }
+    if (h > area_h - y) {
+        h = area_h - y;
+    }
+
+    for (row = y; row < y + h; row++) {
+        PIXEL *line = &back[row * area_w + x];
+        for (col = 0; col < w; col++) {
+            line[col] = *color;
+        }
+    }
+}
+
+// Returns the x after the character
+static UINTN draw_char(UINTN x, UINTN y, CHAR16 ch, const PIXEL *color) {
+    const UINT8 *glyph;
+    UINTN col, row;
+
+    if (ch == 0xB0) {
+        ch = DASH_FONT_DEGREE;
+    } else if (ch < DASH_FONT_FIRST || ch >= DASH_FONT_LAST) {
+        ch = L'?';
+    }
+    glyph = dash_font[ch - DASH_FONT_FIRST];
+
+    for (col = 0; col < DASH_FONT_WIDTH; col++) {
+        for (row = 0; row < DASH_FONT_HEIGHT; row++) {
+            if (glyph[col] & (1 << row)) {
+                fill_rect(x + col * SCALE, y + SCALE + row * SCALE, SCALE, SCALE, color);
+            }
+        }
+    }
+    return x + CHAR_W;
+}
+
+// At most max_chars characters
+static UINTN draw_text(UINTN x, UINTN y, const CHAR16 *text, UINTN max_chars, const PIXEL *color) {
+    UINTN i;
+
+    for (i = 0; i < max_chars && text[i] != L'\0'; i++) {
+        x = draw_char(x, y, text[i], color);
+    }
+    return x;
+}
+
+static UINTN draw_ascii(UINTN x, UINTN y, const CHAR8 *text, const PIXEL *color) {
+    while (*text) {
+        x = draw_char(x, y, (CHAR16)*text++, color);
+    }
+    return x;
+}
+
+/**
+ * Dirty rectangles
+ */
+
+static void mark(UINTN x, UINTN y, UINTN w, UINTN h) {
+    if (dirty_count == MAX_RECTS) {
+        dirty_all = TRUE;
+        return;
+    }
+    if (x >= area_w || y >= area_h) {
+        return;
+    }
+    dirty[dirty_count].x = x;
+    dirty[dirty_count].y = y;
+    dirty[dirty_count].w = w > area_w - x ? area_w - x : w;
+    dirty[dirty_count].h = h > area_h - y ? area_h - y : h;
+    dirty_count++;
+}
+
+// Copy the changed rectangles (or the whole area) to the screen
+static void flush(void) {
+    UINTN delta = area_w * sizeof(PIXEL);
+    UINTN i;
+
+    if (dirty_all) {
+        gop->Blt(gop, back, EfiBltBufferToVideo, 0, 0, area_x, area_y, area_w, area_h, delta);
+    } else {
+        for (i = 0; i < dirty_count; i++) {
+            RECT *r = &dirty[i];
+            gop->Blt(gop, back, EfiBltBufferToVideo, r->x, r->y, area_x + r->x, area_y + r->y,
+                     r->w, r->h, delta);
+        }
+    }
+    dirty_count = 0;
+    dirty_all = FALSE;
+}
+
+/**
+ * Layout for count fans: rows, then two rows of two graph panels, then
+ * the status and help lines at the bottom
+ */
+static void layout(UINT8 count) {
+    UINTN rows;
+
+    fans_y = MARGIN + CHAR_H + GAP;
+    help_y = area_h - MARGIN - CHAR_H;
+    status_y = help_y - CHAR_H - GAP / 2;
+
+    rows = (status_y - GAP - 2 * (PANEL_H + GAP) - fans_y) / FAN_ROW_H;
+    shown_fans = count < rows ? count : (UINT8)rows;
+
+    graphs_y = fans_y + shown_fans * FAN_ROW_H + GAP;
+    panel_w = (area_w - 2 * MARGIN - GAP) / 2;
+}
+
+/**
+ * Widgets
+ * Each redraws its own rectangle and marks it.
+ */
+
+static void draw_fan_row(UINT8 i, const FAN_INFO *fan, BOOLEAN selected) {
+    UINTN y = fans_y + i * FAN_ROW_H;
+    UINTN x = MARGIN;
+    UINTN w = area_w - 2 * MARGIN;
+    UINTN gauge_x = MARGIN + GAUGE_COL * CHAR_W;
+    UINTN gauge_w = w - (GAUGE_COL + NUMBERS_CHARS) * CHAR_W;
+    UINTN gauge_y = y + (FAN_ROW_H - GAUGE_H) / 2;
+    UINT16 range = fan->max_rpm > fan->min_rpm ? fan->max_rpm - fan->min_rpm : 1;
+    const PIXEL *fill_color;
+    const CHAR16 *mode;
+    CHAR16 numbers[24];
+    UINTN fill;
+
+    fill_rect(x, y, w, FAN_ROW_H, selected ? &color_select : &color_background);
+
+    if (selected) {
+        draw_char(x, y + 3, L'>', &color_text);
+    }
+    draw_text(x + 2 * CHAR_W, y + 3, fan->label, MODE_COL - 3, &color_text);
+
+    switch (fan->mode) {
+        case FAN_MODE_MANUAL:
+            mode = L"MAN";
+            break;
+        case FAN_MODE_SENSOR_BASED:
+            mode = L"SENS";
+            break;
+        default:
+            mode = L"AUTO";
+            break;
+    }
+    draw_text(x + MODE_COL * CHAR_W, y + 3, mode, 4, &color_dim);
+
+    // Gauge: RPM between the fan's limits, coloured by how far up it is
+    fill = fan->current_rpm > fan->min_rpm ?
+           (UINTN)(fan->current_rpm - fan->min_rpm) * gauge_w / range : 0;
+    if (fill > gauge_w) {
+        fill = gauge_w;
+    }
+    if (fill * 100 < gauge_w * 60) {
+        fill_color = &color_cool;
+    } else if (fill * 100 < gauge_w * 85) {
+        fill_color = &color_warm;
+    } else {
+        fill_color = &color_hot;
+    }
+    fill_rect(gauge_x, gauge_y, gauge_w, GAUGE_H, &color_panel);
+    fill_rect(gauge_x, gauge_y, fill, GAUGE_H, fill_color);
+
+    if (fan->mode != FAN_MODE_AUTO && fan->target_rpm >= fan->min_rpm) {
+        UINTN target = (UINTN)(fan->target_rpm - fan->min_rpm) * gauge_w / range;
+        if (target >= gauge_w) {
+            target = gauge_w - 2;
+        }
+        fill_rect(gauge_x + target, gauge_y - 3, 2, GAUGE_H + 6, &color_marker);
+    }
+
+    if (fan->mode == FAN_MODE_AUTO) {
+        UnicodeSPrint(numbers, sizeof(numbers), L"%d", fan->current_rpm);
+    } else {
+        UnicodeSPrint(numbers, sizeof(numbers), L"%d/%d", fan->current_rpm, fan->target_rpm);
+    }
+    draw_text(gauge_x + gauge_w + CHAR_W, y + 3, numbers, NUMBERS_CHARS - 1, &color_text);
+
+    mark(x, y, w, FAN_ROW_H);
+}
+
+static void draw_graph(UINT16 g, const TEMP_SENSOR *sensor) {
+    GRAPH *graph = &graphs[g];
+    UINTN x = MARGIN + (g % 2) * (panel_w + GAP);
+    UINTN y = graphs_y + (g / 2) * (PANEL_H + GAP);
+    UINTN plot_x = x + 4;
+    UINTN plot_y = y + CHAR_H + 4;
+    UINTN plot_w = panel_w - 8;
+    INT16 low = 0x7FFF, high = -0x7FFF;
+    CHAR16 caption[64];
+    CHAR16 value[16];
+    UINTN shown, i, col, prev_y = 0;
+    BOOLEAN have_prev = FALSE;
+
+    if (plot_w > DASHBOARD_HISTORY) {
+        plot_w = DASHBOARD_HISTORY;
+    }
+    shown = graph->count < plot_w ? graph->count : plot_w;
+
+    fill_rect(x, y, panel_w, PANEL_H, &color_panel);
+
+    // Caption: key, current reading, description
+    if (sensor->valid) {
+        temp_format_display(sensor->temperature, value, sizeof(value));
+    } else {
+        UnicodeSPrint(value, sizeof(value), L"--");
+    }
+    x = draw_ascii(x + 4, y + 2, sensor->key, &color_text);
+    UnicodeSPrint(caption, sizeof(caption), L" %s  %s", value, sensor->label);
+    draw_text(x, y + 2, caption, (panel_w - 8) / CHAR_W - 4, &color_dim);
+    x = MARGIN + (g % 2) * (panel_w + GAP);
+
+    // Vertical range: the samples on screen, at least 10 degrees
+    for (i = 0; i < shown; i++) {
+        INT16 t = graph->samples[(graph->next + DASHBOARD_HISTORY - shown + i) % DASHBOARD_HISTORY];
+        if (t == NO_SAMPLE) {
+            continue;
+        }
+        if (t < low) low = t;
+        if (t > high) high = t;
+    }
+    if (low > high) {
+        mark(x, y, panel_w, PANEL_H);
+        return;
+    }
+    low = (INT16)(low - (50 + low % 50) % 50);   // Down to a 5-degree line
+    if (high - low < 100) {
+        high = low + 100;
+    }
+
+    // Newest sample at the right edge; a vertical run joins neighbouring samples
+    for (i = 0; i < shown; i++) {
+        INT16 t = graph->samples[(graph->next + DASHBOARD_HISTORY - shown + i) % DASHBOARD_HISTORY];
+        UINTN py;
+
+        col = plot_x + plot_w - shown + i;
+        if (t == NO_SAMPLE) {
+            have_prev = FALSE;
+            continue;
+        }
+        py = plot_y + PLOT_H - 1 - (UINTN)(t - low) * (PLOT_H - 1) / (UINTN)(high - low);
+        if (have_prev && prev_y != py) {
+            UINTN top = prev_y < py ? prev_y : py;
+            UINTN bottom = prev_y < py ? py : prev_y;
+            fill_rect(col, top, 1, bottom - top + 1, &color_trace);
+        } else {
+            fill_rect(col, py, 1, 1, &color_trace);
+        }
+        prev_y = py;
+        have_prev = TRUE;
+    }
+
+    mark(x, y, panel_w, PANEL_H);
+}
+
+static void draw_status(const CHAR16 *status) {
+    UINTN i;
+
+    fill_rect(MARGIN, status_y, area_w - 2 * MARGIN, CHAR_H, &color_background);
+    draw_text(MARGIN, status_y, status, (area_w - 2 * MARGIN) / CHAR_W, &color_text);
+    mark(MARGIN, status_y, area_w - 2 * MARGIN, CHAR_H);
+
+    for (i = 0; status[i] != L'\0' && i + 1 < sizeof(drawn_status) / sizeof(drawn_status[0]); i++) {
+        drawn_status[i] = status[i];
+    }
+    drawn_status[i] = L'\0';
+}
+
+static BOOLEAN status_changed(const CHAR16 *status) {
+    UINTN i = 0;
+
+    while (status[i] != L'\0' && status[i] == drawn_status[i]) {
+        i++;
+    }
+    return status[i] != drawn_status[i];
+}
+
+// Title and key help
+static void draw_static(void) {
+    draw_text(MARGIN, MARGIN, L"Apple SMC Fan Control", 32, &color_text);
+    draw_text(MARGIN, help_y,
+              L"0-9/n select  a auto  m manual  s sensor  +/- adjust  p profile  t sensors  q quit",
+              (area_w - 2 * MARGIN) / CHAR_W, &color_dim);
+}
+
+/**
+ * Pick the graphed sensors and take a sample when one is due
+ */
+static void update_graphs(const FAN_INFO fans[], UINT8 count,
+                          const TEMP_SENSOR sensors[], UINT16 sensor_count, UINT64 now) {
+    UINT16 slots[DASHBOARD_GRAPHS];
+    UINT16 found;
+    UINT16 g, i;
+
+    // Sensors driving fan curves, otherwise the first valid ones
+    found = fan_curve_sensors(fans, count, sensor_count, slots, DASHBOARD_GRAPHS);
+    if (found == 0) {
+        for (i = 0; i < sensor_count && found < DASHBOARD_GRAPHS; i++) {
+            if (sensors[i].valid) {
+                slots[found++] = i;
+            }
+        }
+    }
+
+    for (g = 0; g < found; g++) {
+        if (g >= graph_count || graphs[g].slot != slots[g]) {
+            graphs[g].slot = slots[g];
+            graphs[g].count = 0;
+            graphs[g].next = 0;
+            graphs[g].changed = TRUE;
+        }
+    }
+    if (found != graph_count) {
+        // Panels that came or went
+        full_redraw = TRUE;
+        graph_count = found;
+    }
+
+    if (now < sample_due_us) {
+        return;
+    }
+    sample_due_us = now + (UINT64)DASHBOARD_SAMPLE_MS * 1000;
+
+    for (g = 0; g < graph_count; g++) {
+        GRAPH *graph = &graphs[g];
+        const TEMP_SENSOR *sensor = &sensors[graph->slot];
+
+        graph->samples[graph->next] = sensor->valid ? sensor->temperature : NO_SAMPLE;
+        graph->next = (graph->next + 1) % DASHBOARD_HISTORY;
+        if (graph->count < DASHBOARD_HISTORY) {
+            graph->count++;
+        }
+        graph->changed = TRUE;
+    }
+}
+
+/**
+ * Find the GOP and set up the back buffer
+ */
+EFI_STATUS dashboard_open(void) {
+    EFI_STATUS status;
+    UINTN screen_w, screen_h;
+
+    status = gBS->LocateProtocol(&gop_guid, NULL, (void **)&gop);
+    if (EFI_ERROR(status) || !gop || !gop->Mode || !gop->Mode->Info) {
+        gop = NULL;
+        return EFI_UNSUPPORTED;
+    }
+
+    screen_w = gop->Mode->Info->HorizontalResolution;
+    screen_h = gop->Mode->Info->VerticalResolution;
+    if (screen_w < MIN_WIDTH || screen_h < MIN_HEIGHT) {
+        gop = NULL;
+        return EFI_UNSUPPORTED;
+    }
+
+    area_w = screen_w < DASHBOARD_MAX_WIDTH ? screen_w : DASHBOARD_MAX_WIDTH;
+    area_h = screen_h < DASHBOARD_MAX_HEIGHT ? screen_h : DASHBOARD_MAX_HEIGHT;
+    area_x = (screen_w - area_w) / 2;
+    area_y = (screen_h - area_h) / 2;
+
+    back = AllocatePool(area_w * area_h * sizeof(PIXEL));
+    if (!back) {
+        gop = NULL;
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    graph_count = 0;
+    shown_fans = 0;
+    frame_us = 0;
+    sample_due_us = 0;
+    pending = FALSE;
+    full_redraw = TRUE;
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Release the screen
+ */
+void dashboard_close(void) {
+    if (!gop) {
+        return;
+    }
+    FreePool(back);
+    back = NULL;
+    gop = NULL;
+    gST->ConOut->ClearScreen(gST->ConOut);
+}
+
+BOOLEAN dashboard_due(void) {
+    UINT64 now = timer_now_us();
+
+    if (!gop) {
+        return FALSE;
+    }
+    return (pending && now - frame_us >= (UINT64)DASHBOARD_FRAME_MS * 1000) ||
+           (graph_count > 0 && now >= sample_due_us);
+}
+
+void dashboard_invalidate(void) {
+    full_redraw = TRUE;
+}
+
+/**
+ * Draw a frame
+ */
+void dashboard_render(const FAN_INFO fans[], UINT8 count, INT16 selected_fan,
+                      const TEMP_SENSOR sensors[], UINT16 sensor_count,
+                      const CHAR16 *status) {
+    UINT64 now = timer_now_us();
+    UINT16 g;
+    UINT8 i;
+
+    if (!gop) {
+        return;
+    }
+    if (!full_redraw && now - frame_us < (UINT64)DASHBOARD_FRAME_MS * 1000) {
+        pending = TRUE;
+        return;
+    }
+    pending = FALSE;
+    frame_us = now;
+
+    update_graphs(fans, count, sensors, sensor_count, now);
+
+    if (full_redraw) {
+        // The text console may have drawn anywhere: clear the screen around the area too
+        gop->Blt(gop, (PIXEL *)&color_background, EfiBltVideoFill, 0, 0, 0, 0,
+                 gop->Mode->Info->HorizontalResolution, gop->Mode->Info->VerticalResolution, 0);
+        layout(count);
+        fill_rect(0, 0, area_w, area_h, &color_background);
+        draw_static();
+        for (i = 0; i < shown_fans; i++) {
+            fan_rows[i].drawn = FALSE;
+        }
+        for (g = 0; g < graph_count; g++) {
+            graphs[g].changed = TRUE;
+        }
+        drawn_status[0] = L'\0';
+        dirty_all = TRUE;
+        full_redraw = FALSE;
+    }
+
+    for (i = 0; i < shown_fans; i++) {
+        FAN_ROW *row = &fan_rows[i];
+        BOOLEAN selected = (i == selected_fan);
+
+        if (row->drawn && row->selected == selected && row->mode == fans[i].mode &&
+            row->rpm == fans[i].current_rpm && row->target == fans[i].target_rpm) {
+            continue;
+        }
+        draw_fan_row(i, &fans[i], selected);
+        row->drawn = TRUE;
+        row->selected = selected;
+        row->mode = fans[i].mode;
+        row->rpm = fans[i].current_rpm;
+        row->target = fans[i].target_rpm;
+    }
+
+    for (g = 0; g < graph_count; g++) {
+        if (graphs[g].changed) {
+            draw_graph(g, &sensors[graphs[g].slot]);
+            graphs[g].changed = FALSE;
+        }
+    }
+
+    if (status_changed(status)) {
+        draw_status(status);
+    }
+
+    flush();
+}
@@ -0,0 +1,62 @@
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/PrintLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Graphics dashboard (--graphics)
+ *
+ * Draws the menu on EFI_GRAPHICS_OUTPUT_PROTOCOL: a gauge per fan (RPM
+ * between its limits, with the manual or curve target marked) and a
+ * scrolling graph per sensor driving a fan curve (the first valid sensors
+ * when no curve is set), above the status line and key help.
+ *
+ * Everything is drawn into an off-screen buffer covering the dashboard
+ * only (at most DASHBOARD_MAX_WIDTH x DASHBOARD_MAX_HEIGHT, centred), so
+ * the cost does not grow with the screen resolution. Each widget keeps
+ * what it last drew and is redrawn only when that changes; the changed
+ * rectangles are then copied to the screen with Blt. Frames are at least
+ * DASHBOARD_FRAME_MS apart; a render asked for sooner is held until then.
+ */
+
+// Shortest time between frames, and between graph samples
+#define DASHBOARD_FRAME_MS      100
+#define DASHBOARD_SAMPLE_MS     500
+
+// Graphs shown, and samples kept per graph (at most one per pixel column)
+#define DASHBOARD_GRAPHS        4
+#define DASHBOARD_HISTORY       512
+
+// Largest dashboard area
+#define DASHBOARD_MAX_WIDTH     1024
+#define DASHBOARD_MAX_HEIGHT    768
+
+// Find the GOP and set up the back buffer (EFI_UNSUPPORTED without a usable GOP)
+EFI_STATUS dashboard_open(void);
+
+// Free the back buffer and hand the screen back to the text console
+void dashboard_close(void);
+
+// TRUE when a held frame or a graph sample is due (call dashboard_render then)
+BOOLEAN dashboard_due(void);
+
+// Redraw everything in the next frame (after text was written over the screen)
+void dashboard_invalidate(void);
+
+// Draw a frame from the menu's state, or hold it if the last one was too recent
+void dashboard_render(const FAN_INFO fans[], UINT8 count, INT16 selected_fan,
+                      const TEMP_SENSOR sensors[], UINT16 sensor_count,
+                      const CHAR16 *status);
+
+#endif // DASHBOARD_H
@@ -0,0 +1,204 @@
+#include "fan_calib.h"
+#include "utils.h"
+
+// Samples in the longest step, and in the hold window
+#define STEP_SAMPLES    (FAN_CALIB_TIMEOUT_MS / FAN_CALIB_SAMPLE_MS + 1)
+#define HOLD_SAMPLES    (FAN_CALIB_HOLD_MS / FAN_CALIB_SAMPLE_MS)
+
+// Largest change between the halves of the hold window that still counts as
+// holding; a fan still creeping toward its target drifts by more than this
+#define HOLD_DRIFT      (FAN_CALIB_TOLERANCE / 10)
+
+// One RPM reading, ms after the step's target write
+typedef struct {
+    UINT16 rpm;
+    UINT16 ms;
+} CALIB_SAMPLE;
+
+// Result of one step
+typedef struct {
+    UINT16 reached;       // Mean RPM over the hold window
+    UINT16 lag_ms;
+    UINT16 settle_ms;
+} CALIB_STEP;
+
+// Too large for the UEFI stack
+static CALIB_SAMPLE samples[STEP_SAMPLES];
+
+static UINT16 rpm_distance(UINT16 a, UINT16 b) {
+    return a > b ? a - b : b - a;
+}
+
+/**
+ * Has the RPM held over the last HOLD_SAMPLES samples?
+ * All within the tolerance band, and the two halves' means (HOLD_SAMPLES / 2
+ * samples each) no further apart than HOLD_DRIFT.
+ */
+static BOOLEAN holding(UINTN count) {
+    UINT16 low = 0xFFFF, high = 0;
+    UINT32 early = 0, late = 0;
+    UINTN i, first;
+
+    if (count < HOLD_SAMPLES) {
+        return FALSE;
+    }
+    first = count - HOLD_SAMPLES;
+    for (i = first; i < count; i++) {
+        if (samples[i].rpm < low) {
+            low = samples[i].rpm;
+        }
+        if (samples[i].rpm > high) {
+            high = samples[i].rpm;
+        }
+        if (i < first + HOLD_SAMPLES / 2) {
+            early += samples[i].rpm;
+        } else {
+            late += samples[i].rpm;
+        }
+    }
+    if (high - low > 2 * FAN_CALIB_TOLERANCE) {
+        return FALSE;
+    }
+    early /= HOLD_SAMPLES / 2;
+    late /= HOLD_SAMPLES - HOLD_SAMPLES / 2;
+    return rpm_distance((UINT16)early, (UINT16)late) <= HOLD_DRIFT;
+}
+
+/**
+ * Write a target and sample the RPM until it holds
+ */
+static EFI_STATUS run_step(const FAN_INFO *fan, UINT16 target, CALIB_STEP *step) {
+    UINT16 start_rpm = 0;
+    UINT32 sum = 0;
+    UINT64 start_us, due_us, now;
+    UINTN count = 0;
+    UINTN window;
+    UINTN i;
+    EFI_STATUS status;
+
+    status = fan_read_rpm_fresh(fan->index, &start_rpm);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    status = fan_set_target_rpm(fan->index, target);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    start_us = timer_now_us();
+
+    // Fresh reads: a cached value from the resident driver would quantise lag and settle
+    while (count < STEP_SAMPLES) {
+        // Sample on a fixed schedule; a slow read delays only the next sample
+        due_us = start_us + (UINT64)count * FAN_CALIB_SAMPLE_MS * 1000;
+        now = timer_now_us();
+        if (now < due_us) {
+            gBS->Stall((UINTN)(due_us - now));
+            now = timer_now_us();
+        }
+
+        status = fan_read_rpm_fresh(fan->index, &samples[count].rpm);
+        if (EFI_ERROR(status)) {
+            return status;
+        }
+        samples[count].ms = (UINT16)((now - start_us) / 1000);
+        count++;
+
+        if (holding(count)) {
+            break;
+        }
+    }
+
+    window = count < HOLD_SAMPLES ? count : HOLD_SAMPLES;
+    for (i = count - window; i < count; i++) {
+        sum += samples[i].rpm;
+    }
+    step->reached = (UINT16)(sum / window);
+
+    // Within the tolerance the fan got there; only a clear shortfall narrows its reach
+    if (rpm_distance(step->reached, target) <= FAN_CALIB_TOLERANCE) {
+        step->reached = target;
+    }
+
+    // Lag: first sample out of the band around the start (none if the step was too small)
+    step->lag_ms = 0;
+    for (i = 0; i < count; i++) {
+        if (rpm_distance(samples[i].rpm, start_rpm) > FAN_CALIB_TOLERANCE) {
+            step->lag_ms = samples[i].ms;
+            break;
+        }
+    }
+
+    // Settle: just after the last sample out of the band around the end
+    step->settle_ms = 0;
+    i = count;
+    while (i > 0) {
+        i--;
+        if (rpm_distance(samples[i].rpm, step->reached) > FAN_CALIB_TOLERANCE) {
+            step->settle_ms = (i + 1 < count) ? samples[i + 1].ms : samples[i].ms;
+            break;
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+/**
+ * Step a fan through its range and record its response
+ */
+EFI_STATUS fan_calibrate(FAN_INFO *fan) {
+    FAN_MODEL model = { 0 };
+    CALIB_STEP step;
+    EFI_STATUS status;
+    EFI_STATUS restore;
+    UINTN s;
+
+    if (!fan || fan->max_rpm == 0 || fan->min_rpm >= fan->max_rpm) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = fan_set_manual_mode(fan->index, TRUE);
+
+    // Settle at the bottom first; only the steps from there are timed
+    if (!EFI_ERROR(status)) {
+        status = run_step(fan, fan->min_rpm, &step);
+        model.reach_min = step.reached;
+    }
+
+    // Up through the range, then the full drop back to the minimum
+    for (s = 1; s <= FAN_CALIB_STEPS && !EFI_ERROR(status); s++) {
+        UINT16 target = fan->min_rpm;
+
+        if (s < FAN_CALIB_STEPS) {
+            target = (UINT16)(fan->min_rpm +
+                              (UINT32)(fan->max_rpm - fan->min_rpm) * s / (FAN_CALIB_STEPS - 1));
+        }
+        status = run_step(fan, target, &step);
+        if (EFI_ERROR(status)) {
+            break;
+        }
+        if (s == FAN_CALIB_STEPS - 1) {
+            model.reach_max = step.reached;
+        }
+        if (step.lag_ms > model.lag_ms) {
+            model.lag_ms = step.lag_ms;
+        }
+        if (step.settle_ms > model.settle_ms) {
+            model.settle_ms = step.settle_ms;
+        }
+    }
+
+    // Back to the mode the fan had
+    if (fan->mode == FAN_MODE_AUTO) {
+        restore = fan_set_manual_mode(fan->index, FALSE);
+    } else {
+        restore = fan_set_target_rpm(fan->index, fan->target_rpm);
+    }
+
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    if (model.reach_max <= model.reach_min) {
+        return EFI_DEVICE_ERROR;  // The fan did not follow its target
+    }
+    fan->model = model;
+    return restore;
+}
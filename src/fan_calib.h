@@ -0,0 +1,46 @@
+#ifndef FAN_CALIB_H
+#define FAN_CALIB_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+
+/**
+ * Fan response calibration (--calibrate)
+ *
+ * Puts a fan in manual mode and steps its target from the minimum to the
+ * maximum RPM in FAN_CALIB_STEPS steps and back down to the minimum,
+ * sampling the actual RPM every FAN_CALIB_SAMPLE_MS. A step ends when the
+ * RPM has held within FAN_CALIB_TOLERANCE, and stopped drifting, for
+ * FAN_CALIB_HOLD_MS (or after FAN_CALIB_TIMEOUT_MS). From the samples it
+ * fills the fan's FAN_MODEL:
+ *
+ *   reach_min / reach_max   RPM held at the bottom and top steps (the
+ *                           target itself when within the tolerance)
+ *   lag_ms                  target write to the RPM leaving the tolerance
+ *                           band around where it started (slowest step)
+ *   settle_ms               target write to the last sample outside the
+ *                           band around where it ended (slowest step)
+ *
+ * Runs on the BSP with the SMC to itself, before the menu starts; a fan
+ * takes 5-75 s. Afterwards the fan is back in the mode it had.
+ */
+
+#define FAN_CALIB_SAMPLE_MS     10
+#define FAN_CALIB_STEPS         4       // Targets from min to max RPM, ends included
+#define FAN_CALIB_HOLD_MS       1000
+#define FAN_CALIB_TOLERANCE     50      // RPM
+#define FAN_CALIB_TIMEOUT_MS    15000
+
+// Measure a fan's response and store it in fan->model
+// EFI_INVALID_PARAMETER if the fan has no usable limits; otherwise the first SMC error
+EFI_STATUS fan_calibrate(FAN_INFO *fan);
+
+#endif // FAN_CALIB_H
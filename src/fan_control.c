@@ -1,21 +1,62 @@
 #include "fan_control.h"
 #include "smc_protocol.h"
+#include "smc_codec.h"
 #include "utils.h"
 
-// SMC key suffixes for fan control
-#define KEY_ACTUAL_RPM  "Ac"  // Actual RPM (read)
-#define KEY_MIN_RPM     "Mn"  // Minimum RPM (read)
-#define KEY_MAX_RPM     "Mx"  // Maximum RPM (read)
-#define KEY_MODE        "Md"  // Mode (0=auto, 1=manual)
-#define KEY_TARGET_RPM  "Tg"  // Target RPM (write in manual mode)
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+#endif
+
+// Convert a decoded RPM value to whole RPM
+static UINT16 fixed_to_rpm(SMC_FIXED value) {
+    if (value <= 0) {
+        return 0;
+    }
+    value /= SMC_FIXED_ONE;
+    return (value > 0xFFFF) ? 0xFFFF : (UINT16)value;
+}
+
+// Fans found by the last discovery, and those the SMC is running in manual
+// mode as far as we know (bit n = fan index n; used by restore)
+static UINT64 fan_present_mask = 0;
+static UINT64 fan_manual_mask = 0;
+
+#define FAN_BIT(fan_index) (1ULL << (fan_index))
 
 // Build SMC key for fan operation
-// Format: F[0-5][Ac|Mn|Mx|Md|Tg]
-static void build_fan_key(UINT8 fan_index, const CHAR8 *suffix, CHAR8 key[4]) {
-    key[0] = 'F';
-    key[1] = '0' + fan_index;
-    key[2] = suffix[0];
-    key[3] = suffix[1];
+// Format: F[0-9A-Z][Ac|Mn|Mx|Md|Tg]
+static inline SMC_KEY fan_key(UINT8 fan_index, SMC_KEY suffix) {
+    CHAR8 digit = (fan_index < 10) ? ('0' + fan_index) : ('A' + (fan_index - 10));
+    return SMC_KEY_CONST('F', digit, 0, 0) | suffix;
+}
+
+/**
+ * Build the SMC key F<n><suffix> for a fan
+ */
+SMC_KEY fan_smc_key(UINT8 fan_index, SMC_KEY suffix) {
+    return fan_key(fan_index, suffix);
+}
+
+/**
+ * Decode RPM bytes read from a fan key
+ * For completion callbacks of async reads; uses the cached key type
+ */
+EFI_STATUS fan_decode_rpm(SMC_KEY key, const UINT8 *data, UINT8 data_len, UINT16 *rpm) {
+    SMC_FIXED value;
+    EFI_STATUS status;
+
+    if (!rpm) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = smc_codec_decode_key(key, SMC_TYPE_FPE2, data, data_len, &value);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    *rpm = fixed_to_rpm(value);
+
+    return EFI_SUCCESS;
 }
 
 /**
@@ -27,45 +68,72 @@ EFI_STATUS fan_init(void) {
 }
 
 /**
- * Read current fan RPM
+ * Read number of fans reported by the SMC
  */
-EFI_STATUS fan_read_rpm(UINT8 fan_index, UINT16 *rpm) {
-    CHAR8 key[4];
+EFI_STATUS fan_read_count(UINT8 *count) {
     UINT8 data[32];
     UINT8 data_len = 0;
     EFI_STATUS status;
 
-    if (fan_index >= MAX_FANS || !rpm) {
+    if (!count) {
         return EFI_INVALID_PARAMETER;
     }
 
-    // Build key F[n]Ac
-    build_fan_key(fan_index, KEY_ACTUAL_RPM, key);
-
-    // Read SMC key
-    status = smc_read_key(key, data, &data_len);
+    status = smc_read_key(SMC_KEY_FNUM, data, &data_len);
     if (EFI_ERROR(status)) {
         return status;
     }
 
-    // Verify we got 2 bytes (fpe2 format)
-    if (data_len < 2) {
+    if (data_len < 1) {
         return EFI_DEVICE_ERROR;
     }
 
-    // Decode fpe2 to RPM
-    *rpm = decode_fpe2(data);
+    *count = data[0];
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Read current fan RPM
+ */
+static EFI_STATUS read_rpm(UINT8 fan_index, BOOLEAN fresh, UINT16 *rpm) {
+    SMC_KEY key;
+    SMC_FIXED value;
+    EFI_STATUS status;
+
+    if (fan_index >= MAX_FANS || !rpm) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    // Read SMC key F[n]Ac (fpe2 on older Macs, flt on T2)
+    key = fan_key(fan_index, FAN_KEY_ACTUAL_RPM);
+    if (fresh) {
+        status = smc_codec_read_fresh(key, SMC_TYPE_FPE2, &value);
+    } else {
+        status = smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    }
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    *rpm = fixed_to_rpm(value);
 
     return EFI_SUCCESS;
 }
 
+EFI_STATUS fan_read_rpm(UINT8 fan_index, UINT16 *rpm) {
+    return read_rpm(fan_index, FALSE, rpm);
+}
+
+EFI_STATUS fan_read_rpm_fresh(UINT8 fan_index, UINT16 *rpm) {
+    return read_rpm(fan_index, TRUE, rpm);
+}
+
 /**
  * Read fan min/max RPM limits
  */
 EFI_STATUS fan_read_min_max(UINT8 fan_index, UINT16 *min_rpm, UINT16 *max_rpm) {
-    CHAR8 key[4];
-    UINT8 data[32];
-    UINT8 data_len = 0;
+    SMC_FIXED value;
     EFI_STATUS status;
 
     if (fan_index >= MAX_FANS || !min_rpm || !max_rpm) {
@@ -73,27 +141,18 @@ EFI_STATUS fan_read_min_max(UINT8 fan_index, UINT16 *min_rpm, UINT16 *max_rpm) {
     }
 
     // Read minimum RPM
-    build_fan_key(fan_index, KEY_MIN_RPM, key);
-    status = smc_read_key(key, data, &data_len);
+    status = smc_codec_read(fan_key(fan_index, FAN_KEY_MIN_RPM), SMC_TYPE_FPE2, &value);
     if (EFI_ERROR(status)) {
         return status;
     }
-    if (data_len < 2) {
-        return EFI_DEVICE_ERROR;
-    }
-    *min_rpm = decode_fpe2(data);
+    *min_rpm = fixed_to_rpm(value);
 
     // Read maximum RPM
-    build_fan_key(fan_index, KEY_MAX_RPM, key);
-    data_len = 0;
-    status = smc_read_key(key, data, &data_len);
+    status = smc_codec_read(fan_key(fan_index, FAN_KEY_MAX_RPM), SMC_TYPE_FPE2, &value);
     if (EFI_ERROR(status)) {
         return status;
     }
-    if (data_len < 2) {
-        return EFI_DEVICE_ERROR;
-    }
-    *max_rpm = decode_fpe2(data);
+    *max_rpm = fixed_to_rpm(value);
 
     return EFI_SUCCESS;
 }
@@ -102,7 +161,6 @@ EFI_STATUS fan_read_min_max(UINT8 fan_index, UINT16 *min_rpm, UINT16 *max_rpm) {
  * Check if fan is in manual mode (at SMC level)
  */
 EFI_STATUS fan_get_mode(UINT8 fan_index, BOOLEAN *is_manual) {
-    CHAR8 key[4];
     UINT8 data[32];
     UINT8 data_len = 0;
     EFI_STATUS status;
@@ -111,11 +169,8 @@ EFI_STATUS fan_get_mode(UINT8 fan_index, BOOLEAN *is_manual) {
         return EFI_INVALID_PARAMETER;
     }
 
-    // Build key F[n]Md
-    build_fan_key(fan_index, KEY_MODE, key);
-
-    // Read SMC key
-    status = smc_read_key(key, data, &data_len);
+    // Read SMC key F[n]Md
+    status = smc_read_key(fan_key(fan_index, FAN_KEY_MODE), data, &data_len);
     if (EFI_ERROR(status)) {
         return status;
     }
@@ -168,7 +223,7 @@ UINT16 fan_calculate_rpm_from_temp(INT16 current_temp, INT16 min_temp, INT16 max
  * Enable/disable sensor-based control for a fan
  */
 EFI_STATUS fan_set_sensor_based_mode(UINT8 fan_index, BOOLEAN enable,
-                                     UINT8 sensor_index, INT16 min_temp, INT16 max_temp) {
+                                     UINT16 sensor_index, INT16 min_temp, INT16 max_temp) {
     EFI_STATUS status;
 
     if (fan_index >= MAX_FANS) {
@@ -193,6 +248,98 @@ EFI_STATUS fan_set_sensor_based_mode(UINT8 fan_index, BOOLEAN enable,
     return EFI_SUCCESS;
 }
 
+/**
+ * Clamp an RPM to what the fan can do
+ * The SMC's limits, narrowed to the measured range when there is a model:
+ * below reach_min the fan holds reach_min anyway, above reach_max it stalls.
+ */
+UINT16 fan_reachable_rpm(const FAN_INFO *fan, UINT16 rpm) {
+    UINT16 low = fan->min_rpm;
+    UINT16 high = fan->max_rpm;
+
+    if (fan->model.reach_max > 0) {
+        if (fan->model.reach_min > low) {
+            low = fan->model.reach_min;
+        }
+        if (fan->model.reach_max < high || high == 0) {
+            high = fan->model.reach_max;
+        }
+    }
+    if (high == 0 || low > high) {
+        return rpm;  // No limits known
+    }
+    return clamp_rpm(rpm, low, high);
+}
+
+/**
+ * Write a target for a discovered fan
+ * Its limits were read at discovery: one write instead of three transactions.
+ */
+static EFI_STATUS write_target(const FAN_INFO *fan, UINT16 rpm) {
+    if (fan->max_rpm == 0) {
+        return fan_set_target_rpm(fan->index, fan_reachable_rpm(fan, rpm));
+    }
+    return smc_codec_write(fan_key(fan->index, FAN_KEY_TARGET_RPM), SMC_TYPE_FPE2,
+                           (SMC_FIXED)fan_reachable_rpm(fan, rpm) * SMC_FIXED_ONE);
+}
+
+/**
+ * Temperature a curve is evaluated at
+ * With a response model, a rising temperature is projected over the time
+ * the fan takes to respond (lag plus settling), so the fan starts early
+ * instead of arriving after the heat. The slope is taken once per window
+ * so sensor noise is not amplified; falling temperatures are used as read,
+ * so the fan never slows down ahead of time.
+ */
+static INT16 lead_temperature(FAN_INFO *fan, INT16 temp) {
+    UINT64 now;
+
+    if (fan->model.settle_ms == 0) {
+        return temp;
+    }
+
+    now = timer_now_us();
+    if (fan->window_us == 0 || now < fan->window_us) {
+        fan->lead_temp = 0;
+        fan->window_temp = temp;
+        fan->window_us = now;
+    } else if (now - fan->window_us >= (UINT64)FAN_LEAD_WINDOW_MS * 1000) {
+        INT32 rise = temp - fan->window_temp;
+        INT32 lead = 0;
+
+        if (rise > FAN_LEAD_DEADBAND) {
+            UINT64 response_us = ((UINT64)fan->model.lag_ms + fan->model.settle_ms) * 1000;
+
+            lead = (INT32)((UINT64)rise * response_us / (now - fan->window_us));
+            if (lead > FAN_LEAD_MAX) {
+                lead = FAN_LEAD_MAX;
+            }
+        }
+        fan->lead_temp = (INT16)lead;
+        fan->window_temp = temp;
+        fan->window_us = now;
+    }
+    return (INT16)(temp + fan->lead_temp);
+}
+
+/**
+ * Look a temperature up in a compiled curve, interpolating between degrees
+ */
+static UINT16 curve_lookup(const UINT16 *curve, INT16 temp) {
+    INT32 degree = temp / 10;
+    INT32 low, high;
+
+    if (temp <= 0) {
+        return curve[0];
+    }
+    if (degree >= FAN_CURVE_STEPS - 1) {
+        return curve[FAN_CURVE_STEPS - 1];
+    }
+    low = curve[degree];
+    high = curve[degree + 1];
+    return (UINT16)(low + (high - low) * (temp % 10) / 10);
+}
+
 /**
  * Update fan speed based on current temperature
  * Call this periodically for fans in sensor-based mode
@@ -208,37 +355,123 @@ EFI_STATUS fan_update_sensor_based(FAN_INFO *fan, INT16 current_temp) {
         return EFI_SUCCESS;  // Not in sensor-based mode
     }
 
-    // Calculate target RPM based on temperature
+    current_temp = lead_temperature(fan, current_temp);
+
+    if (fan->curve) {
+        // Compiled curves are already within the fan's limits: a lookup and one write
+        target_rpm = curve_lookup(fan->curve, current_temp);
+        fan->target_rpm = target_rpm;
+        return write_target(fan, target_rpm);
+    }
+
+    // Calculate target RPM based on temperature, across the range the fan reaches
     target_rpm = fan_calculate_rpm_from_temp(current_temp,
                                              fan->min_temp,
                                              fan->max_temp,
-                                             fan->min_rpm,
-                                             fan->max_rpm);
+                                             fan_reachable_rpm(fan, fan->min_rpm),
+                                             fan_reachable_rpm(fan, fan->max_rpm));
 
     // Set the target RPM
     fan->target_rpm = target_rpm;
-    return fan_set_target_rpm(fan->index, target_rpm);
+    return write_target(fan, target_rpm);
+}
+
+/**
+ * List the sensors driving enabled fan curves
+ */
+UINT16 fan_curve_sensors(const FAN_INFO fans[], UINT8 count, UINT16 sensor_count,
+                         UINT16 slots[], UINT16 max) {
+    UINT16 found = 0;
+    UINT16 i, j;
+
+    for (i = 0; i < count && found < max; i++) {
+        UINT16 slot = fans[i].sensor_index;
+
+        if (fans[i].mode != FAN_MODE_SENSOR_BASED || !fans[i].sensor_based_enabled ||
+            slot >= sensor_count) {
+            continue;
+        }
+        j = 0;
+        while (j < found && slots[j] != slot) {
+            j++;
+        }
+        if (j == found) {
+            slots[found++] = slot;
+        }
+    }
+    return found;
+}
+
+/**
+ * Apply mode, target and curve settings to a fan
+ * SMC writes happen only for a mode change or a new manual target; curve
+ * settings are bookkeeping picked up by fan_update_sensor_based(). The
+ * target is clamped first, so target_rpm holds what was written.
+ */
+EFI_STATUS fan_apply_config(FAN_INFO *fan, const FAN_INFO *config) {
+    EFI_STATUS status;
+    BOOLEAN mode_changed;
+    UINT16 target_rpm;
+
+    if (!fan || !config) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    mode_changed = (config->mode != fan->mode);
+    target_rpm = fan_reachable_rpm(fan, config->target_rpm);
+
+    if (mode_changed) {
+        // Manual and sensor-based both run the SMC in manual mode
+        status = fan_set_manual_mode(fan->index, config->mode != FAN_MODE_AUTO);
+        if (EFI_ERROR(status)) {
+            return status;
+        }
+        fan->mode = config->mode;
+    }
+
+    if (config->mode == FAN_MODE_MANUAL &&
+        (mode_changed || target_rpm != fan->target_rpm)) {
+        status = write_target(fan, target_rpm);
+        if (EFI_ERROR(status)) {
+            return status;
+        }
+    }
+
+    fan->target_rpm = target_rpm;
+    fan->sensor_based_enabled = config->sensor_based_enabled;
+    fan->sensor_index = config->sensor_index;
+    fan->min_temp = config->min_temp;
+    fan->max_temp = config->max_temp;
+    fan->curve = config->curve;
+
+    return EFI_SUCCESS;
 }
 
 /**
  * Set fan to manual or automatic mode
  */
 EFI_STATUS fan_set_manual_mode(UINT8 fan_index, BOOLEAN enable) {
-    CHAR8 key[4];
     UINT8 data[1];
+    EFI_STATUS status;
 
     if (fan_index >= MAX_FANS) {
         return EFI_INVALID_PARAMETER;
     }
 
-    // Build key F[n]Md
-    build_fan_key(fan_index, KEY_MODE, key);
-
     // Set mode: 0 = auto, 1 = manual
     data[0] = enable ? 1 : 0;
 
-    // Write SMC key
-    return smc_write_key(key, data, 1);
+    // Write SMC key F[n]Md
+    status = smc_write_key(fan_key(fan_index, FAN_KEY_MODE), data, 1);
+
+    // Remember manual fans for restore; a failed write may still have landed
+    if (enable) {
+        fan_manual_mask |= FAN_BIT(fan_index);
+    } else if (!EFI_ERROR(status)) {
+        fan_manual_mask &= ~FAN_BIT(fan_index);
+    }
+
+    return status;
 }
 
 /**
@@ -246,8 +479,6 @@ EFI_STATUS fan_set_manual_mode(UINT8 fan_index, BOOLEAN enable) {
  * RPM value is clamped to safe range
  */
 EFI_STATUS fan_set_target_rpm(UINT8 fan_index, UINT16 rpm) {
-    CHAR8 key[4];
-    UINT8 data[2];
     UINT16 min_rpm, max_rpm;
     UINT16 clamped_rpm;
     EFI_STATUS status;
@@ -265,30 +496,46 @@ EFI_STATUS fan_set_target_rpm(UINT8 fan_index, UINT16 rpm) {
     // Clamp RPM to safe range
     clamped_rpm = clamp_rpm(rpm, min_rpm, max_rpm);
 
-    // Build key F[n]Tg
-    build_fan_key(fan_index, KEY_TARGET_RPM, key);
-
-    // Encode RPM to fpe2 format
-    encode_fpe2(clamped_rpm, data);
-
-    // Write SMC key
-    return smc_write_key(key, data, 2);
+    // Write SMC key F[n]Tg, encoded in the key's own type
+    return smc_codec_write(fan_key(fan_index, FAN_KEY_TARGET_RPM), SMC_TYPE_FPE2,
+                           (SMC_FIXED)clamped_rpm * SMC_FIXED_ONE);
 }
 
 /**
- * Discover all available fans and populate info array
+ * Discover all available fans and allocate info array
+ * Uses FNum to size the probe; falls back to FAN_PROBE_FALLBACK indices
  */
-EFI_STATUS fan_discover_all(FAN_INFO fans[], UINT8 *count) {
+EFI_STATUS fan_discover_all(FAN_INFO **fans, UINT8 *count) {
     UINT8 i;
+    UINT8 probe_count;
     UINT8 fan_count = 0;
+    FAN_INFO *list;
     EFI_STATUS status;
 
     if (!fans || !count) {
         return EFI_INVALID_PARAMETER;
     }
 
-    // Try to detect up to MAX_FANS fans
-    for (i = 0; i < MAX_FANS; i++) {
+    *fans = NULL;
+    *count = 0;
+
+    // Ask the SMC how many fans it drives
+    status = fan_read_count(&probe_count);
+    if (EFI_ERROR(status) || probe_count == 0) {
+        probe_count = FAN_PROBE_FALLBACK;
+    }
+    if (probe_count > MAX_FANS) {
+        probe_count = MAX_FANS;
+    }
+    fan_present_mask = 0;
+    fan_manual_mask = 0;
+
+    list = AllocateZeroPool(probe_count * sizeof(FAN_INFO));
+    if (!list) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    for (i = 0; i < probe_count; i++) {
         UINT16 rpm;
 
         // Try to read current RPM to see if fan exists
@@ -299,17 +546,17 @@ EFI_STATUS fan_discover_all(FAN_INFO fans[], UINT8 *count) {
         }
 
         // Fan exists, populate info
-        fans[fan_count].index = i;
-        format_fan_label(i, fans[fan_count].label, sizeof(fans[fan_count].label) / sizeof(CHAR16));
+        list[fan_count].index = i;
+        format_fan_label(i, list[fan_count].label, sizeof(list[fan_count].label) / sizeof(CHAR16));
 
-        fans[fan_count].current_rpm = rpm;
+        list[fan_count].current_rpm = rpm;
 
         // Read min/max
-        status = fan_read_min_max(i, &fans[fan_count].min_rpm, &fans[fan_count].max_rpm);
+        status = fan_read_min_max(i, &list[fan_count].min_rpm, &list[fan_count].max_rpm);
         if (EFI_ERROR(status)) {
             // Use safe defaults if can't read
-            fans[fan_count].min_rpm = 600;
-            fans[fan_count].max_rpm = 5200;
+            list[fan_count].min_rpm = 600;
+            list[fan_count].max_rpm = 5200;
         }
 
         // Read SMC mode
@@ -320,41 +567,73 @@ EFI_STATUS fan_discover_all(FAN_INFO fans[], UINT8 *count) {
         }
 
         // Set mode (default to auto)
-        fans[fan_count].mode = smc_manual ? FAN_MODE_MANUAL : FAN_MODE_AUTO;
+        list[fan_count].mode = smc_manual ? FAN_MODE_MANUAL : FAN_MODE_AUTO;
+        fan_present_mask |= FAN_BIT(i);
+        if (smc_manual) {
+            fan_manual_mask |= FAN_BIT(i);
+        }
 
         // Target RPM (same as current for now)
-        fans[fan_count].target_rpm = rpm;
+        list[fan_count].target_rpm = rpm;
 
         // Initialize sensor-based settings
-        fans[fan_count].sensor_based_enabled = FALSE;
-        fans[fan_count].sensor_index = 0;
-        fans[fan_count].min_temp = 400;  // 40.0°C
-        fans[fan_count].max_temp = 800;  // 80.0°C
+        list[fan_count].sensor_based_enabled = FALSE;
+        list[fan_count].sensor_index = 0;
+        list[fan_count].min_temp = 400;  // 40.0°C
+        list[fan_count].max_temp = 800;  // 80.0°C
 
         fan_count++;
     }
 
+    if (fan_count == 0) {
+        FreePool(list);
+        return EFI_NOT_FOUND;
+    }
+
+    *fans = list;
     *count = fan_count;
 
-    return (fan_count > 0) ? EFI_SUCCESS : EFI_NOT_FOUND;
+    return EFI_SUCCESS;
 }
 
 /**
- * Restore all fans to automatic mode (safety function)
+ * Free fan info array returned by fan_discover_all
+ */
+void fan_free_all(FAN_INFO *fans) {
+    if (fans) {
+        FreePool(fans);
+    }
+}
+
+/**
+ * Restore fans to automatic mode (safety function)
+ * Only discovered fans in manual mode are written, in one pass that holds
+ * the bus throughout. Safe at TPL_NOTIFY (no allocation, no console output),
+ * so it can run from an ExitBootServices notification.
  */
 EFI_STATUS fan_restore_auto_mode_all(void) {
-    UINT8 i;
+    UINT64 pending = fan_present_mask & fan_manual_mask;
     EFI_STATUS status;
     EFI_STATUS last_error = EFI_SUCCESS;
+    EFI_TPL old_tpl;
+    UINT8 i;
 
-    // Try to restore all fans to auto mode
+    if (pending == 0) {
+        return EFI_SUCCESS;
+    }
+
+    old_tpl = smc_bus_enter();
     for (i = 0; i < MAX_FANS; i++) {
+        if (!(pending & FAN_BIT(i))) {
+            continue;
+        }
         status = fan_set_manual_mode(i, FALSE);
-        if (EFI_ERROR(status) && status != EFI_NOT_FOUND) {
+        if (EFI_ERROR(status)) {
             // Track last error but continue with other fans
             last_error = status;
         }
     }
+    smc_bus_leave(old_tpl);
 
     return last_error;
 }
@@ -9,9 +9,25 @@
   #include <Uefi.h>
   #include <Library/UefiLib.h>
 #endif
+#include "smc_protocol.h"
 
-// Maximum number of fans supported
-#define MAX_FANS 6
+// Maximum number of fans addressable through F<n>xx keys
+// Indices 0-9 use a decimal digit, 10-35 continue with 'A'-'Z'
+#define MAX_FANS 36
+
+// Entries in a compiled fan curve: target RPM per whole degree C from 0
+#define FAN_CURVE_STEPS 128
+
+// Number of fan indices probed when the FNum key cannot be read
+// (matches the 6-fan layout of the Mac Pro 4,1/5,1)
+#define FAN_PROBE_FALLBACK 6
+
+// SMC key suffixes for fan keys (low half of the FourCC)
+#define FAN_KEY_ACTUAL_RPM  SMC_KEY_CONST(0, 0, 'A', 'c')  // Actual RPM (read)
+#define FAN_KEY_MIN_RPM     SMC_KEY_CONST(0, 0, 'M', 'n')  // Minimum RPM (read)
+#define FAN_KEY_MAX_RPM     SMC_KEY_CONST(0, 0, 'M', 'x')  // Maximum RPM (read)
+#define FAN_KEY_MODE        SMC_KEY_CONST(0, 0, 'M', 'd')  // Mode (0=auto, 1=manual)
+#define FAN_KEY_TARGET_RPM  SMC_KEY_CONST(0, 0, 'T', 'g')  // Target RPM (write in manual mode)
 
 // Fan control modes
 typedef enum {
@@ -20,9 +36,23 @@ typedef enum {
     FAN_MODE_SENSOR_BASED = 2    // Sensor-based (automatic based on temperature)
 } FAN_MODE;
 
+// Measured response of a fan (see fan_calib.h), all zero until calibrated
+typedef struct {
+    UINT16 reach_min;         // Lowest RPM the fan holds
+    UINT16 reach_max;         // Highest RPM the fan reaches
+    UINT16 lag_ms;            // Target write to the first RPM change (slowest step)
+    UINT16 settle_ms;         // Target write to holding the new RPM (slowest step)
+} FAN_MODEL;
+
+// Feed-forward on rising temperatures: slope measured over a window, rises
+// within the dead band ignored as sensor noise, lead capped (decidegrees C)
+#define FAN_LEAD_WINDOW_MS  2000
+#define FAN_LEAD_DEADBAND   3
+#define FAN_LEAD_MAX        50
+
 // Fan information structure
 typedef struct {
-    UINT8 index;              // 0-5
+    UINT8 index;              // SMC fan index (F<n>xx)
     CHAR16 label[16];         // "PCI", "PS", "EXHAUST", etc.
     UINT16 current_rpm;       // Current fan speed
     UINT16 target_rpm;        // Target speed (manual/sensor mode)
@@ -32,9 +62,17 @@ typedef struct {
 
     // Sensor-based control settings
     BOOLEAN sensor_based_enabled;  // TRUE if sensor-based control active
-    UINT8 sensor_index;            // Index of temperature sensor to use
+    UINT16 sensor_index;           // Index of temperature sensor to use
     INT16 min_temp;                // Minimum temperature (decidegrees C)
     INT16 max_temp;                // Maximum temperature (decidegrees C)
+    const UINT16 *curve;           // Compiled curve (FAN_CURVE_STEPS entries, see
+                                   // fan_profile.h), NULL for linear min/max_temp
+
+    // Response model, and the feed-forward state (see fan_update_sensor_based)
+    FAN_MODEL model;
+    INT16 lead_temp;               // Lead added to the temperature read
+    INT16 window_temp;             // Temperature at the start of the slope window
+    UINT64 window_us;              // Start of the slope window, 0 before the first reading
 } FAN_INFO;
 
 /**
@@ -44,16 +82,32 @@ typedef struct {
 // Initialize fan control system
 EFI_STATUS fan_init(void);
 
-// Discover all available fans and populate info array
-EFI_STATUS fan_discover_all(FAN_INFO fans[], UINT8 *count);
+// Read number of fans reported by the SMC (FNum key)
+EFI_STATUS fan_read_count(UINT8 *count);
+
+// Discover all available fans and allocate the info array (free with fan_free_all)
+EFI_STATUS fan_discover_all(FAN_INFO **fans, UINT8 *count);
+
+// Free fan info array returned by fan_discover_all
+void fan_free_all(FAN_INFO *fans);
 
 /**
  * Fan reading functions
  */
 
+// Build the SMC key F<n><suffix> for a fan
+SMC_KEY fan_smc_key(UINT8 fan_index, SMC_KEY suffix);
+
+// Decode RPM bytes read from a fan key (uses cached key type, no SMC traffic)
+EFI_STATUS fan_decode_rpm(SMC_KEY key, const UINT8 *data, UINT8 data_len, UINT16 *rpm);
+
 // Read current fan RPM
 EFI_STATUS fan_read_rpm(UINT8 fan_index, UINT16 *rpm);
 
+// Read current fan RPM from the SMC itself (not the resident driver's value
+// cache), for measurements that need every sample to be new
+EFI_STATUS fan_read_rpm_fresh(UINT8 fan_index, UINT16 *rpm);
+
 // Read fan min/max RPM limits
 EFI_STATUS fan_read_min_max(UINT8 fan_index, UINT16 *min_rpm, UINT16 *max_rpm);
 
@@ -70,26 +124,40 @@ EFI_STATUS fan_set_manual_mode(UINT8 fan_index, BOOLEAN enable);
 // Set target RPM (only in manual mode, value will be clamped to min/max)
 EFI_STATUS fan_set_target_rpm(UINT8 fan_index, UINT16 rpm);
 
+// Move a fan to the mode/target/curve in config, writing only what changed
+// (mode, target_rpm, sensor_based_enabled, sensor_index, min/max_temp)
+EFI_STATUS fan_apply_config(FAN_INFO *fan, const FAN_INFO *config);
+
+// Clamp an RPM to the fan's limits and, once calibrated, to the range it reaches
+UINT16 fan_reachable_rpm(const FAN_INFO *fan, UINT16 rpm);
+
 /**
  * Sensor-based control functions
  */
 
 // Enable/disable sensor-based control for a fan
 EFI_STATUS fan_set_sensor_based_mode(UINT8 fan_index, BOOLEAN enable,
-                                     UINT8 sensor_index, INT16 min_temp, INT16 max_temp);
+                                     UINT16 sensor_index, INT16 min_temp, INT16 max_temp);
 
 // Update fan speed based on current temperature (call periodically in sensor-based mode)
+// With a compiled curve the target is looked up rather than calculated; with a
+// response model a rising temperature is led by the fan's lag and settling time
 EFI_STATUS fan_update_sensor_based(FAN_INFO *fan, INT16 current_temp);
 
 // Calculate target RPM based on temperature and thresholds
 UINT16 fan_calculate_rpm_from_temp(INT16 current_temp, INT16 min_temp, INT16 max_temp,
                                     UINT16 min_rpm, UINT16 max_rpm);
 
+// Sensor slots driving enabled fan curves, each once, in fan order (at most max)
+UINT16 fan_curve_sensors(const FAN_INFO fans[], UINT8 count, UINT16 sensor_count,
+                         UINT16 slots[], UINT16 max);
+
 /**
  * Safety functions
  */
 
-// Restore all fans to automatic mode
+// Restore discovered fans that are in manual mode to automatic mode
+// (callable at TPL_NOTIFY, e.g. from an ExitBootServices notification)
 EFI_STATUS fan_restore_auto_mode_all(void);
 
 #endif // FAN_CONTROL_H
@@ -0,0 +1,226 @@
+#include "fan_profile.h"
+#include "control_engine.h"
+
+// Curve points per profile
+#define PROFILE_MAX_POINTS  4
+
+typedef struct {
+    UINT8 temp;         // Degrees C
+    UINT8 percent;      // Share of the fan's min..max RPM range
+} PROFILE_POINT;
+
+typedef struct {
+    const CHAR8 *name;
+    BOOLEAN full_speed;                         // Every fan at max_rpm, no curve
+    UINT8 point_count;
+    PROFILE_POINT points[PROFILE_MAX_POINTS];   // Rising temperatures
+} PROFILE;
+
+static const PROFILE profiles[FAN_PROFILE_COUNT] = {
+    { (const CHAR8 *)"Silent",      FALSE, 4, { { 50, 0 }, { 65, 15 }, { 80, 50 }, { 90, 100 } } },
+    { (const CHAR8 *)"Balanced",    FALSE, 3, { { 45, 0 }, { 70, 40 }, { 85, 100 } } },
+    { (const CHAR8 *)"Performance", FALSE, 3, { { 40, 10 }, { 60, 50 }, { 75, 100 } } },
+    { (const CHAR8 *)"Max",         TRUE,  0, { { 0, 0 } } },
+};
+
+// CPU sensors a profile follows, most representative first
+static const SMC_KEY cpu_keys[] = {
+    SMC_KEY_CONST('T', 'C', '0', 'P'),  // CPU A proximity
+    SMC_KEY_CONST('T', 'C', '0', 'D'),  // CPU A die
+    SMC_KEY_CONST('T', 'C', '0', 'E'),
+    SMC_KEY_CONST('T', 'C', '0', 'F'),
+    SMC_KEY_CONST('T', 'C', '0', 'H'),  // CPU A heatsink
+    SMC_KEY_CONST('T', 'C', '0', 'C'),  // CPU core 0
+    SMC_KEY_CONST('T', 'C', 'X', 'C'),
+    SMC_KEY_CONST('T', 'C', '1', 'C'),
+};
+
+// Compiled curves; a load fills, per fan, the bank that fan's curve is not in
+static UINT16 banks[2][MAX_FANS][FAN_CURVE_STEPS];
+static UINT8 curve_profile[2][MAX_FANS];
+
+/**
+ * Get a profile's display name
+ */
+const CHAR8 *fan_profile_name(UINT8 profile) {
+    if (profile >= FAN_PROFILE_COUNT) {
+        return (const CHAR8 *)"None";
+    }
+    return profiles[profile].name;
+}
+
+/**
+ * Find a profile by name, ignoring case
+ */
+UINT8 fan_profile_find(const CHAR8 *name) {
+    UINT8 profile;
+
+    if (!name) {
+        return FAN_PROFILE_NONE;
+    }
+
+    for (profile = 0; profile < FAN_PROFILE_COUNT; profile++) {
+        const CHAR8 *a = profiles[profile].name;
+        const CHAR8 *b = name;
+
+        while (*a && *b && (*a | 0x20) == (*b | 0x20)) {
+            a++;
+            b++;
+        }
+        if (*a == 0 && *b == 0) {
+            return profile;
+        }
+    }
+    return FAN_PROFILE_NONE;
+}
+
+/**
+ * Find the profile a compiled curve belongs to
+ */
+UINT8 fan_profile_of(const UINT16 *curve) {
+    UINTN bank;
+
+    if (!curve) {
+        return FAN_PROFILE_NONE;
+    }
+    for (bank = 0; bank < 2; bank++) {
+        const UINT16 *base = &banks[bank][0][0];
+
+        if (curve >= base && curve < base + MAX_FANS * FAN_CURVE_STEPS) {
+            return curve_profile[bank][(curve - base) / FAN_CURVE_STEPS];
+        }
+    }
+    return FAN_PROFILE_NONE;
+}
+
+/**
+ * Pick the sensor slot a profile follows
+ */
+static EFI_STATUS find_cpu_sensor(const TEMP_SENSOR sensors[], UINT16 sensor_count,
+                                  UINT16 *slot) {
+    UINTN k;
+    UINT16 i;
+
+    for (k = 0; k < sizeof(cpu_keys) / sizeof(cpu_keys[0]); k++) {
+        for (i = 0; i < sensor_count; i++) {
+            if (sensors[i].valid && sensors[i].smc_key == cpu_keys[k]) {
+                *slot = i;
+                return EFI_SUCCESS;
+            }
+        }
+    }
+
+    // No CPU key: follow the first sensor that reads
+    for (i = 0; i < sensor_count; i++) {
+        if (sensors[i].valid) {
+            *slot = i;
+            return EFI_SUCCESS;
+        }
+    }
+    return EFI_NOT_FOUND;
+}
+
+/**
+ * Compile a profile's points into a fan's curve table
+ * Flat below the first point and above the last, linear in between.
+ */
+static void compile_curve(const PROFILE *profile, const FAN_INFO *fan, UINT16 *curve) {
+    // Spread over the RPM the fan actually reaches (its limits until calibrated)
+    UINT32 min_rpm = fan_reachable_rpm(fan, fan->min_rpm);
+    UINT32 max_rpm = fan_reachable_rpm(fan, fan->max_rpm);
+    UINT32 range = max_rpm > min_rpm ? max_rpm - min_rpm : 0;
+    const PROFILE_POINT *first = &profile->points[0];
+    const PROFILE_POINT *last = &profile->points[profile->point_count - 1];
+    UINTN point = 0;
+    UINT32 degree;
+
+    for (degree = 0; degree < FAN_CURVE_STEPS; degree++) {
+        const PROFILE_POINT *low;
+        const PROFILE_POINT *high;
+        UINT32 span;
+
+        if (degree <= first->temp) {
+            curve[degree] = (UINT16)(min_rpm + range * first->percent / 100);
+            continue;
+        }
+        if (degree >= last->temp) {
+            curve[degree] = (UINT16)(min_rpm + range * last->percent / 100);
+            continue;
+        }
+
+        // Segment holding this degree: points[point] < degree < points[point + 1]
+        while (degree >= profile->points[point + 1].temp) {
+            point++;
+        }
+        low = &profile->points[point];
+        high = &profile->points[point + 1];
+        span = high->temp - low->temp;
+
+        // Percent scaled by the segment's span, so the division comes last
+        curve[degree] = (UINT16)(min_rpm + range * (low->percent * span +
+                                 (degree - low->temp) * (high->percent - low->percent)) /
+                                 (100 * span));
+    }
+}
+
+/**
+ * Compile a profile for every fan and apply it
+ * Each fan takes one apply (a mode write if it changes, a target write for
+ * Max); curve targets follow from the next control tick's lookup. A fan's
+ * table goes to the bank its current curve is not in, so a fan that keeps
+ * its old curve (failed apply) keeps its table and profile. In AP mode the
+ * AP may still be on a curve the BSP has already replaced until it has
+ * taken the queued commands, so the load waits for that (EFI_NOT_READY).
+ */
+EFI_STATUS fan_profile_load(UINT8 profile, FAN_INFO fans[], UINT8 count,
+                            const TEMP_SENSOR sensors[], UINT16 sensor_count,
+                            FAN_PROFILE_APPLY apply, BOOLEAN ap_mode) {
+    const PROFILE *selected;
+    EFI_STATUS result = EFI_SUCCESS;
+    UINT16 sensor = 0;
+    UINT8 i;
+
+    if (profile >= FAN_PROFILE_COUNT || !fans || !apply) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (ap_mode && control_engine_pending()) {
+        return EFI_NOT_READY;
+    }
+    selected = &profiles[profile];
+
+    if (!selected->full_speed) {
+        EFI_STATUS status = find_cpu_sensor(sensors, sensor_count, &sensor);
+        if (EFI_ERROR(status)) {
+            return status;
+        }
+    }
+
+    for (i = 0; i < count && i < MAX_FANS; i++) {
+        FAN_INFO next = fans[i];
+        UINTN bank = (fans[i].curve == banks[0][i]) ? 1 : 0;
+        EFI_STATUS status;
+
+        if (selected->full_speed) {
+            next.mode = FAN_MODE_MANUAL;
+            next.target_rpm = fan_reachable_rpm(&fans[i], fans[i].max_rpm);
+            next.sensor_based_enabled = FALSE;
+            next.curve = NULL;
+        } else {
+            compile_curve(selected, &fans[i], banks[bank][i]);
+            curve_profile[bank][i] = profile;
+            next.mode = FAN_MODE_SENSOR_BASED;
+            next.sensor_based_enabled = TRUE;
+            next.sensor_index = sensor;
+            next.min_temp = (INT16)(selected->points[0].temp * 10);
+            next.max_temp = (INT16)(selected->points[selected->point_count - 1].temp * 10);
+            next.curve = banks[bank][i];
+        }
+
+        status = apply(fans, i, &next, ap_mode);
+        if (EFI_ERROR(status)) {
+            result = status;  // Keep going: the other fans still switch
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,63 @@
+#ifndef FAN_PROFILE_H
+#define FAN_PROFILE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Thermal profiles
+ *
+ * A profile sets every fan at once. Silent, Balanced and Performance put
+ * each fan on a curve of a few (temperature, share of the fan's RPM
+ * range) points, driven by the CPU sensor (the first of a list of CPU
+ * keys that was found, else the first valid sensor); Max runs every fan
+ * at its maximum.
+ *
+ * Loading a profile compiles its curve into a table per fan, target RPM
+ * by degree already scaled to that fan's limits (FAN_INFO.curve), and
+ * applies the fans' new settings in one pass. The control tick then only
+ * looks temperatures up. Each fan's tables alternate between two banks, so
+ * a fan still on its previous table keeps a consistent one while the next
+ * is compiled.
+ */
+
+typedef enum {
+    FAN_PROFILE_SILENT = 0,
+    FAN_PROFILE_BALANCED,
+    FAN_PROFILE_PERFORMANCE,
+    FAN_PROFILE_MAX,
+    FAN_PROFILE_COUNT
+} FAN_PROFILE;
+
+// No profile selected
+#define FAN_PROFILE_NONE    0xFF
+
+// Applies one fan's new settings (the menu's apply path: direct or via the AP)
+typedef EFI_STATUS (*FAN_PROFILE_APPLY)(FAN_INFO fans[], UINT8 slot, const FAN_INFO *config,
+                                        BOOLEAN ap_mode);
+
+// Display name ("Silent", ...)
+const CHAR8 *fan_profile_name(UINT8 profile);
+
+// Profile for a name (any case); FAN_PROFILE_NONE if there is none
+UINT8 fan_profile_find(const CHAR8 *name);
+
+// Profile a FAN_INFO.curve was compiled from; FAN_PROFILE_NONE for NULL
+UINT8 fan_profile_of(const UINT16 *curve);
+
+// Compile profile for the fans and apply it through apply
+// EFI_NOT_FOUND if it needs a sensor and none is valid; EFI_NOT_READY in AP
+// mode while the AP has fan commands to take; otherwise the last apply error
+EFI_STATUS fan_profile_load(UINT8 profile, FAN_INFO fans[], UINT8 count,
+                            const TEMP_SENSOR sensors[], UINT16 sensor_count,
+                            FAN_PROFILE_APPLY apply, BOOLEAN ap_mode);
+
+#endif // FAN_PROFILE_H
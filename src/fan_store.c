@@ -0,0 +1,336 @@
+#include "fan_store.h"
+#include "fan_profile.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+  #include <Library/UefiRuntimeServicesTableLib.h>
+#endif
+
+#define STORE_ATTRIBUTES    (EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS)
+
+static EFI_GUID store_guid = FAN_STORE_GUID;
+
+// What the variable holds (stored_size 0: nothing usable), and which entries are done
+static FAN_STORE_RECORD stored;
+static UINTN stored_size = 0;
+static BOOLEAN present = FALSE;         // The variable exists, usable or not
+static UINT64 applied = 0;              // Bit per stored entry
+
+/**
+ * CRC32 of a record, taken with its crc field zero
+ */
+static UINT32 record_crc(FAN_STORE_HEADER *header, UINTN size) {
+    UINT32 saved = header->crc;
+    UINT32 crc = 0;
+
+    header->crc = 0;
+    gBS->CalculateCrc32(header, size, &crc);
+    header->crc = saved;
+    return crc;
+}
+
+/**
+ * Read and check a record
+ * One GetVariable into a buffer sized for the largest valid record; a
+ * larger variable fails with EFI_BUFFER_TOO_SMALL and cannot be ours.
+ * *size is the buffer size in, the record size out.
+ */
+static EFI_STATUS read_record(CHAR16 *name, FAN_STORE_HEADER *header, UINTN *size,
+                              UINT32 signature, UINT16 version, UINTN entry_size) {
+    EFI_STATUS status;
+
+    status = gRT->GetVariable(name, &store_guid, NULL, size, header);
+    if (status == EFI_BUFFER_TOO_SMALL) {
+        return EFI_COMPROMISED_DATA;
+    }
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    if (*size < sizeof(FAN_STORE_HEADER) || header->signature != signature) {
+        return EFI_COMPROMISED_DATA;
+    }
+    if (header->version != version) {
+        return EFI_INCOMPATIBLE_VERSION;
+    }
+    if (header->size != *size || header->fan_count > MAX_FANS ||
+        *size != sizeof(FAN_STORE_HEADER) + header->fan_count * entry_size) {
+        return EFI_COMPROMISED_DATA;
+    }
+    if (record_crc(header, *size) != header->crc) {
+        return EFI_CRC_ERROR;
+    }
+    return EFI_SUCCESS;
+}
+
+/**
+ * Size, checksum and write a record
+ */
+static EFI_STATUS write_record(CHAR16 *name, FAN_STORE_HEADER *header, UINTN entry_size) {
+    UINTN size = sizeof(FAN_STORE_HEADER) + header->fan_count * entry_size;
+
+    header->size = (UINT16)size;
+    header->crc = record_crc(header, size);
+    return gRT->SetVariable(name, &store_guid, STORE_ATTRIBUTES, size, header);
+}
+
+/**
+ * Read and check the saved record
+ */
+EFI_STATUS fan_store_load(void) {
+    UINTN size = sizeof(stored);
+    EFI_STATUS status;
+
+    stored_size = 0;
+    applied = 0;
+
+    status = read_record(FAN_STORE_VARIABLE, &stored.header, &size, FAN_STORE_SIGNATURE,
+                         FAN_STORE_VERSION, sizeof(FAN_STORE_ENTRY));
+    present = (status != EFI_NOT_FOUND);
+    if (!EFI_ERROR(status)) {
+        stored_size = size;
+    }
+    return status;
+}
+
+/**
+ * Profile the loaded record's profile fans follow
+ */
+UINT8 fan_store_profile(void) {
+    UINT8 i;
+
+    if (stored_size == 0 || stored.header.profile >= FAN_PROFILE_COUNT) {
+        return FAN_PROFILE_NONE;
+    }
+    for (i = 0; i < stored.header.fan_count; i++) {
+        if (stored.fans[i].flags & FAN_STORE_ON_PROFILE) {
+            return stored.header.profile;
+        }
+    }
+    return FAN_PROFILE_NONE;
+}
+
+/**
+ * Apply the loaded entries that can be applied now
+ * Profile fans are left to the profile load; every other entry is applied
+ * once, as soon as its fan and (for a curve) its sensor are present.
+ */
+BOOLEAN fan_store_apply(FAN_INFO fans[], UINT8 count, const TEMP_SENSOR sensors[],
+                        UINT16 sensor_count, BOOLEAN discovery_done,
+                        FAN_STORE_APPLY apply, BOOLEAN ap_mode) {
+    BOOLEAN waiting = FALSE;
+    UINT8 i;
+
+    if (stored_size == 0) {
+        return FALSE;
+    }
+
+    for (i = 0; i < stored.header.fan_count; i++) {
+        const FAN_STORE_ENTRY *entry = &stored.fans[i];
+        UINT64 bit = (UINT64)1 << i;
+        FAN_INFO config;
+        UINT8 slot;
+        UINT16 s;
+
+        if ((applied & bit) || (entry->flags & FAN_STORE_ON_PROFILE)) {
+            applied |= bit;
+            continue;
+        }
+
+        slot = 0;
+        while (slot < count && fans[slot].index != entry->index) {
+            slot++;
+        }
+        if (slot == count || entry->mode > FAN_MODE_SENSOR_BASED) {
+            applied |= bit;  // Fan gone, or an entry we cannot use
+            continue;
+        }
+
+        config = fans[slot];
+        config.mode = (FAN_MODE)entry->mode;
+        config.sensor_based_enabled = FALSE;
+        config.curve = NULL;
+
+        if (entry->mode == FAN_MODE_MANUAL) {
+            config.target_rpm = fan_reachable_rpm(&fans[slot], entry->target_rpm);
+        } else if (entry->mode == FAN_MODE_SENSOR_BASED) {
+            s = 0;
+            while (s < sensor_count && sensors[s].smc_key != entry->sensor_key) {
+                s++;
+            }
+            if (s == sensor_count) {
+                if (!discovery_done) {
+                    waiting = TRUE;
+                    continue;
+                }
+                applied |= bit;  // Sensor is gone: leave the fan to the SMC
+                continue;
+            }
+            config.sensor_based_enabled = TRUE;
+            config.sensor_index = s;
+            config.min_temp = entry->min_temp;
+            config.max_temp = entry->max_temp;
+        }
+
+        applied |= bit;
+        apply(fans, slot, &config, ap_mode);
+    }
+
+    return waiting;
+}
+
+/**
+ * Save the fans' settings
+ * The record is built in full and compared with the stored one, so an
+ * unchanged session costs no variable write (and no flash wear).
+ */
+EFI_STATUS fan_store_save(const FAN_INFO fans[], UINT8 count,
+                          const TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    FAN_STORE_RECORD record;
+    BOOLEAN any_set = FALSE;
+    EFI_STATUS status;
+    UINTN size;
+    UINT8 i;
+
+    if (!fans) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    ZeroMem(&record, sizeof(record));
+    record.header.signature = FAN_STORE_SIGNATURE;
+    record.header.version = FAN_STORE_VERSION;
+    record.header.profile = FAN_PROFILE_NONE;
+
+    for (i = 0; i < count && i < MAX_FANS; i++) {
+        FAN_STORE_ENTRY *entry = &record.fans[i];
+        const FAN_INFO *fan = &fans[i];
+
+        entry->index = fan->index;
+        entry->mode = (UINT8)fan->mode;
+        if (fan->mode != FAN_MODE_AUTO) {
+            any_set = TRUE;
+        }
+
+        if (fan->mode == FAN_MODE_MANUAL) {
+            entry->target_rpm = fan->target_rpm;
+        } else if (fan->mode == FAN_MODE_SENSOR_BASED) {
+            UINT8 profile = fan_profile_of(fan->curve);
+
+            if (profile != FAN_PROFILE_NONE &&
+                (record.header.profile == FAN_PROFILE_NONE || record.header.profile == profile)) {
+                record.header.profile = profile;
+                entry->flags = FAN_STORE_ON_PROFILE;
+            } else if (fan->sensor_index < sensor_count) {
+                entry->sensor_key = sensors[fan->sensor_index].smc_key;
+                entry->min_temp = fan->min_temp;
+                entry->max_temp = fan->max_temp;
+            } else {
+                entry->mode = FAN_MODE_AUTO;  // No sensor to name
+            }
+        }
+    }
+    record.header.fan_count = i;
+
+    // Nothing to restore: drop the variable rather than store an all-automatic record
+    if (!any_set) {
+        if (!present) {
+            return EFI_SUCCESS;
+        }
+        status = gRT->SetVariable(FAN_STORE_VARIABLE, &store_guid, STORE_ATTRIBUTES, 0, NULL);
+        if (status == EFI_NOT_FOUND) {
+            status = EFI_SUCCESS;
+        }
+        if (!EFI_ERROR(status)) {
+            present = FALSE;
+            stored_size = 0;
+        }
+        return status;
+    }
+
+    // Same layout and CRC as written, so an unchanged record compares equal
+    size = sizeof(FAN_STORE_HEADER) + record.header.fan_count * sizeof(FAN_STORE_ENTRY);
+    record.header.size = (UINT16)size;
+    record.header.crc = record_crc(&record.header, size);
+    if (stored_size == size && CompareMem(&stored, &record, size) == 0) {
+        return EFI_SUCCESS;
+    }
+
+    status = write_record(FAN_STORE_VARIABLE, &record.header, sizeof(FAN_STORE_ENTRY));
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    CopyMem(&stored, &record, size);
+    stored_size = size;
+    present = TRUE;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Give the fans their saved response models
+ */
+EFI_STATUS fan_store_load_models(FAN_INFO fans[], UINT8 count) {
+    FAN_STORE_MODELS models;
+    UINTN size = sizeof(models);
+    EFI_STATUS status;
+    UINT8 i, slot;
+
+    status = read_record(FAN_STORE_MODEL_VARIABLE, &models.header, &size,
+                         FAN_STORE_MODEL_SIGNATURE, FAN_STORE_MODEL_VERSION,
+                         sizeof(FAN_STORE_MODEL));
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    for (i = 0; i < models.header.fan_count; i++) {
+        const FAN_STORE_MODEL *entry = &models.fans[i];
+
+        slot = 0;
+        while (slot < count && fans[slot].index != entry->index) {
+            slot++;
+        }
+        if (slot == count || entry->reach_max <= entry->reach_min) {
+            continue;
+        }
+        fans[slot].model.reach_min = entry->reach_min;
+        fans[slot].model.reach_max = entry->reach_max;
+        fans[slot].model.lag_ms = entry->lag_ms;
+        fans[slot].model.settle_ms = entry->settle_ms;
+    }
+    return EFI_SUCCESS;
+}
+
+/**
+ * Save the calibrated fans' response models
+ */
+EFI_STATUS fan_store_save_models(const FAN_INFO fans[], UINT8 count) {
+    FAN_STORE_MODELS models;
+    UINT8 i;
+
+    if (!fans) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    ZeroMem(&models, sizeof(models));
+    models.header.signature = FAN_STORE_MODEL_SIGNATURE;
+    models.header.version = FAN_STORE_MODEL_VERSION;
+    models.header.profile = FAN_PROFILE_NONE;
+
+    for (i = 0; i < count && i < MAX_FANS; i++) {
+        if (fans[i].model.reach_max == 0) {
+            continue;  // Not calibrated
+        }
+        models.fans[models.header.fan_count].index = fans[i].index;
+        models.fans[models.header.fan_count].reach_min = fans[i].model.reach_min;
+        models.fans[models.header.fan_count].reach_max = fans[i].model.reach_max;
+        models.fans[models.header.fan_count].lag_ms = fans[i].model.lag_ms;
+        models.fans[models.header.fan_count].settle_ms = fans[i].model.settle_ms;
+        models.header.fan_count++;
+    }
+    if (models.header.fan_count == 0) {
+        return EFI_NOT_FOUND;
+    }
+
+    return write_record(FAN_STORE_MODEL_VARIABLE, &models.header, sizeof(FAN_STORE_MODEL));
+}
@@ -0,0 +1,130 @@
+#ifndef FAN_STORE_H
+#define FAN_STORE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Saved fan settings
+ *
+ * When the menu exits, the fans' settings (mode, manual target, curve
+ * thresholds, the thermal profile and each curve's sensor as its SMC key)
+ * are written to the non-volatile variable FAN_STORE_VARIABLE. The next
+ * launch reads it back with one GetVariable call and reapplies it before the
+ * menu is first drawn, so the fans pick up where they were; the fans are
+ * still handed back to the SMC at every exit.
+ *
+ * The record is a header and one entry per fan, both naturally aligned. It
+ * is ignored (and the menu starts from automatic mode) unless signature,
+ * version, size and the header's CRC32 of the whole record all check out.
+ * Fans are matched by SMC index, sensors by key: manual and automatic fans
+ * are set at once, curve fans as soon as their sensor has been discovered,
+ * and profile fans once the profile can be loaded. The variable is only
+ * rewritten when the settings differ from what is stored.
+ *
+ * Fan response models measured by --calibrate (fan_calib.h) are kept the
+ * same way in FAN_STORE_MODEL_VARIABLE, apart from the settings: they
+ * describe the hardware and stay until the next calibration.
+ */
+
+// Variable name and vendor GUID {4C1E9A57-8D26-4F3B-A6E0-5B72D9C8F413}
+#define FAN_STORE_VARIABLE  L"ApplesSmcFanConfig"
+#define FAN_STORE_GUID \
+    { 0x4c1e9a57, 0x8d26, 0x4f3b, { 0xa6, 0xe0, 0x5b, 0x72, 0xd9, 0xc8, 0xf4, 0x13 } }
+
+#define FAN_STORE_SIGNATURE SMC_KEY_CONST('S', 'M', 'C', 'F')
+#define FAN_STORE_VERSION   1
+
+// Response models: same GUID and header
+#define FAN_STORE_MODEL_VARIABLE    L"ApplesSmcFanModel"
+#define FAN_STORE_MODEL_SIGNATURE   SMC_KEY_CONST('S', 'M', 'C', 'M')
+#define FAN_STORE_MODEL_VERSION     1
+
+// Entry flags
+#define FAN_STORE_ON_PROFILE    0x01    // Fan follows the header's profile
+
+// Per-fan entry
+typedef struct {
+    UINT8 index;                  // SMC fan index (F<n>xx)
+    UINT8 mode;                   // FAN_MODE
+    UINT8 flags;                  // FAN_STORE_*
+    UINT8 reserved;
+    UINT16 target_rpm;            // Manual target
+    INT16 min_temp;               // Curve thresholds, decidegrees C
+    INT16 max_temp;
+    UINT16 reserved2;
+    UINT32 sensor_key;            // SMC key of the curve's sensor, 0 if none
+} FAN_STORE_ENTRY;
+
+// Per-fan response model
+typedef struct {
+    UINT8 index;                  // SMC fan index (F<n>xx)
+    UINT8 reserved;
+    UINT16 reach_min;             // FAN_MODEL
+    UINT16 reach_max;
+    UINT16 lag_ms;
+    UINT16 settle_ms;
+    UINT16 reserved2;
+} FAN_STORE_MODEL;
+
+// Header of both records
+typedef struct {
+    UINT32 signature;             // FAN_STORE_SIGNATURE / FAN_STORE_MODEL_SIGNATURE
+    UINT16 version;               // FAN_STORE_VERSION / FAN_STORE_MODEL_VERSION
+    UINT16 size;                  // Bytes in the record, header included
+    UINT32 crc;                   // CRC32 of the record with this field zero
+    UINT8 profile;                // FAN_PROFILE_*, FAN_PROFILE_NONE (settings only)
+    UINT8 fan_count;
+    UINT16 reserved;
+} FAN_STORE_HEADER;
+
+typedef struct {
+    FAN_STORE_HEADER header;
+    FAN_STORE_ENTRY fans[MAX_FANS];
+} FAN_STORE_RECORD;
+
+typedef struct {
+    FAN_STORE_HEADER header;
+    FAN_STORE_MODEL fans[MAX_FANS];
+} FAN_STORE_MODELS;
+
+// Applies one fan's new settings (the menu's apply path: direct or via the AP)
+typedef EFI_STATUS (*FAN_STORE_APPLY)(FAN_INFO fans[], UINT8 slot, const FAN_INFO *config,
+                                      BOOLEAN ap_mode);
+
+// Read and check the saved record
+// EFI_NOT_FOUND if there is none; EFI_COMPROMISED_DATA, EFI_CRC_ERROR or
+// EFI_INCOMPATIBLE_VERSION if it cannot be used
+EFI_STATUS fan_store_load(void);
+
+// Profile of the loaded record's profile fans (FAN_PROFILE_NONE if none)
+UINT8 fan_store_profile(void);
+
+// Apply the loaded entries whose fan (and sensor) is present; TRUE while some still wait
+// Curve fans wait for their sensor until discovery_done, then are left alone
+BOOLEAN fan_store_apply(FAN_INFO fans[], UINT8 count, const TEMP_SENSOR sensors[],
+                        UINT16 sensor_count, BOOLEAN discovery_done,
+                        FAN_STORE_APPLY apply, BOOLEAN ap_mode);
+
+// Save the fans' settings (deleting the variable when every fan is automatic)
+// Does nothing if they match the stored record
+EFI_STATUS fan_store_save(const FAN_INFO fans[], UINT8 count,
+                          const TEMP_SENSOR sensors[], UINT16 sensor_count);
+
+// Give the fans their saved response models (matched by SMC index)
+// Errors as for fan_store_load; fans without a saved model keep theirs
+EFI_STATUS fan_store_load_models(FAN_INFO fans[], UINT8 count);
+
+// Save the calibrated fans' response models
+EFI_STATUS fan_store_save_models(const FAN_INFO fans[], UINT8 count);
+
+#endif // FAN_STORE_H
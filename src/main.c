@@ -13,127 +13,254 @@
 #endif
 
 #include "smc_protocol.h"
+#include "smc_service.h"
+#include "smc_acpi.h"
 #include "fan_control.h"
+#include "fan_calib.h"
+#include "fan_store.h"
+#include "control_engine.h"
+#include "telemetry.h"
+#include "telemetry_table.h"
 #include "ui_menu.h"
+#include "options.h"
+#include "chainload.h"
+#include "smc_trace.h"
 #include "utils.h"
 
+/**
+ * Write the SMC port-I/O trace, if one is being recorded
+ */
+static void finish_trace(EFI_HANDLE image_handle, const APP_OPTIONS *options) {
+    EFI_STATUS status;
+
+    if (!options->trace) {
+        return;
+    }
+
+    status = smc_trace_save(image_handle, SMC_TRACE_FILE);
+    if (EFI_ERROR(status)) {
+        Print(L"Warning: Could not write SMC trace (Status: 0x%x)\n", status);
+    } else {
+        Print(L"SMC trace written to %s (%d records)\n", SMC_TRACE_FILE, smc_trace_count());
+    }
+    smc_trace_free();
+}
+
+/**
+ * ExitBootServices notification: give the fans back to the SMC if an OS is
+ * booted while the application is loaded (e.g. from a chainloaded loader)
+ * Runs at TPL_NOTIFY, so no allocation or console output.
+ */
+static VOID EFIAPI on_exit_boot_services(EFI_EVENT event, VOID *context) {
+    // An AP still running the control loop owns the bus
+    if (control_engine_halt()) {
+        fan_restore_auto_mode_all();
+    }
+}
+
+/**
+ * Put the fans named by --fan into manual mode at their targets
+ */
+static void apply_pinned_fans(FAN_INFO fans[], UINT8 fan_count, const APP_OPTIONS *options) {
+    EFI_STATUS status;
+    UINT8 i, j;
+
+    for (i = 0; i < options->fan_count; i++) {
+        const OPTION_FAN *pin = &options->fans[i];
+
+        j = 0;
+        while (j < fan_count && fans[j].index != pin->fan) {
+            j++;
+        }
+        if (j == fan_count) {
+            Print(L"Warning: --fan=%d: no such fan\n", pin->fan);
+            continue;
+        }
+
+        FAN_INFO config = fans[j];
+        config.mode = FAN_MODE_MANUAL;
+        config.sensor_based_enabled = FALSE;
+        config.target_rpm = fan_reachable_rpm(&fans[j], pin->rpm);
+
+        status = fan_apply_config(&fans[j], &config);
+        if (EFI_ERROR(status)) {
+            Print(L"Warning: Could not pin fan %d (Status: 0x%x)\n", pin->fan, status);
+        }
+    }
+}
+
+/**
+ * Measure every fan's response (--calibrate) and save the models
+ */
+static void calibrate_fans(FAN_INFO fans[], UINT8 fan_count) {
+    EFI_STATUS status;
+    UINT8 i;
+
+    Print(L"Calibrating fans (each is stepped through its range)...\n");
+    for (i = 0; i < fan_count; i++) {
+        Print(L"  Fan %d (%s): ", i, fans[i].label);
+        status = fan_calibrate(&fans[i]);
+        if (EFI_ERROR(status)) {
+            Print(L"failed (Status: 0x%x)\n", status);
+            continue;
+        }
+        Print(L"%d-%d RPM, lag %d ms, settles in %d ms\n",
+              fans[i].model.reach_min, fans[i].model.reach_max,
+              fans[i].model.lag_ms, fans[i].model.settle_ms);
+    }
+
+    status = fan_store_save_models(fans, fan_count);
+    if (EFI_ERROR(status) && status != EFI_NOT_FOUND) {
+        Print(L"Warning: Could not save fan models (Status: 0x%x)\n", status);
+    }
+    Print(L"\n");
+}
+
 /**
  * UEFI Application Entry Point
  * This is the main function that will be called when the EFI application starts
  */
 EFI_STATUS EFIAPI efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
     EFI_STATUS status;
-    FAN_INFO fans[MAX_FANS];
+    FAN_INFO *fans = NULL;
     UINT8 fan_count = 0;
+    APP_OPTIONS options;
+    EFI_EVENT exit_event = NULL;
+    BOOLEAN bus_released;
 
 #ifdef _GNU_EFI
     // Initialize gnu-efi library
     InitializeLib(ImageHandle, SystemTable);
 #else
     // EDK2 doesn't need explicit initialization
-    (void)ImageHandle;
     (void)SystemTable;
 #endif
 
-    // Clear screen and display banner
-    gST->ConOut->ClearScreen(gST->ConOut);
+    options_parse(ImageHandle, &options);
+
+    // Clear screen and display banner (the boot path leaves the console alone)
+    if (!options.boot) {
+        gST->ConOut->ClearScreen(gST->ConOut);
+    }
     Print(L"Apple SMC Fan Control v1.0 (UEFI)\n");
     Print(L"===================================\n\n");
 
-    // Detect SMC hardware
+    if (options.trace) {
+        status = smc_trace_start(SMC_TRACE_DEFAULT_RECORDS);
+        if (EFI_ERROR(status)) {
+            Print(L"Warning: SMC tracing unavailable (Status: 0x%x)\n\n", status);
+            options.trace = FALSE;
+        }
+    }
+
+    // Share the resident driver's key cache when it is loaded
+    if (!EFI_ERROR(smc_service_attach())) {
+        Print(L"Using resident SMC driver\n");
+    }
+
+    // Detect SMC hardware (ACPI APP0001 device; no bus traffic)
     Print(L"Detecting Apple SMC...\n");
-    if (!smc_detect()) {
+    if (!smc_acpi_detect()) {
         Print(L"\nERROR: Apple SMC not detected\n");
         Print(L"This application requires Apple hardware with SMC.\n\n");
-        Print(L"Press any key to exit.\n");
-
-        UINTN Index;
-        EFI_INPUT_KEY Key;
-        gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &Index);
-        gST->ConIn->ReadKeyStroke(gST->ConIn, &Key);
+        finish_trace(ImageHandle, &options);
 
         return EFI_UNSUPPORTED;
     }
-    Print(L"SMC detected successfully!\n\n");
+    Print(L"SMC detected successfully (%s)\n\n", smc_get_transport()->name);
 
     // Initialize fan control
     Print(L"Initializing fan control...\n");
     status = fan_init();
     if (EFI_ERROR(status)) {
         Print(L"ERROR: Failed to initialize fan control (Status: 0x%x)\n", status);
-        Print(L"\nPress any key to exit.\n");
-
-        UINTN Index;
-        EFI_INPUT_KEY Key;
-        gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &Index);
-        gST->ConIn->ReadKeyStroke(gST->ConIn, &Key);
+        finish_trace(ImageHandle, &options);
 
         return EFI_DEVICE_ERROR;
     }
 
     // Discover fans
     Print(L"Discovering fans...\n");
-    status = fan_discover_all(fans, &fan_count);
+    status = fan_discover_all(&fans, &fan_count);
     if (EFI_ERROR(status) || fan_count == 0) {
         Print(L"ERROR: No fans detected\n");
-        Print(L"\nPress any key to exit.\n");
-
-        UINTN Index;
-        EFI_INPUT_KEY Key;
-        gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &Index);
-        gST->ConIn->ReadKeyStroke(gST->ConIn, &Key);
+        finish_trace(ImageHandle, &options);
 
         return EFI_NOT_FOUND;
     }
 
-    Print(L"Found %d fans!\n\n", fan_count);
+    Print(L"Found %d fans!\n", fan_count);
 
-    // Display detected fans
-    Print(L"Detected fans:\n");
-    for (UINT8 i = 0; i < fan_count; i++) {
-        Print(L"  [%d] %s - %d RPM (range: %d-%d)\n",
-              i,
-              fans[i].label,
-              fans[i].current_rpm,
-              fans[i].min_rpm,
-              fans[i].max_rpm);
+    // Restore the fans if something boots the OS before we exit
+    status = gBS->CreateEvent(EVT_SIGNAL_EXIT_BOOT_SERVICES, TPL_NOTIFY,
+                              on_exit_boot_services, NULL, &exit_event);
+    if (EFI_ERROR(status)) {
+        exit_event = NULL;
     }
-    Print(L"\n");
 
-    // Wait before starting interactive menu
-    Print(L"Press any key to start interactive fan control...\n");
-    {
-        UINTN Index;
-        EFI_INPUT_KEY Key;
-        gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &Index);
-        gST->ConIn->ReadKeyStroke(gST->ConIn, &Key);
+    // Response models from an earlier --calibrate, or new ones
+    fan_store_load_models(fans, fan_count);
+    if (options.calibrate) {
+        calibrate_fans(fans, fan_count);
     }
 
-    // Run interactive menu
-    ui_menu_run(fans, fan_count);
+    apply_pinned_fans(fans, fan_count, &options);
 
-    // Safety: Restore all fans to automatic mode before exit
-    Print(L"\n");
-    Print(L"Restoring all fans to automatic mode...\n");
-    status = fan_restore_auto_mode_all();
+    // Publish the fan state for other tools and the OS loader
+    status = telemetry_table_install();
     if (EFI_ERROR(status)) {
-        Print(L"Warning: Some fans may not have been restored to auto mode\n");
+        Print(L"Warning: Telemetry table unavailable (Status: 0x%x)\n", status);
+    }
+    telemetry_table_bind(fans, fan_count, NULL, 0, FALSE);
+    telemetry_capture(fans, fan_count, NULL, 0);
+
+    if (options.boot) {
+        // With --keep-manual the OS inherits the pinned fans
+        if (options.keep_manual && exit_event) {
+            gBS->CloseEvent(exit_event);
+            exit_event = NULL;
+        }
+        finish_trace(ImageHandle, &options);
+        options.trace = FALSE;
+
+        // Only returns if no loader could be started or the loader exited
+        status = chainload_start(ImageHandle, options.loader);
+        if (status == EFI_NOT_FOUND) {
+            Print(L"ERROR: No OS loader found to start\n");
+        } else {
+            Print(L"OS loader returned (Status: 0x%x)\n", status);
+        }
     } else {
-        Print(L"All fans restored to automatic mode.\n");
+        // Run interactive menu
+        ui_menu_run(fans, fan_count, &options);
+        status = EFI_SUCCESS;
     }
+    // An AP that did not leave its loop still owns the bus
+    bus_released = control_engine_halt();
 
-    Print(L"\n");
-    Print(L"Thank you for using Apple SMC Fan Control!\n");
-    Print(L"Press any key to exit.\n");
+    // A stuck AP still publishes into the table: keep it allocated
+    if (bus_released) {
+        telemetry_table_uninstall();
+    }
+    fan_free_all(fans);
 
-    {
-        UINTN Index;
-        EFI_INPUT_KEY Key;
-        gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &Index);
-        gST->ConIn->ReadKeyStroke(gST->ConIn, &Key);
+    // Safety: Restore manual fans to automatic mode before exit
+    if (!bus_released) {
+        Print(L"\nWarning: Control loop did not stop - fans left to the AP\n");
+    } else if (EFI_ERROR(fan_restore_auto_mode_all())) {
+        Print(L"\nWarning: Some fans may not have been restored to auto mode\n");
+    } else {
+        Print(L"\nFans restored to automatic mode.\n");
+    }
+    if (exit_event) {
+        gBS->CloseEvent(exit_event);
     }
+    finish_trace(ImageHandle, &options);
+
+    Print(L"\n");
+    Print(L"Thank you for using Apple SMC Fan Control!\n");
 
-    return EFI_SUCCESS;
+    return status;
 }
 
 #ifndef _GNU_EFI
@@ -0,0 +1,183 @@
+#include "options.h"
+#include "fan_profile.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+  #include <Protocol/LoadedImage.h>
+#endif
+
+// Longest option word we look at (--loader= plus a path)
+#define OPTION_WORD_MAX (9 + OPTION_PATH_MAX)
+
+/**
+ * Compare a word with an option name
+ */
+static BOOLEAN word_is(const CHAR16 *word, UINTN len, const CHAR16 *name) {
+    UINTN i;
+
+    for (i = 0; i < len; i++) {
+        if (name[i] == L'\0' || word[i] != name[i]) {
+            return FALSE;
+        }
+    }
+    return name[len] == L'\0';
+}
+
+/**
+ * Match an option name ending in '=' at the start of a word
+ * Returns the length of the name, or 0 if the word does not start with it
+ */
+static UINTN word_prefix(const CHAR16 *word, UINTN len, const CHAR16 *name) {
+    UINTN i;
+
+    for (i = 0; name[i] != L'\0'; i++) {
+        if (i >= len || word[i] != name[i]) {
+            return 0;
+        }
+    }
+    return i;
+}
+
+/**
+ * Parse a decimal number; returns the digits consumed (0 if none)
+ */
+static UINTN parse_decimal(const CHAR16 *text, UINTN len, UINT32 *value) {
+    UINTN i;
+
+    *value = 0;
+    for (i = 0; i < len && text[i] >= L'0' && text[i] <= L'9'; i++) {
+        if (*value > 100000) {
+            return 0;  // Far beyond any fan index or RPM
+        }
+        *value = *value * 10 + (text[i] - L'0');
+    }
+    return i;
+}
+
+/**
+ * Parse "<n>:<rpm>" into a --fan setting
+ */
+static void apply_fan(const CHAR16 *text, UINTN len, APP_OPTIONS *options) {
+    UINT32 fan, rpm;
+    UINTN n, m;
+
+    n = parse_decimal(text, len, &fan);
+    if (n == 0 || n >= len || text[n] != L':') {
+        return;
+    }
+    m = parse_decimal(&text[n + 1], len - n - 1, &rpm);
+    if (m == 0 || n + 1 + m != len || fan > 0xFF || rpm > 0xFFFF) {
+        return;
+    }
+
+    if (options->fan_count < OPTION_FANS_MAX) {
+        options->fans[options->fan_count].fan = (UINT8)fan;
+        options->fans[options->fan_count].rpm = (UINT16)rpm;
+        options->fan_count++;
+    }
+}
+
+/**
+ * Apply one option word
+ */
+static void apply_word(const CHAR16 *word, UINTN len, APP_OPTIONS *options) {
+    UINTN n;
+
+    if (word_is(word, len, L"--ap")) {
+        options->use_ap = TRUE;
+    } else if (word_is(word, len, L"--trace")) {
+        options->trace = TRUE;
+    } else if (word_is(word, len, L"--boot")) {
+        options->boot = TRUE;
+    } else if (word_is(word, len, L"--keep-manual")) {
+        options->keep_manual = TRUE;
+    } else if (word_is(word, len, L"--serial")) {
+        options->serial = TRUE;
+    } else if ((n = word_prefix(word, len, L"--serial=")) != 0) {
+        UINT32 port;
+
+        if (len > n && parse_decimal(&word[n], len - n, &port) == len - n && port <= 0xFF) {
+            options->serial = TRUE;
+            options->serial_port = (UINT8)port;
+        }
+    } else if (word_is(word, len, L"--calibrate")) {
+        options->calibrate = TRUE;
+    } else if (word_is(word, len, L"--no-restore")) {
+        options->no_restore = TRUE;
+    } else if (word_is(word, len, L"--graphics")) {
+        options->graphics = TRUE;
+    } else if (word_is(word, len, L"--headless")) {
+        options->headless = TRUE;
+    } else if ((n = word_prefix(word, len, L"--headless=")) != 0) {
+        UINT32 ticks;
+
+        if (len > n && parse_decimal(&word[n], len - n, &ticks) == len - n &&
+            ticks > 0 && ticks <= 0xFFFF) {
+            options->headless = TRUE;
+            options->decimation = (UINT16)ticks;
+        }
+    } else if ((n = word_prefix(word, len, L"--profile=")) != 0) {
+        CHAR8 name[16];
+        UINTN i;
+
+        // Profile names are ASCII; anything longer matches none of them
+        if (len - n < sizeof(name)) {
+            for (i = 0; i < len - n; i++) {
+                name[i] = word[n + i] < 0x80 ? (CHAR8)word[n + i] : '?';
+            }
+            name[len - n] = '\0';
+            options->profile = fan_profile_find(name);
+        }
+    } else if ((n = word_prefix(word, len, L"--fan=")) != 0) {
+        apply_fan(&word[n], len - n, options);
+    } else if ((n = word_prefix(word, len, L"--loader=")) != 0) {
+        if (len - n < OPTION_PATH_MAX) {
+            CopyMem(options->loader, (void *)&word[n], (len - n) * sizeof(CHAR16));
+            options->loader[len - n] = L'\0';
+        }
+    }
+}
+
+/**
+ * Parse options for the running image
+ */
+void options_parse(EFI_HANDLE image_handle, APP_OPTIONS *options) {
+    EFI_LOADED_IMAGE_PROTOCOL *loaded_image = NULL;
+    const CHAR16 *args;
+    UINTN length;
+    UINTN i;
+
+    if (!options) {
+        return;
+    }
+
+    ZeroMem(options, sizeof(*options));
+    options->profile = FAN_PROFILE_NONE;
+
+    if (EFI_ERROR(gBS->HandleProtocol(image_handle, &gEfiLoadedImageProtocolGuid,
+                                      (void **)&loaded_image)) ||
+        !loaded_image->LoadOptions) {
+        return;
+    }
+
+    // LoadOptions is a UCS-2 command line (the Shell includes the image name first)
+    args = (const CHAR16 *)loaded_image->LoadOptions;
+    length = loaded_image->LoadOptionsSize / sizeof(CHAR16);
+
+    i = 0;
+    while (i < length && args[i] != L'\0') {
+        UINTN start;
+
+        while (i < length && args[i] == L' ') {
+            i++;
+        }
+        start = i;
+        while (i < length && args[i] != L' ' && args[i] != L'\0') {
+            i++;
+        }
+
+        if (i > start && i - start <= OPTION_WORD_MAX) {
+            apply_word(&args[start], i - start, options);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+
+/**
+ * Command-line options
+ * Parsed from the image's LoadOptions (UEFI Shell arguments or the
+ * optional data of a Boot#### entry). Unknown words are ignored.
+ *
+ *   --ap             Run sampling and fan control on an application processor
+ *   --trace          Record SMC port I/O and write it to \smc_trace.bin on exit
+ *   --fan=<n>:<rpm>  Put SMC fan n in manual mode at rpm before anything else runs
+ *   --boot           No menu: apply the --fan settings and start the OS loader
+ *   --loader=<path>  Loader for --boot on the image's volume (default: the
+ *                    BootOrder entry after the current one)
+ *   --keep-manual    With --boot, leave the --fan settings in place for the OS
+ *                    (otherwise they are undone at ExitBootServices)
+ *   --serial[=<n>]   Accept remote requests on serial port n (default 0;
+ *                    see serial_rpc.h)
+ *   --headless[=<n>] One status line every n ticks instead of the menu
+ *                    (see status_line.h)
+ *   --graphics       Graphical dashboard on the GOP (text menu without one)
+ *   --profile=<name> Start the menu in a thermal profile: silent, balanced,
+ *                    performance or max (see fan_profile.h)
+ *   --no-restore     Start from automatic mode instead of the settings saved at
+ *                    the last exit (see fan_store.h)
+ *   --calibrate      Measure each fan's response before anything else runs and
+ *                    save it for later launches (see fan_calib.h)
+ */
+
+// Longest --loader path, including the terminator
+#define OPTION_PATH_MAX     128
+
+// Most --fan settings kept
+#define OPTION_FANS_MAX     8
+
+// One --fan setting
+typedef struct {
+    UINT8 fan;                // SMC fan index (F<n>xx)
+    UINT16 rpm;               // Manual target
+} OPTION_FAN;
+
+typedef struct {
+    BOOLEAN use_ap;           // Control loop on a dedicated AP
+    BOOLEAN trace;            // Record SMC port I/O (smc_trace.h)
+    BOOLEAN boot;             // Chainload the OS loader instead of running the menu
+    BOOLEAN keep_manual;      // Pinned fans stay manual into the OS
+    BOOLEAN serial;           // Remote control on a serial port
+    UINT8 serial_port;        // Index among the serial I/O handles
+    BOOLEAN headless;         // Status lines instead of the full-screen menu
+    UINT16 decimation;        // Status ticks per line (0 for the default)
+    BOOLEAN graphics;         // Dashboard on the graphics output
+    UINT8 profile;            // FAN_PROFILE_*, FAN_PROFILE_NONE if not given
+    BOOLEAN no_restore;       // Ignore the saved fan settings
+    BOOLEAN calibrate;        // Measure fan response models first
+    CHAR16 loader[OPTION_PATH_MAX];   // --loader path, empty for BootOrder
+    OPTION_FAN fans[OPTION_FANS_MAX];
+    UINT8 fan_count;
+} APP_OPTIONS;
+
+// Parse options for the running image (defaults on any failure)
+void options_parse(EFI_HANDLE image_handle, APP_OPTIONS *options);
+
+#endif // OPTIONS_H
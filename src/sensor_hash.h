@@ -0,0 +1,545 @@
+// Generated by tools/gen_sensor_hash.py from src/temp_sensors.c - do not edit
+#ifndef SENSOR_HASH_H
+#define SENSOR_HASH_H
+
+#define SENSOR_HASH_ENTRIES      234  // sensor_map[] rows
+#define SENSOR_HASH_BUCKET_BITS  7
+#define SENSOR_HASH_SLOT_BITS    9
+#define SENSOR_HASH_SLOT_MULT    0x85EBCA6BU
+#define SENSOR_HASH_EMPTY        0xFFFF
+
+// Per-bucket displacement
+static const UINT16 sensor_hash_disp[128] = {
+    0, 0, 0, 1, 0, 1, 0, 1, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 1, 8, 1, 1, 1, 0, 0,
+    0, 0, 5, 0, 0, 0, 0, 0, 0, 0, 0, 7,
+    0, 0, 2, 3, 2, 0, 0, 2, 0, 4, 0, 0,
+    6, 0, 0, 0, 0, 0, 4, 0, 1, 0, 0, 0,
+    0, 0, 0, 3, 4, 0, 8, 0, 8, 5, 0, 0,
+    0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    4, 5, 0, 1, 0, 0, 0, 3, 2, 7, 0, 4,
+    9, 0, 1, 0, 0, 0, 3, 0, 5, 0, 0, 0,
+    0, 1, 0, 0, 6, 1, 0, 12, 0, 2, 3, 0,
+    0, 13, 0, 0, 2, 0, 5, 0,
+};
+
+// Slot -> FourCC key and sensor_map[] index
+static const struct {
+    UINT32 key;
+    UINT16 index;
+} sensor_hash_slots[512] = {
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434143U,  50},  // TCAC
+    {0x54473554U,  89},  // TG5T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54616C73U,  12},  // Tals
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434247U,  57},  // TCBG
+    {0x54733150U, 221},  // Ts1P
+    {0x54483150U, 144},  // TH1P
+    {0x544D3750U, 116},  // TM7P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433443U,  19},  // TC4C
+    {0x54473044U,  68},  // TG0D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433138U,  33},  // TC18
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3450U, 101},  // Tm4P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653154U, 225},  // Te1T
+    {0x54423146U, 199},  // TB1F
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433235U,  40},  // TC25
+    {0x544D5053U, 141},  // TMPS
+    {0x544D3050U, 109},  // TM0P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54683248U, 166},  // Th2H
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54423172U, 201},  // TB1r
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3753U, 126},  // TM7S
+    {0x54473350U,  77},  // TG3P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3150U,  98},  // Tm1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483256U, 155},  // TH2V
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473454U,  88},  // TG4T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434147U,  52},  // TCAG
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54733050U, 220},  // Ts0P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D4153U, 105},  // TmAS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433343U,  18},  // TC3C
+    {0x54433943U,  24},  // TC9C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3350U, 100},  // Tm3P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653054U, 224},  // Te0T
+    {0x48444431U, 149},  // HDD1
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54413053U,   6},  // TA0S
+    {0x54504D50U, 212},  // TPMP
+    {0x54683148U, 165},  // Th1H
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54485053U, 167},  // THPS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54733053U, 222},  // Ts0S
+    {0x544D3653U, 125},  // TM6S
+    {0x54473250U,  76},  // TG2P
+    {0x54545844U, 192},  // TTXD
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D4134U, 134},  // TMA4
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483156U, 153},  // TH1V
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473354U,  87},  // TG3T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x48444433U, 151},  // HDD3
+    {0x54433137U,  32},  // TC17
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54705447U, 211},  // TpTG
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544E3048U, 184},  // TN0H
+    {0x544C3150U, 203},  // TL1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54435843U,  65},  // TCXC
+    {0x544D5056U, 142},  // TMPV
+    {0x544D3056U, 118},  // TM0V
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434248U,  58},  // TCBH
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653553U, 182},  // Te5S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54423354U, 196},  // TB3T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54683048U, 164},  // Th0H
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3553U, 124},  // TM5S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3130U, 129},  // TM10
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473254U,  86},  // TG2T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433231U,  36},  // TC21
+    {0x54703050U, 206},  // Tp0P
+    {0x54483042U, 162},  // TH0B
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54654750U,  95},  // TeGP
+    {0x544C3050U, 202},  // TL0P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433143U,  16},  // TC1C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54436150U,  66},  // TCaP
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653453U, 180},  // Te4S
+    {0x54483050U, 160},  // TH0P
+    {0x54413044U,   7},  // TA0D
+    {0x54423254U, 195},  // TB2T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544E5447U, 188},  // TNTG
+    {0x54434253U,  59},  // TCBS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483043U, 163},  // TH0C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54443250U, 232},  // TD2P
+    {0x5461726CU,  14},  // Tarl
+    {0x544D3453U, 123},  // TM4S
+    {0x54473050U,  74},  // TG0P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433144U,  44},  // TC1D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473154U,  85},  // TG1T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433130U,  25},  // TC10
+    {0x54413350U,   3},  // TA3P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433230U,  35},  // TC20
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433043U,  15},  // TC0C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3050U,  97},  // Tm0P
+    {0x54703044U, 207},  // Tp0D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434344U,  63},  // TCCD
+    {0x54573250U, 217},  // TW2P
+    {0x54433132U,  27},  // TC12
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54615243U,  11},  // TaRC
+    {0x54505344U, 190},  // TPSD
+    {0x54433232U,  37},  // TC22
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483041U, 161},  // TH0A
+    {0x54655250U,  96},  // TeRP
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54423053U, 197},  // TB0S
+    {0x54653546U, 181},  // Te5F
+    {0x54413250U,   2},  // TA2P
+    {0x54653354U, 227},  // Te3T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D4C53U, 140},  // TMLS
+    {0x54654747U,  93},  // TeGG
+    {0x544D4231U, 135},  // TMB1
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433136U,  31},  // TC16
+    {0x544D3850U, 117},  // TM8P
+    {0x546D4353U, 107},  // TmCS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483350U, 146},  // TH3P
+    {0x54433234U,  39},  // TC24
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433045U,  45},  // TC0E
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653253U, 176},  // Te2S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434244U,  56},  // TCBD
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54573150U, 216},  // TW1P
+    {0x54474444U,  92},  // TGDD
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D4232U, 136},  // TMB2
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3253U, 121},  // TM2S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54545444U, 191},  // TTTD
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653150U, 172},  // Te1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653446U, 179},  // Te4F
+    {0x54434743U,  60},  // TCGC
+    {0x54413150U,   1},  // TA1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D4131U, 131},  // TMA1
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D5447U, 143},  // TMTG
+    {0x546D4253U, 106},  // TmBS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473043U,  80},  // TG0C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433139U,  34},  // TC19
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483062U, 170},  // TH0b
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653153U, 174},  // Te1S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54705053U, 210},  // TpPS
+    {0x54434144U,  51},  // TCAD
+    {0x54573053U, 218},  // TW0S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54435341U,  64},  // TCSA
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D4133U, 133},  // TMA3
+    {0x544D3153U, 120},  // TM1S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54485447U, 214},  // THTG
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483446U, 158},  // TH4F
+    {0x544D4233U, 137},  // TMB3
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653346U, 177},  // Te3F
+    {0x54413050U,   0},  // TA0P
+    {0x544E3044U, 183},  // TN0D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433237U,  42},  // TC27
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3550U, 102},  // Tm5P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3650U, 115},  // TM6P
+    {0x54435343U,  62},  // TCSC
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473054U,  84},  // TG0T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473047U,  90},  // TG0G
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473450U,  78},  // TG4P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x5442314DU, 200},  // TB1M
+    {0x54574150U, 219},  // TWAP
+    {0x54434148U,  53},  // TCAH
+    {0x54573050U, 215},  // TW0P
+    {0x54473550U,  79},  // TG5P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483346U, 156},  // TH3F
+    {0x544D4132U, 132},  // TMA2
+    {0x544F3050U, 204},  // TO0P
+    {0x54655247U,  94},  // TeRG
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653246U, 175},  // Te2F
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54504344U, 189},  // TPCD
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54413054U,   9},  // TA0T
+    {0x544D3550U, 114},  // TM5P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433243U,  17},  // TC2C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3053U, 119},  // TM0S
+    {0x54433050U,  48},  // TC0P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653146U, 173},  // Te1F
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54733153U, 223},  // Ts1S
+    {0x54473544U,  73},  // TG5D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x48444430U, 148},  // HDD0
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54443350U, 233},  // TD3P
+    {0x54434763U,  61},  // TCGc
+    {0x54413056U,   5},  // TA0V
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483246U, 154},  // TH2F
+    {0x54433843U,  23},  // TC8C
+    {0x54473444U,  72},  // TG4D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3250U,  99},  // Tm2P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653554U, 229},  // Te5T
+    {0x544D4853U, 139},  // TMHS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3450U, 113},  // TM4P
+    {0x54563052U, 213},  // TV0R
+    {0x48444432U, 150},  // HDD2
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473150U,  75},  // TG1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3131U, 130},  // TM11
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544E3150U, 187},  // TN1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54413450U,   4},  // TA4P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433044U,  43},  // TC0D
+    {0x546D4453U, 108},  // TmDS
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483450U, 147},  // TH4P
+    {0x54473048U,  91},  // TG0H
+    {0x54703150U, 209},  // Tp1P
+    {0x54483146U, 152},  // TH1F
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433743U,  22},  // TC7C
+    {0x54473344U,  71},  // TG3D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54423154U, 194},  // TB1T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x546D3750U, 104},  // Tm7P
+    {0x54434153U,  54},  // TCAS
+    {0x54653454U, 228},  // Te4T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54413045U,   8},  // TA0E
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3350U, 112},  // TM3P
+    {0x54433233U,  38},  // TC23
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433047U,  49},  // TC0G
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653353U, 178},  // Te3S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544E3050U, 185},  // TN0P
+    {0x54423153U, 198},  // TB1S
+    {0x54703143U, 208},  // Tp1C
+    {0x54433131U,  26},  // TC11
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54614C43U,  10},  // TaLC
+    {0x54443150U, 231},  // TD1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3353U, 122},  // TM3S
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483046U, 168},  // TH0F
+    {0x54433643U,  21},  // TC6C
+    {0x54473244U,  70},  // TG2D
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483456U, 159},  // TH4V
+    {0x54473053U,  82},  // TG0S
+    {0x546D3650U, 103},  // Tm6P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544E3053U, 186},  // TN0S
+    {0x54473153U,  83},  // TG1S
+    {0x544D3250U, 111},  // TM2P
+    {0x54433133U,  28},  // TC13
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54473143U,  81},  // TG1C
+    {0x54483356U, 157},  // TH3V
+    {0x54433236U,  41},  // TC26
+    {0x544D3953U, 128},  // TM9S
+    {0x54433046U,  46},  // TC0F
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54434243U,  55},  // TCBC
+    {0x54703043U, 205},  // Tp0C
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54533056U, 171},  // TS0V
+    {0x54443050U, 230},  // TD0P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54483250U, 145},  // TH2P
+    {0x54433134U,  29},  // TC14
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433543U,  20},  // TC5C
+    {0x54473144U,  69},  // TG1D
+    {0x54494544U,  67},  // TIED
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433048U,  47},  // TC0H
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54653254U, 226},  // Te2T
+    {0x54617273U,  13},  // Tars
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54423054U, 193},  // TB0T
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D3150U, 110},  // TM1P
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x544D4234U, 138},  // TMB4
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x54433135U,  30},  // TC15
+    {0x544D3853U, 127},  // TM8S
+    {0x54483061U, 169},  // TH0a
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+    {0x00000000U, SENSOR_HASH_EMPTY},
+};
+
+#endif // SENSOR_HASH_H
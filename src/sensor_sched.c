@@ -0,0 +1,384 @@
+#include "sensor_sched.h"
+#include "smc_async.h"
+#include "telemetry.h"
+#include "smc_health.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+#endif
+
+// Per-sensor schedule
+typedef struct {
+    UINT64 next_due_us;       // Next time the sensor should be read
+    UINT8 rate;               // SENSOR_RATE class
+    BOOLEAN bound;            // Feeds an active fan curve
+    BOOLEAN in_flight;        // Read submitted, not yet completed
+} SCHED_ENTRY;
+
+static const UINT32 rate_period_ms[SENSOR_RATE_COUNT] = {
+    SENSOR_PERIOD_FAST_MS,
+    SENSOR_PERIOD_MEDIUM_MS,
+    SENSOR_PERIOD_SLOW_MS
+};
+
+static TEMP_SENSOR *sched_sensors = NULL;
+static SCHED_ENTRY *entries = NULL;
+static UINT16 sched_count = 0;
+
+// Round-robin cursor per class so no sensor starves behind its neighbours
+static UINT16 rate_cursor[SENSOR_RATE_COUNT];
+
+// Sensors bound to sensor-based fans
+static UINT16 bound_list[MAX_FANS];
+static UINT8 bound_count = 0;
+
+static EFI_EVENT sched_event = NULL;
+static UINT32 sched_budget_us = SENSOR_SCHED_BUDGET_US;
+
+// New readings in the telemetry working frame since the last publish
+static BOOLEAN frame_dirty = FALSE;
+
+// Measured SMC cost per read (from engine counters)
+static UINT32 read_cost_us = SENSOR_SCHED_READ_COST_US;
+static SMC_ASYNC_STATS last_stats;
+
+/**
+ * Sampling class from the key name
+ * T<group><n><kind>: group C/G/p are dies, A/B/s/W/L/H are slow thermal masses,
+ * and Te?T are enclosure sensors.
+ */
+SENSOR_RATE sensor_sched_classify(SMC_KEY key) {
+    CHAR8 group = (CHAR8)SMC_KEY_CHAR(key, 1);
+
+    switch (group) {
+        case 'C':   // CPU
+        case 'G':   // GPU
+        case 'p':   // Power supply / processor package
+            return SENSOR_RATE_FAST;
+
+        case 'A':   // Ambient
+        case 'B':   // Battery
+        case 's':   // Skin / palm rest
+        case 'W':   // Wireless module
+        case 'L':   // LCD
+        case 'H':   // Hard drive bays
+            return SENSOR_RATE_SLOW;
+
+        case 'e':   // Enclosure (Te?T); other Te keys track PCIe/GPU parts
+            return (SMC_KEY_CHAR(key, 3) == 'T') ? SENSOR_RATE_SLOW : SENSOR_RATE_MEDIUM;
+
+        default:
+            return SENSOR_RATE_MEDIUM;
+    }
+}
+
+/**
+ * Period for a sensor, accounting for fan-curve binding
+ */
+static UINT64 entry_period_us(const SCHED_ENTRY *entry) {
+    UINT8 rate = entry->bound ? SENSOR_RATE_FAST : entry->rate;
+    return (UINT64)rate_period_ms[rate] * 1000;
+}
+
+/**
+ * Async completion: store the temperature in the telemetry working frame
+ */
+static void on_sensor_read(SMC_KEY key, EFI_STATUS status, const UINT8 *data, UINT8 data_len,
+                           void *context) {
+    TELEMETRY_FRAME *frame = telemetry_working_frame();
+    UINTN i = (UINTN)context;
+    INT16 temp;
+
+    if (!entries || i >= sched_count) {
+        return;
+    }
+    entries[i].in_flight = FALSE;
+
+    if (!EFI_ERROR(status)) {
+        status = temp_decode_sensor(key, data, data_len, &temp);
+        if (status == EFI_NOT_READY) {
+            return;  // Type not cached yet: keep the last reading
+        }
+    }
+
+    if (!EFI_ERROR(status)) {
+        frame->temperature[i] = temp;
+        frame->sensor_valid[i] = TRUE;
+    } else {
+        frame->sensor_valid[i] = FALSE;
+    }
+    frame_dirty = TRUE;
+}
+
+/**
+ * Submit one read if the sensor is due and the budget allows
+ * Returns FALSE once the tick budget is exhausted
+ */
+static BOOLEAN try_submit(UINT16 i, UINT64 now, UINT32 *budget) {
+    SCHED_ENTRY *entry = &entries[i];
+    EFI_STATUS status;
+
+    if (entry->in_flight || now < entry->next_due_us) {
+        return TRUE;
+    }
+    if (*budget < read_cost_us) {
+        return FALSE;
+    }
+
+    status = smc_async_submit_read(sched_sensors[i].smc_key, on_sensor_read,
+                                   (void *)(UINTN)i, NULL);
+    if (status == SMC_STATUS_QUARANTINED) {
+        // Dead key: costs nothing, try again next period
+        TELEMETRY_FRAME *frame = telemetry_working_frame();
+        if (frame->sensor_valid[i]) {
+            frame->sensor_valid[i] = FALSE;
+            frame_dirty = TRUE;
+        }
+        entry->next_due_us = now + entry_period_us(entry);
+        return TRUE;
+    }
+    if (EFI_ERROR(status)) {
+        return FALSE;  // Engine queue full; retry next tick
+    }
+
+    entry->in_flight = TRUE;
+    entry->next_due_us = now + entry_period_us(entry);
+    *budget -= read_cost_us;
+
+    return TRUE;
+}
+
+/**
+ * Refresh the per-read cost estimate from engine counters
+ */
+static void update_read_cost(void) {
+    SMC_ASYNC_STATS stats;
+    UINT64 busy, done;
+
+    smc_async_get_stats(&stats);
+    busy = stats.busy_us - last_stats.busy_us;
+    done = stats.completed - last_stats.completed;
+
+    // Wait for a handful of completions so one slow read doesn't skew it
+    if (done < 8) {
+        return;
+    }
+
+    // Moving average, 1/4 weight on the new sample
+    read_cost_us = (UINT32)((read_cost_us * 3 + busy / done) / 4);
+    if (read_cost_us == 0) {
+        read_cost_us = 1;
+    }
+    last_stats = stats;
+}
+
+/**
+ * Submit due reads, fan-bound sensors first, then by class
+ */
+static void submit_due(void) {
+    UINT64 now = timer_now_us();
+    UINT32 budget = sched_budget_us;
+    UINT8 rate;
+    UINTN i;
+
+    for (i = 0; i < bound_count; i++) {
+        if (!try_submit(bound_list[i], now, &budget)) {
+            return;
+        }
+    }
+
+    for (rate = 0; rate < SENSOR_RATE_COUNT; rate++) {
+        UINT16 start = rate_cursor[rate];
+        UINT16 n;
+
+        for (n = 0; n < sched_count; n++) {
+            UINT16 idx = (UINT16)((start + n) % sched_count);
+
+            if (entries[idx].rate != rate || entries[idx].bound) {
+                continue;
+            }
+            if (!try_submit(idx, now, &budget)) {
+                rate_cursor[rate] = idx;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Timer notify: publish readings completed since the last tick, then
+ * submit the next batch
+ */
+static void EFIAPI sched_tick(EFI_EVENT event, void *context) {
+    if (frame_dirty) {
+        frame_dirty = FALSE;
+        telemetry_publish();
+    }
+
+    update_read_cost();
+    submit_due();
+}
+
+/**
+ * Start the scheduler
+ */
+EFI_STATUS sensor_sched_init(TEMP_SENSOR sensors[], UINT16 count,
+                             UINT32 tick_ms, UINT32 budget_us) {
+    UINT16 class_count[SENSOR_RATE_COUNT] = {0};
+    UINT16 class_seen[SENSOR_RATE_COUNT] = {0};
+    EFI_STATUS status;
+    UINT64 now;
+    UINT16 i;
+
+    if (sched_event) {
+        return EFI_ALREADY_STARTED;
+    }
+    if (!sensors || count == 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    entries = AllocateZeroPool(count * sizeof(SCHED_ENTRY));
+    if (!entries) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    sched_sensors = sensors;
+    sched_count = count;
+    sched_budget_us = budget_us;
+    bound_count = 0;
+    frame_dirty = FALSE;
+    read_cost_us = SENSOR_SCHED_READ_COST_US;
+    smc_async_get_stats(&last_stats);
+
+    for (i = 0; i < count; i++) {
+        entries[i].rate = (UINT8)sensor_sched_classify(sensors[i].smc_key);
+        class_count[entries[i].rate]++;
+    }
+
+    // Stagger first reads across each class period so they don't bunch up
+    now = timer_now_us();
+    for (i = 0; i < count; i++) {
+        UINT8 rate = entries[i].rate;
+        UINT64 period_us = (UINT64)rate_period_ms[rate] * 1000;
+
+        entries[i].next_due_us = now + period_us * class_seen[rate] / class_count[rate];
+        class_seen[rate]++;
+    }
+
+    for (i = 0; i < SENSOR_RATE_COUNT; i++) {
+        rate_cursor[i] = 0;
+    }
+
+    status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                              sched_tick, NULL, &sched_event);
+    if (!EFI_ERROR(status)) {
+        status = gBS->SetTimer(sched_event, TimerPeriodic, (UINT64)tick_ms * 10000);
+        if (EFI_ERROR(status)) {
+            gBS->CloseEvent(sched_event);
+        }
+    }
+    if (EFI_ERROR(status)) {
+        sched_event = NULL;
+        FreePool(entries);
+        entries = NULL;
+        return status;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Stop the scheduler
+ */
+void sensor_sched_shutdown(void) {
+    UINTN i;
+    BOOLEAN busy;
+
+    if (!sched_event) {
+        return;
+    }
+
+    gBS->SetTimer(sched_event, TimerCancel, 0);
+    gBS->CloseEvent(sched_event);
+    sched_event = NULL;
+
+    // Let submitted reads land before the entries go away
+    do {
+        busy = FALSE;
+        for (i = 0; i < sched_count; i++) {
+            if (entries[i].in_flight) {
+                busy = TRUE;
+                break;
+            }
+        }
+        if (busy) {
+            smc_async_run(SMC_STATUS_TIMEOUT_US);
+        }
+    } while (busy && smc_async_pending() > 0);
+
+    FreePool(entries);
+    entries = NULL;
+    sched_sensors = NULL;
+    sched_count = 0;
+    bound_count = 0;
+}
+
+/**
+ * Track sensors that feed sensor-based fans
+ */
+void sensor_sched_bind_fans(const FAN_INFO fans[], UINT8 count) {
+    EFI_TPL old_tpl;
+    UINT64 now;
+    UINT8 i;
+
+    if (!entries) {
+        return;
+    }
+
+    old_tpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+    for (i = 0; i < bound_count; i++) {
+        entries[bound_list[i]].bound = FALSE;
+    }
+    bound_count = 0;
+
+    now = timer_now_us();
+    for (i = 0; i < count; i++) {
+        UINT16 idx = fans[i].sensor_index;
+
+        if (fans[i].mode != FAN_MODE_SENSOR_BASED || !fans[i].sensor_based_enabled ||
+            idx >= sched_count || entries[idx].bound) {
+            continue;
+        }
+
+        // Newly bound sensors drop to the fast period right away
+        entries[idx].bound = TRUE;
+        if (entries[idx].next_due_us > now + entry_period_us(&entries[idx])) {
+            entries[idx].next_due_us = now;
+        }
+        bound_list[bound_count++] = idx;
+    }
+
+    gBS->RestoreTPL(old_tpl);
+}
+
+/**
+ * Make every sensor due now
+ */
+void sensor_sched_refresh_all(void) {
+    EFI_TPL old_tpl;
+    UINT64 now;
+    UINT16 i;
+
+    if (!entries) {
+        return;
+    }
+
+    old_tpl = gBS->RaiseTPL(TPL_CALLBACK);
+    now = timer_now_us();
+    for (i = 0; i < sched_count; i++) {
+        entries[i].next_due_us = now;
+    }
+    gBS->RestoreTPL(old_tpl);
+}
@@ -0,0 +1,73 @@
+#ifndef SENSOR_SCHED_H
+#define SENSOR_SCHED_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "temp_sensors.h"
+#include "fan_control.h"
+
+/**
+ * Rate-grouped sensor scheduler
+ *
+ * Each sensor gets a sampling class from its key: die sensors change in
+ * milliseconds, enclosure/ambient/battery sensors over minutes. A timer
+ * spreads the due reads across ticks through the async SMC engine and
+ * stops submitting once the tick's SMC time budget is spent. Sensors that
+ * drive a sensor-based fan curve are always sampled fast and go first.
+ * Readings land in the telemetry working frame and are published on the
+ * following tick.
+ */
+
+// Sampling classes
+typedef enum {
+    SENSOR_RATE_FAST = 0,     // CPU/GPU die
+    SENSOR_RATE_MEDIUM,       // Proximity, memory, storage, power
+    SENSOR_RATE_SLOW,         // Ambient, enclosure, battery, skin
+    SENSOR_RATE_COUNT
+} SENSOR_RATE;
+
+// Sampling period per class (milliseconds)
+#define SENSOR_PERIOD_FAST_MS       250
+#define SENSOR_PERIOD_MEDIUM_MS     1000
+#define SENSOR_PERIOD_SLOW_MS       10000
+
+// Default scheduler tick and per-tick SMC time budget
+#define SENSOR_SCHED_TICK_MS        10
+#define SENSOR_SCHED_BUDGET_US      400
+
+// Assumed cost of one sensor read until the engine has measured it
+#define SENSOR_SCHED_READ_COST_US   80
+
+/**
+ * Lifecycle
+ * The async SMC engine must already be running.
+ */
+
+// Start sampling sensors[] (keys only; the array must outlive the scheduler)
+EFI_STATUS sensor_sched_init(TEMP_SENSOR sensors[], UINT16 count,
+                             UINT32 tick_ms, UINT32 budget_us);
+
+// Stop the timer and wait for reads already submitted
+void sensor_sched_shutdown(void);
+
+/**
+ * Control
+ */
+
+// Track which sensors feed active fan curves (call after fan mode changes)
+void sensor_sched_bind_fans(const FAN_INFO fans[], UINT8 count);
+
+// Make every sensor due immediately
+void sensor_sched_refresh_all(void);
+
+// Sampling class for a sensor key
+SENSOR_RATE sensor_sched_classify(SMC_KEY key);
+
+#endif // SENSOR_SCHED_H
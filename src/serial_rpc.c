@@ -0,0 +1,675 @@
+#include "serial_rpc.h"
+#include "smc_protocol.h"
+#include "telemetry.h"
+#include "fan_profile.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+  #include <Protocol/SerialIo.h>
+#endif
+
+// Most words in one request
+#define MAX_WORDS           12
+
+static EFI_SERIAL_IO_PROTOCOL *serial = NULL;
+
+// Request being received
+static CHAR8 line[SERIAL_RPC_LINE_MAX];
+static UINTN line_length = 0;
+static BOOLEAN line_overflow = FALSE;
+
+// Reply or telemetry line being encoded (CR LF is appended on send)
+static CHAR8 out[SERIAL_RPC_OUT_MAX];
+static UINTN out_length = 0;
+
+// Telemetry subscription
+static UINT32 sub_period_ms = 0;
+static UINT64 sub_due_us = 0;
+static TELEMETRY_FRAME frame;  // Too large for the stack
+
+/**
+ * Output encoding
+ * Appends past the end are dropped, so a long line is cut short, not overrun.
+ */
+
+static void out_char(CHAR8 c) {
+    if (out_length < sizeof(out) - 2) {
+        out[out_length++] = c;
+    }
+}
+
+static void out_str(const CHAR8 *text) {
+    while (*text) {
+        out_char(*text++);
+    }
+}
+
+static void out_uint(UINT64 value) {
+    CHAR8 digits[20];
+    UINTN count = 0;
+
+    do {
+        digits[count++] = (CHAR8)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (count > 0) {
+        out_char(digits[--count]);
+    }
+}
+
+// Decidegrees as degrees with one decimal
+static void out_temp(INT16 temp) {
+    INT32 value = temp;
+
+    if (value < 0) {
+        out_char('-');
+        value = -value;
+    }
+    out_uint((UINT32)value / 10);
+    out_char('.');
+    out_char((CHAR8)('0' + value % 10));
+}
+
+static void out_hex(UINT8 value) {
+    static const CHAR8 hex[] = "0123456789abcdef";
+
+    out_char(hex[value >> 4]);
+    out_char(hex[value & 0x0F]);
+}
+
+static void out_key(SMC_KEY key) {
+    UINT8 i;
+
+    for (i = 0; i < 4; i++) {
+        out_char((CHAR8)SMC_KEY_CHAR(key, i));
+    }
+}
+
+// Write the line in one call
+static void out_send(void) {
+    UINTN size;
+
+    out[out_length++] = '\r';
+    out[out_length++] = '\n';
+    size = out_length;
+    serial->Write(serial, &size, out);
+    out_length = 0;
+}
+
+static void reply_error(const CHAR8 *reason) {
+    out_length = 0;
+    out_str("ERR ");
+    out_str(reason);
+    out_send();
+}
+
+/**
+ * Request parsing
+ */
+
+static BOOLEAN word_is(const CHAR8 *word, const CHAR8 *name) {
+    while (*name) {
+        CHAR8 c = *word++;
+
+        if (c >= 'a' && c <= 'z') {
+            c = (CHAR8)(c - 'a' + 'A');
+        }
+        if (c != *name++) {
+            return FALSE;
+        }
+    }
+    return *word == '\0';
+}
+
+/**
+ * Parse a decimal number ending at stop or the end of the word
+ * Returns the character after the digits, NULL if there were none
+ */
+static const CHAR8 *parse_decimal(const CHAR8 *text, CHAR8 stop, UINT32 *value) {
+    const CHAR8 *start = text;
+
+    *value = 0;
+    while (*text >= '0' && *text <= '9') {
+        if (*value > 100000) {
+            return NULL;  // Far beyond any slot, RPM or period
+        }
+        *value = *value * 10 + (UINT32)(*text - '0');
+        text++;
+    }
+    if (text == start || (*text != '\0' && *text != stop)) {
+        return NULL;
+    }
+    return text;
+}
+
+static BOOLEAN parse_number(const CHAR8 *text, UINT32 *value) {
+    const CHAR8 *end = parse_decimal(text, '\0', value);
+    return end && *end == '\0';
+}
+
+static UINTN text_length(const CHAR8 *text) {
+    UINTN length = 0;
+
+    while (text[length]) {
+        length++;
+    }
+    return length;
+}
+
+// Key of up to four characters; short keys are padded with spaces ("REV" is "REV ")
+static BOOLEAN parse_key(const CHAR8 *text, UINTN length, SMC_KEY *key) {
+    CHAR8 chars[4] = { ' ', ' ', ' ', ' ' };
+    UINTN i;
+
+    if (length == 0 || length > 4) {
+        return FALSE;
+    }
+    for (i = 0; i < length; i++) {
+        chars[i] = text[i];
+    }
+    *key = smc_key_from_chars(chars);
+    return TRUE;
+}
+
+static BOOLEAN parse_slot(const SERIAL_RPC_CONTEXT *context, const CHAR8 *text, UINT8 *slot) {
+    UINT32 value;
+
+    if (!parse_number(text, &value) || value >= context->fan_count) {
+        return FALSE;
+    }
+    *slot = (UINT8)value;
+    return TRUE;
+}
+
+/**
+ * Requests
+ */
+
+static const CHAR8 *mode_name(FAN_MODE mode) {
+    switch (mode) {
+        case FAN_MODE_MANUAL:
+            return "MANUAL";
+        case FAN_MODE_SENSOR_BASED:
+            return "SENSOR";
+        default:
+            return "AUTO";
+    }
+}
+
+// "FAN <slot> <smc index> <mode> <rpm> <target> <min> <max>"
+static void out_fan(const SERIAL_RPC_CONTEXT *context, UINT8 slot) {
+    const FAN_INFO *fan = &context->fans[slot];
+
+    out_str("FAN ");
+    out_uint(slot);
+    out_char(' ');
+    out_uint(fan->index);
+    out_char(' ');
+    out_str(mode_name(fan->mode));
+    out_char(' ');
+    out_uint(fan->current_rpm);
+    out_char(' ');
+    out_uint(fan->mode == FAN_MODE_AUTO ? 0 : fan->target_rpm);
+    out_char(' ');
+    out_uint(fan->min_rpm);
+    out_char(' ');
+    out_uint(fan->max_rpm);
+}
+
+static BOOLEAN apply(SERIAL_RPC_CONTEXT *context, UINT8 slot, const FAN_INFO *config) {
+    if (EFI_ERROR(context->apply(context->fans, slot, config, context->ap_mode))) {
+        reply_error("smc");
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static BOOLEAN do_mode(SERIAL_RPC_CONTEXT *context, CHAR8 **words, UINTN count) {
+    FAN_INFO config;
+    UINT8 slot;
+
+    if (count != 3 || !parse_slot(context, words[1], &slot)) {
+        reply_error("usage: MODE <slot> AUTO|MANUAL");
+        return FALSE;
+    }
+
+    config = context->fans[slot];
+    config.sensor_based_enabled = FALSE;
+    if (word_is(words[2], "AUTO")) {
+        config.mode = FAN_MODE_AUTO;
+    } else if (word_is(words[2], "MANUAL")) {
+        config.mode = FAN_MODE_MANUAL;
+        config.target_rpm = fan_reachable_rpm(&config, context->fans[slot].current_rpm);
+    } else {
+        reply_error("usage: MODE <slot> AUTO|MANUAL");
+        return FALSE;
+    }
+
+    if (!apply(context, slot, &config)) {
+        return FALSE;
+    }
+    out_str("OK");
+    out_send();
+    return TRUE;
+}
+
+static BOOLEAN do_target(SERIAL_RPC_CONTEXT *context, CHAR8 **words, UINTN count) {
+    FAN_INFO config;
+    UINT32 rpm;
+    UINT8 slot;
+
+    if (count != 3 || !parse_slot(context, words[1], &slot) || !parse_number(words[2], &rpm) ||
+        rpm > 0xFFFF) {
+        reply_error("usage: TARGET <slot> <rpm>");
+        return FALSE;
+    }
+
+    config = context->fans[slot];
+    config.mode = FAN_MODE_MANUAL;
+    config.sensor_based_enabled = FALSE;
+    config.target_rpm = fan_reachable_rpm(&config, (UINT16)rpm);
+
+    if (!apply(context, slot, &config)) {
+        return FALSE;
+    }
+    out_str("OK ");
+    out_uint(config.target_rpm);
+    out_send();
+    return TRUE;
+}
+
+static void do_read(const SERIAL_RPC_CONTEXT *context, CHAR8 **words, UINTN count) {
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len = 0;
+    UINT8 size = 0;
+    CHAR8 type[5];
+    SMC_KEY key;
+    UINT8 i;
+
+    if (count != 2 || !parse_key(words[1], text_length(words[1]), &key)) {
+        reply_error("usage: READ <key>");
+        return;
+    }
+    if (context->ap_mode) {
+        reply_error("busy");  // The AP owns the SMC
+        return;
+    }
+
+    if (EFI_ERROR(smc_read_key(key, data, &data_len))) {
+        reply_error("smc");
+        return;
+    }
+    if (EFI_ERROR(smc_get_key_type(key, &size, type))) {
+        type[0] = type[1] = type[2] = type[3] = '?';
+        type[4] = '\0';
+    }
+
+    out_str("OK ");
+    out_key(key);
+    out_char(' ');
+    out_str(type);
+    out_char(' ');
+    out_uint(data_len);
+    out_char(' ');
+    for (i = 0; i < data_len; i++) {
+        out_hex(data[i]);
+    }
+    out_send();
+}
+
+static void do_sub(CHAR8 **words, UINTN count) {
+    UINT32 period;
+
+    if (count != 2 || !parse_number(words[1], &period)) {
+        reply_error("usage: SUB <ms>");
+        return;
+    }
+    if (period != 0 && period < SERIAL_RPC_SUB_MIN_MS) {
+        period = SERIAL_RPC_SUB_MIN_MS;
+    }
+
+    sub_period_ms = period;
+    sub_due_us = timer_now_us();
+
+    out_str("OK ");
+    out_uint(period);
+    out_send();
+}
+
+/**
+ * Parse one PROFILE spec into config
+ */
+static BOOLEAN parse_spec(const SERIAL_RPC_CONTEXT *context, const CHAR8 *spec, UINT8 *slot,
+                          FAN_INFO *config) {
+    const CHAR8 *rest;
+    const CHAR8 *key_end;
+    UINT32 value, min_c, max_c;
+    SMC_KEY key;
+    UINT16 i;
+
+    rest = parse_decimal(spec, ':', &value);
+    if (!rest || *rest != ':' || value >= context->fan_count) {
+        return FALSE;
+    }
+    rest++;
+    *slot = (UINT8)value;
+    *config = context->fans[*slot];
+    config->sensor_based_enabled = FALSE;
+    config->curve = NULL;
+
+    if (word_is(rest, "AUTO")) {
+        config->mode = FAN_MODE_AUTO;
+        return TRUE;
+    }
+    if (parse_number(rest, &value) && value <= 0xFFFF) {
+        config->mode = FAN_MODE_MANUAL;
+        config->target_rpm = fan_reachable_rpm(config, (UINT16)value);
+        return TRUE;
+    }
+
+    // <key>:<min>-<max>
+    key_end = rest;
+    while (*key_end && *key_end != ':') {
+        key_end++;
+    }
+    if (*key_end != ':' || !parse_key(rest, (UINTN)(key_end - rest), &key)) {
+        return FALSE;
+    }
+    rest = parse_decimal(key_end + 1, '-', &min_c);
+    if (!rest || *rest != '-' || !parse_number(rest + 1, &max_c) || min_c >= max_c ||
+        max_c > 120) {
+        return FALSE;
+    }
+
+    for (i = 0; i < context->sensor_count; i++) {
+        if (context->sensors[i].smc_key == key) {
+            break;
+        }
+    }
+    if (i == context->sensor_count) {
+        return FALSE;
+    }
+
+    config->mode = FAN_MODE_SENSOR_BASED;
+    config->sensor_based_enabled = TRUE;
+    config->sensor_index = i;
+    config->min_temp = (INT16)(min_c * 10);
+    config->max_temp = (INT16)(max_c * 10);
+    return TRUE;
+}
+
+/**
+ * Apply a set of fan settings, or a named thermal profile
+ * Every spec is checked before any fan is touched.
+ */
+static BOOLEAN do_profile(SERIAL_RPC_CONTEXT *context, CHAR8 **words, UINTN count) {
+    FAN_INFO config;
+    UINT8 profile;
+    UINT8 slot;
+    UINTN i;
+
+    if (count == 2 && (profile = fan_profile_find(words[1])) != FAN_PROFILE_NONE) {
+        EFI_STATUS status = fan_profile_load(profile, context->fans, context->fan_count,
+                                             context->sensors, context->sensor_count,
+                                             context->apply, context->ap_mode);
+        if (status == EFI_NOT_FOUND) {
+            reply_error("no sensor");
+            return FALSE;
+        }
+        if (status == EFI_NOT_READY) {
+            reply_error("busy");  // The AP has not taken the last changes yet
+            return FALSE;
+        }
+        if (EFI_ERROR(status)) {
+            reply_error("smc");
+            return TRUE;  // Other fans may have switched
+        }
+        out_str("OK ");
+        out_uint(context->fan_count);
+        out_send();
+        return TRUE;
+    }
+
+    if (count < 2) {
+        reply_error("usage: PROFILE <name> | <slot>:AUTO|<rpm>|<key>:<min>-<max>...");
+        return FALSE;
+    }
+    for (i = 1; i < count; i++) {
+        if (!parse_spec(context, words[i], &slot, &config)) {
+            out_str("ERR bad spec ");
+            out_str(words[i]);
+            out_send();
+            return FALSE;
+        }
+    }
+
+    for (i = 1; i < count; i++) {
+        parse_spec(context, words[i], &slot, &config);
+        if (!apply(context, slot, &config)) {
+            return i > 1;
+        }
+    }
+
+    out_str("OK ");
+    out_uint(count - 1);
+    out_send();
+    return TRUE;
+}
+
+/**
+ * Run one request line; TRUE if fan settings changed
+ */
+static BOOLEAN execute(SERIAL_RPC_CONTEXT *context, CHAR8 *request) {
+    CHAR8 *words[MAX_WORDS];
+    UINTN count = 0;
+    UINT8 slot;
+    UINT8 i;
+
+    // Split in place at spaces
+    while (*request) {
+        while (*request == ' ' || *request == '\t') {
+            *request++ = '\0';
+        }
+        if (!*request) {
+            break;
+        }
+        if (count == MAX_WORDS) {
+            reply_error("too many words");
+            return FALSE;
+        }
+        words[count++] = request;
+        while (*request && *request != ' ' && *request != '\t') {
+            request++;
+        }
+    }
+    if (count == 0) {
+        return FALSE;
+    }
+
+    if (word_is(words[0], "PING")) {
+        out_str("OK");
+        out_send();
+    } else if (word_is(words[0], "FANS")) {
+        out_str("OK ");
+        out_uint(context->fan_count);
+        out_send();
+        for (i = 0; i < context->fan_count; i++) {
+            out_fan(context, i);
+            out_send();
+        }
+    } else if (word_is(words[0], "GET")) {
+        if (count != 2 || !parse_slot(context, words[1], &slot)) {
+            reply_error("usage: GET <slot>");
+        } else {
+            out_str("OK ");
+            out_fan(context, slot);
+            out_send();
+        }
+    } else if (word_is(words[0], "MODE")) {
+        return do_mode(context, words, count);
+    } else if (word_is(words[0], "TARGET")) {
+        return do_target(context, words, count);
+    } else if (word_is(words[0], "READ")) {
+        do_read(context, words, count);
+    } else if (word_is(words[0], "SUB")) {
+        do_sub(words, count);
+    } else if (word_is(words[0], "PROFILE")) {
+        return do_profile(context, words, count);
+    } else {
+        reply_error("unknown request");
+    }
+    return FALSE;
+}
+
+/**
+ * Send one telemetry line from the latest published frame
+ */
+static void send_telemetry(const SERIAL_RPC_CONTEXT *context) {
+    UINT8 fan_count;
+    UINT8 i;
+
+    if (!telemetry_read(&frame)) {
+        return;
+    }
+
+    fan_count = context->fan_count < frame.fan_count ? context->fan_count : frame.fan_count;
+
+    out_str("T ");
+    out_uint(frame.timestamp_us / 1000);
+    out_str(" F");
+    for (i = 0; i < fan_count; i++) {
+        const FAN_INFO *fan = &context->fans[i];
+        UINT16 target = fan->target_rpm;
+
+        if (fan->mode == FAN_MODE_AUTO) {
+            target = 0;
+        } else if (fan->mode == FAN_MODE_SENSOR_BASED && frame.targets_valid) {
+            target = frame.fan_target[i];
+        }
+        out_char(' ');
+        out_uint(frame.fan_rpm[i]);
+        out_char('/');
+        out_uint(target);
+    }
+
+    out_str(" S");
+    for (i = 0; i < fan_count; i++) {
+        const FAN_INFO *fan = &context->fans[i];
+        UINT16 slot = fan->sensor_index;
+
+        if (fan->mode != FAN_MODE_SENSOR_BASED || !fan->sensor_based_enabled ||
+            slot >= context->sensor_count || slot >= frame.sensor_count ||
+            !frame.sensor_valid[slot]) {
+            continue;
+        }
+        out_char(' ');
+        out_key(context->sensors[slot].smc_key);
+        out_char('=');
+        out_temp(frame.temperature[slot]);
+    }
+    out_send();
+}
+
+/**
+ * Open the port-th serial port
+ */
+EFI_STATUS serial_rpc_open(UINTN port) {
+    EFI_HANDLE *handles = NULL;
+    UINTN handle_count = 0;
+    EFI_STATUS status;
+
+    if (serial) {
+        return EFI_ALREADY_STARTED;
+    }
+
+    status = gBS->LocateHandleBuffer(ByProtocol, &gEfiSerialIoProtocolGuid, NULL,
+                                     &handle_count, &handles);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    if (port < handle_count) {
+        status = gBS->HandleProtocol(handles[port], &gEfiSerialIoProtocolGuid, (void **)&serial);
+    } else {
+        status = EFI_NOT_FOUND;
+    }
+    FreePool(handles);
+
+    if (EFI_ERROR(status)) {
+        serial = NULL;
+        return status;
+    }
+
+    line_length = 0;
+    line_overflow = FALSE;
+    sub_period_ms = 0;
+    return EFI_SUCCESS;
+}
+
+void serial_rpc_close(void) {
+    serial = NULL;
+    sub_period_ms = 0;
+}
+
+BOOLEAN serial_rpc_active(void) {
+    return serial != NULL;
+}
+
+/**
+ * Drain received bytes, run complete requests, send due telemetry
+ */
+BOOLEAN serial_rpc_poll(SERIAL_RPC_CONTEXT *context) {
+    BOOLEAN changed = FALSE;
+    UINT32 control;
+    UINT64 now;
+
+    if (!serial || !context) {
+        return FALSE;
+    }
+
+    while (!EFI_ERROR(serial->GetControl(serial, &control)) &&
+           !(control & EFI_SERIAL_INPUT_BUFFER_EMPTY)) {
+        UINTN size = 1;
+        CHAR8 c;
+
+        if (EFI_ERROR(serial->Read(serial, &size, &c)) || size == 0) {
+            break;
+        }
+
+        if (c != '\r' && c != '\n') {
+            if (line_length < sizeof(line) - 1) {
+                line[line_length++] = c;
+            } else {
+                line_overflow = TRUE;
+            }
+            continue;
+        }
+
+        // End of a request (CR LF gives an empty second line, which is skipped)
+        if (line_overflow) {
+            reply_error("line too long");
+        } else if (line_length > 0) {
+            line[line_length] = '\0';
+            changed |= execute(context, line);
+        }
+        line_length = 0;
+        line_overflow = FALSE;
+    }
+
+    if (sub_period_ms != 0) {
+        now = timer_now_us();
+        if (now >= sub_due_us) {
+            send_telemetry(context);
+
+            // Keep the cadence; after a stall restart it instead of bursting
+            sub_due_us += (UINT64)sub_period_ms * 1000;
+            if (sub_due_us <= now) {
+                sub_due_us = now + (UINT64)sub_period_ms * 1000;
+            }
+        }
+    }
+
+    return changed;
+}
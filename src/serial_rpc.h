@@ -0,0 +1,85 @@
+#ifndef SERIAL_RPC_H
+#define SERIAL_RPC_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Remote control over a serial line
+ *
+ * A line protocol on an EFI_SERIAL_IO_PROTOCOL port (--serial[=<n>]) for
+ * driving headless machines from a host. Requests are ASCII words ending
+ * in CR or LF; every request gets one reply line, "OK ..." or "ERR <why>".
+ * Fans are addressed by their slot in the menu's table.
+ *
+ *   PING                       OK
+ *   FANS                       OK <count>, then FAN lines (as for GET)
+ *   GET <slot>                 OK FAN <slot> <smc index> <mode> <rpm> <target> <min> <max>
+ *   MODE <slot> AUTO|MANUAL    OK
+ *   TARGET <slot> <rpm>        OK <rpm after clamping>   (switches to manual)
+ *   READ <key>                 OK <key> <type> <size> <hex bytes>
+ *   SUB <ms>                   OK <ms>   telemetry every <ms>, 0 to stop
+ *   PROFILE <spec>...          OK <fans changed>
+ *   PROFILE <name>             OK <fans changed>   (thermal profile, fan_profile.h)
+ *
+ * PROFILE specs: <slot>:AUTO, <slot>:<rpm>, or <slot>:<key>:<min>-<max> for a
+ * curve on a sensor (whole degrees C), e.g. "PROFILE 0:AUTO 1:2000 2:TC0P:40-80".
+ * A name (SILENT, BALANCED, PERFORMANCE or MAX, any case) sets every fan.
+ *
+ * Telemetry lines come from the published frame (telemetry.h), encoded
+ * into a static buffer as they are written:
+ *
+ *   T <ms> F <rpm>/<target>... S <key>=<temp>...
+ *
+ * with a rpm/target pair per fan (target 0 in auto mode) and the sensors
+ * bound to fan curves. The port is polled; the firmware console should be
+ * on a different port, or its terminal driver competes for input.
+ */
+
+// Poll period for the menu loop
+#define SERIAL_RPC_POLL_MS      20
+
+// Longest request line, and longest reply or telemetry line
+#define SERIAL_RPC_LINE_MAX     128
+#define SERIAL_RPC_OUT_MAX      768
+
+// Shortest telemetry period
+#define SERIAL_RPC_SUB_MIN_MS   20
+
+// Applies a fan's new mode/target/curve (the menu's apply path: direct or via the AP)
+typedef EFI_STATUS (*SERIAL_RPC_APPLY)(FAN_INFO fans[], UINT8 slot, const FAN_INFO *config,
+                                       BOOLEAN ap_mode);
+
+// The menu's state, refreshed by the caller before each poll
+typedef struct {
+    FAN_INFO *fans;
+    UINT8 fan_count;
+    TEMP_SENSOR *sensors;
+    UINT16 sensor_count;
+    BOOLEAN ap_mode;          // An AP owns the SMC (READ is refused)
+    SERIAL_RPC_APPLY apply;
+} SERIAL_RPC_CONTEXT;
+
+// Open the port-th serial port (in handle order)
+EFI_STATUS serial_rpc_open(UINTN port);
+
+// Stop telemetry and release the port
+void serial_rpc_close(void);
+
+// TRUE while a port is open
+BOOLEAN serial_rpc_active(void);
+
+// Handle received requests and send telemetry that is due (no allocation)
+// Returns TRUE if a request changed fan settings
+BOOLEAN serial_rpc_poll(SERIAL_RPC_CONTEXT *context);
+
+#endif // SERIAL_RPC_H
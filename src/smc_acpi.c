@@ -0,0 +1,398 @@
+#include "smc_acpi.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+  #include <Guid/Acpi.h>
+#endif
+
+#ifdef _GNU_EFI
+static EFI_GUID acpi20_table_guid = ACPI_20_TABLE_GUID;
+static EFI_GUID acpi10_table_guid = ACPI_TABLE_GUID;
+#else
+#define acpi20_table_guid gEfiAcpi20TableGuid
+#define acpi10_table_guid gEfiAcpi10TableGuid
+#endif
+
+// Table layouts, as byte offsets (fields are unaligned little-endian)
+#define SDT_LENGTH          4
+#define SDT_HEADER_SIZE     36
+#define RSDP_REVISION       15
+#define RSDP_RSDT           16
+#define RSDP_XSDT           24
+#define FADT_DSDT           40
+#define FADT_X_DSDT         140
+
+// AML encoding
+#define AML_ZERO_OP         0x00
+#define AML_ONE_OP          0x01
+#define AML_NAME_OP         0x08
+#define AML_BYTE_PREFIX     0x0A
+#define AML_WORD_PREFIX     0x0B
+#define AML_DWORD_PREFIX    0x0C
+#define AML_STRING_PREFIX   0x0D
+#define AML_BUFFER_OP       0x11
+#define AML_EXT_OP_PREFIX   0x5B
+#define AML_DEVICE_OP       0x82
+
+// Resource descriptors (small: type in bits 6..3, large: bit 7 set)
+#define RES_SMALL_IO        0x08
+#define RES_SMALL_FIXED_IO  0x09
+#define RES_SMALL_END       0x0F
+#define RES_LARGE_MEMORY32  0x85
+#define RES_LARGE_FIXED_MEM 0x86
+
+static const UINT8 smc_eisaid[4] = SMC_ACPI_EISAID;
+
+static UINT16 read16(const UINT8 *p) {
+    return (UINT16)(p[0] | (p[1] << 8));
+}
+
+static UINT32 read32(const UINT8 *p) {
+    return (UINT32)read16(p) | ((UINT32)read16(p + 2) << 16);
+}
+
+static UINT64 read64(const UINT8 *p) {
+    return (UINT64)read32(p) | ((UINT64)read32(p + 4) << 32);
+}
+
+static BOOLEAN signature_is(const UINT8 *table, const char *signature) {
+    return CompareMem((void *)table, (void *)signature, 4) == 0;
+}
+
+/**
+ * Find the RSDP in the system configuration table (ACPI 2.0+ preferred)
+ */
+static const UINT8 *find_rsdp(void) {
+    const UINT8 *rsdp10 = NULL;
+    UINTN i;
+
+    for (i = 0; i < gST->NumberOfTableEntries; i++) {
+        EFI_CONFIGURATION_TABLE *entry = &gST->ConfigurationTable[i];
+
+        if (CompareMem(&entry->VendorGuid, &acpi20_table_guid, sizeof(EFI_GUID)) == 0) {
+            return (const UINT8 *)entry->VendorTable;
+        }
+        if (CompareMem(&entry->VendorGuid, &acpi10_table_guid, sizeof(EFI_GUID)) == 0) {
+            rsdp10 = (const UINT8 *)entry->VendorTable;
+        }
+    }
+    return rsdp10;
+}
+
+/**
+ * Decode a PkgLength
+ * Returns the encoded length (which counts the PkgLength bytes themselves)
+ * and the number of bytes the encoding takes; FALSE if it runs past end.
+ */
+static BOOLEAN pkg_length(const UINT8 *p, const UINT8 *end, UINT32 *length, UINT32 *size) {
+    UINT32 extra;
+    UINT32 i;
+
+    if (p >= end) {
+        return FALSE;
+    }
+
+    extra = p[0] >> 6;
+    if (p + 1 + extra > end) {
+        return FALSE;
+    }
+
+    if (extra == 0) {
+        *length = p[0] & 0x3F;
+    } else {
+        *length = p[0] & 0x0F;
+        for (i = 0; i < extra; i++) {
+            *length |= (UINT32)p[1 + i] << (4 + 8 * i);
+        }
+    }
+    *size = 1 + extra;
+    return TRUE;
+}
+
+// First byte of a NameString: lead name character or a path prefix
+static BOOLEAN is_name_start(UINT8 c) {
+    return (c >= 'A' && c <= 'Z') || c == '_' || c == '\\' || c == '^' ||
+           c == 0x2E || c == 0x2F;
+}
+
+/**
+ * Find the innermost Device whose body contains position
+ * Scans back for DeviceOp; the first candidate that encloses position is
+ * the innermost one. Stray 5B 82 bytes in data fail the range or name check.
+ */
+static BOOLEAN find_enclosing_device(const UINT8 *aml, const UINT8 *end, const UINT8 *position,
+                                     const UINT8 **body, const UINT8 **body_end) {
+    const UINT8 *p = position;
+
+    while (p > aml + 1) {
+        UINT32 length;
+        UINT32 size;
+
+        p--;
+        if (p[-1] != AML_EXT_OP_PREFIX || p[0] != AML_DEVICE_OP) {
+            continue;
+        }
+        if (!pkg_length(p + 1, end, &length, &size) || length <= size ||
+            p + 1 + length > end) {
+            continue;
+        }
+        if (p + 1 + length > position && is_name_start(p[1 + size])) {
+            *body = p + 1 + size;
+            *body_end = p + 1 + length;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Take the first I/O range and the first memory window from a resource template
+ */
+static void parse_resources(const UINT8 *p, const UINT8 *end, SMC_ACPI_DEVICE *dev) {
+    while (p < end) {
+        UINT8 tag = p[0];
+        const UINT8 *data;
+        UINT32 length;
+
+        if (tag & 0x80) {
+            if (p + 3 > end) {
+                return;
+            }
+            length = read16(p + 1);
+            data = p + 3;
+        } else {
+            length = tag & 0x07;
+            data = p + 1;
+            if ((tag >> 3) == RES_SMALL_END) {
+                return;
+            }
+        }
+        if (data + length > end) {
+            return;
+        }
+
+        if (tag == RES_LARGE_FIXED_MEM && length >= 9 && dev->mmio_length == 0) {
+            dev->mmio_base = read32(data + 1);
+            dev->mmio_length = read32(data + 5);
+        } else if (tag == RES_LARGE_MEMORY32 && length >= 17 && dev->mmio_length == 0) {
+            dev->mmio_base = read32(data + 1);
+            dev->mmio_length = read32(data + 13);
+        } else if (!(tag & 0x80) && (tag >> 3) == RES_SMALL_IO && length >= 7 &&
+                   dev->io_length == 0) {
+            dev->io_base = read16(data + 1);
+            dev->io_length = data[6];
+        } else if (!(tag & 0x80) && (tag >> 3) == RES_SMALL_FIXED_IO && length >= 3 &&
+                   dev->io_length == 0) {
+            dev->io_base = read16(data) & 0x03FF;
+            dev->io_length = data[2];
+        }
+
+        p = data + length;
+    }
+}
+
+/**
+ * Decode Name (_CRS, Buffer (n) {...}) inside a device body
+ */
+static void parse_crs(const UINT8 *body, const UINT8 *body_end, SMC_ACPI_DEVICE *dev) {
+    const UINT8 *p = body;
+
+    while (p + 6 <= body_end) {
+        const UINT8 *buffer;
+        const UINT8 *buffer_end;
+        UINT32 length;
+        UINT32 size;
+        UINT32 buffer_size;
+
+        if (p[0] != AML_NAME_OP || !signature_is(p + 1, "_CRS") || p[5] != AML_BUFFER_OP) {
+            p++;
+            continue;
+        }
+
+        if (!pkg_length(p + 6, body_end, &length, &size) || length < size + 2 ||
+            p + 6 + length > body_end) {
+            return;
+        }
+        buffer = p + 6 + size;
+        buffer_end = p + 6 + length;
+
+        // BufferSize term, then the bytes
+        switch (buffer[0]) {
+            case AML_ZERO_OP:
+            case AML_ONE_OP:
+                buffer_size = buffer[0];
+                buffer += 1;
+                break;
+            case AML_BYTE_PREFIX:
+                buffer_size = buffer[1];
+                buffer += 2;
+                break;
+            case AML_WORD_PREFIX:
+                buffer_size = read16(buffer + 1);
+                buffer += 3;
+                break;
+            case AML_DWORD_PREFIX:
+                buffer_size = read32(buffer + 1);
+                buffer += 5;
+                break;
+            default:
+                return;
+        }
+        if (buffer > buffer_end) {
+            return;
+        }
+        if (buffer + buffer_size < buffer_end) {
+            buffer_end = buffer + buffer_size;
+        }
+
+        parse_resources(buffer, buffer_end, dev);
+        return;
+    }
+}
+
+// _HID as EisaId ("APP0001") or the string "APP0001"
+static BOOLEAN is_smc_hid(const UINT8 *p, const UINT8 *end) {
+    if (end - p >= 5 && p[0] == AML_DWORD_PREFIX &&
+        CompareMem((void *)(p + 1), (void *)smc_eisaid, sizeof(smc_eisaid)) == 0) {
+        return TRUE;
+    }
+    return end - p >= 9 && p[0] == AML_STRING_PREFIX &&
+           CompareMem((void *)(p + 1), (void *)"APP0001", 8) == 0;
+}
+
+/**
+ * Scan one DSDT/SSDT for the SMC device
+ */
+static EFI_STATUS scan_table(const UINT8 *table, SMC_ACPI_DEVICE *dev) {
+    const UINT8 *aml;
+    const UINT8 *end;
+    const UINT8 *p;
+    UINT32 length;
+
+    if (!table || !(signature_is(table, "DSDT") || signature_is(table, "SSDT"))) {
+        return EFI_NOT_FOUND;
+    }
+    length = read32(table + SDT_LENGTH);
+    if (length <= SDT_HEADER_SIZE) {
+        return EFI_NOT_FOUND;
+    }
+
+    aml = table + SDT_HEADER_SIZE;
+    end = table + length;
+
+    for (p = aml; p + 5 < end; p++) {
+        const UINT8 *body;
+        const UINT8 *body_end;
+
+        if (p[0] != AML_NAME_OP || !signature_is(p + 1, "_HID") || !is_smc_hid(p + 5, end)) {
+            continue;
+        }
+        if (!find_enclosing_device(aml, end, p, &body, &body_end)) {
+            continue;
+        }
+
+        parse_crs(body, body_end, dev);
+        return EFI_SUCCESS;
+    }
+
+    return EFI_NOT_FOUND;
+}
+
+/**
+ * Walk the RSDT/XSDT: the DSDT (through the FADT) first, then the SSDTs
+ */
+EFI_STATUS smc_acpi_find_device(SMC_ACPI_DEVICE *dev) {
+    const UINT8 *rsdp;
+    const UINT8 *sdt;
+    const UINT8 *fadt = NULL;
+    UINT32 entry_size;
+    UINT32 count;
+    UINT32 i;
+
+    if (!dev) {
+        return EFI_INVALID_PARAMETER;
+    }
+    dev->io_base = 0;
+    dev->io_length = 0;
+    dev->mmio_base = 0;
+    dev->mmio_length = 0;
+
+    rsdp = find_rsdp();
+    if (!rsdp) {
+        return EFI_UNSUPPORTED;
+    }
+
+    if (rsdp[RSDP_REVISION] >= 2 && read64(rsdp + RSDP_XSDT) != 0) {
+        sdt = (const UINT8 *)(UINTN)read64(rsdp + RSDP_XSDT);
+        entry_size = 8;
+    } else {
+        sdt = (const UINT8 *)(UINTN)read32(rsdp + RSDP_RSDT);
+        entry_size = 4;
+    }
+    if (!sdt || read32(sdt + SDT_LENGTH) < SDT_HEADER_SIZE) {
+        return EFI_UNSUPPORTED;
+    }
+    count = (read32(sdt + SDT_LENGTH) - SDT_HEADER_SIZE) / entry_size;
+
+    for (i = 0; i < count && !fadt; i++) {
+        const UINT8 *entry = sdt + SDT_HEADER_SIZE + i * entry_size;
+        const UINT8 *table = (const UINT8 *)(UINTN)(entry_size == 8 ? read64(entry) : read32(entry));
+
+        if (table && signature_is(table, "FACP")) {
+            fadt = table;
+        }
+    }
+
+    if (fadt) {
+        const UINT8 *dsdt = NULL;
+
+        if (read32(fadt + SDT_LENGTH) >= FADT_X_DSDT + 8) {
+            dsdt = (const UINT8 *)(UINTN)read64(fadt + FADT_X_DSDT);
+        }
+        if (!dsdt) {
+            dsdt = (const UINT8 *)(UINTN)read32(fadt + FADT_DSDT);
+        }
+        if (!EFI_ERROR(scan_table(dsdt, dev))) {
+            return EFI_SUCCESS;
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        const UINT8 *entry = sdt + SDT_HEADER_SIZE + i * entry_size;
+        const UINT8 *table = (const UINT8 *)(UINTN)(entry_size == 8 ? read64(entry) : read32(entry));
+
+        if (!EFI_ERROR(scan_table(table, dev))) {
+            return EFI_SUCCESS;
+        }
+    }
+
+    return EFI_NOT_FOUND;
+}
+
+/**
+ * Detect the SMC and set up its transport
+ * The answer comes from the tables without touching the bus. The REV probe
+ * is only used on firmware without ACPI tables, and to vet a memory window
+ * before switching to it.
+ */
+BOOLEAN smc_acpi_detect(void) {
+    SMC_ACPI_DEVICE dev;
+    EFI_STATUS status;
+
+    status = smc_acpi_find_device(&dev);
+    if (status == EFI_UNSUPPORTED) {
+        return smc_detect();
+    }
+    if (EFI_ERROR(status)) {
+        return FALSE;
+    }
+
+    // A range too short for the error port is not the SMC's register block
+    if (dev.io_length >= APPLESMC_IO_LENGTH) {
+        smc_set_io_base(dev.io_base);
+    }
+    if (dev.mmio_length != 0) {
+        smc_mmio_attach(dev.mmio_base, dev.mmio_length);
+    }
+    return TRUE;
+}
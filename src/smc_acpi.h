@@ -0,0 +1,59 @@
+#ifndef SMC_ACPI_H
+#define SMC_ACPI_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "smc_mmio.h"
+
+/**
+ * ACPI discovery of the SMC
+ *
+ * Firmware describes the SMC as the APP0001 device in the DSDT (or an
+ * SSDT), with its register ranges in a static _CRS resource template:
+ *
+ *   Device (SMC) {
+ *       Name (_HID, EisaId ("APP0001"))
+ *       Name (_CRS, ResourceTemplate () {
+ *           IO (Decode16, 0x0300, 0x0300, 0x01, 0x20)
+ *           Memory32Fixed (ReadWrite, 0xFEF00000, 0x00010000)
+ *           IRQNoFlags () {6}
+ *       })
+ *   }
+ *
+ * The AML is scanned as bytes, not interpreted: find the _HID, take the
+ * innermost Device around it and decode the _CRS buffer. A _CRS that is
+ * a method (computed at runtime) is not supported; the legacy ports are
+ * used then.
+ *
+ * Tables without APP0001 mean there is no SMC, which is known without a
+ * single port access (a REV read on a non-Apple machine costs a full
+ * status timeout).
+ */
+
+// EisaId ("APP0001") as stored after a DWordPrefix
+#define SMC_ACPI_EISAID     { 0x06, 0x10, 0x00, 0x01 }
+
+typedef struct {
+    UINT16 io_base;           // First I/O port, 0 if no I/O resource
+    UINT16 io_length;
+    UINT64 mmio_base;         // Memory window, 0 if none
+    UINT64 mmio_length;
+} SMC_ACPI_DEVICE;
+
+// Locate APP0001 and its resources: EFI_NOT_FOUND if the tables don't describe it,
+// EFI_UNSUPPORTED if there are no ACPI tables. A resource the _CRS doesn't list is
+// left at length 0.
+EFI_STATUS smc_acpi_find_device(SMC_ACPI_DEVICE *dev);
+
+// Detect the SMC from the ACPI tables (no bus traffic) and select its I/O range,
+// and its memory window when that answers; falls back to smc_detect() without tables
+BOOLEAN smc_acpi_detect(void);
+
+#endif // SMC_ACPI_H
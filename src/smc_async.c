@@ -0,0 +1,554 @@
+#include "smc_async.h"
+#include "smc_health.h"
+#include "smc_service.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+#endif
+
+// Slot states
+typedef enum {
+    SLOT_FREE = 0,
+    SLOT_QUEUED,
+    SLOT_ACTIVE,
+    SLOT_DONE
+} SLOT_STATE;
+
+// Transaction steps (one port operation each)
+typedef enum {
+    STEP_SEND_CMD = 0,
+    STEP_WAIT_ACK,
+    STEP_SEND_KEY,
+    STEP_WAIT_DATA,
+    STEP_READ_LEN,
+    STEP_READ_DATA,
+    STEP_SEND_LEN,
+    STEP_SEND_DATA,
+    STEP_WAIT_DONE,
+    STEP_WAIT_POSTED,    // split-phase transports: command posted, polling
+    STEP_WAIT_SERVICE    // resident driver: busy with another caller, retrying
+} TX_STEP;
+
+// Result of advancing a transaction by one step
+typedef enum {
+    STEP_PROGRESS,   // port operation done, more to follow
+    STEP_WAITING,    // status not ready yet
+    STEP_FINISHED    // transaction complete (see status)
+} STEP_RESULT;
+
+typedef struct {
+    UINT8 state;
+    UINT8 generation;
+    UINT8 step;
+    UINT8 byte_index;
+    BOOLEAN is_write;
+    SMC_KEY key;
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len;
+    UINT64 deadline_us;
+    EFI_STATUS status;
+    SMC_ASYNC_CALLBACK callback;
+    void *context;
+} TX_SLOT;
+
+static TX_SLOT slots[SMC_ASYNC_MAX_PENDING];
+
+// FIFO of slot indices in submission order
+static UINT8 queue[SMC_ASYNC_MAX_PENDING];
+static UINTN queue_head = 0;
+static UINTN queue_count = 0;
+
+static EFI_EVENT tick_event = NULL;
+static UINT32 tick_budget_us = SMC_ASYNC_BUDGET_US;
+static BOOLEAN in_run = FALSE;
+static SMC_ASYNC_STATS stats;
+
+/**
+ * Engine lock: keeps the timer notify out while queue state changes
+ */
+static EFI_TPL engine_lock(void) {
+    EFI_TPL old_tpl = gBS->RaiseTPL(TPL_HIGH_LEVEL);
+
+    gBS->RestoreTPL(old_tpl);
+    if (old_tpl < TPL_CALLBACK) {
+        gBS->RaiseTPL(TPL_CALLBACK);
+    }
+    return old_tpl;
+}
+
+static void engine_unlock(EFI_TPL old_tpl) {
+    if (old_tpl < TPL_CALLBACK) {
+        gBS->RestoreTPL(old_tpl);
+    }
+}
+
+static SMC_ASYNC_HANDLE make_handle(UINTN index) {
+    return (SMC_ASYNC_HANDLE)((slots[index].generation << 8) | index);
+}
+
+static TX_SLOT *slot_from_handle(SMC_ASYNC_HANDLE handle) {
+    UINTN index = handle & 0xFF;
+
+    if (index >= SMC_ASYNC_MAX_PENDING ||
+        slots[index].generation != (UINT8)(handle >> 8)) {
+        return NULL;
+    }
+    return &slots[index];
+}
+
+static void release_slot(TX_SLOT *tx) {
+    tx->state = SLOT_FREE;
+    tx->generation++;
+}
+
+/**
+ * Check one status sample against the expected bits
+ * Same test as smc_wait_status()
+ */
+static BOOLEAN status_matches(UINT8 expected) {
+    UINT8 status = smc_inb(APPLESMC_CMD_PORT);
+    return (status & expected) == expected;
+}
+
+// Enter a wait step with a fresh timeout
+static void begin_wait(TX_SLOT *tx, TX_STEP step) {
+    tx->step = step;
+    tx->deadline_us = timer_now_us() + SMC_STATUS_TIMEOUT_US;
+}
+
+/**
+ * Run a transaction as one resident driver call
+ * EFI_NOT_READY while the driver is serving another caller
+ */
+static EFI_STATUS service_call(SMC_SERVICE_PROTOCOL *service, TX_SLOT *tx) {
+    if (tx->is_write) {
+        return service->WriteKey(service, tx->key, tx->data, tx->data_len);
+    }
+    return service->ReadKey(service, tx->key, SMC_SERVICE_VALUE_TTL_MS, tx->data, &tx->data_len);
+}
+
+/**
+ * Advance a transaction by one port operation
+ * Mirrors the blocking sequences in smc_protocol.c
+ */
+static STEP_RESULT tx_step(TX_SLOT *tx) {
+    const SMC_TRANSPORT *transport = smc_get_transport();
+    SMC_SERVICE_PROTOCOL *service = smc_get_service();
+    UINT8 cmd = tx->is_write ? APPLESMC_WRITE_CMD : APPLESMC_READ_CMD;
+
+    switch (tx->step) {
+        case STEP_SEND_CMD:
+            if (service) {
+                tx->status = service_call(service, tx);
+                if (tx->status != EFI_NOT_READY) {
+                    return STEP_FINISHED;
+                }
+                begin_wait(tx, STEP_WAIT_SERVICE);
+                return STEP_WAITING;
+            }
+            if (transport->start) {
+                // The whole request goes out in one step
+                tx->status = transport->start(cmd, tx->key, tx->data,
+                                              tx->is_write ? tx->data_len : 0);
+                if (EFI_ERROR(tx->status)) {
+                    return STEP_FINISHED;
+                }
+                begin_wait(tx, STEP_WAIT_POSTED);
+                return STEP_PROGRESS;
+            }
+            smc_outb(APPLESMC_CMD_PORT, cmd);
+            begin_wait(tx, STEP_WAIT_ACK);
+            return STEP_PROGRESS;
+
+        case STEP_WAIT_ACK:
+            if (status_matches(APPLESMC_ST_ACK)) {
+                tx->step = STEP_SEND_KEY;
+                tx->byte_index = 0;
+                return STEP_PROGRESS;
+            }
+            if (timer_now_us() < tx->deadline_us) {
+                return STEP_WAITING;
+            }
+            smc_get_last_error();
+            tx->status = EFI_DEVICE_ERROR;
+            return STEP_FINISHED;
+
+        case STEP_SEND_KEY:
+            smc_outb(APPLESMC_DATA_PORT, SMC_KEY_CHAR(tx->key, tx->byte_index));
+            if (++tx->byte_index == 4) {
+                if (tx->is_write) {
+                    tx->step = STEP_SEND_LEN;
+                } else {
+                    begin_wait(tx, STEP_WAIT_DATA);
+                }
+            }
+            return STEP_PROGRESS;
+
+        case STEP_WAIT_DATA:
+            if (status_matches(APPLESMC_ST_DATA_READY)) {
+                tx->step = STEP_READ_LEN;
+                return STEP_PROGRESS;
+            }
+            if (timer_now_us() < tx->deadline_us) {
+                return STEP_WAITING;
+            }
+            tx->status = (smc_get_last_error() == APPLESMC_ST_1E_NOEXIST) ?
+                         EFI_NOT_FOUND : EFI_DEVICE_ERROR;
+            return STEP_FINISHED;
+
+        case STEP_READ_LEN:
+            tx->data_len = smc_inb(APPLESMC_DATA_PORT);
+            if (tx->data_len > SMC_MAX_DATA_LENGTH) {
+                tx->data_len = SMC_MAX_DATA_LENGTH;
+            }
+            tx->byte_index = 0;
+            if (tx->data_len == 0) {
+                begin_wait(tx, STEP_WAIT_DONE);
+            } else {
+                tx->step = STEP_READ_DATA;
+            }
+            return STEP_PROGRESS;
+
+        case STEP_READ_DATA:
+            tx->data[tx->byte_index++] = smc_inb(APPLESMC_DATA_PORT);
+            if (tx->byte_index == tx->data_len) {
+                begin_wait(tx, STEP_WAIT_DONE);
+            }
+            return STEP_PROGRESS;
+
+        case STEP_SEND_LEN:
+            smc_outb(APPLESMC_DATA_PORT, tx->data_len);
+            tx->step = STEP_SEND_DATA;
+            tx->byte_index = 0;
+            return STEP_PROGRESS;
+
+        case STEP_SEND_DATA:
+            smc_outb(APPLESMC_DATA_PORT, tx->data[tx->byte_index++]);
+            if (tx->byte_index == tx->data_len) {
+                begin_wait(tx, STEP_WAIT_DONE);
+            }
+            return STEP_PROGRESS;
+
+        case STEP_WAIT_DONE:
+            if (status_matches(APPLESMC_ST_CMD_DONE)) {
+                tx->status = EFI_SUCCESS;
+                return STEP_FINISHED;
+            }
+            if (timer_now_us() < tx->deadline_us) {
+                return STEP_WAITING;
+            }
+            if (tx->is_write && smc_get_last_error() == APPLESMC_ST_1E_READONLY) {
+                tx->status = EFI_WRITE_PROTECTED;
+            } else {
+                tx->status = EFI_DEVICE_ERROR;
+            }
+            return STEP_FINISHED;
+
+        case STEP_WAIT_POSTED:
+            if (transport->ready()) {
+                tx->status = transport->finish(cmd, tx->data, &tx->data_len);
+                return STEP_FINISHED;
+            }
+            if (timer_now_us() < tx->deadline_us) {
+                return STEP_WAITING;
+            }
+            tx->status = EFI_DEVICE_ERROR;
+            return STEP_FINISHED;
+
+        case STEP_WAIT_SERVICE:
+            tx->status = service_call(service, tx);
+            if (tx->status != EFI_NOT_READY) {
+                return STEP_FINISHED;
+            }
+            if (timer_now_us() < tx->deadline_us) {
+                return STEP_WAITING;
+            }
+            tx->status = EFI_DEVICE_ERROR;
+            return STEP_FINISHED;
+    }
+
+    tx->status = EFI_DEVICE_ERROR;
+    return STEP_FINISHED;
+}
+
+/**
+ * Retire the transaction at the head of the queue
+ */
+static void complete_head(void) {
+    TX_SLOT *tx = &slots[queue[queue_head]];
+
+    queue_head = (queue_head + 1) % SMC_ASYNC_MAX_PENDING;
+    queue_count--;
+
+    // Leave the bus idle for the next transaction (the resident driver
+    // cleans up after itself, and "no such key" leaves nothing pending),
+    // and track dead keys
+    if (EFI_ERROR(tx->status) && tx->status != EFI_NOT_FOUND && !smc_get_service()) {
+        smc_resync();
+    }
+    if (!tx->is_write) {
+        smc_health_record(tx->key, tx->status);
+    }
+
+    if (tx->is_write) {
+        tx->data_len = 0;
+    }
+
+    if (tx->callback) {
+        tx->callback(tx->key, tx->status, tx->data, tx->data_len, tx->context);
+        release_slot(tx);
+    } else {
+        tx->state = SLOT_DONE;
+    }
+}
+
+/**
+ * Timer notify: run one budget slice
+ */
+static void EFIAPI tick_notify(EFI_EVENT event, void *context) {
+    smc_async_run(tick_budget_us);
+}
+
+/**
+ * Queue a transaction
+ */
+static EFI_STATUS submit(SMC_KEY key, BOOLEAN is_write, const UINT8 *data, UINT8 data_len,
+                         SMC_ASYNC_CALLBACK callback, void *context,
+                         SMC_ASYNC_HANDLE *handle) {
+    EFI_TPL old_tpl;
+    UINTN i;
+
+    old_tpl = engine_lock();
+
+    // Quarantined keys are refused up front (see smc_health.h)
+    if (!is_write && !smc_health_allow(key)) {
+        engine_unlock(old_tpl);
+        return SMC_STATUS_QUARANTINED;
+    }
+
+    for (i = 0; i < SMC_ASYNC_MAX_PENDING; i++) {
+        if (slots[i].state == SLOT_FREE) {
+            break;
+        }
+    }
+    if (i == SMC_ASYNC_MAX_PENDING) {
+        engine_unlock(old_tpl);
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    slots[i].state = SLOT_QUEUED;
+    slots[i].step = STEP_SEND_CMD;
+    slots[i].byte_index = 0;
+    slots[i].is_write = is_write;
+    slots[i].key = key;
+    slots[i].data_len = 0;
+    slots[i].status = EFI_NOT_READY;
+    slots[i].callback = callback;
+    slots[i].context = context;
+    if (is_write) {
+        CopyMem(slots[i].data, (void *)data, data_len);
+        slots[i].data_len = data_len;
+    }
+
+    queue[(queue_head + queue_count) % SMC_ASYNC_MAX_PENDING] = (UINT8)i;
+    queue_count++;
+
+    if (handle) {
+        *handle = make_handle(i);
+    }
+
+    engine_unlock(old_tpl);
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Start the engine
+ */
+EFI_STATUS smc_async_init(UINT32 tick_us, UINT32 budget_us) {
+    EFI_STATUS status;
+    UINTN i;
+
+    if (tick_event) {
+        return EFI_ALREADY_STARTED;
+    }
+
+    for (i = 0; i < SMC_ASYNC_MAX_PENDING; i++) {
+        slots[i].state = SLOT_FREE;
+    }
+    queue_head = 0;
+    queue_count = 0;
+    tick_budget_us = budget_us;
+    stats.busy_us = 0;
+    stats.completed = 0;
+
+    timer_calibrate();
+
+    status = gBS->CreateEvent(EVT_TIMER | EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+                              tick_notify, NULL, &tick_event);
+    if (EFI_ERROR(status)) {
+        tick_event = NULL;
+        return status;
+    }
+
+    // Timer period is in 100ns units
+    status = gBS->SetTimer(tick_event, TimerPeriodic, (UINT64)tick_us * 10);
+    if (EFI_ERROR(status)) {
+        gBS->CloseEvent(tick_event);
+        tick_event = NULL;
+        return status;
+    }
+
+    smc_set_quiesce_handler(smc_async_quiesce);
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Stop the engine
+ */
+void smc_async_shutdown(void) {
+    if (tick_event) {
+        gBS->SetTimer(tick_event, TimerCancel, 0);
+        gBS->CloseEvent(tick_event);
+        tick_event = NULL;
+    }
+
+    smc_set_quiesce_handler(NULL);
+
+    // Finish whatever is still queued; each transaction is bounded by its timeouts
+    while (queue_count > 0) {
+        smc_async_run(SMC_STATUS_TIMEOUT_US);
+    }
+}
+
+EFI_STATUS smc_async_submit_read(SMC_KEY key, SMC_ASYNC_CALLBACK callback, void *context,
+                                 SMC_ASYNC_HANDLE *handle) {
+    return submit(key, FALSE, NULL, 0, callback, context, handle);
+}
+
+EFI_STATUS smc_async_submit_write(SMC_KEY key, const UINT8 *data, UINT8 data_len,
+                                  SMC_ASYNC_CALLBACK callback, void *context,
+                                  SMC_ASYNC_HANDLE *handle) {
+    if (!data || data_len == 0 || data_len > SMC_MAX_DATA_LENGTH) {
+        return EFI_INVALID_PARAMETER;
+    }
+    return submit(key, TRUE, data, data_len, callback, context, handle);
+}
+
+/**
+ * Poll a handle
+ */
+EFI_STATUS smc_async_poll(SMC_ASYNC_HANDLE handle, UINT8 *data, UINT8 *data_len) {
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+    TX_SLOT *tx;
+
+    old_tpl = engine_lock();
+
+    tx = slot_from_handle(handle);
+    if (!tx || tx->state == SLOT_FREE || tx->callback) {
+        engine_unlock(old_tpl);
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (tx->state != SLOT_DONE) {
+        engine_unlock(old_tpl);
+        return EFI_NOT_READY;
+    }
+
+    status = tx->status;
+    if (data && data_len) {
+        CopyMem(data, tx->data, tx->data_len);
+        *data_len = tx->data_len;
+    }
+    release_slot(tx);
+
+    engine_unlock(old_tpl);
+
+    return status;
+}
+
+/**
+ * Advance queued transactions for up to budget_us
+ * A waiting transaction keeps polling only while budget remains; the
+ * next tick picks it up where it stopped.
+ */
+UINTN smc_async_run(UINT32 budget_us) {
+    UINT64 start;
+    UINTN completed = 0;
+
+    if (in_run) {
+        return 0;
+    }
+    in_run = TRUE;
+
+    start = timer_now_us();
+    while (queue_count > 0) {
+        TX_SLOT *tx = &slots[queue[queue_head]];
+
+        if (tx->state == SLOT_QUEUED) {
+            tx->state = SLOT_ACTIVE;
+        }
+
+        if (tx_step(tx) == STEP_FINISHED) {
+            complete_head();
+            completed++;
+        }
+
+        if (timer_now_us() - start >= budget_us) {
+            break;
+        }
+
+        // Pace port operations like the blocking path does
+        delay_microseconds(SMC_IO_DELAY_US);
+    }
+
+    stats.busy_us += timer_now_us() - start;
+    stats.completed += completed;
+
+    in_run = FALSE;
+
+    return completed;
+}
+
+/**
+ * Finish the in-flight transaction synchronously
+ * Called before blocking I/O so the two never interleave on the bus
+ */
+void smc_async_quiesce(void) {
+    TX_SLOT *tx;
+
+    if (queue_count == 0) {
+        return;
+    }
+
+    tx = &slots[queue[queue_head]];
+    if (tx->state != SLOT_ACTIVE) {
+        return;
+    }
+
+    while (tx_step(tx) != STEP_FINISHED) {
+        delay_microseconds(SMC_IO_DELAY_US);
+    }
+    complete_head();
+}
+
+/**
+ * Number of queued or in-flight transactions
+ */
+UINTN smc_async_pending(void) {
+    return queue_count;
+}
+
+/**
+ * Read engine counters
+ */
+void smc_async_get_stats(SMC_ASYNC_STATS *out) {
+    EFI_TPL old_tpl;
+
+    old_tpl = engine_lock();
+    *out = stats;
+    engine_unlock(old_tpl);
+}
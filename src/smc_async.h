@@ -0,0 +1,97 @@
+#ifndef SMC_ASYNC_H
+#define SMC_ASYNC_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "smc_protocol.h"
+
+/**
+ * Asynchronous SMC transactions
+ *
+ * Each read or write is a small state machine that advances one port
+ * operation per step. A periodic timer event runs steps until the per-tick
+ * time budget is used up, so a slow or stuck key only ever costs one
+ * budget slice per tick instead of blocking the caller for the full
+ * SMC_STATUS_TIMEOUT_US. Transactions run in submission order.
+ * On a split-phase transport (MMIO) the command is posted in one step and
+ * the remaining steps only poll for completion. With the resident driver
+ * attached (smc_service.h) a transaction is one call to it instead, so the
+ * driver stays the only owner of the bus and its value cache serves reads.
+ */
+
+// Maximum outstanding transactions
+#define SMC_ASYNC_MAX_PENDING   64
+
+// Default timer period and per-tick SMC time budget (microseconds)
+#define SMC_ASYNC_TICK_US       2000
+#define SMC_ASYNC_BUDGET_US     300
+
+// Opaque transaction handle (slot index and generation)
+typedef UINT16 SMC_ASYNC_HANDLE;
+
+#define SMC_ASYNC_INVALID_HANDLE    0xFFFF
+
+// Engine counters (cumulative since smc_async_init)
+typedef struct {
+    UINT64 busy_us;       // Time spent driving the bus from smc_async_run()
+    UINT64 completed;     // Transactions finished
+} SMC_ASYNC_STATS;
+
+// Completion callback, called at TPL_CALLBACK once the transaction ends
+// data/data_len hold the value for reads (data_len is 0 for writes)
+typedef void (*SMC_ASYNC_CALLBACK)(SMC_KEY key, EFI_STATUS status,
+                                   const UINT8 *data, UINT8 data_len, void *context);
+
+/**
+ * Engine lifecycle
+ */
+
+// Start the engine with the given timer period and per-tick budget
+EFI_STATUS smc_async_init(UINT32 tick_us, UINT32 budget_us);
+
+// Stop the timer, finishing any queued transactions synchronously
+void smc_async_shutdown(void);
+
+/**
+ * Submission and completion
+ * With a callback, the handle is released after the callback returns.
+ * Without one, poll the handle until it stops returning EFI_NOT_READY.
+ */
+
+// Queue a key read (SMC_STATUS_QUARANTINED if the key is quarantined)
+EFI_STATUS smc_async_submit_read(SMC_KEY key, SMC_ASYNC_CALLBACK callback, void *context,
+                                 SMC_ASYNC_HANDLE *handle);
+
+// Queue a key write (data is copied)
+EFI_STATUS smc_async_submit_write(SMC_KEY key, const UINT8 *data, UINT8 data_len,
+                                  SMC_ASYNC_CALLBACK callback, void *context,
+                                  SMC_ASYNC_HANDLE *handle);
+
+// Poll a handle; returns EFI_NOT_READY while pending, else the final status
+// (read data is copied out and the handle is released)
+EFI_STATUS smc_async_poll(SMC_ASYNC_HANDLE handle, UINT8 *data, UINT8 *data_len);
+
+/**
+ * Execution
+ */
+
+// Advance queued transactions for up to budget_us; returns completions
+UINTN smc_async_run(UINT32 budget_us);
+
+// Finish the in-flight transaction synchronously (bus quiesce handler)
+void smc_async_quiesce(void);
+
+// Number of queued or in-flight transactions
+UINTN smc_async_pending(void);
+
+// Read engine counters
+void smc_async_get_stats(SMC_ASYNC_STATS *stats);
+
+#endif // SMC_ASYNC_H
@@ -0,0 +1,515 @@
+#include "smc_codec.h"
+
+// Linear probe limit for the key type cache
+#define TYPE_CACHE_PROBE        8
+#define TYPE_CACHE_SIZE         (1 << SMC_TYPE_CACHE_BITS)
+
+// Cached key types (key 0 marks an empty slot)
+static struct {
+    SMC_KEY key;
+    UINT8 type;
+} type_cache[TYPE_CACHE_SIZE];
+
+/**
+ * Fixed-point helpers
+ */
+
+static SMC_FIXED saturate(INT64 value) {
+    if (value > 0x7FFFFFFF) {
+        return 0x7FFFFFFF;
+    }
+    if (value < -0x7FFFFFFF - 1) {
+        return -0x7FFFFFFF - 1;
+    }
+    return (SMC_FIXED)value;
+}
+
+// Divide rounding half away from zero
+static INT64 div_round(INT64 numerator, INT64 denominator) {
+    if (numerator >= 0) {
+        return (numerator + denominator / 2) / denominator;
+    }
+    return -((-numerator + denominator / 2) / denominator);
+}
+
+static INT64 clamp64(INT64 value, INT64 min, INT64 max) {
+    if (value < min) {
+        return min;
+    }
+    if (value > max) {
+        return max;
+    }
+    return value;
+}
+
+static UINT16 read_be16(const UINT8 *data) {
+    return (UINT16)((data[0] << 8) | data[1]);
+}
+
+static void write_be16(UINT16 value, UINT8 *data) {
+    data[0] = (value >> 8) & 0xFF;
+    data[1] = value & 0xFF;
+}
+
+/**
+ * Decoders: raw big-endian bytes -> SMC_FIXED
+ */
+
+static SMC_FIXED decode_sp78(const UINT8 *data) {
+    return (SMC_FIXED)(((INT32)(INT16)read_be16(data) * SMC_FIXED_ONE) / 256);
+}
+
+static SMC_FIXED decode_fpe2(const UINT8 *data) {
+    return (SMC_FIXED)(((INT32)read_be16(data) * SMC_FIXED_ONE) / 4);
+}
+
+static SMC_FIXED decode_fp88(const UINT8 *data) {
+    return (SMC_FIXED)(((INT32)read_be16(data) * SMC_FIXED_ONE) / 256);
+}
+
+/**
+ * flt is IEEE 754 single precision stored little-endian (T2 Macs).
+ * Converted with integer arithmetic only; no FPU state is touched.
+ */
+static SMC_FIXED decode_flt(const UINT8 *data) {
+    UINT32 bits = (UINT32)data[0] | ((UINT32)data[1] << 8) |
+                  ((UINT32)data[2] << 16) | ((UINT32)data[3] << 24);
+    BOOLEAN negative = (bits >> 31) != 0;
+    INT32 exponent = (bits >> 23) & 0xFF;
+    UINT64 scaled = bits & 0x7FFFFF;
+    INT32 shift;
+
+    // Infinity and NaN saturate
+    if (exponent == 0xFF) {
+        return negative ? saturate(-0x80000000LL) : saturate(0x7FFFFFFFLL);
+    }
+
+    // Normal numbers carry an implicit leading one
+    if (exponent == 0) {
+        exponent = 1;
+    } else {
+        scaled |= 0x800000;
+    }
+
+    // value = mantissa * 2^(exponent - 150)
+    scaled *= SMC_FIXED_ONE;
+    shift = exponent - 150;
+    if (shift >= 0) {
+        scaled = (shift > 28) ? 0xFFFFFFFFFFULL : (scaled << shift);
+        if (scaled > 0xFFFFFFFFFFULL) {
+            scaled = 0xFFFFFFFFFFULL;
+        }
+    } else if (-shift >= 40) {
+        scaled = 0;
+    } else {
+        scaled = (scaled + (1ULL << (-shift - 1))) >> -shift;
+    }
+
+    return saturate(negative ? -(INT64)scaled : (INT64)scaled);
+}
+
+static SMC_FIXED decode_ui8(const UINT8 *data) {
+    return (SMC_FIXED)data[0] * SMC_FIXED_ONE;
+}
+
+static SMC_FIXED decode_ui16(const UINT8 *data) {
+    return (SMC_FIXED)read_be16(data) * SMC_FIXED_ONE;
+}
+
+static SMC_FIXED decode_ui32(const UINT8 *data) {
+    UINT32 value = ((UINT32)data[0] << 24) | ((UINT32)data[1] << 16) |
+                   ((UINT32)data[2] << 8) | data[3];
+    return saturate((INT64)value * SMC_FIXED_ONE);
+}
+
+static SMC_FIXED decode_si8(const UINT8 *data) {
+    return (SMC_FIXED)(INT8)data[0] * SMC_FIXED_ONE;
+}
+
+static SMC_FIXED decode_si16(const UINT8 *data) {
+    return (SMC_FIXED)(INT16)read_be16(data) * SMC_FIXED_ONE;
+}
+
+static SMC_FIXED decode_flag(const UINT8 *data) {
+    return data[0] ? SMC_FIXED_ONE : 0;
+}
+
+/**
+ * Encoders: SMC_FIXED -> raw bytes (rounded and clamped to the type range)
+ */
+
+static void encode_sp78(SMC_FIXED value, UINT8 *data) {
+    INT64 raw = clamp64(div_round((INT64)value * 256, SMC_FIXED_ONE), -32768, 32767);
+    write_be16((UINT16)(INT16)raw, data);
+}
+
+static void encode_fpe2(SMC_FIXED value, UINT8 *data) {
+    INT64 raw = clamp64(div_round((INT64)value * 4, SMC_FIXED_ONE), 0, 0xFFFF);
+    write_be16((UINT16)raw, data);
+}
+
+static void encode_fp88(SMC_FIXED value, UINT8 *data) {
+    INT64 raw = clamp64(div_round((INT64)value * 256, SMC_FIXED_ONE), 0, 0xFFFF);
+    write_be16((UINT16)raw, data);
+}
+
+static void encode_flt(SMC_FIXED value, UINT8 *data) {
+    UINT32 bits = 0;
+
+    if (value != 0) {
+        UINT64 magnitude = (value < 0) ? (UINT64)(-(INT64)value) : (UINT64)value;
+        // |value| / 1000 as 32.32 fixed point (magnitude <= 2^31, so no overflow)
+        UINT64 q = (magnitude << 32) / SMC_FIXED_ONE;
+        INT32 top = 63;
+        UINT32 mantissa;
+
+        while (top > 0 && !(q >> top)) {
+            top--;
+        }
+
+        // Normalize to a 24-bit mantissa with implicit leading one
+        if (top >= 23) {
+            mantissa = (UINT32)(q >> (top - 23));
+        } else {
+            mantissa = (UINT32)(q << (23 - top));
+        }
+
+        bits = ((value < 0) ? 0x80000000U : 0) |
+               ((UINT32)(top - 32 + 127) << 23) |
+               (mantissa & 0x7FFFFF);
+    }
+
+    data[0] = bits & 0xFF;
+    data[1] = (bits >> 8) & 0xFF;
+    data[2] = (bits >> 16) & 0xFF;
+    data[3] = (bits >> 24) & 0xFF;
+}
+
+static void encode_ui8(SMC_FIXED value, UINT8 *data) {
+    data[0] = (UINT8)clamp64(div_round(value, SMC_FIXED_ONE), 0, 0xFF);
+}
+
+static void encode_ui16(SMC_FIXED value, UINT8 *data) {
+    write_be16((UINT16)clamp64(div_round(value, SMC_FIXED_ONE), 0, 0xFFFF), data);
+}
+
+static void encode_ui32(SMC_FIXED value, UINT8 *data) {
+    UINT32 raw = (UINT32)clamp64(div_round(value, SMC_FIXED_ONE), 0, 0xFFFFFFFFLL);
+    data[0] = (raw >> 24) & 0xFF;
+    data[1] = (raw >> 16) & 0xFF;
+    data[2] = (raw >> 8) & 0xFF;
+    data[3] = raw & 0xFF;
+}
+
+static void encode_si8(SMC_FIXED value, UINT8 *data) {
+    data[0] = (UINT8)(INT8)clamp64(div_round(value, SMC_FIXED_ONE), -128, 127);
+}
+
+static void encode_si16(SMC_FIXED value, UINT8 *data) {
+    write_be16((UINT16)(INT16)clamp64(div_round(value, SMC_FIXED_ONE), -32768, 32767), data);
+}
+
+static void encode_flag(SMC_FIXED value, UINT8 *data) {
+    data[0] = (value != 0) ? 1 : 0;
+}
+
+// Codec dispatch table, indexed by SMC_VALUE_TYPE
+static const struct {
+    SMC_KEY code;
+    UINT8 size;
+    SMC_FIXED (*decode)(const UINT8 *data);
+    void (*encode)(SMC_FIXED value, UINT8 *data);
+} codec_table[SMC_TYPE_COUNT] = {
+    {0,                  0, NULL,        NULL},         // SMC_TYPE_UNKNOWN
+    {SMC_TYPE_CODE_SP78, 2, decode_sp78, encode_sp78},  // SMC_TYPE_SP78
+    {SMC_TYPE_CODE_FPE2, 2, decode_fpe2, encode_fpe2},  // SMC_TYPE_FPE2
+    {SMC_TYPE_CODE_FP88, 2, decode_fp88, encode_fp88},  // SMC_TYPE_FP88
+    {SMC_TYPE_CODE_FLT,  4, decode_flt,  encode_flt},   // SMC_TYPE_FLT
+    {SMC_TYPE_CODE_UI8,  1, decode_ui8,  encode_ui8},   // SMC_TYPE_UI8
+    {SMC_TYPE_CODE_UI16, 2, decode_ui16, encode_ui16},  // SMC_TYPE_UI16
+    {SMC_TYPE_CODE_UI32, 4, decode_ui32, encode_ui32},  // SMC_TYPE_UI32
+    {SMC_TYPE_CODE_SI8,  1, decode_si8,  encode_si8},   // SMC_TYPE_SI8
+    {SMC_TYPE_CODE_SI16, 2, decode_si16, encode_si16},  // SMC_TYPE_SI16
+    {SMC_TYPE_CODE_FLAG, 1, decode_flag, encode_flag},  // SMC_TYPE_FLAG
+};
+
+/**
+ * Map an SMC type code to a codec type
+ */
+SMC_VALUE_TYPE smc_codec_type_from_code(SMC_KEY type_code) {
+    UINTN i;
+
+    for (i = 1; i < SMC_TYPE_COUNT; i++) {
+        if (codec_table[i].code == type_code) {
+            return (SMC_VALUE_TYPE)i;
+        }
+    }
+
+    return SMC_TYPE_UNKNOWN;
+}
+
+/**
+ * Find a key in the type cache
+ * Returns TRUE with the key's slot on a hit; on a miss, slot is where the
+ * key should be inserted
+ */
+static BOOLEAN find_cache_slot(SMC_KEY key, UINT32 *slot) {
+    UINT32 home = SMC_KEY_HASH(key, SMC_TYPE_CACHE_BITS);
+    UINT32 i;
+
+    *slot = home;
+    for (i = 0; i < TYPE_CACHE_PROBE; i++) {
+        UINT32 probe = (home + i) & (TYPE_CACHE_SIZE - 1);
+        if (type_cache[probe].key == key) {
+            *slot = probe;
+            return TRUE;
+        }
+        if (type_cache[probe].key == 0) {
+            *slot = probe;
+            return FALSE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Get the type of a key
+ * The first call per key issues GET_KEY_TYPE; later calls hit the cache.
+ * Definite answers are cached: a key the SMC does not know, or a type the
+ * codec cannot use, is cached as SMC_TYPE_UNKNOWN so it never costs more
+ * than one round-trip. Any other failure (timeout, busy bus) is returned
+ * uncached, so the next call asks again.
+ */
+EFI_STATUS smc_codec_get_type(SMC_KEY key, SMC_VALUE_TYPE *type) {
+    UINT32 slot;
+    UINT8 data_size;
+    CHAR8 type_str[5];
+    EFI_STATUS status;
+
+    if (!type || key == 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (find_cache_slot(key, &slot)) {
+        *type = (SMC_VALUE_TYPE)type_cache[slot].type;
+        return EFI_SUCCESS;
+    }
+
+    // Miss: ask the SMC (evicts the home slot if the probe window is full)
+    status = smc_get_key_type(key, &data_size, type_str);
+    if (status == EFI_NOT_FOUND) {
+        *type = SMC_TYPE_UNKNOWN;
+    } else if (EFI_ERROR(status)) {
+        *type = SMC_TYPE_UNKNOWN;
+        return status;
+    } else {
+        *type = smc_codec_type_from_code(smc_key_from_chars(type_str));
+        if (*type != SMC_TYPE_UNKNOWN && data_size != codec_table[*type].size) {
+            *type = SMC_TYPE_UNKNOWN;
+        }
+    }
+
+    type_cache[slot].key = key;
+    type_cache[slot].type = (UINT8)*type;
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Get the cached type of a key without touching the SMC
+ */
+EFI_STATUS smc_codec_peek_type(SMC_KEY key, SMC_VALUE_TYPE *type) {
+    UINT32 slot;
+
+    if (!type || key == 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (!find_cache_slot(key, &slot)) {
+        return EFI_NOT_FOUND;
+    }
+
+    *type = (SMC_VALUE_TYPE)type_cache[slot].type;
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Forget all cached key types
+ */
+void smc_codec_flush_types(void) {
+    UINTN i;
+
+    for (i = 0; i < TYPE_CACHE_SIZE; i++) {
+        type_cache[i].key = 0;
+        type_cache[i].type = SMC_TYPE_UNKNOWN;
+    }
+}
+
+/**
+ * Decode raw key bytes of a known type
+ */
+EFI_STATUS smc_codec_decode(SMC_VALUE_TYPE type, const UINT8 *data, UINT8 data_len,
+                            SMC_FIXED *value) {
+    if (!data || !value || type <= SMC_TYPE_UNKNOWN || type >= SMC_TYPE_COUNT) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (data_len < codec_table[type].size) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    *value = codec_table[type].decode(data);
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Encode a value into raw key bytes
+ */
+EFI_STATUS smc_codec_encode(SMC_VALUE_TYPE type, SMC_FIXED value, UINT8 *data,
+                            UINT8 *data_len) {
+    if (!data || !data_len || type <= SMC_TYPE_UNKNOWN || type >= SMC_TYPE_COUNT) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    codec_table[type].encode(value, data);
+    *data_len = codec_table[type].size;
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Decode bytes read from a key using its cached type
+ * Safe to call from completion callbacks: never issues SMC traffic, so a
+ * key whose type is not cached is not decoded (guessing could misdecode a
+ * flt key). The fallback type is only used for a key known to have no
+ * usable type, and only if the data is exactly its size.
+ */
+EFI_STATUS smc_codec_decode_key(SMC_KEY key, SMC_VALUE_TYPE fallback_type,
+                                const UINT8 *data, UINT8 data_len, SMC_FIXED *value) {
+    SMC_VALUE_TYPE type = SMC_TYPE_UNKNOWN;
+
+    if (fallback_type <= SMC_TYPE_UNKNOWN || fallback_type >= SMC_TYPE_COUNT) {
+        return EFI_INVALID_PARAMETER;
+    }
+    if (EFI_ERROR(smc_codec_peek_type(key, &type))) {
+        return EFI_NOT_READY;
+    }
+    if (type == SMC_TYPE_UNKNOWN) {
+        if (data_len != codec_table[fallback_type].size) {
+            return EFI_BAD_BUFFER_SIZE;
+        }
+        type = fallback_type;
+    }
+
+    return smc_codec_decode(type, data, data_len, value);
+}
+
+// Resolve the type to use for a key
+// Fails if the type could not be asked for: guessing could misdecode a flt key
+static EFI_STATUS resolve_type(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_VALUE_TYPE *type) {
+    EFI_STATUS status;
+
+    status = smc_codec_get_type(key, type);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    if (*type == SMC_TYPE_UNKNOWN) {
+        *type = fallback_type;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Read and decode one key
+ */
+static EFI_STATUS read_value(SMC_KEY key, SMC_VALUE_TYPE fallback_type, BOOLEAN fresh,
+                             SMC_FIXED *value) {
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len = 0;
+    SMC_VALUE_TYPE type;
+    EFI_STATUS status;
+
+    if (!value) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    if (fresh) {
+        status = smc_read_key_fresh(key, data, &data_len);
+    } else {
+        status = smc_read_key(key, data, &data_len);
+    }
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    status = resolve_type(key, fallback_type, &type);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    return smc_codec_decode(type, data, data_len, value);
+}
+
+EFI_STATUS smc_codec_read(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_FIXED *value) {
+    return read_value(key, fallback_type, FALSE, value);
+}
+
+EFI_STATUS smc_codec_read_fresh(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_FIXED *value) {
+    return read_value(key, fallback_type, TRUE, value);
+}
+
+/**
+ * Encode and write one key
+ */
+EFI_STATUS smc_codec_write(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_FIXED value) {
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len = 0;
+    SMC_VALUE_TYPE type;
+    EFI_STATUS status;
+
+    status = resolve_type(key, fallback_type, &type);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    status = smc_codec_encode(type, value, data, &data_len);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    return smc_write_key(key, data, data_len);
+}
+
+/**
+ * Read and decode a batch of keys
+ * Types are resolved from the cache, so a refresh of mixed-type keys costs
+ * one READ per key. Returns the last error seen; per-key status goes to
+ * results when provided.
+ */
+EFI_STATUS smc_codec_read_batch(const SMC_KEY keys[], UINTN count,
+                                SMC_VALUE_TYPE fallback_type,
+                                SMC_FIXED values[], EFI_STATUS results[]) {
+    UINTN i;
+    EFI_STATUS status;
+    EFI_STATUS last_error = EFI_SUCCESS;
+
+    if (!keys || !values) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    for (i = 0; i < count; i++) {
+        status = smc_codec_read(keys[i], fallback_type, &values[i]);
+        if (results) {
+            results[i] = status;
+        }
+        if (EFI_ERROR(status)) {
+            last_error = status;
+        }
+    }
+
+    return last_error;
+}
@@ -0,0 +1,110 @@
+#ifndef SMC_CODEC_H
+#define SMC_CODEC_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+#endif
+#include "smc_protocol.h"
+
+/**
+ * Normalized value representation
+ * Every decoded value is a signed fixed-point number in 1/1000 of its
+ * natural unit (millidegrees, milli-RPM, ...). Values outside the INT32
+ * range saturate.
+ */
+typedef INT32 SMC_FIXED;
+
+#define SMC_FIXED_ONE           1000
+
+// SMC data types understood by the codec (compact index into codec table)
+typedef enum {
+    SMC_TYPE_UNKNOWN = 0,
+    SMC_TYPE_SP78,     // signed 7.8 fixed point (temperatures)
+    SMC_TYPE_FPE2,     // unsigned 14.2 fixed point (fan RPM, pre-T2)
+    SMC_TYPE_FP88,     // unsigned 8.8 fixed point
+    SMC_TYPE_FLT,      // IEEE 754 single, little-endian (T2 fan keys)
+    SMC_TYPE_UI8,
+    SMC_TYPE_UI16,
+    SMC_TYPE_UI32,
+    SMC_TYPE_SI8,
+    SMC_TYPE_SI16,
+    SMC_TYPE_FLAG,     // 1 byte boolean
+    SMC_TYPE_COUNT
+} SMC_VALUE_TYPE;
+
+// Type codes as returned by smc_get_key_type()
+#define SMC_TYPE_CODE_SP78      SMC_KEY_CONST('s', 'p', '7', '8')
+#define SMC_TYPE_CODE_FPE2      SMC_KEY_CONST('f', 'p', 'e', '2')
+#define SMC_TYPE_CODE_FP88      SMC_KEY_CONST('f', 'p', '8', '8')
+#define SMC_TYPE_CODE_FLT       SMC_KEY_CONST('f', 'l', 't', ' ')
+#define SMC_TYPE_CODE_UI8       SMC_KEY_CONST('u', 'i', '8', ' ')
+#define SMC_TYPE_CODE_UI16      SMC_KEY_CONST('u', 'i', '1', '6')
+#define SMC_TYPE_CODE_UI32      SMC_KEY_CONST('u', 'i', '3', '2')
+#define SMC_TYPE_CODE_SI8       SMC_KEY_CONST('s', 'i', '8', ' ')
+#define SMC_TYPE_CODE_SI16      SMC_KEY_CONST('s', 'i', '1', '6')
+#define SMC_TYPE_CODE_FLAG      SMC_KEY_CONST('f', 'l', 'a', 'g')
+
+// Key type cache size (power of two)
+#define SMC_TYPE_CACHE_BITS     9
+
+/**
+ * Type information
+ */
+
+// Map an SMC type code to a codec type (SMC_TYPE_UNKNOWN if unsupported)
+SMC_VALUE_TYPE smc_codec_type_from_code(SMC_KEY type_code);
+
+// Get the type of a key; queried from the SMC until it gives a definite answer
+// (the type, or EFI_NOT_FOUND for SMC_TYPE_UNKNOWN), then served from cache
+EFI_STATUS smc_codec_get_type(SMC_KEY key, SMC_VALUE_TYPE *type);
+
+// Get the cached type of a key without touching the SMC (EFI_NOT_FOUND if uncached)
+EFI_STATUS smc_codec_peek_type(SMC_KEY key, SMC_VALUE_TYPE *type);
+
+// Forget all cached key types
+void smc_codec_flush_types(void);
+
+/**
+ * Decoding and encoding
+ */
+
+// Decode raw key bytes of a known type
+EFI_STATUS smc_codec_decode(SMC_VALUE_TYPE type, const UINT8 *data, UINT8 data_len,
+                            SMC_FIXED *value);
+
+// Encode a value into raw key bytes; returns encoded length in data_len
+EFI_STATUS smc_codec_encode(SMC_VALUE_TYPE type, SMC_FIXED value, UINT8 *data,
+                            UINT8 *data_len);
+
+// Decode bytes read from a key using its cached type (never touches the SMC)
+// EFI_NOT_READY if the type is not cached yet; EFI_BAD_BUFFER_SIZE if the key
+// has no usable type and the data is not the size of fallback_type
+EFI_STATUS smc_codec_decode_key(SMC_KEY key, SMC_VALUE_TYPE fallback_type,
+                                const UINT8 *data, UINT8 data_len, SMC_FIXED *value);
+
+/**
+ * Typed key access
+ * fallback_type is used when the SMC has no usable type for the key; if the
+ * type query itself fails (timeout, busy bus) the access fails with it
+ */
+
+// Read and decode one key
+EFI_STATUS smc_codec_read(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_FIXED *value);
+
+// Read and decode one key, bypassing the resident driver's value cache
+EFI_STATUS smc_codec_read_fresh(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_FIXED *value);
+
+// Encode and write one key
+EFI_STATUS smc_codec_write(SMC_KEY key, SMC_VALUE_TYPE fallback_type, SMC_FIXED value);
+
+// Read and decode a batch of keys; per-key status goes to results (optional)
+EFI_STATUS smc_codec_read_batch(const SMC_KEY keys[], UINTN count,
+                                SMC_VALUE_TYPE fallback_type,
+                                SMC_FIXED values[], EFI_STATUS results[]);
+
+#endif // SMC_CODEC_H
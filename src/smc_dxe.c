@@ -0,0 +1,414 @@
+#include "smc_service.h"
+#include "smc_protocol.h"
+#include "smc_acpi.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+#endif
+
+/**
+ * Resident SMC driver
+ *
+ * Boot-service driver build (applesmc_dxe.efi / ApplesSmcDxe.inf) that
+ * publishes SMC_SERVICE_PROTOCOL (smc_service.h) on top of the blocking
+ * transactions in smc_protocol.c. Tools that load later share its key
+ * directory and caches instead of each probing the SMC again.
+ */
+
+// Key info cache (open addressing, power of two)
+#define INFO_CACHE_BITS     10
+#define INFO_CACHE_SIZE     (1U << INFO_CACHE_BITS)
+
+// Value cache (direct mapped, power of two)
+#define VALUE_CACHE_BITS    7
+#define VALUE_CACHE_SIZE    (1U << VALUE_CACHE_BITS)
+
+typedef struct {
+    SMC_KEY key;            // 0 = free slot
+    SMC_KEY type_code;
+    UINT8 data_size;
+    BOOLEAN missing;        // SMC reported the key as nonexistent
+} KEY_INFO;
+
+typedef struct {
+    SMC_KEY key;            // 0 = empty
+    UINT8 data_len;
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT64 read_us;
+} VALUE_ENTRY;
+
+static KEY_INFO info_cache[INFO_CACHE_SIZE];
+static UINT32 info_used = 0;
+static VALUE_ENTRY value_cache[VALUE_CACHE_SIZE];
+
+// Key directory: "#KEY" and the keys fetched by index so far (0 = not yet)
+static UINT32 key_count = 0;
+static BOOLEAN key_count_valid = FALSE;
+static SMC_KEY *key_directory = NULL;
+
+// Set while a call holds the service
+static BOOLEAN service_busy = FALSE;
+
+/**
+ * Serialization
+ * The bus is taken at TPL_CALLBACK, so callers at or below it run one at
+ * a time. A call from a higher TPL can still land in the middle of one;
+ * it is turned away rather than interleaving port I/O.
+ */
+static EFI_STATUS service_enter(EFI_TPL *old_tpl) {
+    *old_tpl = smc_bus_enter();
+    if (service_busy) {
+        smc_bus_leave(*old_tpl);
+        return EFI_NOT_READY;
+    }
+    service_busy = TRUE;
+    return EFI_SUCCESS;
+}
+
+static void service_leave(EFI_TPL old_tpl) {
+    service_busy = FALSE;
+    smc_bus_leave(old_tpl);
+}
+
+/**
+ * Key info cache
+ */
+static KEY_INFO *info_lookup(SMC_KEY key) {
+    UINT32 slot = SMC_KEY_HASH(key, INFO_CACHE_BITS);
+    UINT32 probes;
+
+    for (probes = 0; probes < INFO_CACHE_SIZE; probes++) {
+        if (info_cache[slot].key == key) {
+            return &info_cache[slot];
+        }
+        if (info_cache[slot].key == 0) {
+            return NULL;
+        }
+        slot = (slot + 1) & (INFO_CACHE_SIZE - 1);
+    }
+    return NULL;
+}
+
+// Slot for a new key; NULL once the table is 3/4 full (lookups stay short)
+static KEY_INFO *info_insert(SMC_KEY key) {
+    UINT32 slot = SMC_KEY_HASH(key, INFO_CACHE_BITS);
+
+    if (key == 0 || info_used >= INFO_CACHE_SIZE / 4 * 3) {
+        return NULL;
+    }
+    while (info_cache[slot].key != 0) {
+        slot = (slot + 1) & (INFO_CACHE_SIZE - 1);
+    }
+    info_cache[slot].key = key;
+    info_used++;
+    return &info_cache[slot];
+}
+
+static void info_record_missing(SMC_KEY key) {
+    KEY_INFO *info = info_lookup(key);
+
+    if (!info) {
+        info = info_insert(key);
+    }
+    if (info) {
+        info->missing = TRUE;
+        info->data_size = 0;
+        info->type_code = 0;
+    }
+}
+
+/**
+ * Value cache
+ */
+static VALUE_ENTRY *value_slot(SMC_KEY key) {
+    return &value_cache[SMC_KEY_HASH(key, VALUE_CACHE_BITS)];
+}
+
+/**
+ * Read one key, from the cache when fresh enough (caller holds the service)
+ */
+static EFI_STATUS read_cached(SMC_KEY key, UINT32 max_age_ms, UINT8 *data, UINT8 *data_len) {
+    VALUE_ENTRY *entry = value_slot(key);
+    KEY_INFO *info = info_lookup(key);
+    UINT64 now = timer_now_us();
+    EFI_STATUS status;
+
+    if (info && info->missing) {
+        return EFI_NOT_FOUND;
+    }
+
+    if (max_age_ms > SMC_SERVICE_VALUE_TTL_MS) {
+        max_age_ms = SMC_SERVICE_VALUE_TTL_MS;
+    }
+    if (entry->key == key && now - entry->read_us <= (UINT64)max_age_ms * 1000) {
+        CopyMem(data, entry->data, entry->data_len);
+        *data_len = entry->data_len;
+        return EFI_SUCCESS;
+    }
+
+    status = smc_read_key(key, data, data_len);
+    if (status == EFI_NOT_FOUND) {
+        info_record_missing(key);
+    }
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    entry->key = key;
+    entry->data_len = *data_len;
+    CopyMem(entry->data, data, *data_len);
+    entry->read_us = now;
+    return EFI_SUCCESS;
+}
+
+/**
+ * Protocol entry points
+ */
+
+static EFI_STATUS EFIAPI service_read_key(SMC_SERVICE_PROTOCOL *This, SMC_KEY Key,
+                                          UINT32 MaxAgeMs, UINT8 *Data, UINT8 *DataLen) {
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+
+    if (!Data || !DataLen) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = service_enter(&old_tpl);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    status = read_cached(Key, MaxAgeMs, Data, DataLen);
+    service_leave(old_tpl);
+
+    return status;
+}
+
+static EFI_STATUS EFIAPI service_write_key(SMC_SERVICE_PROTOCOL *This, SMC_KEY Key,
+                                           const UINT8 *Data, UINT8 DataLen) {
+    VALUE_ENTRY *entry;
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+
+    status = service_enter(&old_tpl);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    // Drop the cached value whether or not the write lands
+    entry = value_slot(Key);
+    if (entry->key == Key) {
+        entry->key = 0;
+    }
+    status = smc_write_key(Key, Data, DataLen);
+
+    service_leave(old_tpl);
+    return status;
+}
+
+// Read "#KEY" once (caller holds the service)
+static EFI_STATUS load_key_count(void) {
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len = 0;
+    EFI_STATUS status;
+
+    if (key_count_valid) {
+        return EFI_SUCCESS;
+    }
+
+    status = smc_read_key(SMC_KEY_COUNT, data, &data_len);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    if (data_len != 4) {
+        return EFI_DEVICE_ERROR;
+    }
+
+    key_count = ((UINT32)data[0] << 24) | ((UINT32)data[1] << 16) |
+                ((UINT32)data[2] << 8) | data[3];
+    key_count_valid = TRUE;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI service_get_key_count(SMC_SERVICE_PROTOCOL *This, UINT32 *Count) {
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+
+    if (!Count) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = service_enter(&old_tpl);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    status = load_key_count();
+    if (!EFI_ERROR(status)) {
+        *Count = key_count;
+    }
+    service_leave(old_tpl);
+
+    return status;
+}
+
+static EFI_STATUS EFIAPI service_get_key_by_index(SMC_SERVICE_PROTOCOL *This, UINT32 Index,
+                                                  SMC_KEY *Key) {
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+
+    if (!Key) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = service_enter(&old_tpl);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    status = load_key_count();
+    if (!EFI_ERROR(status) && Index >= key_count) {
+        status = EFI_NOT_FOUND;
+    }
+    if (!EFI_ERROR(status) && !key_directory) {
+        key_directory = AllocateZeroPool(key_count * sizeof(SMC_KEY));
+    }
+
+    if (!EFI_ERROR(status)) {
+        if (key_directory && key_directory[Index] != 0) {
+            *Key = key_directory[Index];
+        } else {
+            // Without a directory every lookup goes to the SMC
+            status = smc_get_key_by_index(Index, Key);
+            if (!EFI_ERROR(status) && key_directory) {
+                key_directory[Index] = *Key;
+            }
+        }
+    }
+
+    service_leave(old_tpl);
+    return status;
+}
+
+static EFI_STATUS EFIAPI service_get_key_info(SMC_SERVICE_PROTOCOL *This, SMC_KEY Key,
+                                              UINT8 *DataSize, SMC_KEY *TypeCode) {
+    KEY_INFO *info;
+    CHAR8 type[5];
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+
+    if (!DataSize || !TypeCode) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = service_enter(&old_tpl);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    info = info_lookup(Key);
+    if (info && info->missing) {
+        status = EFI_NOT_FOUND;
+    } else if (info) {
+        *DataSize = info->data_size;
+        *TypeCode = info->type_code;
+    } else {
+        status = smc_get_key_type(Key, DataSize, type);
+        if (!EFI_ERROR(status)) {
+            *TypeCode = smc_key_from_chars(type);
+            info = info_insert(Key);
+            if (info) {
+                info->data_size = *DataSize;
+                info->type_code = *TypeCode;
+                info->missing = FALSE;
+            }
+        } else if (status == EFI_NOT_FOUND) {
+            info_record_missing(Key);
+        }
+    }
+
+    service_leave(old_tpl);
+    return status;
+}
+
+static EFI_STATUS EFIAPI service_read_batch(SMC_SERVICE_PROTOCOL *This,
+                                            SMC_SERVICE_READ_REQUEST *Requests,
+                                            UINTN Count, UINT32 MaxAgeMs) {
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+    EFI_STATUS last_error = EFI_SUCCESS;
+    UINTN i;
+
+    if (!Requests && Count > 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = service_enter(&old_tpl);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    for (i = 0; i < Count; i++) {
+        Requests[i].DataLen = 0;
+        Requests[i].Status = read_cached(Requests[i].Key, MaxAgeMs, Requests[i].Data,
+                                         &Requests[i].DataLen);
+        if (EFI_ERROR(Requests[i].Status)) {
+            last_error = Requests[i].Status;
+        }
+    }
+
+    service_leave(old_tpl);
+    return last_error;
+}
+
+static SMC_SERVICE_PROTOCOL service_protocol = {
+    SMC_SERVICE_REVISION,
+    service_read_key,
+    service_write_key,
+    service_get_key_count,
+    service_get_key_by_index,
+    service_get_key_info,
+    service_read_batch
+};
+
+/**
+ * Driver entry point
+ * Stays resident only if an SMC answers and no other instance is loaded.
+ */
+EFI_STATUS EFIAPI efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
+    SMC_SERVICE_PROTOCOL *existing = NULL;
+    EFI_HANDLE handle = NULL;
+
+#ifdef _GNU_EFI
+    InitializeLib(ImageHandle, SystemTable);
+#else
+    (void)SystemTable;
+#endif
+
+    if (!EFI_ERROR(gBS->LocateProtocol(&gApplesSmcServiceProtocolGuid, NULL,
+                                       (void **)&existing))) {
+        return EFI_ALREADY_STARTED;
+    }
+
+    if (!smc_acpi_detect() || EFI_ERROR(smc_init())) {
+        return EFI_UNSUPPORTED;
+    }
+
+    return gBS->InstallProtocolInterface(&handle, &gApplesSmcServiceProtocolGuid,
+                                         EFI_NATIVE_INTERFACE, &service_protocol);
+}
+
+#ifndef _GNU_EFI
+/**
+ * EDK2/TianoCore Entry Point Wrapper
+ */
+EFI_STATUS
+EFIAPI
+SmcDxeEntry(
+    IN EFI_HANDLE        ImageHandle,
+    IN EFI_SYSTEM_TABLE  *SystemTable
+    )
+{
+    return efi_main(ImageHandle, SystemTable);
+}
+#endif
@@ -0,0 +1,143 @@
+#include "smc_health.h"
+#include "utils.h"
+
+#define HEALTH_TABLE_SIZE   (1 << SMC_HEALTH_TABLE_BITS)
+#define HEALTH_TABLE_PROBE  8
+
+// Tracked key state (key 0 marks an empty slot)
+typedef struct {
+    SMC_KEY key;
+    UINT8 failures;           // Consecutive failures
+    UINT8 backoff_level;      // Quarantine period is BASE << level
+    UINT64 retry_at_us;       // Quarantined until this time (0 = not quarantined)
+} HEALTH_ENTRY;
+
+static HEALTH_ENTRY health_table[HEALTH_TABLE_SIZE];
+
+/**
+ * Find a key's slot, or the slot it would use
+ * With the probe window full, a new key takes the slot of the key with the
+ * fewest failures that is not quarantined (a recovered key, or one short of
+ * the threshold). Returns NULL if every slot in the window is quarantined.
+ */
+static HEALTH_ENTRY *find_entry(SMC_KEY key, BOOLEAN create) {
+    UINT32 home = SMC_KEY_HASH(key, SMC_HEALTH_TABLE_BITS);
+    HEALTH_ENTRY *victim = NULL;
+    HEALTH_ENTRY *entry;
+    UINT32 i;
+
+    for (i = 0; i < HEALTH_TABLE_PROBE; i++) {
+        entry = &health_table[(home + i) & (HEALTH_TABLE_SIZE - 1)];
+
+        if (entry->key == key) {
+            return entry;
+        }
+        if (entry->key == 0) {
+            victim = entry;
+            break;
+        }
+        if (entry->retry_at_us == 0 && (!victim || entry->failures < victim->failures)) {
+            victim = entry;
+        }
+    }
+
+    if (!create || !victim) {
+        return NULL;
+    }
+
+    victim->key = key;
+    victim->failures = 0;
+    victim->backoff_level = 0;
+    victim->retry_at_us = 0;
+    return victim;
+}
+
+/**
+ * Quarantine period for a backoff level
+ */
+static UINT64 backoff_us(UINT8 level) {
+    UINT64 ms = (UINT64)SMC_HEALTH_BASE_BACKOFF_MS << level;
+
+    if (ms > SMC_HEALTH_MAX_BACKOFF_MS) {
+        ms = SMC_HEALTH_MAX_BACKOFF_MS;
+    }
+    return ms * 1000;
+}
+
+/**
+ * May the key be read now?
+ */
+BOOLEAN smc_health_allow(SMC_KEY key) {
+    HEALTH_ENTRY *entry = find_entry(key, FALSE);
+
+    if (!entry || entry->retry_at_us == 0) {
+        return TRUE;
+    }
+
+    // Quarantine over: let one probe through (the result re-arms or clears it)
+    return timer_now_us() >= entry->retry_at_us;
+}
+
+/**
+ * Record the outcome of a read
+ */
+void smc_health_record(SMC_KEY key, EFI_STATUS status) {
+    HEALTH_ENTRY *entry;
+
+    if (!EFI_ERROR(status)) {
+        entry = find_entry(key, FALSE);
+        if (entry) {
+            entry->failures = 0;
+            entry->backoff_level = 0;
+            entry->retry_at_us = 0;
+        }
+        return;
+    }
+
+    // Caller mistakes say nothing about the key, and "no such key" is a
+    // definite answer rather than a failure (discovery probes many of them)
+    if (status == EFI_INVALID_PARAMETER || status == SMC_STATUS_QUARANTINED ||
+        status == EFI_NOT_FOUND) {
+        return;
+    }
+
+    entry = find_entry(key, TRUE);
+    if (!entry) {
+        return;  // Neighbourhood all quarantined; key stays untracked
+    }
+
+    if (entry->failures < 0xFF) {
+        entry->failures++;
+    }
+
+    if (entry->retry_at_us != 0) {
+        // Failed probe: back off further
+        if ((UINT64)SMC_HEALTH_BASE_BACKOFF_MS << entry->backoff_level < SMC_HEALTH_MAX_BACKOFF_MS) {
+            entry->backoff_level++;
+        }
+        entry->retry_at_us = timer_now_us() + backoff_us(entry->backoff_level);
+    } else if (entry->failures >= SMC_HEALTH_FAIL_THRESHOLD) {
+        entry->backoff_level = 0;
+        entry->retry_at_us = timer_now_us() + backoff_us(0);
+    }
+}
+
+/**
+ * Is the key quarantined?
+ */
+BOOLEAN smc_health_is_quarantined(SMC_KEY key) {
+    HEALTH_ENTRY *entry = find_entry(key, FALSE);
+
+    return entry && entry->retry_at_us != 0;
+}
+
+/**
+ * Forget all tracked keys
+ */
+void smc_health_reset(void) {
+    UINT32 i;
+
+    for (i = 0; i < HEALTH_TABLE_SIZE; i++) {
+        health_table[i].key = 0;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef SMC_HEALTH_H
+#define SMC_HEALTH_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+#endif
+#include "smc_protocol.h"
+
+/**
+ * Per-key health tracking
+ *
+ * A read that fails usually costs a full SMC_STATUS_TIMEOUT_US. Keys that
+ * fail SMC_HEALTH_FAIL_THRESHOLD times in a row are quarantined: reads
+ * return EFI_NO_RESPONSE without touching the bus until the quarantine
+ * expires. Then one probe read is let through; another failure doubles
+ * the quarantine (up to SMC_HEALTH_MAX_BACKOFF_MS), a success clears it.
+ *
+ * Only keys that have failed take a table slot; EFI_NOT_FOUND (no such key)
+ * is not a failure. A full neighbourhood gives up the slot of a key that is
+ * not quarantined. Callers must own the bus (the table is updated from the
+ * same contexts that do SMC I/O).
+ */
+
+// Consecutive failures before a key is quarantined
+#define SMC_HEALTH_FAIL_THRESHOLD   3
+
+// First quarantine period and cap for exponential backoff
+#define SMC_HEALTH_BASE_BACKOFF_MS  1000
+#define SMC_HEALTH_MAX_BACKOFF_MS   64000
+
+// Tracked keys (power of two)
+#define SMC_HEALTH_TABLE_BITS       8
+
+// Status returned for reads of a quarantined key
+#define SMC_STATUS_QUARANTINED      EFI_NO_RESPONSE
+
+// TRUE if the key may be read now (not quarantined, or due for a probe)
+BOOLEAN smc_health_allow(SMC_KEY key);
+
+// Record the outcome of a read
+void smc_health_record(SMC_KEY key, EFI_STATUS status);
+
+// TRUE while the key is quarantined
+BOOLEAN smc_health_is_quarantined(SMC_KEY key);
+
+// Forget all tracked keys
+void smc_health_reset(void);
+
+#endif // SMC_HEALTH_H
@@ -0,0 +1,245 @@
+#include "smc_mmio.h"
+
+// Window base (0 until smc_mmio_init succeeds)
+static UINTN mmio_base = 0;
+
+/**
+ * Register access
+ * Byte-wide volatile accesses; host builds route them to the simulator.
+ */
+#ifdef SMC_HOST_IO
+  #define mmio_read8(offset)          smc_host_mmio_read8(offset)
+  #define mmio_write8(offset, value)  smc_host_mmio_write8(offset, value)
+#else
+static inline UINT8 mmio_read8(UINT32 offset) {
+    return *(volatile UINT8 *)(mmio_base + offset);
+}
+
+static inline void mmio_write8(UINT32 offset, UINT8 value) {
+    *(volatile UINT8 *)(mmio_base + offset) = value;
+}
+#endif
+
+/**
+ * Map a result code (ERR_PORT values) to a status
+ */
+static EFI_STATUS result_status(UINT8 result) {
+    switch (result) {
+        case 0:
+            return EFI_SUCCESS;
+        case APPLESMC_ST_1E_NOEXIST:
+        case APPLESMC_ST_1E_BAD_INDEX:
+            return EFI_NOT_FOUND;
+        case APPLESMC_ST_1E_READONLY:
+            return EFI_WRITE_PROTECTED;
+        default:
+            return EFI_DEVICE_ERROR;
+    }
+}
+
+/**
+ * Post a command
+ * key is the key for READ/WRITE/GET_KEY_TYPE, the index for GET_KEY_BY_INDEX
+ */
+static EFI_STATUS mmio_start(UINT8 cmd, SMC_KEY key, const UINT8 *data, UINT8 data_len) {
+    UINT8 i;
+
+    if (data_len > SMC_MAX_DATA_LENGTH || (data_len > 0 && !data)) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    mmio_write8(SMC_MMIO_STATUS, 0);
+
+    for (i = 0; i < data_len; i++) {
+        mmio_write8(SMC_MMIO_DATA + i, data[i]);
+    }
+    mmio_write8(SMC_MMIO_DATA_LEN, data_len);
+
+    for (i = 0; i < 4; i++) {
+        mmio_write8(SMC_MMIO_KEY + i, (UINT8)SMC_KEY_CHAR(key, i));
+    }
+    mmio_write8(SMC_MMIO_SMC_ID, 0);
+    mmio_write8(SMC_MMIO_CMD, cmd);
+
+    return EFI_SUCCESS;
+}
+
+static BOOLEAN mmio_ready(void) {
+    return (mmio_read8(SMC_MMIO_STATUS) & SMC_MMIO_ST_DONE) != 0;
+}
+
+/**
+ * Collect the result of a finished command
+ * READ returns the reported length; other commands fill *data_len bytes
+ */
+static EFI_STATUS mmio_finish(UINT8 cmd, UINT8 *data, UINT8 *data_len) {
+    EFI_STATUS status = result_status(mmio_read8(SMC_MMIO_CMD));
+    UINT8 i;
+
+    if (EFI_ERROR(status) || cmd == APPLESMC_WRITE_CMD) {
+        return status;
+    }
+
+    if (cmd == APPLESMC_READ_CMD) {
+        *data_len = mmio_read8(SMC_MMIO_DATA_LEN);
+        if (*data_len > SMC_MAX_DATA_LENGTH) {
+            *data_len = SMC_MAX_DATA_LENGTH;
+        }
+    }
+    for (i = 0; i < *data_len; i++) {
+        data[i] = mmio_read8(SMC_MMIO_DATA + i);
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Run one command to completion
+ */
+static EFI_STATUS mmio_transact(UINT8 cmd, SMC_KEY key, const UINT8 *in, UINT8 in_len,
+                                UINT8 *out, UINT8 *out_len) {
+    UINT32 timeout_us = smc_wait_limit_us(SMC_STATUS_TIMEOUT_US);
+    UINT32 elapsed = 0;
+    EFI_STATUS status;
+
+    status = mmio_start(cmd, key, in, in_len);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    while (!mmio_ready()) {
+        if (elapsed >= timeout_us) {
+            return EFI_TIMEOUT;
+        }
+        smc_delay_us(SMC_IO_DELAY_US);
+        elapsed += SMC_IO_DELAY_US;
+    }
+
+    return mmio_finish(cmd, out, out_len);
+}
+
+/**
+ * Blocking transport entries
+ */
+
+static EFI_STATUS mmio_read_key(SMC_KEY key, UINT8 *data, UINT8 *data_len) {
+    if (!data || !data_len) {
+        return EFI_INVALID_PARAMETER;
+    }
+    return mmio_transact(APPLESMC_READ_CMD, key, NULL, 0, data, data_len);
+}
+
+static EFI_STATUS mmio_write_key(SMC_KEY key, const UINT8 *data, UINT8 data_len) {
+    if (!data || data_len == 0 || data_len > SMC_MAX_DATA_LENGTH) {
+        return EFI_INVALID_PARAMETER;
+    }
+    return mmio_transact(APPLESMC_WRITE_CMD, key, data, data_len, NULL, NULL);
+}
+
+static EFI_STATUS mmio_get_key_type(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]) {
+    UINT8 reply[SMC_MMIO_TYPE_REPLY];
+    UINT8 reply_len = SMC_MMIO_TYPE_REPLY;
+    EFI_STATUS status;
+    UINT8 i;
+
+    if (!data_size || !type) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = mmio_transact(APPLESMC_GET_KEY_TYPE_CMD, key, NULL, 0, reply, &reply_len);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    for (i = 0; i < 4; i++) {
+        type[i] = (CHAR8)reply[SMC_MMIO_TYPE_CODE + i];
+    }
+    type[4] = '\0';
+    *data_size = reply[SMC_MMIO_TYPE_LEN];
+
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS mmio_get_key_by_index(UINT32 index, SMC_KEY *key) {
+    UINT8 reply[4];
+    UINT8 reply_len = sizeof(reply);
+    EFI_STATUS status;
+
+    if (!key) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    status = mmio_transact(APPLESMC_GET_KEY_BY_INDEX_CMD, (SMC_KEY)index, NULL, 0,
+                           reply, &reply_len);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    *key = SMC_KEY_CONST(reply[0], reply[1], reply[2], reply[3]);
+    return EFI_SUCCESS;
+}
+
+// Nothing is left half-transferred; clearing STATUS is enough
+static EFI_STATUS mmio_resync(void) {
+    mmio_write8(SMC_MMIO_STATUS, 0);
+    return EFI_SUCCESS;
+}
+
+const SMC_TRANSPORT smc_mmio_transport = {
+    L"MMIO",
+    mmio_read_key,
+    mmio_write_key,
+    mmio_get_key_type,
+    mmio_get_key_by_index,
+    mmio_resync,
+    mmio_start,
+    mmio_ready,
+    mmio_finish
+};
+
+/**
+ * Map the window
+ * Firmware identity-maps MMIO, so the physical base is used directly.
+ */
+EFI_STATUS smc_mmio_init(UINT64 base, UINT64 size) {
+    if (size < SMC_MMIO_MIN_SIZE) {
+        return EFI_UNSUPPORTED;
+    }
+
+    mmio_base = (UINTN)base;
+
+    // Unbacked physical memory reads as all ones
+    if (mmio_read8(SMC_MMIO_STATUS) == 0xFF) {
+        mmio_base = 0;
+        return EFI_UNSUPPORTED;
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Map the window, verify it and switch to it
+ */
+EFI_STATUS smc_mmio_attach(UINT64 base, UINT64 size) {
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len = 0;
+    EFI_TPL old_tpl;
+    EFI_STATUS status;
+
+    status = smc_mmio_init(base, size);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    old_tpl = smc_bus_enter();
+    status = mmio_read_key(SMC_KEY_REV, data, &data_len);
+    if (EFI_ERROR(status) || data_len == 0) {
+        mmio_resync();
+        status = EFI_UNSUPPORTED;
+    } else {
+        smc_set_transport(&smc_mmio_transport);
+    }
+    smc_bus_leave(old_tpl);
+
+    return status;
+}
@@ -0,0 +1,65 @@
+#ifndef SMC_MMIO_H
+#define SMC_MMIO_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+#endif
+#include "smc_protocol.h"
+
+/**
+ * Memory-mapped SMC transport
+ *
+ * Newer Macs describe a memory window next to the I/O ports in the
+ * APP0001 device's _CRS. A transaction is a handful of register writes
+ * and one status poll instead of the byte-at-a-time port handshake:
+ *
+ *   1. Clear STATUS
+ *   2. (write) Data bytes at DATA, length at DATA_LEN
+ *   3. Key (or big-endian index) at KEY, 0 at SMC_ID, command at CMD
+ *   4. Poll STATUS until SMC_MMIO_ST_DONE
+ *   5. CMD now holds the result code (0 = success, else an ERR_PORT code)
+ *   6. (read) Length from DATA_LEN, value from DATA
+ *
+ * Host builds (tools/) define SMC_HOST_IO and supply the register backend.
+ */
+
+// Register offsets within the window
+#define SMC_MMIO_DATA           0x00    // Value buffer (SMC_MAX_DATA_LENGTH bytes)
+#define SMC_MMIO_KEY            0x78    // Key, first character first
+#define SMC_MMIO_DATA_LEN       0x7D    // Value length
+#define SMC_MMIO_SMC_ID         0x7E    // Target SMC (always 0)
+#define SMC_MMIO_CMD            0x7F    // Command; result code once done
+#define SMC_MMIO_STATUS         0x4005  // Completion status
+
+#define SMC_MMIO_MIN_SIZE       0x4006
+
+// STATUS bits
+#define SMC_MMIO_ST_DONE        0x20
+
+// GET_KEY_TYPE reply layout in DATA
+#define SMC_MMIO_TYPE_CODE      0       // 4-character type code
+#define SMC_MMIO_TYPE_LEN       5       // Value length
+#define SMC_MMIO_TYPE_FLAGS     6       // Attributes
+#define SMC_MMIO_TYPE_REPLY     7
+
+#ifdef SMC_HOST_IO
+// Register backend for host builds (tools/)
+UINT8 smc_host_mmio_read8(UINT32 offset);
+void smc_host_mmio_write8(UINT32 offset, UINT8 value);
+#endif
+
+extern const SMC_TRANSPORT smc_mmio_transport;
+
+// Map the window at base and check it answers (EFI_UNSUPPORTED if not)
+EFI_STATUS smc_mmio_init(UINT64 base, UINT64 size);
+
+// Map the window, verify it with a REV read and select it as the transport;
+// the port transport stays selected on failure
+EFI_STATUS smc_mmio_attach(UINT64 base, UINT64 size);
+
+#endif // SMC_MMIO_H
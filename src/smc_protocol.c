@@ -1,54 +1,238 @@
 #include "smc_protocol.h"
+#include "smc_health.h"
+#include "smc_service.h"
+#include "smc_trace.h"
+#include "utils.h"
 
 // Global variable to store last error
 static UINT8 last_error = 0;
 
+// Completes any in-flight async transaction before blocking I/O
+static void (*quiesce_handler)(void) = NULL;
+
+// Bus owned by a single processor outside Boot Services
+static BOOLEAN bus_exclusive = FALSE;
+
+// Status waits end by this time (0 = SMC_STATUS_TIMEOUT_US alone)
+static UINT64 wait_deadline_us = 0;
+
+// Resident driver that blocking transactions are routed through (if loaded)
+static SMC_SERVICE_PROTOCOL *smc_service = NULL;
+
+static EFI_STATUS read_key_unlocked(SMC_KEY key, UINT8 *data, UINT8 *data_len);
+static EFI_STATUS write_key_unlocked(SMC_KEY key, const UINT8 *data, UINT8 data_len);
+static EFI_STATUS get_key_type_unlocked(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]);
+static EFI_STATUS get_key_by_index_unlocked(UINT32 index, SMC_KEY *key);
+static EFI_STATUS port_resync(void);
+
+// Legacy port-I/O handshake (no split-phase access; see smc_async.c)
+const SMC_TRANSPORT smc_port_transport = {
+    L"port I/O",
+    read_key_unlocked,
+    write_key_unlocked,
+    get_key_type_unlocked,
+    get_key_by_index_unlocked,
+    port_resync,
+    NULL,
+    NULL,
+    NULL
+};
+
+static const SMC_TRANSPORT *transport = &smc_port_transport;
+
+// I/O range; described is set once firmware has vouched for it
+static UINT16 io_base = APPLESMC_DEFAULT_IO_BASE;
+static BOOLEAN io_described = FALSE;
+
 /**
  * Direct I/O port access using inline assembly
- * x86_64 specific implementation
+ * x86_64 specific implementation. Host builds (tools/) define SMC_HOST_IO
+ * and supply the port backend instead.
  */
-
-UINT8 smc_inb(UINT16 port) {
+#ifdef SMC_HOST_IO
+  #define port_inb(port)          smc_host_inb(port)
+  #define port_outb(port, value)  smc_host_outb(port, value)
+#else
+static inline UINT8 port_inb(UINT16 port) {
     UINT8 value;
     __asm__ volatile("inb %1, %0" : "=a"(value) : "Nd"(port));
     return value;
 }
 
-void smc_outb(UINT16 port, UINT8 value) {
+static inline void port_outb(UINT16 port, UINT8 value) {
     __asm__ volatile("outb %0, %1" : : "a"(value), "Nd"(port));
 }
+#endif
+
+UINT8 smc_inb(UINT16 port) {
+    UINT8 value = port_inb(port);
+    smc_trace_record(SMC_TRACE_OP_IN, port, value);
+    return value;
+}
+
+void smc_outb(UINT16 port, UINT8 value) {
+    port_outb(port, value);
+    smc_trace_record(SMC_TRACE_OP_OUT, port, value);
+}
 
 /**
  * Microsecond delay using UEFI Boot Services
+ * (TSC spin when an AP owns the bus; Boot Services are BSP-only)
  */
-static void smc_delay_us(UINT32 microseconds) {
+void smc_delay_us(UINT32 microseconds) {
+    if (bus_exclusive) {
+        timer_spin_us(microseconds);
+        return;
+    }
     gBS->Stall(microseconds);
 }
 
+/**
+ * Bound status waits by an absolute time
+ */
+void smc_set_wait_deadline(UINT64 deadline_us) {
+    wait_deadline_us = deadline_us;
+}
+
+/**
+ * Shorten a status wait to end by the deadline
+ */
+UINT32 smc_wait_limit_us(UINT32 timeout_us) {
+    UINT64 now;
+
+    if (wait_deadline_us == 0) {
+        return timeout_us;
+    }
+
+    now = timer_now_us();
+    if (now >= wait_deadline_us) {
+        return 0;
+    }
+    if (wait_deadline_us - now < timeout_us) {
+        return (UINT32)(wait_deadline_us - now);
+    }
+    return timeout_us;
+}
+
 /**
  * Wait for specific status with timeout
- * Returns EFI_SUCCESS if status achieved, EFI_TIMEOUT otherwise
+ * Returns EFI_SUCCESS if status achieved, EFI_TIMEOUT otherwise. The status
+ * is always checked once, even past the wait deadline.
  */
 EFI_STATUS smc_wait_status(UINT8 expected_status, UINT32 timeout_us) {
     UINT32 elapsed = 0;
     UINT8 status;
 
-    while (elapsed < timeout_us) {
+    timeout_us = smc_wait_limit_us(timeout_us);
+
+    while (TRUE) {
         status = smc_inb(APPLESMC_CMD_PORT);
 
         // Check if we have the expected status
         if ((status & expected_status) == expected_status) {
             return EFI_SUCCESS;
         }
+        if (elapsed >= timeout_us) {
+            return EFI_TIMEOUT;
+        }
 
         // Small delay before next check
         smc_delay_us(SMC_IO_DELAY_US);
         elapsed += SMC_IO_DELAY_US;
     }
+}
+
+/**
+ * Resynchronize the interface after a protocol error
+ */
+EFI_STATUS smc_resync(void) {
+    return transport->resync();
+}
+
+/**
+ * Port-I/O resync
+ * A timeout partway through a transaction can leave the SMC holding data
+ * bytes or still acknowledging; the next command would then be misread.
+ */
+static EFI_STATUS port_resync(void) {
+    UINT32 elapsed = 0;
+    UINT8 drained = 0;
+    UINT8 status;
+
+    while (elapsed < SMC_RESYNC_TIMEOUT_US) {
+        status = smc_inb(APPLESMC_CMD_PORT);
+
+        if ((status & (APPLESMC_ST_DATA_READY | APPLESMC_ST_BUSY | APPLESMC_ST_ACK)) == 0) {
+            last_error = 0;  // Belonged to the aborted transaction
+            return EFI_SUCCESS;
+        }
+
+        // Discard leftover output from the aborted transaction
+        if ((status & APPLESMC_ST_DATA_READY) && drained < SMC_RESYNC_DRAIN_MAX) {
+            smc_inb(APPLESMC_DATA_PORT);
+            drained++;
+        }
+
+        smc_delay_us(SMC_IO_DELAY_US);
+        elapsed += SMC_IO_DELAY_US;
+    }
 
     return EFI_TIMEOUT;
 }
 
+/**
+ * Install handler that completes any in-flight async transaction
+ */
+void smc_set_quiesce_handler(void (*handler)(void)) {
+    quiesce_handler = handler;
+}
+
+/**
+ * Take the bus for a blocking transaction
+ * Raises to TPL_CALLBACK unless the caller already runs at or above it
+ */
+EFI_TPL smc_bus_enter(void) {
+    EFI_TPL old_tpl;
+
+    if (bus_exclusive) {
+        return TPL_HIGH_LEVEL;  // Nothing to restore
+    }
+
+    old_tpl = gBS->RaiseTPL(TPL_HIGH_LEVEL);
+
+    gBS->RestoreTPL(old_tpl);
+    if (old_tpl < TPL_CALLBACK) {
+        gBS->RaiseTPL(TPL_CALLBACK);
+    }
+
+    if (quiesce_handler) {
+        quiesce_handler();
+    }
+
+    return old_tpl;
+}
+
+/**
+ * Release the bus
+ */
+void smc_bus_leave(EFI_TPL old_tpl) {
+    if (old_tpl < TPL_CALLBACK) {
+        gBS->RestoreTPL(old_tpl);
+    }
+}
+
+/**
+ * Switch exclusive (single owner, no Boot Services) bus mode
+ * Call from the BSP before starting / after stopping the owner
+ */
+void smc_set_exclusive(BOOLEAN exclusive) {
+    if (exclusive) {
+        timer_calibrate();
+    }
+    bus_exclusive = exclusive;
+    memory_fence();
+}
+
 /**
  * Get last SMC error code from error port
  */
@@ -67,13 +251,50 @@ void smc_clear_error(void) {
     last_error = 0;
 }
 
+/**
+ * Pack four key characters into an SMC_KEY
+ */
+SMC_KEY smc_key_from_chars(const CHAR8 *chars) {
+    if (!chars) {
+        return 0;
+    }
+
+    return SMC_KEY_CONST(chars[0], chars[1], chars[2], chars[3]);
+}
+
+/**
+ * Unpack an SMC_KEY into a null-terminated string
+ */
+void smc_key_to_chars(SMC_KEY key, CHAR8 chars[5]) {
+    UINT8 i;
+
+    if (!chars) {
+        return;
+    }
+
+    for (i = 0; i < 4; i++) {
+        chars[i] = SMC_KEY_CHAR(key, i);
+    }
+    chars[4] = '\0';
+}
+
 /**
  * Initialize SMC interface
  */
 EFI_STATUS smc_init(void) {
+    // Other transports check their window when they are attached
+    if (transport != &smc_port_transport) {
+        return EFI_SUCCESS;
+    }
+
     // Clear any pending errors
     smc_clear_error();
 
+    // The ACPI description already says an SMC is there
+    if (io_described) {
+        return EFI_SUCCESS;
+    }
+
     // Verify CMD port is accessible
     UINT8 status = smc_inb(APPLESMC_CMD_PORT);
 
@@ -92,9 +313,8 @@ EFI_STATUS smc_init(void) {
 BOOLEAN smc_detect(void) {
     UINT8 data[32];
     UINT8 data_len = 0;
-    CHAR8 test_key[4] = {'R', 'E', 'V', ' '};
 
-    EFI_STATUS status = smc_read_key(test_key, data, &data_len);
+    EFI_STATUS status = smc_read_key(SMC_KEY_REV, data, &data_len);
 
     return (status == EFI_SUCCESS && data_len > 0);
 }
@@ -112,11 +332,11 @@ BOOLEAN smc_detect(void) {
  * 6. Read data bytes from DATA port
  * 7. Status returns to CMD_DONE
  */
-EFI_STATUS smc_read_key(const CHAR8 key[4], UINT8 *data, UINT8 *data_len) {
+static EFI_STATUS read_key_unlocked(SMC_KEY key, UINT8 *data, UINT8 *data_len) {
     EFI_STATUS status;
     UINT8 i;
 
-    if (!key || !data || !data_len) {
+    if (!data || !data_len) {
         return EFI_INVALID_PARAMETER;
     }
 
@@ -133,7 +353,7 @@ EFI_STATUS smc_read_key(const CHAR8 key[4], UINT8 *data, UINT8 *data_len) {
 
     // Step 3: Write 4-byte key
     for (i = 0; i < 4; i++) {
-        smc_outb(APPLESMC_DATA_PORT, key[i]);
+        smc_outb(APPLESMC_DATA_PORT, SMC_KEY_CHAR(key, i));
         smc_delay_us(SMC_IO_DELAY_US);
 
         // After 4th byte, wait for DATA_READY
@@ -185,11 +405,11 @@ EFI_STATUS smc_read_key(const CHAR8 key[4], UINT8 *data, UINT8 *data_len) {
  * 5. Write data bytes to DATA port
  * 6. Wait for CMD_DONE
  */
-EFI_STATUS smc_write_key(const CHAR8 key[4], const UINT8 *data, UINT8 data_len) {
+static EFI_STATUS write_key_unlocked(SMC_KEY key, const UINT8 *data, UINT8 data_len) {
     EFI_STATUS status;
     UINT8 i;
 
-    if (!key || !data || data_len == 0 || data_len > SMC_MAX_DATA_LENGTH) {
+    if (!data || data_len == 0 || data_len > SMC_MAX_DATA_LENGTH) {
         return EFI_INVALID_PARAMETER;
     }
 
@@ -206,7 +426,7 @@ EFI_STATUS smc_write_key(const CHAR8 key[4], const UINT8 *data, UINT8 data_len)
 
     // Step 3: Write 4-byte key
     for (i = 0; i < 4; i++) {
-        smc_outb(APPLESMC_DATA_PORT, key[i]);
+        smc_outb(APPLESMC_DATA_PORT, SMC_KEY_CHAR(key, i));
         smc_delay_us(SMC_IO_DELAY_US);
     }
 
@@ -237,11 +457,11 @@ EFI_STATUS smc_write_key(const CHAR8 key[4], const UINT8 *data, UINT8 data_len)
  * Get key type information
  * Returns the data size and type code for a given key
  */
-EFI_STATUS smc_get_key_type(const CHAR8 key[4], UINT8 *data_size, CHAR8 type[5]) {
+static EFI_STATUS get_key_type_unlocked(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]) {
     EFI_STATUS status;
     UINT8 i;
 
-    if (!key || !data_size || !type) {
+    if (!data_size || !type) {
         return EFI_INVALID_PARAMETER;
     }
 
@@ -257,13 +477,16 @@ EFI_STATUS smc_get_key_type(const CHAR8 key[4], UINT8 *data_size, CHAR8 type[5])
 
     // Write 4-byte key
     for (i = 0; i < 4; i++) {
-        smc_outb(APPLESMC_DATA_PORT, key[i]);
+        smc_outb(APPLESMC_DATA_PORT, SMC_KEY_CHAR(key, i));
         smc_delay_us(SMC_IO_DELAY_US);
     }
 
     // Wait for DATA_READY
     status = smc_wait_status(APPLESMC_ST_DATA_READY, SMC_STATUS_TIMEOUT_US);
     if (EFI_ERROR(status)) {
+        if (smc_get_last_error() == APPLESMC_ST_1E_NOEXIST) {
+            return EFI_NOT_FOUND;
+        }
         return EFI_DEVICE_ERROR;
     }
 
@@ -282,3 +505,190 @@ EFI_STATUS smc_get_key_type(const CHAR8 key[4], UINT8 *data_size, CHAR8 type[5])
 
     return EFI_SUCCESS;
 }
+
+/**
+ * Get key by directory index
+ * Same exchange as GET_KEY_TYPE with the big-endian index in place of
+ * the key; the SMC answers with the 4 key bytes.
+ */
+static EFI_STATUS get_key_by_index_unlocked(UINT32 index, SMC_KEY *key) {
+    EFI_STATUS status;
+    UINT8 i;
+
+    if (!key) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    smc_outb(APPLESMC_CMD_PORT, APPLESMC_GET_KEY_BY_INDEX_CMD);
+    smc_delay_us(SMC_IO_DELAY_US);
+
+    status = smc_wait_status(APPLESMC_ST_ACK, SMC_STATUS_TIMEOUT_US);
+    if (EFI_ERROR(status)) {
+        smc_get_last_error();
+        return EFI_DEVICE_ERROR;
+    }
+
+    // Write 4-byte index, most significant byte first
+    for (i = 0; i < 4; i++) {
+        smc_outb(APPLESMC_DATA_PORT, (UINT8)(index >> (24 - 8 * i)));
+        smc_delay_us(SMC_IO_DELAY_US);
+    }
+
+    status = smc_wait_status(APPLESMC_ST_DATA_READY, SMC_STATUS_TIMEOUT_US);
+    if (EFI_ERROR(status)) {
+        if (smc_get_last_error() == APPLESMC_ST_1E_BAD_INDEX) {
+            return EFI_NOT_FOUND;
+        }
+        return EFI_DEVICE_ERROR;
+    }
+
+    *key = 0;
+    for (i = 0; i < 4; i++) {
+        *key = (*key << 8) | smc_inb(APPLESMC_DATA_PORT);
+        smc_delay_us(SMC_IO_DELAY_US);
+    }
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Blocking transaction entry points
+ * Each takes the bus for the duration of one transaction. With the
+ * resident driver attached the transaction is its call instead; the bus
+ * is still taken so the local async engine is quiesced first.
+ */
+
+static BOOLEAN use_service(void) {
+    return smc_service != NULL && !bus_exclusive;
+}
+
+// A failed transaction leaves the interface to clean up, unless the caller's
+// arguments were refused or the SMC answered "no such key" (nothing pending)
+static BOOLEAN needs_resync(EFI_STATUS status) {
+    return EFI_ERROR(status) && status != EFI_INVALID_PARAMETER && status != EFI_NOT_FOUND;
+}
+
+// Read a key; the resident driver may answer from a value up to max_age_ms old
+static EFI_STATUS read_key(SMC_KEY key, UINT32 max_age_ms, UINT8 *data, UINT8 *data_len) {
+    EFI_TPL old_tpl = smc_bus_enter();
+    EFI_STATUS status;
+
+    // Quarantined keys fail fast instead of burning another timeout
+    if (!smc_health_allow(key)) {
+        smc_bus_leave(old_tpl);
+        return SMC_STATUS_QUARANTINED;
+    }
+
+    if (use_service()) {
+        status = smc_service->ReadKey(smc_service, key, max_age_ms, data, data_len);
+    } else {
+        status = transport->read_key(key, data, data_len);
+        if (needs_resync(status)) {
+            smc_resync();
+        }
+    }
+    smc_health_record(key, status);
+
+    smc_bus_leave(old_tpl);
+    return status;
+}
+
+EFI_STATUS smc_read_key(SMC_KEY key, UINT8 *data, UINT8 *data_len) {
+    return read_key(key, SMC_SERVICE_VALUE_TTL_MS, data, data_len);
+}
+
+EFI_STATUS smc_read_key_fresh(SMC_KEY key, UINT8 *data, UINT8 *data_len) {
+    return read_key(key, 0, data, data_len);
+}
+
+EFI_STATUS smc_write_key(SMC_KEY key, const UINT8 *data, UINT8 data_len) {
+    EFI_TPL old_tpl = smc_bus_enter();
+    EFI_STATUS status;
+
+    if (use_service()) {
+        status = smc_service->WriteKey(smc_service, key, data, data_len);
+    } else {
+        status = transport->write_key(key, data, data_len);
+        if (needs_resync(status)) {
+            smc_resync();
+        }
+    }
+    smc_bus_leave(old_tpl);
+    return status;
+}
+
+EFI_STATUS smc_get_key_type(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]) {
+    EFI_TPL old_tpl = smc_bus_enter();
+    EFI_STATUS status;
+    SMC_KEY type_code;
+
+    if (use_service()) {
+        if (!data_size || !type) {
+            status = EFI_INVALID_PARAMETER;
+        } else {
+            status = smc_service->GetKeyInfo(smc_service, key, data_size, &type_code);
+            if (!EFI_ERROR(status)) {
+                smc_key_to_chars(type_code, type);
+            }
+        }
+    } else {
+        status = transport->get_key_type(key, data_size, type);
+        if (needs_resync(status)) {
+            smc_resync();
+        }
+    }
+    smc_bus_leave(old_tpl);
+    return status;
+}
+
+EFI_STATUS smc_get_key_by_index(UINT32 index, SMC_KEY *key) {
+    EFI_TPL old_tpl = smc_bus_enter();
+    EFI_STATUS status;
+
+    if (use_service()) {
+        status = smc_service->GetKeyByIndex(smc_service, index, key);
+    } else {
+        status = transport->get_key_by_index(index, key);
+        if (needs_resync(status)) {
+            smc_resync();
+        }
+    }
+    smc_bus_leave(old_tpl);
+    return status;
+}
+
+/**
+ * Route blocking transactions through the resident driver
+ */
+void smc_set_service(SMC_SERVICE_PROTOCOL *service) {
+    smc_service = service;
+}
+
+SMC_SERVICE_PROTOCOL *smc_get_service(void) {
+    return use_service() ? smc_service : NULL;
+}
+
+/**
+ * Select the transport backend
+ * Call with the bus idle (before the async engine or an AP owner starts)
+ */
+void smc_set_transport(const SMC_TRANSPORT *backend) {
+    transport = backend ? backend : &smc_port_transport;
+}
+
+const SMC_TRANSPORT *smc_get_transport(void) {
+    return transport;
+}
+
+UINT16 smc_get_io_base(void) {
+    return io_base;
+}
+
+/**
+ * Move to a firmware-described I/O range
+ * Call with the bus idle, like smc_set_transport()
+ */
+void smc_set_io_base(UINT16 base) {
+    io_base = base;
+    io_described = TRUE;
+}
@@ -11,10 +11,19 @@
   #include <Library/UefiBootServicesTableLib.h>
 #endif
 
+// SMC I/O range: taken from the APP0001 _CRS (smc_acpi.c), else the legacy base
+#define APPLESMC_DEFAULT_IO_BASE    0x300
+#define APPLESMC_IO_LENGTH          0x20
+
+// Register offsets within the I/O range
+#define APPLESMC_DATA_OFFSET    0x00   // Data read/write port
+#define APPLESMC_CMD_OFFSET     0x04   // Command and status port
+#define APPLESMC_ERR_OFFSET     0x1E   // Error status port
+
 // SMC I/O Port Addresses
-#define APPLESMC_DATA_PORT      0x300  // Data read/write port
-#define APPLESMC_CMD_PORT       0x304  // Command and status port
-#define APPLESMC_ERR_PORT       0x31E  // Error status port
+#define APPLESMC_DATA_PORT      ((UINT16)(smc_get_io_base() + APPLESMC_DATA_OFFSET))
+#define APPLESMC_CMD_PORT       ((UINT16)(smc_get_io_base() + APPLESMC_CMD_OFFSET))
+#define APPLESMC_ERR_PORT       ((UINT16)(smc_get_io_base() + APPLESMC_ERR_OFFSET))
 
 // SMC Commands
 #define APPLESMC_READ_CMD               0x10  // Read SMC key value
@@ -45,9 +54,38 @@
 // Maximum data length for SMC keys
 #define SMC_MAX_DATA_LENGTH     32
 
+// Resynchronization limits (bytes drained, time to reach a clean status)
+#define SMC_RESYNC_DRAIN_MAX    (SMC_MAX_DATA_LENGTH + 8)
+#define SMC_RESYNC_TIMEOUT_US   10000
+
+/**
+ * SMC key representation
+ * Keys are four ASCII characters packed big-endian into a UINT32
+ * (FourCC), so "F0Ac" is 0x46304163. Comparisons and hashing are
+ * single-word operations and the first character is the high byte,
+ * which keeps numeric order equal to the SMC's own key order.
+ */
+typedef UINT32 SMC_KEY;
+
+// Compile-time key construction from four characters
+#define SMC_KEY_CONST(a, b, c, d) \
+    ((SMC_KEY)(((UINT32)(UINT8)(a) << 24) | ((UINT32)(UINT8)(b) << 16) | \
+               ((UINT32)(UINT8)(c) << 8)  |  (UINT32)(UINT8)(d)))
+
+// Extract character n (0-3) from a key
+#define SMC_KEY_CHAR(key, n)    ((CHAR8)(((key) >> (24 - 8 * (n))) & 0xFF))
+
+// Multiplicative hash of a key into a table of 2^bits entries
+#define SMC_KEY_HASH(key, bits) ((UINT32)((UINT32)(key) * 0x9E3779B1U) >> (32 - (bits)))
+
+// Well-known keys
+#define SMC_KEY_REV             SMC_KEY_CONST('R', 'E', 'V', ' ')  // SMC firmware revision
+#define SMC_KEY_FNUM            SMC_KEY_CONST('F', 'N', 'u', 'm')  // Number of fans
+#define SMC_KEY_COUNT           SMC_KEY_CONST('#', 'K', 'E', 'Y')  // Number of keys (ui32)
+
 /**
  * Low-level I/O functions
- * Direct port access for SMC communication
+ * Direct port access for SMC communication (recorded by smc_trace.h)
  */
 
 // Read byte from I/O port
@@ -56,6 +94,55 @@ UINT8 smc_inb(UINT16 port);
 // Write byte to I/O port
 void smc_outb(UINT16 port, UINT8 value);
 
+#ifdef SMC_HOST_IO
+// Port backend for host builds (tools/), replacing in/out instructions
+UINT8 smc_host_inb(UINT16 port);
+void smc_host_outb(UINT16 port, UINT8 value);
+#endif
+
+// First port of the I/O range in use
+UINT16 smc_get_io_base(void);
+
+// Use the I/O range firmware describes. The SMC is then known to exist, so
+// smc_init() skips its port probe.
+void smc_set_io_base(UINT16 base);
+
+// Delay between bus accesses (Stall, or a TSC spin in exclusive mode)
+void smc_delay_us(UINT32 microseconds);
+
+/**
+ * Transports
+ * The blocking transactions below run on the selected backend: the legacy
+ * port-I/O handshake (smc_port_transport, the default) or a memory-mapped
+ * window (smc_mmio.h). Caller owns the bus for every entry.
+ */
+typedef struct {
+    const CHAR16 *name;
+
+    EFI_STATUS (*read_key)(SMC_KEY key, UINT8 *data, UINT8 *data_len);
+    EFI_STATUS (*write_key)(SMC_KEY key, const UINT8 *data, UINT8 data_len);
+    EFI_STATUS (*get_key_type)(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]);
+    EFI_STATUS (*get_key_by_index)(UINT32 index, SMC_KEY *key);
+
+    // Bring the interface back to idle after a failed transaction
+    EFI_STATUS (*resync)(void);
+
+    // Split-phase READ/WRITE for the async engine: post the command, poll
+    // until ready, collect the result. NULL when the backend needs the
+    // byte-level handshake (the engine then steps the ports itself).
+    EFI_STATUS (*start)(UINT8 cmd, SMC_KEY key, const UINT8 *data, UINT8 data_len);
+    BOOLEAN (*ready)(void);
+    EFI_STATUS (*finish)(UINT8 cmd, UINT8 *data, UINT8 *data_len);
+} SMC_TRANSPORT;
+
+extern const SMC_TRANSPORT smc_port_transport;
+
+// Select the backend (NULL restores port I/O)
+void smc_set_transport(const SMC_TRANSPORT *transport);
+
+// The selected backend
+const SMC_TRANSPORT *smc_get_transport(void);
+
 /**
  * SMC Protocol Functions
  */
@@ -66,17 +153,70 @@ EFI_STATUS smc_init(void);
 // Detect if SMC is present
 BOOLEAN smc_detect(void);
 
-// Wait for specific status with timeout
+// Wait for specific status with timeout (capped by the wait deadline)
 EFI_STATUS smc_wait_status(UINT8 expected_status, UINT32 timeout_us);
 
+// End every status wait by an absolute time (timer_now_us), 0 for no limit.
+// For a caller with a time budget (sensor discovery): a probe of an absent
+// key then gives up at the deadline instead of after SMC_STATUS_TIMEOUT_US.
+// Applies to the port and MMIO transports, not to the resident driver.
+// Caller must own the bus.
+void smc_set_wait_deadline(UINT64 deadline_us);
+
+// A status wait of timeout_us, shortened to end by the wait deadline
+UINT32 smc_wait_limit_us(UINT32 timeout_us);
+
+// Bring the interface back to idle after a failed transaction (port I/O:
+// drain stale data bytes and wait for a clean status). Caller must own the bus.
+EFI_STATUS smc_resync(void);
+
 // Read SMC key value
-EFI_STATUS smc_read_key(const CHAR8 key[4], UINT8 *data, UINT8 *data_len);
+// Through the resident driver the value may be up to SMC_SERVICE_VALUE_TTL_MS old
+EFI_STATUS smc_read_key(SMC_KEY key, UINT8 *data, UINT8 *data_len);
+
+// Read SMC key value from the SMC itself, never from the driver's value cache
+EFI_STATUS smc_read_key_fresh(SMC_KEY key, UINT8 *data, UINT8 *data_len);
 
 // Write SMC key value
-EFI_STATUS smc_write_key(const CHAR8 key[4], const UINT8 *data, UINT8 data_len);
+EFI_STATUS smc_write_key(SMC_KEY key, const UINT8 *data, UINT8 data_len);
 
 // Get key type information
-EFI_STATUS smc_get_key_type(const CHAR8 key[4], UINT8 *data_size, CHAR8 type[5]);
+EFI_STATUS smc_get_key_type(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]);
+
+// Get the key at a directory index (0 .. "#KEY" - 1); EFI_NOT_FOUND past the end
+EFI_STATUS smc_get_key_by_index(UINT32 index, SMC_KEY *key);
+
+// Send the blocking transactions above through the resident SMC driver
+// (smc_service.h) instead of the ports; NULL goes back to port I/O.
+// Exclusive mode always uses the ports.
+struct _SMC_SERVICE_PROTOCOL;
+void smc_set_service(struct _SMC_SERVICE_PROTOCOL *service);
+
+// The resident driver transactions are routed through; NULL when they use
+// the ports (no driver, or exclusive mode)
+struct _SMC_SERVICE_PROTOCOL *smc_get_service(void);
+
+/**
+ * Bus arbitration
+ * Blocking transactions run at TPL_CALLBACK so the async engine's timer
+ * cannot interleave port I/O with them. The quiesce handler is called
+ * first so an in-flight async transaction finishes before the bus is
+ * reused.
+ */
+
+// Install handler that completes any in-flight async transaction
+void smc_set_quiesce_handler(void (*handler)(void));
+
+// Take the bus for a blocking transaction; returns TPL to restore
+EFI_TPL smc_bus_enter(void);
+
+// Release the bus
+void smc_bus_leave(EFI_TPL old_tpl);
+
+// Hand the bus to a single owner that runs without Boot Services (an AP):
+// no TPL arbitration, TSC delays instead of Stall(). Nothing else may
+// touch the SMC while exclusive mode is on.
+void smc_set_exclusive(BOOLEAN exclusive);
 
 /**
  * Helper functions
@@ -88,4 +228,10 @@ UINT8 smc_get_last_error(void);
 // Clear SMC error status
 void smc_clear_error(void);
 
+// Pack four key characters into an SMC_KEY
+SMC_KEY smc_key_from_chars(const CHAR8 *chars);
+
+// Unpack an SMC_KEY into a null-terminated string
+void smc_key_to_chars(SMC_KEY key, CHAR8 chars[5]);
+
 #endif // SMC_PROTOCOL_H
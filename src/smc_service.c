@@ -0,0 +1,25 @@
+#include "smc_service.h"
+
+#ifdef _GNU_EFI
+EFI_GUID gApplesSmcServiceProtocolGuid = APPLE_SMC_SERVICE_PROTOCOL_GUID;
+#endif
+
+/**
+ * Attach to the resident SMC driver
+ * Older revisions are ignored; the tool then talks to the ports itself.
+ */
+EFI_STATUS smc_service_attach(void) {
+    SMC_SERVICE_PROTOCOL *service = NULL;
+    EFI_STATUS status;
+
+    status = gBS->LocateProtocol(&gApplesSmcServiceProtocolGuid, NULL, (void **)&service);
+    if (EFI_ERROR(status) || !service) {
+        return EFI_NOT_FOUND;
+    }
+    if (service->Revision < SMC_SERVICE_REVISION) {
+        return EFI_INCOMPATIBLE_VERSION;
+    }
+
+    smc_set_service(service);
+    return EFI_SUCCESS;
+}
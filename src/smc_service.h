@@ -0,0 +1,100 @@
+#ifndef SMC_SERVICE_H
+#define SMC_SERVICE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "smc_protocol.h"
+
+/**
+ * Resident SMC service protocol
+ *
+ * The boot-service driver (applesmc_dxe.efi, src/smc_dxe.c) owns the SMC
+ * for every pre-boot tool that loads after it and publishes this protocol
+ * on its own handle. Behind it sit:
+ *
+ *  - a key directory: the "#KEY" count and the index -> key table, filled
+ *    on demand and kept for the life of the driver
+ *  - a key info cache: size and type code per key, including keys the SMC
+ *    reported as missing, so sensor discovery is paid for once
+ *  - a value cache: the last bytes read per key, served while younger than
+ *    the caller's MaxAgeMs (capped at SMC_SERVICE_VALUE_TTL_MS); a write
+ *    drops the key's entry
+ *
+ * Calls are serialized at TPL_CALLBACK. A call that interrupts another one
+ * (from a higher TPL) returns EFI_NOT_READY instead of touching the bus.
+ * Data buffers hold SMC_MAX_DATA_LENGTH bytes, as for smc_read_key().
+ */
+
+#define APPLE_SMC_SERVICE_PROTOCOL_GUID \
+    { 0x5c1b7a6e, 0x2f3d, 0x4b8a, { 0x9e, 0x41, 0x7d, 0x02, 0xc6, 0x58, 0xa3, 0x1f } }
+
+// Defined in smc_service.c for gnu-efi; EDK2 takes it from ApplesSmcEfi.dec
+extern EFI_GUID gApplesSmcServiceProtocolGuid;
+
+#define SMC_SERVICE_REVISION        0x00010000
+
+// Upper bound on the age of a cached value
+#define SMC_SERVICE_VALUE_TTL_MS    250
+
+typedef struct _SMC_SERVICE_PROTOCOL SMC_SERVICE_PROTOCOL;
+
+// One key of a ReadBatch call
+typedef struct {
+    SMC_KEY Key;                           // In
+    UINT8 DataLen;                         // Out: bytes in Data
+    UINT8 Data[SMC_MAX_DATA_LENGTH];       // Out
+    EFI_STATUS Status;                     // Out
+} SMC_SERVICE_READ_REQUEST;
+
+// Read a key; a cached value no older than MaxAgeMs is returned without bus traffic
+typedef EFI_STATUS (EFIAPI *SMC_SERVICE_READ_KEY)(SMC_SERVICE_PROTOCOL *This, SMC_KEY Key,
+                                                  UINT32 MaxAgeMs, UINT8 *Data,
+                                                  UINT8 *DataLen);
+
+// Write a key
+typedef EFI_STATUS (EFIAPI *SMC_SERVICE_WRITE_KEY)(SMC_SERVICE_PROTOCOL *This, SMC_KEY Key,
+                                                   const UINT8 *Data, UINT8 DataLen);
+
+// Number of keys the SMC reports ("#KEY")
+typedef EFI_STATUS (EFIAPI *SMC_SERVICE_GET_KEY_COUNT)(SMC_SERVICE_PROTOCOL *This,
+                                                       UINT32 *Count);
+
+// Key at a directory index (EFI_NOT_FOUND past the end)
+typedef EFI_STATUS (EFIAPI *SMC_SERVICE_GET_KEY_BY_INDEX)(SMC_SERVICE_PROTOCOL *This,
+                                                          UINT32 Index, SMC_KEY *Key);
+
+// Data size and type code of a key (EFI_NOT_FOUND if the SMC has no such key)
+typedef EFI_STATUS (EFIAPI *SMC_SERVICE_GET_KEY_INFO)(SMC_SERVICE_PROTOCOL *This, SMC_KEY Key,
+                                                      UINT8 *DataSize, SMC_KEY *TypeCode);
+
+// Read several keys under one bus acquisition; returns the last error seen
+typedef EFI_STATUS (EFIAPI *SMC_SERVICE_READ_BATCH)(SMC_SERVICE_PROTOCOL *This,
+                                                    SMC_SERVICE_READ_REQUEST *Requests,
+                                                    UINTN Count, UINT32 MaxAgeMs);
+
+struct _SMC_SERVICE_PROTOCOL {
+    UINT32 Revision;
+    SMC_SERVICE_READ_KEY ReadKey;
+    SMC_SERVICE_WRITE_KEY WriteKey;
+    SMC_SERVICE_GET_KEY_COUNT GetKeyCount;
+    SMC_SERVICE_GET_KEY_BY_INDEX GetKeyByIndex;
+    SMC_SERVICE_GET_KEY_INFO GetKeyInfo;
+    SMC_SERVICE_READ_BATCH ReadBatch;
+};
+
+/**
+ * Client side
+ */
+
+// Route smc_protocol.h transactions through the resident driver if it is
+// loaded; EFI_NOT_FOUND (and direct port I/O) otherwise
+EFI_STATUS smc_service_attach(void);
+
+#endif // SMC_SERVICE_H
@@ -0,0 +1,177 @@
+#include "smc_trace.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+  #include <Protocol/LoadedImage.h>
+  #include <Protocol/SimpleFileSystem.h>
+#endif
+
+static SMC_TRACE_RECORD *trace_ring = NULL;
+static UINT32 trace_mask = 0;
+static UINT64 trace_written = 0;      // Records appended since start
+static UINT64 trace_origin_us = 0;
+static BOOLEAN trace_on = FALSE;
+
+/**
+ * Start recording into a fresh ring
+ */
+EFI_STATUS smc_trace_start(UINT32 capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    smc_trace_free();
+
+    trace_ring = AllocatePool(capacity * sizeof(SMC_TRACE_RECORD));
+    if (!trace_ring) {
+        return EFI_OUT_OF_RESOURCES;
+    }
+
+    trace_mask = capacity - 1;
+    trace_written = 0;
+    trace_origin_us = timer_now_us();
+    trace_on = TRUE;
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Stop recording
+ */
+void smc_trace_stop(void) {
+    trace_on = FALSE;
+}
+
+/**
+ * Append one port access
+ */
+void smc_trace_record(UINT8 op, UINT16 port, UINT8 value) {
+    SMC_TRACE_RECORD *record;
+
+    if (!trace_on) {
+        return;
+    }
+
+    record = &trace_ring[trace_written & trace_mask];
+    record->time_us = (UINT32)(timer_now_us() - trace_origin_us);
+    record->port = port;
+    record->value = value;
+    record->op = op;
+    trace_written++;
+}
+
+/**
+ * Records held in the ring
+ */
+UINT32 smc_trace_count(void) {
+    if (!trace_ring) {
+        return 0;
+    }
+    return (trace_written > trace_mask) ? trace_mask + 1 : (UINT32)trace_written;
+}
+
+/**
+ * Write a buffer, failing on short writes
+ */
+static EFI_STATUS write_all(EFI_FILE_PROTOCOL *file, void *buffer, UINTN size) {
+    UINTN written = size;
+    EFI_STATUS status;
+
+    if (size == 0) {
+        return EFI_SUCCESS;
+    }
+
+    status = file->Write(file, &written, buffer);
+    if (!EFI_ERROR(status) && written != size) {
+        status = EFI_VOLUME_FULL;
+    }
+    return status;
+}
+
+/**
+ * Write the ring to a file on the image's volume
+ */
+EFI_STATUS smc_trace_save(EFI_HANDLE image_handle, const CHAR16 *path) {
+    EFI_LOADED_IMAGE_PROTOCOL *loaded_image = NULL;
+    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *volume = NULL;
+    EFI_FILE_PROTOCOL *root = NULL;
+    EFI_FILE_PROTOCOL *file = NULL;
+    SMC_TRACE_HEADER header;
+    UINT32 count, first;
+    EFI_STATUS status;
+
+    if (!trace_ring || !path) {
+        return EFI_NOT_STARTED;
+    }
+
+    status = gBS->HandleProtocol(image_handle, &gEfiLoadedImageProtocolGuid,
+                                 (void **)&loaded_image);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    status = gBS->HandleProtocol(loaded_image->DeviceHandle, &gEfiSimpleFileSystemProtocolGuid,
+                                 (void **)&volume);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    status = volume->OpenVolume(volume, &root);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    // Replace any previous trace (Open with CREATE would keep its old length)
+    if (!EFI_ERROR(root->Open(root, &file, (CHAR16 *)path,
+                              EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0))) {
+        file->Delete(file);
+        file = NULL;
+    }
+    status = root->Open(root, &file, (CHAR16 *)path,
+                        EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE | EFI_FILE_MODE_CREATE, 0);
+    root->Close(root);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+
+    // Nothing may append while the ring is copied out
+    smc_trace_stop();
+
+    count = smc_trace_count();
+    first = (UINT32)(trace_written - count) & trace_mask;
+
+    header.magic = SMC_TRACE_MAGIC;
+    header.version = SMC_TRACE_VERSION;
+    header.record_size = sizeof(SMC_TRACE_RECORD);
+    header.record_count = count;
+    header.dropped = (trace_written - count > 0xFFFFFFFF) ? 0xFFFFFFFF
+                                                          : (UINT32)(trace_written - count);
+
+    // Oldest records first: the tail of the ring, then its head
+    status = write_all(file, &header, sizeof(header));
+    if (!EFI_ERROR(status)) {
+        UINT32 tail = trace_mask + 1 - first;
+        if (tail > count) {
+            tail = count;
+        }
+        status = write_all(file, &trace_ring[first], tail * sizeof(SMC_TRACE_RECORD));
+        if (!EFI_ERROR(status)) {
+            status = write_all(file, trace_ring, (count - tail) * sizeof(SMC_TRACE_RECORD));
+        }
+    }
+
+    file->Close(file);
+    return status;
+}
+
+/**
+ * Stop recording and release the ring
+ */
+void smc_trace_free(void) {
+    trace_on = FALSE;
+    if (trace_ring) {
+        FreePool(trace_ring);
+        trace_ring = NULL;
+    }
+    trace_mask = 0;
+    trace_written = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef SMC_TRACE_H
+#define SMC_TRACE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+
+/**
+ * SMC port-I/O tracing
+ *
+ * While tracing is on, every smc_inb()/smc_outb() is appended to a ring
+ * buffer with its time, port and value; when the ring is full the oldest
+ * records are overwritten. smc_trace_save() writes the ring, oldest record
+ * first, to a file on the volume the application was loaded from.
+ * tools/smc_replay.c feeds such a file back into smc_protocol.c on a Linux
+ * host with the recorded status-bit timing.
+ *
+ * Records are appended by whoever owns the bus (see smc_bus_enter), so the
+ * ring has one writer at a time.
+ *
+ * File layout (little-endian): SMC_TRACE_HEADER, then record_count
+ * SMC_TRACE_RECORDs in time order.
+ */
+
+#define SMC_TRACE_MAGIC             0x54434D53  // "SMCT"
+#define SMC_TRACE_VERSION           1
+
+// Default ring size (records, power of two): 512 KiB
+#define SMC_TRACE_DEFAULT_RECORDS   65536
+
+// Default output file, in the root of the application's volume
+#define SMC_TRACE_FILE              L"\\smc_trace.bin"
+
+// Record operations
+#define SMC_TRACE_OP_IN             0
+#define SMC_TRACE_OP_OUT            1
+
+typedef struct {
+    UINT32 time_us;           // Since smc_trace_start() (wraps after ~71 minutes)
+    UINT16 port;
+    UINT8 value;
+    UINT8 op;                 // SMC_TRACE_OP_*
+} SMC_TRACE_RECORD;
+
+typedef struct {
+    UINT32 magic;             // SMC_TRACE_MAGIC
+    UINT16 version;           // SMC_TRACE_VERSION
+    UINT16 record_size;       // sizeof(SMC_TRACE_RECORD)
+    UINT32 record_count;      // Records that follow
+    UINT32 dropped;           // Older records overwritten in the ring
+} SMC_TRACE_HEADER;
+
+// Allocate a ring of `capacity` records (power of two) and start recording
+EFI_STATUS smc_trace_start(UINT32 capacity);
+
+// Stop recording; the ring is kept for smc_trace_save()
+void smc_trace_stop(void);
+
+// Append one port access (called by smc_inb/smc_outb; no-op when stopped)
+void smc_trace_record(UINT8 op, UINT16 port, UINT8 value);
+
+// Records currently held in the ring
+UINT32 smc_trace_count(void);
+
+// Stop recording and write the ring to `path` on the image's volume
+// (replaces an existing file)
+EFI_STATUS smc_trace_save(EFI_HANDLE image_handle, const CHAR16 *path);
+
+// Stop recording and free the ring
+void smc_trace_free(void);
+
+#endif // SMC_TRACE_H
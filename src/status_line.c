@@ -0,0 +1,193 @@
+#include "status_line.h"
+#include "utils.h"
+
+// Field widths
+#define TIME_WIDTH  10    // ms
+#define RPM_WIDTH   5
+#define TEMP_WIDTH  5     // -10.5 to 999.9
+#define FAN_WIDTH   (3 + RPM_WIDTH + 1 + RPM_WIDTH)   // " M " rpm "/" target
+
+// Line under construction, and the last message written
+static CHAR16 line[STATUS_LINE_MAX + 3];
+static UINTN line_len;
+static CHAR16 last_note[128];
+
+/**
+ * Line encoding
+ * Characters past STATUS_LINE_MAX are dropped.
+ */
+
+static void put_char(CHAR16 ch) {
+    if (line_len < STATUS_LINE_MAX) {
+        line[line_len++] = ch;
+    }
+}
+
+static void put_ascii(const CHAR8 *text) {
+    while (*text) {
+        put_char((CHAR16)*text++);
+    }
+}
+
+// Right-aligned in width characters (0 for no padding)
+static void put_uint(UINT32 value, UINTN width) {
+    CHAR16 digits[10];
+    UINTN count = 0;
+
+    do {
+        digits[count++] = (CHAR16)(L'0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (width > count) {
+        put_char(L' ');
+        width--;
+    }
+    while (count > 0) {
+        put_char(digits[--count]);
+    }
+}
+
+// Decidegrees as "ddd.d", right-aligned in TEMP_WIDTH
+static void put_temp(INT16 temp) {
+    UINT32 value = temp < 0 ? (UINT32)-temp : (UINT32)temp;
+    UINT32 whole;
+    UINTN width;
+
+    if (value > 9999) {
+        value = 9999;
+    }
+    whole = value / 10;
+    width = (temp < 0 ? 1 : 0) + (whole >= 100 ? 3 : whole >= 10 ? 2 : 1) + 2;
+
+    while (width < TEMP_WIDTH) {
+        put_char(L' ');
+        width++;
+    }
+    if (temp < 0) {
+        put_char(L'-');
+    }
+    put_uint(whole, 0);
+    put_char(L'.');
+    put_char((CHAR16)(L'0' + value % 10));
+}
+
+static void pad_to(UINTN column) {
+    while (line_len < column) {
+        put_char(L' ');
+    }
+}
+
+// Terminate the line and write it in one call
+static void line_send(void) {
+    line[line_len++] = L'\r';
+    line[line_len++] = L'\n';
+    line[line_len] = L'\0';
+    gST->ConOut->OutputString(gST->ConOut, line);
+    line_len = 0;
+}
+
+static CHAR16 mode_char(const FAN_INFO *fan) {
+    switch (fan->mode) {
+        case FAN_MODE_MANUAL:
+            return L'M';
+        case FAN_MODE_SENSOR_BASED:
+            return L'S';
+        default:
+            return L'A';
+    }
+}
+
+static void put_sensor(const TEMP_SENSOR *sensor) {
+    put_char(L' ');
+    put_ascii(sensor->key);
+    put_char(L'=');
+    if (sensor->valid) {
+        put_temp(sensor->temperature);
+    } else {
+        pad_to(line_len + TEMP_WIDTH - 3);
+        put_ascii("---");
+    }
+}
+
+/**
+ * Write the column header
+ */
+void status_line_header(UINT8 fan_count) {
+    UINT8 i;
+
+    line_len = 0;
+    put_ascii("#  time_ms");
+    for (i = 0; i < fan_count; i++) {
+        UINTN start = line_len;
+
+        put_ascii(" F");
+        put_uint(i, 0);
+        put_ascii(" rpm/tgt");
+        pad_to(start + FAN_WIDTH);
+    }
+    put_ascii(" key=degC...");
+    line_send();
+}
+
+/**
+ * Write one status line
+ */
+void status_line_emit(const FAN_INFO fans[], UINT8 fan_count,
+                      const TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    UINT16 slots[STATUS_LINE_SENSORS];
+    UINT16 shown;
+    UINT16 fallback = 0;
+    UINT16 i;
+
+    line_len = 0;
+    put_uint((UINT32)(timer_now_us() / 1000), TIME_WIDTH);
+
+    for (i = 0; i < fan_count; i++) {
+        const FAN_INFO *fan = &fans[i];
+
+        put_char(L' ');
+        put_char(mode_char(fan));
+        put_char(L' ');
+        put_uint(fan->current_rpm, RPM_WIDTH);
+        put_char(L'/');
+        put_uint(fan->mode == FAN_MODE_AUTO ? 0 : fan->target_rpm, RPM_WIDTH);
+    }
+
+    // Sensors driving fan curves, otherwise a fixed set so the columns stay put
+    shown = fan_curve_sensors(fans, fan_count, sensor_count, slots, STATUS_LINE_SENSORS);
+    for (i = 0; i < shown; i++) {
+        put_sensor(&sensors[slots[i]]);
+    }
+    for (i = 0; shown == 0 && i < sensor_count && fallback < STATUS_LINE_SENSORS; i++) {
+        if (sensors[i].valid) {
+            put_sensor(&sensors[i]);
+            fallback++;
+        }
+    }
+
+    line_send();
+}
+
+/**
+ * Write a status message once
+ */
+void status_line_note(const CHAR16 *message) {
+    UINTN i = 0;
+
+    while (message[i] != L'\0' && message[i] == last_note[i]) {
+        i++;
+    }
+    if (message[i] == last_note[i]) {
+        return;
+    }
+
+    line_len = 0;
+    put_ascii("# ");
+    for (i = 0; message[i] != L'\0' && i + 1 < sizeof(last_note) / sizeof(last_note[0]); i++) {
+        last_note[i] = message[i];
+        put_char(message[i]);
+    }
+    last_note[i] = L'\0';
+    line_send();
+}
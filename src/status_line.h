@@ -0,0 +1,51 @@
+#ifndef STATUS_LINE_H
+#define STATUS_LINE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Headless status stream (--headless[=<n>])
+ *
+ * Instead of redrawing the menu, the main loop writes one line every n
+ * status ticks, with fixed-width fields so logs line up and parse by column:
+ *
+ *     48120 M  2004/ 2000 A  1210/    0 TC0P= 61.2
+ *
+ * time in ms, then mode (A/M/S), measured and commanded RPM per fan (target
+ * 0 in automatic mode), then key=temperature for up to STATUS_LINE_SENSORS
+ * sensors bound to fan curves, or the first valid sensors if none are.
+ * Each line is encoded into a static buffer and written with a single
+ * OutputString call; status messages go out as "# ..." lines when they change.
+ */
+
+// Status tick, and the default ticks per line (one line a second)
+#define STATUS_LINE_TICK_MS     100
+#define STATUS_LINE_DECIMATION  10
+
+// Sensors shown per line
+#define STATUS_LINE_SENSORS     4
+
+// Longest line in characters (MAX_FANS fans plus the sensors)
+#define STATUS_LINE_MAX         640
+
+// Write the "# ..." line naming the columns
+void status_line_header(UINT8 fan_count);
+
+// Write one status line from the menu's fan and sensor tables
+void status_line_emit(const FAN_INFO fans[], UINT8 fan_count,
+                      const TEMP_SENSOR sensors[], UINT16 sensor_count);
+
+// Write a status message as a "# ..." line if it differs from the last one written
+void status_line_note(const CHAR16 *message);
+
+#endif // STATUS_LINE_H
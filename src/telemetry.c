@@ -0,0 +1,177 @@
+#include "telemetry.h"
+#include "telemetry_table.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+#endif
+
+// Reader attempts before giving up on a frame (writer publishes at most every few ms)
+#define TELEMETRY_READ_RETRIES 4
+
+static TELEMETRY_FRAME working;
+static TELEMETRY_FRAME buffers[2];
+static volatile UINT32 published_index = 0;
+static UINT32 frame_counter = 0;
+
+/**
+ * Copy a frame's payload (everything but the sequence number)
+ * Only the fan and sensor entries in use are copied.
+ */
+static void copy_frame(TELEMETRY_FRAME *dst, const TELEMETRY_FRAME *src) {
+    UINT8 fans = src->fan_count;
+    UINT16 sensors = src->sensor_count;
+
+    if (fans > MAX_FANS) {
+        fans = MAX_FANS;
+    }
+    if (sensors > MAX_TEMP_SENSORS) {
+        sensors = MAX_TEMP_SENSORS;
+    }
+
+    dst->timestamp_us = src->timestamp_us;
+    dst->targets_valid = src->targets_valid;
+    dst->fan_count = fans;
+    dst->sensor_count = sensors;
+    CopyMem(dst->fan_rpm, (void *)src->fan_rpm, fans * sizeof(UINT16));
+    CopyMem(dst->fan_target, (void *)src->fan_target, fans * sizeof(UINT16));
+    CopyMem(dst->temperature, (void *)src->temperature, sensors * sizeof(INT16));
+    CopyMem(dst->sensor_valid, (void *)src->sensor_valid, sensors * sizeof(BOOLEAN));
+}
+
+/**
+ * Reset buffers before a writer starts
+ */
+void telemetry_reset(UINT8 fan_count, UINT16 sensor_count, BOOLEAN targets_valid) {
+    ZeroMem(&working, sizeof(working));
+    working.fan_count = fan_count;
+    working.sensor_count = sensor_count;
+    working.targets_valid = targets_valid;
+
+    buffers[0].sequence = 0;
+    buffers[1].sequence = 0;
+    published_index = 0;
+    frame_counter = 0;
+    memory_fence();
+}
+
+/**
+ * The writer's working frame
+ */
+TELEMETRY_FRAME *telemetry_working_frame(void) {
+    return &working;
+}
+
+/**
+ * Publish the working frame
+ * Fill the back buffer, stamp it, then flip the published index
+ */
+void telemetry_publish(void) {
+    UINT32 back = published_index ^ 1;
+    TELEMETRY_FRAME *dst = &buffers[back];
+
+    // Mark the buffer as in progress for readers still copying it
+    dst->sequence = 0;
+    memory_fence();
+
+    working.timestamp_us = timer_now_us();
+    copy_frame(dst, &working);
+
+    if (++frame_counter == 0) {
+        frame_counter = 1;
+    }
+    memory_fence();
+    dst->sequence = frame_counter;
+
+    memory_fence();
+    published_index = back;
+
+    telemetry_table_update(&working);
+}
+
+/**
+ * Reset and publish a frame taken from fan and sensor tables
+ */
+void telemetry_capture(const FAN_INFO fans[], UINT8 fan_count,
+                       const TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    UINT16 i;
+
+    telemetry_reset(fan_count, sensor_count, FALSE);
+    for (i = 0; i < fan_count; i++) {
+        working.fan_rpm[i] = fans[i].current_rpm;
+        working.fan_target[i] = fans[i].target_rpm;
+    }
+    for (i = 0; i < sensor_count; i++) {
+        working.temperature[i] = sensors[i].temperature;
+        working.sensor_valid[i] = sensors[i].valid;
+    }
+    telemetry_publish();
+}
+
+/**
+ * Copy the latest complete frame
+ */
+BOOLEAN telemetry_read(TELEMETRY_FRAME *frame) {
+    UINT32 attempt;
+
+    if (!frame) {
+        return FALSE;
+    }
+
+    for (attempt = 0; attempt < TELEMETRY_READ_RETRIES; attempt++) {
+        const TELEMETRY_FRAME *src = &buffers[published_index];
+        UINT32 sequence;
+
+        memory_fence();
+        sequence = *(volatile UINT32 *)&src->sequence;
+        if (sequence == 0) {
+            if (frame_counter == 0) {
+                return FALSE;  // Nothing published yet
+            }
+            continue;          // Writer is refilling this buffer
+        }
+
+        memory_fence();
+        copy_frame(frame, src);
+        memory_fence();
+
+        if (*(volatile UINT32 *)&src->sequence == sequence) {
+            frame->sequence = sequence;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * Copy frame values into fan and sensor tables
+ * Targets are taken only for sensor-based fans and only when the writer runs
+ * the curves; manual targets always belong to the caller.
+ */
+void telemetry_apply(const TELEMETRY_FRAME *frame, FAN_INFO fans[], UINT8 fan_count,
+                     TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    UINT16 i;
+
+    if (!frame) {
+        return;
+    }
+    if (fan_count > frame->fan_count) {
+        fan_count = frame->fan_count;
+    }
+    if (sensor_count > frame->sensor_count) {
+        sensor_count = frame->sensor_count;
+    }
+
+    for (i = 0; i < fan_count; i++) {
+        fans[i].current_rpm = frame->fan_rpm[i];
+        if (frame->targets_valid && fans[i].mode == FAN_MODE_SENSOR_BASED) {
+            fans[i].target_rpm = frame->fan_target[i];
+        }
+    }
+
+    for (i = 0; i < sensor_count; i++) {
+        sensors[i].temperature = frame->temperature[i];
+        sensors[i].valid = frame->sensor_valid[i];
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+
+/**
+ * Telemetry snapshot
+ *
+ * The sampler (timer callbacks on the BSP, or the control loop on an AP)
+ * updates a private working frame, then publishes it: the frame is copied
+ * into the back buffer of a pair and the published index flips in one
+ * store. Readers copy the front buffer and check its sequence number
+ * afterwards, retrying if the writer reused the buffer meanwhile. Neither
+ * side locks or raises the TPL, and the writer never waits for a reader.
+ *
+ * There is one writer context at a time and readers run on the BSP.
+ */
+
+typedef struct {
+    UINT32 sequence;                          // Frame number, 0 while being written
+    UINT64 timestamp_us;                      // timer_now_us() at publish
+    BOOLEAN targets_valid;                    // Writer runs the fan curves (targets are its own)
+    UINT8 fan_count;
+    UINT16 sensor_count;
+    UINT16 fan_rpm[MAX_FANS];                 // Measured RPM
+    UINT16 fan_target[MAX_FANS];              // Commanded RPM (see targets_valid)
+    INT16 temperature[MAX_TEMP_SENSORS];      // Decidegrees C
+    BOOLEAN sensor_valid[MAX_TEMP_SENSORS];
+} TELEMETRY_FRAME;
+
+/**
+ * Writer side
+ */
+
+// Reset both buffers and the working frame (before the writer starts)
+void telemetry_reset(UINT8 fan_count, UINT16 sensor_count, BOOLEAN targets_valid);
+
+// The writer's working frame; update fields in place between publishes
+TELEMETRY_FRAME *telemetry_working_frame(void);
+
+// Publish the working frame (also rewrites the telemetry configuration table)
+void telemetry_publish(void);
+
+// Reset and publish a frame taken from fan and sensor tables (no background writer)
+void telemetry_capture(const FAN_INFO fans[], UINT8 fan_count,
+                       const TEMP_SENSOR sensors[], UINT16 sensor_count);
+
+/**
+ * Reader side
+ */
+
+// Copy the latest complete frame; FALSE if nothing published yet or the writer kept lapping
+BOOLEAN telemetry_read(TELEMETRY_FRAME *frame);
+
+// Copy measured values (and curve targets when the writer owns them) into fan/sensor tables
+void telemetry_apply(const TELEMETRY_FRAME *frame, FAN_INFO fans[], UINT8 fan_count,
+                     TEMP_SENSOR sensors[], UINT16 sensor_count);
+
+#endif // TELEMETRY_H
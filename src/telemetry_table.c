@@ -0,0 +1,161 @@
+#include "telemetry_table.h"
+#include "utils.h"
+
+#ifndef _GNU_EFI
+  #include <Library/BaseMemoryLib.h>
+#endif
+
+#define TABLE_PAGES         ((sizeof(TELEMETRY_TABLE) + 4095) / 4096)
+
+// No bound sensor
+#define NO_SENSOR           0xFFFF
+
+// Fan settings owned by the UI, merged into every update
+typedef struct {
+    UINT8 index;
+    UINT8 mode;
+    UINT16 target_rpm;
+    UINT16 min_rpm;
+    UINT16 max_rpm;
+    UINT16 sensor_slot;       // Index into the frame's sensors, NO_SENSOR if none
+    UINT32 sensor_key;
+} FAN_BINDING;
+
+static EFI_GUID table_guid = TELEMETRY_TABLE_GUID;
+static TELEMETRY_TABLE *table = NULL;
+
+static FAN_BINDING bindings[MAX_FANS];
+static UINT8 binding_count = 0;
+static BOOLEAN binding_ap = FALSE;
+
+/**
+ * Allocate the block and register it
+ */
+EFI_STATUS telemetry_table_install(void) {
+    EFI_PHYSICAL_ADDRESS address = 0;
+    EFI_STATUS status;
+
+    if (table) {
+        return EFI_SUCCESS;
+    }
+
+    status = gBS->AllocatePages(AllocateAnyPages, EfiReservedMemoryType, TABLE_PAGES, &address);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
+    table = (TELEMETRY_TABLE *)(UINTN)address;
+
+    ZeroMem(table, sizeof(TELEMETRY_TABLE));
+    table->signature = TELEMETRY_TABLE_SIGNATURE;
+    table->revision = TELEMETRY_TABLE_REVISION;
+    table->fan_entry_size = sizeof(TELEMETRY_TABLE_FAN);
+    table->table_size = (UINT32)(sizeof(TELEMETRY_TABLE) - sizeof(table->fans));
+    table->tsc_per_us = timer_ticks_per_us();
+    table->timestamp_us = timer_now_us();
+
+    status = gBS->InstallConfigurationTable(&table_guid, table);
+    if (EFI_ERROR(status)) {
+        gBS->FreePages(address, TABLE_PAGES);
+        table = NULL;
+    }
+    return status;
+}
+
+/**
+ * Unregister and free the block
+ * Writers must have stopped (the AP loop, async refresh)
+ */
+void telemetry_table_uninstall(void) {
+    if (!table) {
+        return;
+    }
+
+    gBS->InstallConfigurationTable(&table_guid, NULL);
+    gBS->FreePages((EFI_PHYSICAL_ADDRESS)(UINTN)table, TABLE_PAGES);
+    table = NULL;
+}
+
+/**
+ * Take fan settings from the UI's tables
+ * Entries are single aligned stores, so a writer on an AP may briefly mix
+ * old and new settings of different fans but never tears one value.
+ */
+void telemetry_table_bind(const FAN_INFO fans[], UINT8 fan_count,
+                          const TEMP_SENSOR sensors[], UINT16 sensor_count, BOOLEAN ap_mode) {
+    UINT8 i;
+
+    if (fan_count > MAX_FANS) {
+        fan_count = MAX_FANS;
+    }
+
+    for (i = 0; i < fan_count; i++) {
+        FAN_BINDING *binding = &bindings[i];
+        BOOLEAN bound = fans[i].mode == FAN_MODE_SENSOR_BASED &&
+                        fans[i].sensor_index < sensor_count;
+
+        binding->index = fans[i].index;
+        binding->mode = (UINT8)fans[i].mode;
+        binding->target_rpm = fans[i].target_rpm;
+        binding->min_rpm = fans[i].min_rpm;
+        binding->max_rpm = fans[i].max_rpm;
+        binding->sensor_slot = bound ? fans[i].sensor_index : NO_SENSOR;
+        binding->sensor_key = bound ? sensors[fans[i].sensor_index].smc_key : 0;
+    }
+
+    binding_count = fan_count;
+    binding_ap = ap_mode;
+    memory_fence();
+}
+
+/**
+ * Rewrite the block from a published frame
+ * Runs in the telemetry writer's context, which may be an AP
+ */
+void telemetry_table_update(const TELEMETRY_FRAME *frame) {
+    UINT8 fan_count;
+    UINT8 i;
+
+    if (!table || !frame) {
+        return;
+    }
+
+    fan_count = binding_count;
+    if (fan_count > frame->fan_count) {
+        fan_count = frame->fan_count;
+    }
+
+    table->sequence++;          // Odd: update in progress
+    memory_fence();
+
+    for (i = 0; i < fan_count; i++) {
+        const FAN_BINDING *binding = &bindings[i];
+        TELEMETRY_TABLE_FAN *entry = &table->fans[i];
+        UINT16 slot = binding->sensor_slot;
+
+        entry->index = binding->index;
+        entry->mode = binding->mode;
+        entry->rpm = frame->fan_rpm[i];
+        entry->target_rpm = (frame->targets_valid && binding->mode == FAN_MODE_SENSOR_BASED)
+                                ? frame->fan_target[i] : binding->target_rpm;
+        entry->min_rpm = binding->min_rpm;
+        entry->max_rpm = binding->max_rpm;
+        entry->sensor_key = binding->sensor_key;
+        entry->flags = 0;
+        entry->sensor_temperature = 0;
+        if (slot != NO_SENSOR && slot < frame->sensor_count) {
+            entry->sensor_temperature = frame->temperature[slot];
+            if (frame->sensor_valid[slot]) {
+                entry->flags |= TELEMETRY_FAN_SENSOR_VALID;
+            }
+        }
+    }
+
+    table->fan_count = fan_count;
+    table->flags = binding_ap ? TELEMETRY_TABLE_FLAG_AP : 0;
+    table->table_size = (UINT32)(sizeof(TELEMETRY_TABLE) - sizeof(table->fans) +
+                                 fan_count * sizeof(TELEMETRY_TABLE_FAN));
+    table->timestamp_us = frame->timestamp_us;
+
+    memory_fence();
+    table->sequence++;          // Even: stable
+}
@@ -0,0 +1,94 @@
+#ifndef TELEMETRY_TABLE_H
+#define TELEMETRY_TABLE_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+#include "fan_control.h"
+#include "temp_sensors.h"
+#include "telemetry.h"
+
+/**
+ * Telemetry configuration table
+ *
+ * A fixed-layout copy of the live fan state in one page of
+ * EfiReservedMemoryType, registered with InstallConfigurationTable() under
+ * TELEMETRY_TABLE_GUID. Other pre-boot tools and the OS loader find it in
+ * the system table's configuration table array and read it without any
+ * SMC traffic; the memory stays reserved for the OS, which sees the last
+ * snapshot taken before ExitBootServices.
+ *
+ * The block is rewritten in place by telemetry_publish(), so it tracks
+ * whichever writer runs (AP control loop, async refresh, or the blocking
+ * refresh). Fan modes, limits and sensor bindings come from the UI's fan
+ * table via telemetry_table_bind().
+ *
+ * Readers: copy the block while `sequence` is even and unchanged before
+ * and after the copy (odd means an update is in progress). Timestamps are
+ * TSC / tsc_per_us, so a reader on the same machine gets the age of the
+ * data from its own RDTSC.
+ */
+
+// {6F2B8D14-3C57-4A9E-B0D2-81E4C7A95F36}
+#define TELEMETRY_TABLE_GUID \
+    { 0x6f2b8d14, 0x3c57, 0x4a9e, { 0xb0, 0xd2, 0x81, 0xe4, 0xc7, 0xa9, 0x5f, 0x36 } }
+
+#define TELEMETRY_TABLE_SIGNATURE   SMC_KEY_CONST('S', 'M', 'C', 'T')
+#define TELEMETRY_TABLE_REVISION    1
+
+// Header flags
+#define TELEMETRY_TABLE_FLAG_AP     0x01    // Values come from the control loop on an AP
+
+// Fan entry flags
+#define TELEMETRY_FAN_SENSOR_VALID  0x01    // sensor_temperature is a current reading
+
+// Per-fan entry (naturally aligned, little-endian)
+typedef struct {
+    UINT8 index;                  // SMC fan index (F<n>xx)
+    UINT8 mode;                   // FAN_MODE
+    UINT16 rpm;                   // Measured RPM
+    UINT16 target_rpm;            // Commanded RPM (manual / sensor-based)
+    UINT16 min_rpm;
+    UINT16 max_rpm;
+    UINT8 flags;                  // TELEMETRY_FAN_*
+    UINT8 reserved;
+    UINT32 sensor_key;            // SMC key of the bound sensor, 0 if none
+    INT16 sensor_temperature;     // Bound sensor, decidegrees C
+    INT16 reserved2;
+} TELEMETRY_TABLE_FAN;
+
+typedef struct {
+    UINT32 signature;             // TELEMETRY_TABLE_SIGNATURE
+    UINT16 revision;              // TELEMETRY_TABLE_REVISION
+    UINT16 fan_entry_size;        // sizeof(TELEMETRY_TABLE_FAN)
+    UINT32 table_size;            // Bytes in use, header included
+    volatile UINT32 sequence;     // Even when stable, odd while being updated
+    UINT64 tsc_per_us;            // Time base of the timestamps
+    UINT64 timestamp_us;          // Last update
+    UINT8 fan_count;
+    UINT8 flags;                  // TELEMETRY_TABLE_FLAG_*
+    UINT16 reserved;
+    UINT32 reserved2;
+    TELEMETRY_TABLE_FAN fans[MAX_FANS];
+} TELEMETRY_TABLE;
+
+// Allocate the block and register it (no-op if already installed)
+EFI_STATUS telemetry_table_install(void);
+
+// Unregister and free the block (only once every writer has stopped)
+void telemetry_table_uninstall(void);
+
+// Take fan modes, targets, limits and bound sensors from the UI's tables (BSP only)
+void telemetry_table_bind(const FAN_INFO fans[], UINT8 fan_count,
+                          const TEMP_SENSOR sensors[], UINT16 sensor_count, BOOLEAN ap_mode);
+
+// Rewrite the measured values from a published frame (writer context, no Boot Services)
+void telemetry_table_update(const TELEMETRY_FRAME *frame);
+
+#endif // TELEMETRY_TABLE_H
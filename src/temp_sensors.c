@@ -1,6 +1,11 @@
 #include "temp_sensors.h"
 #include "smc_protocol.h"
+#include "smc_codec.h"
 #include "utils.h"
+#include "sensor_hash.h"
+
+// Number of sensors decoded per batch during refresh
+#define REFRESH_BATCH_SIZE 32
 
 // Known temperature sensor keys and their descriptions
 // Based on comprehensive Intel/T2 SMC sensor database (2006-2020 Intel Macs, 2018-2019 T2 Macs)
@@ -293,6 +298,28 @@ static const struct {
     {NULL, NULL}  // Terminator
 };
 
+// sensor_hash.h is generated from the table above; regenerate it with
+// tools/gen_sensor_hash.py (the Makefile does this automatically)
+_Static_assert(sizeof(sensor_map) / sizeof(sensor_map[0]) - 1 == SENSOR_HASH_ENTRIES,
+               "sensor_hash.h is stale - rerun tools/gen_sensor_hash.py");
+
+/**
+ * Find a key in sensor_map using the generated perfect hash
+ * Returns the sensor_map index, or -1 if the key is not known
+ */
+static INTN sensor_map_lookup(SMC_KEY key) {
+    UINT32 bucket = SMC_KEY_HASH(key, SENSOR_HASH_BUCKET_BITS);
+    UINT32 slot = ((UINT32)(key ^ sensor_hash_disp[bucket]) * SENSOR_HASH_SLOT_MULT) >>
+                  (32 - SENSOR_HASH_SLOT_BITS);
+
+    if (sensor_hash_slots[slot].index == SENSOR_HASH_EMPTY ||
+        sensor_hash_slots[slot].key != key) {
+        return -1;
+    }
+
+    return sensor_hash_slots[slot].index;
+}
+
 /**
  * Initialize temperature sensor system
  */
@@ -304,102 +331,129 @@ EFI_STATUS temp_init(void) {
 /**
  * Get human-readable description for a sensor key
  */
-void temp_get_description(const CHAR8 key[4], CHAR16 *description, UINTN desc_size) {
-    UINTN i;
+void temp_get_description(SMC_KEY key, CHAR16 *description, UINTN desc_size) {
+    INTN i;
+    CHAR8 key_str[5];
 
-    if (!key || !description || desc_size == 0) {
+    if (!description || desc_size == 0) {
         return;
     }
 
-    // Search for matching key in sensor map
-    for (i = 0; sensor_map[i].key != NULL; i++) {
-        if (key[0] == sensor_map[i].key[0] &&
-            key[1] == sensor_map[i].key[1] &&
-            key[2] == sensor_map[i].key[2] &&
-            key[3] == sensor_map[i].key[3]) {
-            // Found match - copy description
-            UINTN j;
-            const CHAR16 *src = sensor_map[i].description;
-            for (j = 0; j < desc_size - 1 && src[j] != L'\0'; j++) {
-                description[j] = src[j];
-            }
-            description[j] = L'\0';
-            return;
+    // Look up key in sensor map
+    i = sensor_map_lookup(key);
+    if (i >= 0) {
+        // Found match - copy description
+        UINTN j;
+        const CHAR16 *src = sensor_map[i].description;
+        for (j = 0; j < desc_size - 1 && src[j] != L'\0'; j++) {
+            description[j] = src[j];
         }
+        description[j] = L'\0';
+        return;
     }
 
     // No match found - just copy the key
-    ascii_to_wide(key, description, desc_size);
+    smc_key_to_chars(key, key_str);
+    ascii_to_wide(key_str, description, desc_size);
 }
 
 /**
  * Read temperature from a specific SMC key
  * Temperature is returned in decidegrees Celsius (0.1°C units)
  * For example: 450 = 45.0°C
+ * The key's own type is used when the SMC reports it (sp78 otherwise)
  */
-EFI_STATUS temp_read_sensor(const CHAR8 key[4], INT16 *temp) {
-    UINT8 data[32];
-    UINT8 data_len = 0;
+EFI_STATUS temp_read_sensor(SMC_KEY key, INT16 *temp) {
+    SMC_FIXED value;
     EFI_STATUS status;
 
-    if (!key || !temp) {
+    if (!temp) {
         return EFI_INVALID_PARAMETER;
     }
 
-    // Read SMC key
-    status = smc_read_key(key, data, &data_len);
+    status = smc_codec_read(key, SMC_TYPE_SP78, &value);
     if (EFI_ERROR(status)) {
         return status;
     }
 
-    // Verify we got 2 bytes (sp78 format)
-    if (data_len < 2) {
-        return EFI_DEVICE_ERROR;
+    // Millidegrees to decidegrees
+    *temp = (INT16)(value / 100);
+
+    return EFI_SUCCESS;
+}
+
+/**
+ * Decode temperature bytes read from a sensor key
+ * For completion callbacks of async reads; uses the cached key type
+ */
+EFI_STATUS temp_decode_sensor(SMC_KEY key, const UINT8 *data, UINT8 data_len, INT16 *temp) {
+    SMC_FIXED value;
+    EFI_STATUS status;
+
+    if (!temp) {
+        return EFI_INVALID_PARAMETER;
     }
 
-    // Decode sp78 format (signed fixed-point, 7.8 bits)
-    // Formula: temp_celsius = value / 256.0
-    // We want decidegrees, so: temp_decidegrees = (value * 10) / 256
-    INT16 value = (INT16)((data[0] << 8) | data[1]);
+    status = smc_codec_decode_key(key, SMC_TYPE_SP78, data, data_len, &value);
+    if (EFI_ERROR(status)) {
+        return status;
+    }
 
-    // Convert to decidegrees Celsius
-    // value / 256.0 * 10 = value * 10 / 256
-    *temp = (value * 10) / 256;
+    *temp = (INT16)(value / 100);
 
     return EFI_SUCCESS;
 }
 
 /**
- * Discover all available temperature sensors
- * Tries common sensor keys and returns those that respond
+ * Start an incremental sensor discovery
  */
-EFI_STATUS temp_discover_sensors(TEMP_SENSOR sensors[], UINT8 *count) {
-    UINT8 sensor_count = 0;
-    UINTN i;
+void temp_discover_begin(TEMP_DISCOVERY *discovery) {
+    discovery->next = 0;
+    discovery->done = FALSE;
+}
 
-    if (!sensors || !count) {
-        return EFI_INVALID_PARAMETER;
-    }
+/**
+ * Probe known sensor keys for up to budget_us (at least one key per call)
+ * Sensors that respond are appended to sensors[]; returns TRUE once every
+ * key has been tried. An absent key is only reported once the SMC has
+ * waited out the status timeout, so each probe's waits are cut off at the
+ * end of the budget (see smc_set_wait_deadline).
+ */
+BOOLEAN temp_discover_step(TEMP_DISCOVERY *discovery, TEMP_SENSOR sensors[], UINT16 *count,
+                           UINT32 budget_us) {
+    UINT64 start = timer_now_us();
+    UINT64 now, left;
+    UINT16 sensor_count = *count;
+    UINTN i;
 
-    // Try all known sensor keys
-    for (i = 0; sensor_map[i].key != NULL && sensor_count < MAX_TEMP_SENSORS; i++) {
+    for (i = discovery->next; sensor_map[i].key != NULL && sensor_count < MAX_TEMP_SENSORS; i++) {
+        SMC_KEY key;
         INT16 temp;
         EFI_STATUS status;
 
-        // Try to read this sensor
-        status = temp_read_sensor((const CHAR8 *)sensor_map[i].key, &temp);
+        now = timer_now_us();
+        if (i > discovery->next && now - start >= budget_us) {
+            break;
+        }
+
+        // Try to read this sensor, waiting no longer than the budget has left
+        left = (now - start < budget_us) ? budget_us - (now - start) : 0;
+        if (left < TEMP_PROBE_MIN_WAIT_US) {
+            left = TEMP_PROBE_MIN_WAIT_US;
+        }
+        smc_set_wait_deadline(now + left);
+        key = smc_key_from_chars(sensor_map[i].key);
+        status = temp_read_sensor(key, &temp);
+        smc_set_wait_deadline(0);
         if (!EFI_ERROR(status)) {
             // Sensor exists and returned valid data
             // Check if temperature is reasonable (not -128°C which indicates error)
             if (temp > -1000) {  // -100°C in decidegrees
                 sensors[sensor_count].index = sensor_count;
 
-                // Copy key
-                UINTN j;
-                for (j = 0; j < 4; j++) {
-                    sensors[sensor_count].key[j] = sensor_map[i].key[j];
-                }
-                sensors[sensor_count].key[4] = '\0';
+                // Store key
+                sensors[sensor_count].smc_key = key;
+                smc_key_to_chars(key, sensors[sensor_count].key);
 
                 // Copy description
                 UINTN desc_len = 0;
@@ -418,32 +472,67 @@ EFI_STATUS temp_discover_sensors(TEMP_SENSOR sensors[], UINT8 *count) {
         }
     }
 
+    discovery->next = i;
+    discovery->done = (sensor_map[i].key == NULL || sensor_count >= MAX_TEMP_SENSORS);
     *count = sensor_count;
 
-    return (sensor_count > 0) ? EFI_SUCCESS : EFI_NOT_FOUND;
+    return discovery->done;
+}
+
+/**
+ * Discover all available temperature sensors
+ * Tries common sensor keys and returns those that respond
+ */
+EFI_STATUS temp_discover_sensors(TEMP_SENSOR sensors[], UINT16 *count) {
+    TEMP_DISCOVERY discovery;
+
+    if (!sensors || !count) {
+        return EFI_INVALID_PARAMETER;
+    }
+
+    *count = 0;
+    temp_discover_begin(&discovery);
+    while (!temp_discover_step(&discovery, sensors, count, 0xFFFFFFFF)) {
+        // No time limit: each call runs to the end of the key list
+    }
+
+    return (*count > 0) ? EFI_SUCCESS : EFI_NOT_FOUND;
 }
 
 /**
  * Update temperatures for existing sensor list
  * Faster than rediscovering - just reads known sensors
  */
-EFI_STATUS temp_refresh_sensors(TEMP_SENSOR sensors[], UINT8 count) {
-    UINT8 i;
+EFI_STATUS temp_refresh_sensors(TEMP_SENSOR sensors[], UINT16 count) {
+    SMC_KEY keys[REFRESH_BATCH_SIZE];
+    SMC_FIXED values[REFRESH_BATCH_SIZE];
+    EFI_STATUS results[REFRESH_BATCH_SIZE];
+    UINT16 base;
+    UINT16 i;
 
     if (!sensors) {
         return EFI_INVALID_PARAMETER;
     }
 
-    for (i = 0; i < count; i++) {
-        INT16 temp;
-        EFI_STATUS status;
+    for (base = 0; base < count; base += REFRESH_BATCH_SIZE) {
+        UINT16 batch = count - base;
+        if (batch > REFRESH_BATCH_SIZE) {
+            batch = REFRESH_BATCH_SIZE;
+        }
 
-        status = temp_read_sensor(sensors[i].key, &temp);
-        if (!EFI_ERROR(status)) {
-            sensors[i].temperature = temp;
-            sensors[i].valid = TRUE;
-        } else {
-            sensors[i].valid = FALSE;
+        for (i = 0; i < batch; i++) {
+            keys[i] = sensors[base + i].smc_key;
+        }
+
+        smc_codec_read_batch(keys, batch, SMC_TYPE_SP78, values, results);
+
+        for (i = 0; i < batch; i++) {
+            if (!EFI_ERROR(results[i])) {
+                sensors[base + i].temperature = (INT16)(values[i] / 100);
+                sensors[base + i].valid = TRUE;
+            } else {
+                sensors[base + i].valid = FALSE;
+            }
         }
     }
 
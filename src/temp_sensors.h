@@ -10,19 +10,31 @@
   #include <Library/UefiLib.h>
   #include <Library/PrintLib.h>
 #endif
+#include "smc_protocol.h"
 
 // Maximum number of temperature sensors
-#define MAX_TEMP_SENSORS 200
+#define MAX_TEMP_SENSORS 1024
 
 // Temperature sensor information structure
 typedef struct {
-    UINT8 index;              // Sensor index
-    CHAR8 key[5];             // SMC key (4 chars + null)
+    UINT16 index;             // Sensor index
+    SMC_KEY smc_key;          // SMC key (FourCC)
+    CHAR8 key[5];             // SMC key for display (4 chars + null)
     CHAR16 label[48];         // Human-readable description
     INT16 temperature;        // Temperature in 0.1°C units (e.g., 450 = 45.0°C)
     BOOLEAN valid;            // TRUE if sensor has valid data
 } TEMP_SENSOR;
 
+// Shortest status wait a discovery probe gets, whatever is left of its budget
+// (a present key answers well within it)
+#define TEMP_PROBE_MIN_WAIT_US  1000
+
+// Incremental discovery cursor (see temp_discover_step)
+typedef struct {
+    UINTN next;               // Next known key to probe
+    BOOLEAN done;             // Every known key has been tried
+} TEMP_DISCOVERY;
+
 /**
  * Initialization
  */
@@ -35,20 +47,33 @@ EFI_STATUS temp_init(void);
  */
 
 // Read temperature from a specific SMC key
-EFI_STATUS temp_read_sensor(const CHAR8 key[4], INT16 *temp);
+EFI_STATUS temp_read_sensor(SMC_KEY key, INT16 *temp);
+
+// Decode temperature bytes read from a sensor key (uses cached key type, no SMC traffic)
+EFI_STATUS temp_decode_sensor(SMC_KEY key, const UINT8 *data, UINT8 data_len, INT16 *temp);
 
 // Discover all available temperature sensors
-EFI_STATUS temp_discover_sensors(TEMP_SENSOR sensors[], UINT8 *count);
+EFI_STATUS temp_discover_sensors(TEMP_SENSOR sensors[], UINT16 *count);
+
+// Start an incremental discovery
+void temp_discover_begin(TEMP_DISCOVERY *discovery);
+
+// Probe known keys for budget_us, appending responding sensors to sensors[]/count.
+// A probe's SMC waits end with the budget (but get at least
+// TEMP_PROBE_MIN_WAIT_US), so a slice overruns by one probe's I/O at most.
+// Returns TRUE when discovery is complete
+BOOLEAN temp_discover_step(TEMP_DISCOVERY *discovery, TEMP_SENSOR sensors[], UINT16 *count,
+                           UINT32 budget_us);
 
 // Update temperatures for existing sensor list
-EFI_STATUS temp_refresh_sensors(TEMP_SENSOR sensors[], UINT8 count);
+EFI_STATUS temp_refresh_sensors(TEMP_SENSOR sensors[], UINT16 count);
 
 /**
  * Helper functions
  */
 
 // Get human-readable description for a sensor key
-void temp_get_description(const CHAR8 key[4], CHAR16 *description, UINTN desc_size);
+void temp_get_description(SMC_KEY key, CHAR16 *description, UINTN desc_size);
 
 // Format temperature for display
 void temp_format_display(INT16 temp_decidegrees, CHAR16 *buffer, UINTN buffer_size);
@@ -0,0 +1,50 @@
+#include "ui_input.h"
+
+/**
+ * Read every pending keystroke
+ */
+UINTN ui_input_drain(EFI_INPUT_KEY keys[], UINTN max) {
+    UINTN count = 0;
+
+    while (count < max) {
+        if (EFI_ERROR(gST->ConIn->ReadKeyStroke(gST->ConIn, &keys[count]))) {
+            break;  // EFI_NOT_READY: nothing left
+        }
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Step multiplier for one press
+ * Presses taken in the same drain share a timestamp and count as repeats.
+ */
+UINT32 ui_input_repeat_scale(UI_KEY_REPEAT *repeat, CHAR16 key, UINT64 now_us) {
+    static const UINT32 runs[] = UI_INPUT_ACCEL_RUNS;
+    static const UINT32 scales[] = UI_INPUT_ACCEL_SCALES;
+    UINT32 scale = 1;
+    UINTN i;
+
+    if (key == repeat->key && now_us - repeat->last_us <= (UINT64)UI_INPUT_REPEAT_GAP_MS * 1000) {
+        repeat->run++;
+    } else {
+        repeat->key = key;
+        repeat->run = 0;
+    }
+    repeat->last_us = now_us;
+
+    for (i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        if (repeat->run >= runs[i]) {
+            scale = scales[i];
+        }
+    }
+    return scale;
+}
+
+/**
+ * Forget the repeat run
+ */
+void ui_input_repeat_reset(UI_KEY_REPEAT *repeat) {
+    repeat->key = L'\0';
+    repeat->run = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef UI_INPUT_H
+#define UI_INPUT_H
+
+// Support both gnu-efi and EDK2/TianoCore build systems
+#ifdef _GNU_EFI
+  #include <efi.h>
+  #include <efilib.h>
+#else
+  #include <Uefi.h>
+  #include <Library/UefiLib.h>
+  #include <Library/UefiBootServicesTableLib.h>
+#endif
+
+/**
+ * Menu keyboard input
+ *
+ * The menu drains every pending keystroke once per frame and folds
+ * adjustment keys into one net change, so a held key costs one SMC write
+ * per redraw rather than one per typematic repeat. Sustained repeats of
+ * the same key scale its step up; a pause or a different key resets it.
+ */
+
+// Most keystrokes taken per frame (the rest wait for the next one)
+#define UI_INPUT_MAX            32
+
+// Longest gap between two presses that still counts as a repeat (above the
+// typematic rate, and above a slow frame so a held key keeps its run)
+#define UI_INPUT_REPEAT_GAP_MS  400
+
+// Repeat run lengths at which the step grows, and the scale at each
+#define UI_INPUT_ACCEL_RUNS     { 4, 12, 24 }
+#define UI_INPUT_ACCEL_SCALES   { 2, 5, 10 }
+
+typedef struct {
+    CHAR16 key;               // Last adjustment key
+    UINT64 last_us;           // When it was seen
+    UINT32 run;               // Repeats without a pause
+} UI_KEY_REPEAT;
+
+// Read every pending keystroke into keys[]; returns how many
+UINTN ui_input_drain(EFI_INPUT_KEY keys[], UINTN max);
+
+// Step multiplier for one press of key at now_us (1 unless it is being held)
+UINT32 ui_input_repeat_scale(UI_KEY_REPEAT *repeat, CHAR16 key, UINT64 now_us);
+
+// Forget the repeat run (after any other key)
+void ui_input_repeat_reset(UI_KEY_REPEAT *repeat);
+
+#endif // UI_INPUT_H
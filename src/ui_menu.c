@@ -1,11 +1,45 @@
 #include "ui_menu.h"
 #include "fan_control.h"
 #include "temp_sensors.h"
+#include "smc_async.h"
+#include "smc_codec.h"
+#include "smc_health.h"
+#include "sensor_sched.h"
+#include "control_engine.h"
+#include "telemetry.h"
+#include "telemetry_table.h"
+#include "serial_rpc.h"
+#include "status_line.h"
+#include "ui_input.h"
+#include "dashboard.h"
+#include "fan_profile.h"
+#include "fan_store.h"
 #include "utils.h"
 
+#ifndef _GNU_EFI
+  #include <Library/MemoryAllocationLib.h>
+#endif
+
 #define RPM_STEP 100     // RPM increment/decrement step
 #define TEMP_STEP 50     // Temperature threshold increment (5.0°C in decidegrees)
 
+#define REFRESH_INTERVAL_MS 1000  // Background refresh period
+#define REFRESH_WINDOW      16    // Async reads kept in flight per refresh cycle
+
+#define DISCOVERY_SLICE_MS  10    // Sensor discovery timer period
+#define DISCOVERY_BUDGET_US 4000  // SMC time per slice, probe waits included
+#define DISCOVERY_REDRAW_MS 100   // Minimum interval between redraws as sensors turn up
+
+// Background fan refresh cycle state (sensors are handled by sensor_sched)
+// Readings go to the telemetry working frame, published when a cycle completes
+static struct {
+    FAN_INFO *fans;
+    UINT8 fan_count;
+    UINTN next;           // Next item to submit
+    UINTN outstanding;    // Reads submitted but not completed
+    BOOLEAN complete;     // Last cycle finished
+} refresh;
+
 /**
  * Clear the screen using UEFI ConOut
  */
@@ -25,7 +59,7 @@ void ui_display_header(void) {
 /**
  * Display fan information table
  */
-void ui_display_fans(FAN_INFO fans[], UINT8 count, INT8 selected_fan) {
+void ui_display_fans(FAN_INFO fans[], UINT8 count, INT16 selected_fan) {
     UINT8 i;
 
     Print(L"Detected Fans:\n");
@@ -73,7 +107,8 @@ void ui_display_fans(FAN_INFO fans[], UINT8 count, INT8 selected_fan) {
  */
 void ui_display_help(void) {
     Print(L"Commands:\n");
-    Print(L"  [0-5]  Select fan\n");
+    Print(L"  [0-9]  Select fan\n");
+    Print(L"  [n]    Select next fan\n");
     Print(L"  [a]    Set to Auto mode\n");
     Print(L"  [m]    Set to Manual mode\n");
     Print(L"  [s]    Set to Sensor-based mode\n");
@@ -81,6 +116,7 @@ void ui_display_help(void) {
     Print(L"  [-]    Decrease RPM/Temp (-%d RPM or -%.1f°C)\n", RPM_STEP, TEMP_STEP / 10.0);
     Print(L"  [<]    Lower min temp threshold\n");
     Print(L"  [>]    Raise max temp threshold\n");
+    Print(L"  [p]    Next thermal profile (all fans)\n");
     Print(L"  [t]    View temperature sensors\n");
     Print(L"  [r]    Refresh display\n");
     Print(L"  [q]    Quit\n");
@@ -95,9 +131,25 @@ void ui_display_status(const CHAR16 *message) {
 }
 
 /**
- * Refresh fan data and update sensor-based fans
+ * Apply sensor-based control using the latest temperatures
+ */
+static void update_sensor_based_fans(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    UINT8 i;
+
+    for (i = 0; i < count; i++) {
+        if (fans[i].mode == FAN_MODE_SENSOR_BASED && fans[i].sensor_based_enabled) {
+            if (fans[i].sensor_index < sensor_count) {
+                INT16 current_temp = sensors[fans[i].sensor_index].temperature;
+                fan_update_sensor_based(&fans[i], current_temp);
+            }
+        }
+    }
+}
+
+/**
+ * Refresh fan data and update sensor-based fans (blocking)
  */
-static void refresh_fan_data(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[], UINT8 sensor_count) {
+static void refresh_fan_data(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[], UINT16 sensor_count) {
     UINT8 i;
 
     // Refresh temperature sensors
@@ -105,25 +157,329 @@ static void refresh_fan_data(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[]
         temp_refresh_sensors(sensors, sensor_count);
     }
 
+    // Update current RPM
     for (i = 0; i < count; i++) {
-        // Update current RPM
         fan_read_rpm(fans[i].index, &fans[i].current_rpm);
+    }
 
-        // Update sensor-based fans
-        if (fans[i].mode == FAN_MODE_SENSOR_BASED && fans[i].sensor_based_enabled) {
-            if (fans[i].sensor_index < sensor_count) {
-                INT16 current_temp = sensors[fans[i].sensor_index].temperature;
-                fan_update_sensor_based(&fans[i], current_temp);
-            }
+    update_sensor_based_fans(fans, count, sensors, sensor_count);
+}
+
+/**
+ * Look up the key types the async completions decode with
+ * Completions only use cached types; a type whose query failed (or that was
+ * evicted) is asked for here, outside any callback. Cached types cost no
+ * SMC traffic.
+ */
+static void resolve_refresh_types(FAN_INFO fans[], UINT8 count,
+                                  TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    SMC_VALUE_TYPE type;
+    UINT16 i;
+
+    for (i = 0; i < count; i++) {
+        smc_codec_get_type(fan_smc_key(fans[i].index, FAN_KEY_ACTUAL_RPM), &type);
+    }
+    for (i = 0; i < sensor_count; i++) {
+        smc_codec_get_type(sensors[i].smc_key, &type);
+    }
+}
+
+static void refresh_refill(void);
+
+/**
+ * Async completion: fan RPM
+ */
+static void on_fan_rpm(SMC_KEY key, EFI_STATUS status, const UINT8 *data, UINT8 data_len,
+                       void *context) {
+    TELEMETRY_FRAME *frame = telemetry_working_frame();
+    UINTN slot = (UINTN)context;
+
+    if (!EFI_ERROR(status)) {
+        fan_decode_rpm(key, data, data_len, &frame->fan_rpm[slot]);
+    }
+
+    refresh.outstanding--;
+    refresh_refill();
+}
+
+/**
+ * Keep up to REFRESH_WINDOW reads of the current cycle queued
+ * Runs at TPL_CALLBACK (from completions or refresh_begin)
+ */
+static void refresh_refill(void) {
+    UINTN total = refresh.fan_count;
+
+    while (refresh.outstanding < REFRESH_WINDOW && refresh.next < total) {
+        FAN_INFO *fan = &refresh.fans[refresh.next];
+        EFI_STATUS status;
+
+        status = smc_async_submit_read(fan_smc_key(fan->index, FAN_KEY_ACTUAL_RPM),
+                                       on_fan_rpm, (void *)refresh.next, NULL);
+        if (status == SMC_STATUS_QUARANTINED) {
+            refresh.next++;  // Skip this cycle; keeps the last reading
+            continue;
+        }
+        if (EFI_ERROR(status)) {
+            break;  // Queue full; completions will refill
+        }
+
+        refresh.next++;
+        refresh.outstanding++;
+    }
+
+    if (refresh.next == total && refresh.outstanding == 0 && !refresh.complete) {
+        refresh.complete = TRUE;
+        telemetry_publish();
+    }
+}
+
+/**
+ * Start a background fan refresh cycle
+ * Returns FALSE if the previous cycle is still running
+ */
+static BOOLEAN refresh_begin(FAN_INFO fans[], UINT8 count) {
+    EFI_TPL old_tpl;
+
+    old_tpl = gBS->RaiseTPL(TPL_CALLBACK);
+
+    if (refresh.outstanding > 0 || refresh.next < refresh.fan_count) {
+        gBS->RestoreTPL(old_tpl);
+        return FALSE;
+    }
+
+    refresh.fans = fans;
+    refresh.fan_count = count;
+    refresh.next = 0;
+    refresh.complete = FALSE;
+    refresh_refill();
+
+    gBS->RestoreTPL(old_tpl);
+
+    return TRUE;
+}
+
+/**
+ * Extend the working frame with sensors found after telemetry_capture() and publish it
+ */
+static void telemetry_add_sensors(TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    TELEMETRY_FRAME *frame;
+    EFI_TPL old_tpl;
+    UINT16 i;
+
+    // The async completions write the working frame at TPL_CALLBACK
+    old_tpl = gBS->RaiseTPL(TPL_CALLBACK);
+    frame = telemetry_working_frame();
+    for (i = frame->sensor_count; i < sensor_count; i++) {
+        frame->temperature[i] = sensors[i].temperature;
+        frame->sensor_valid[i] = sensors[i].valid;
+    }
+    frame->sensor_count = sensor_count;
+    telemetry_publish();
+    gBS->RestoreTPL(old_tpl);
+}
+
+/**
+ * Pull the latest published frame into the UI's fan and sensor tables
+ */
+static void pull_telemetry(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[], UINT16 sensor_count) {
+    static TELEMETRY_FRAME frame;  // Too large for the stack
+
+    if (telemetry_read(&frame)) {
+        telemetry_apply(&frame, fans, count, sensors, sensor_count);
+    }
+}
+
+/**
+ * Apply new mode/target/curve settings to a fan
+ * With the control loop on an AP the change is posted to it (clamped as
+ * fan_apply_config() will clamp it there); otherwise the SMC is written
+ * directly.
+ */
+static EFI_STATUS apply_fan(FAN_INFO fans[], UINT8 slot, const FAN_INFO *config, BOOLEAN ap_mode) {
+    FAN_INFO next;
+    EFI_STATUS status;
+
+    if (!ap_mode) {
+        return fan_apply_config(&fans[slot], config);
+    }
+
+    next = *config;
+    next.target_rpm = fan_reachable_rpm(&fans[slot], config->target_rpm);
+    status = control_engine_set_fan(slot, &next);
+    if (!EFI_ERROR(status)) {
+        fans[slot] = next;
+    }
+    return status;
+}
+
+/**
+ * Apply a frame's +/- presses to the selected fan
+ * rpm_delta is the net RPM change with repeat acceleration (manual mode);
+ * presses is the net key count (sensor cycling in sensor mode). One
+ * apply_fan call, so at most one SMC write however many keys came in.
+ */
+static void adjust_selected_fan(FAN_INFO fans[], UINT8 count, INT16 selected_fan,
+                                TEMP_SENSOR sensors[], UINT16 sensor_count, BOOLEAN ap_mode,
+                                INT32 rpm_delta, INT32 presses,
+                                CHAR16 *status_msg, UINTN status_size) {
+    FAN_INFO next;
+    EFI_STATUS status;
+
+    if (selected_fan < 0 || selected_fan >= count) {
+        UnicodeSPrint(status_msg, status_size, L"No fan selected");
+        return;
+    }
+    next = fans[selected_fan];
+
+    if (next.mode == FAN_MODE_MANUAL) {
+        INT32 new_rpm = (INT32)next.target_rpm + rpm_delta;
+        if (new_rpm < 0) new_rpm = 0;
+        if (new_rpm > 0xFFFF) new_rpm = 0xFFFF;
+
+        next.target_rpm = fan_reachable_rpm(&next, (UINT16)new_rpm);
+
+        status = apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
+        if (!EFI_ERROR(status)) {
+            UnicodeSPrint(status_msg, status_size, L"Target RPM: %d", next.target_rpm);
+        } else {
+            UnicodeSPrint(status_msg, status_size, L"Failed to set RPM");
+        }
+    } else if (next.mode == FAN_MODE_SENSOR_BASED) {
+        // Cycle through the sensors, wrapping both ways
+        if (sensor_count > 0) {
+            INT32 index = ((INT32)next.sensor_index + presses) % (INT32)sensor_count;
+            if (index < 0) index += sensor_count;
+
+            next.sensor_index = (UINT16)index;
+            apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
+            UnicodeSPrint(status_msg, status_size, L"Sensor: %s (%s)",
+                         sensors[fans[selected_fan].sensor_index].label,
+                         sensors[fans[selected_fan].sensor_index].key);
         }
+    } else {
+        UnicodeSPrint(status_msg, status_size, L"Fan must be in MANUAL or SENSOR mode");
     }
 }
 
+/**
+ * Switch every fan to a thermal profile
+ */
+static void load_profile(UINT8 profile, FAN_INFO fans[], UINT8 count,
+                         TEMP_SENSOR sensors[], UINT16 sensor_count, BOOLEAN ap_mode,
+                         CHAR16 *status_msg, UINTN status_size) {
+    EFI_STATUS status;
+
+    status = fan_profile_load(profile, fans, count, sensors, sensor_count, apply_fan, ap_mode);
+    if (!EFI_ERROR(status)) {
+        UnicodeSPrint(status_msg, status_size, L"Profile: %a", fan_profile_name(profile));
+    } else if (status == EFI_NOT_FOUND) {
+        UnicodeSPrint(status_msg, status_size, L"Profile %a needs a temperature sensor",
+                     fan_profile_name(profile));
+    } else if (status == EFI_NOT_READY) {
+        UnicodeSPrint(status_msg, status_size, L"Control loop busy - load %a again",
+                     fan_profile_name(profile));
+    } else {
+        UnicodeSPrint(status_msg, status_size, L"Failed to load profile %a (Status: 0x%x)",
+                     fan_profile_name(profile), status);
+    }
+}
+
+/**
+ * Create a periodic timer for the main loop to wait on
+ * Returns NULL if the timer could not be set up
+ */
+static EFI_EVENT create_wait_timer(UINT32 period_ms) {
+    EFI_EVENT event = NULL;
+    EFI_STATUS status;
+
+    status = gBS->CreateEvent(EVT_TIMER, 0, NULL, NULL, &event);
+    if (EFI_ERROR(status)) {
+        return NULL;
+    }
+    status = gBS->SetTimer(event, TimerPeriodic, (UINT64)period_ms * 10000);
+    if (EFI_ERROR(status)) {
+        gBS->CloseEvent(event);
+        return NULL;
+    }
+    return event;
+}
+
+/**
+ * Start background refresh through the async engine
+ * Returns FALSE (nothing started) if the engine or the refresh timer is unavailable
+ */
+static BOOLEAN async_refresh_start(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[],
+                                   UINT16 sensor_count, EFI_EVENT *refresh_event) {
+    if (EFI_ERROR(smc_async_init(SMC_ASYNC_TICK_US, SMC_ASYNC_BUDGET_US))) {
+        return FALSE;
+    }
+
+    *refresh_event = create_wait_timer(REFRESH_INTERVAL_MS);
+    if (!*refresh_event) {
+        smc_async_shutdown();
+        return FALSE;
+    }
+
+    // Seed the frame with the values read during discovery
+    telemetry_capture(fans, count, sensors, sensor_count);
+    refresh_begin(fans, count);
+    if (sensor_count > 0) {
+        sensor_sched_init(sensors, sensor_count, SENSOR_SCHED_TICK_MS, SENSOR_SCHED_BUDGET_US);
+    }
+    return TRUE;
+}
+
+/**
+ * Sensor discovery finished: hand the complete list to the background sampler
+ * With --ap the control loop starts on an AP now; if that fails the async
+ * engine takes over instead.
+ */
+static void sensors_ready(FAN_INFO fans[], UINT8 count, TEMP_SENSOR sensors[], UINT16 sensor_count,
+                          BOOLEAN want_ap, BOOLEAN *ap_mode, BOOLEAN *async_refresh,
+                          EFI_EVENT *refresh_event, CHAR16 *status_msg, UINTN status_size) {
+    EFI_STATUS status;
+
+    if (sensor_count == 0) {
+        UnicodeSPrint(status_msg, status_size, L"Warning: No temperature sensors found");
+    } else {
+        UnicodeSPrint(status_msg, status_size, L"Ready - %d sensors available", sensor_count);
+    }
+
+    if (*async_refresh) {
+        // Already sampling fans; add the sensors
+        if (sensor_count > 0) {
+            telemetry_add_sensors(sensors, sensor_count);
+            sensor_sched_init(sensors, sensor_count, SENSOR_SCHED_TICK_MS, SENSOR_SCHED_BUDGET_US);
+        }
+        return;
+    }
+
+    if (want_ap) {
+        status = control_engine_start(fans, count, sensors, sensor_count);
+        if (!EFI_ERROR(status)) {
+            *ap_mode = TRUE;
+            *refresh_event = create_wait_timer(REFRESH_INTERVAL_MS);
+            UnicodeSPrint(status_msg, status_size,
+                         L"Ready - %d sensors available, control loop on AP", sensor_count);
+            return;
+        }
+        if (status == EFI_ACCESS_DENIED) {
+            UnicodeSPrint(status_msg, status_size,
+                         L"Resident SMC driver owns the bus - control loop on BSP");
+        } else {
+            UnicodeSPrint(status_msg, status_size,
+                         L"No AP available (Status: 0x%x) - control loop on BSP", status);
+        }
+    }
+
+    *async_refresh = async_refresh_start(fans, count, sensors, sensor_count, refresh_event);
+}
+
 /**
  * Display temperature sensors
  */
-static void display_temp_sensors(TEMP_SENSOR sensors[], UINT8 count, INT8 selected_sensor) {
-    UINT8 i;
+static void display_temp_sensors(TEMP_SENSOR sensors[], UINT16 count, INT16 selected_sensor) {
+    UINT16 i;
     CHAR16 temp_str[16];
 
     ui_clear_screen();
@@ -153,256 +509,527 @@ static void display_temp_sensors(TEMP_SENSOR sensors[], UINT8 count, INT8 select
 /**
  * Main interactive menu loop
  */
-void ui_menu_run(FAN_INFO fans[], UINT8 count) {
-    INT8 selected_fan = -1;  // -1 means no fan selected
+void ui_menu_run(FAN_INFO fans[], UINT8 count, const APP_OPTIONS *options) {
+    INT16 selected_fan = -1;  // -1 means no fan selected
     BOOLEAN running = TRUE;
-    EFI_INPUT_KEY key;
+    UI_KEY_REPEAT repeat = { 0 };
     EFI_STATUS status;
     CHAR16 status_msg[128];
 
-    // Discover temperature sensors
-    TEMP_SENSOR sensors[MAX_TEMP_SENSORS];
-    UINT8 sensor_count = 0;
+    // Sensor table (too large for the UEFI stack), filled in by background discovery
+    TEMP_SENSOR *sensors = AllocateZeroPool(MAX_TEMP_SENSORS * sizeof(TEMP_SENSOR));
+    UINT16 sensor_count = 0;
+    UINT16 drawn_sensor_count = 0;
+    UINT64 drawn_us = 0;
+    TEMP_DISCOVERY discovery;
 
-    Print(L"Discovering temperature sensors...\n");
-    status = temp_discover_sensors(sensors, &sensor_count);
-    if (EFI_ERROR(status) || sensor_count == 0) {
-        Print(L"Warning: No temperature sensors found\n");
-        sensor_count = 0;
-    } else {
-        Print(L"Found %d temperature sensors\n", sensor_count);
+    if (!sensors) {
+        Print(L"ERROR: Out of memory for sensor table\n");
+        return;
+    }
+
+    // With --ap the control loop moves to an AP once the sensor list is complete
+    // (the AP owns the SMC, so discovery has to finish on the BSP first)
+    BOOLEAN want_ap = options && options->use_ap;
+    BOOLEAN ap_mode = FALSE;
+    BOOLEAN async_refresh = FALSE;
+    EFI_EVENT refresh_event = NULL;
+
+    // Remote requests and telemetry on a serial port (--serial)
+    SERIAL_RPC_CONTEXT rpc;
+    EFI_EVENT rpc_event = NULL;
+
+    rpc.fans = fans;
+    rpc.fan_count = count;
+    rpc.sensors = sensors;
+    rpc.apply = apply_fan;
+    if (options && options->serial) {
+        status = serial_rpc_open(options->serial_port);
+        if (!EFI_ERROR(status)) {
+            rpc_event = create_wait_timer(SERIAL_RPC_POLL_MS);
+        }
+        if (!rpc_event) {
+            serial_rpc_close();
+        }
+    }
+
+    // Headless: a status line every few ticks instead of redrawing the menu
+    BOOLEAN headless = FALSE;
+    BOOLEAN status_due = FALSE;
+    UINT16 decimation = STATUS_LINE_DECIMATION;
+    UINT32 status_ticks = 0;
+    EFI_EVENT status_event = NULL;
+
+    if (options && options->headless) {
+        status_event = create_wait_timer(STATUS_LINE_TICK_MS);
+        if (status_event) {
+            headless = TRUE;
+            if (options->decimation > 0) {
+                decimation = options->decimation;
+            }
+            status_line_header(count);
+        }
+    }
+
+    // Graphics dashboard; the text menu when there is no usable GOP
+    BOOLEAN graphics = FALSE;
+    EFI_EVENT frame_event = NULL;
+
+    if (options && options->graphics && !headless && !EFI_ERROR(dashboard_open())) {
+        frame_event = create_wait_timer(DASHBOARD_FRAME_MS);
+        if (frame_event) {
+            graphics = TRUE;
+        } else {
+            dashboard_close();
+        }
     }
 
-    delay_milliseconds(1000);
+    // Thermal profile (--profile or p); curves need the full sensor list, so a
+    // profile chosen during discovery waits for it
+    UINT8 profile = FAN_PROFILE_NONE;
+    UINT8 pending_profile = options ? options->profile : FAN_PROFILE_NONE;
 
-    UnicodeSPrint(status_msg, sizeof(status_msg), L"Ready - %d sensors available", sensor_count);
+    // Last session's settings, unless this launch sets fans itself; applied
+    // before the first draw, curve fans as their sensors turn up
+    BOOLEAN restoring = FALSE;
+    EFI_STATUS store_status = fan_store_load();
+
+    // Probe sensor keys in timer slices between redraws and key presses
+    temp_discover_begin(&discovery);
+    EFI_EVENT discovery_event = create_wait_timer(DISCOVERY_SLICE_MS);
+    if (discovery_event) {
+        UnicodeSPrint(status_msg, sizeof(status_msg), L"Ready - discovering temperature sensors");
+
+        // Meanwhile refresh fans in the background through the async engine;
+        // blocking if unavailable
+        if (!want_ap) {
+            async_refresh = async_refresh_start(fans, count, sensors, 0, &refresh_event);
+        }
+    } else {
+        temp_discover_sensors(sensors, &sensor_count);
+        sensors_ready(fans, count, sensors, sensor_count, want_ap, &ap_mode, &async_refresh,
+                      &refresh_event, status_msg, sizeof(status_msg));
+    }
+    if (options && options->serial && !rpc_event) {
+        UnicodeSPrint(status_msg, sizeof(status_msg), L"Warning: Serial port %d unavailable",
+                     options->serial_port);
+    }
+    if (options && options->graphics && !headless && !graphics) {
+        UnicodeSPrint(status_msg, sizeof(status_msg), L"Warning: No graphics output - text menu");
+    }
+    if (!EFI_ERROR(store_status) && options && !options->no_restore && options->fan_count == 0 &&
+        options->profile == FAN_PROFILE_NONE) {
+        restoring = TRUE;
+        pending_profile = fan_store_profile();
+        UnicodeSPrint(status_msg, sizeof(status_msg), L"Restoring saved fan settings");
+    } else if (EFI_ERROR(store_status) && store_status != EFI_NOT_FOUND) {
+        UnicodeSPrint(status_msg, sizeof(status_msg),
+                     L"Saved fan settings ignored (Status: 0x%x)", store_status);
+    }
 
     while (running) {
+        // Deferred until the AP has taken earlier fan commands (see fan_profile_load)
+        if (pending_profile != FAN_PROFILE_NONE && !discovery_event &&
+            !(ap_mode && control_engine_pending())) {
+            profile = pending_profile;
+            pending_profile = FAN_PROFILE_NONE;
+            load_profile(profile, fans, count, sensors, sensor_count, ap_mode,
+                         status_msg, sizeof(status_msg));
+        }
+        // Saved settings for fans off the profile go on top of it
+        if (restoring && pending_profile == FAN_PROFILE_NONE) {
+            restoring = fan_store_apply(fans, count, sensors, sensor_count, !discovery_event,
+                                        apply_fan, ap_mode);
+        }
+
+        // Modes, targets and bound sensors for the telemetry table
+        telemetry_table_bind(fans, count, sensors, sensor_count, ap_mode);
+
         // Refresh fan data (including sensor-based updates)
-        refresh_fan_data(fans, count, sensors, sensor_count);
+        if (ap_mode) {
+            pull_telemetry(fans, count, sensors, sensor_count);
+        } else if (!async_refresh) {
+            refresh_fan_data(fans, count, sensors, sensor_count);
 
-        // Clear and redraw screen
-        ui_clear_screen();
-        ui_display_header();
+            // No background writer: publish the blocking refresh ourselves
+            telemetry_capture(fans, count, sensors, sensor_count);
+        } else {
+            pull_telemetry(fans, count, sensors, sensor_count);
 
-        // Display fans
-        ui_display_fans(fans, count, selected_fan);
+            // Keep fan-curve sensors on the fast schedule
+            sensor_sched_bind_fans(fans, count);
+        }
 
-        // Display status
-        ui_display_status(status_msg);
-        Print(L"\n");
+        if (headless) {
+            // One line per due tick; status messages only when they change
+            status_line_note(status_msg);
+            if (status_due) {
+                status_line_emit(fans, count, sensors, sensor_count);
+                status_due = FALSE;
+            }
+        } else if (graphics) {
+            // Only what changed reaches the screen, at most once per frame period
+            dashboard_render(fans, count, selected_fan, sensors, sensor_count, status_msg);
+        } else {
+            // Clear and redraw screen
+            ui_clear_screen();
+            ui_display_header();
 
-        // Display help
-        ui_display_help();
+            // Display fans
+            ui_display_fans(fans, count, selected_fan);
+            if (discovery_event) {
+                Print(L"Discovering temperature sensors... %d found\n", sensor_count);
+            }
 
-        // Wait for key press
-        UINTN index;
-        gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &index);
+            // Display status
+            ui_display_status(status_msg);
+            Print(L"\n");
 
-        // Read key
-        status = gST->ConIn->ReadKeyStroke(gST->ConIn, &key);
-        if (EFI_ERROR(status)) {
-            continue;
+            // Display help
+            ui_display_help();
         }
+        drawn_sensor_count = sensor_count;
+        drawn_us = timer_now_us();
 
-        // Handle key input
-        CHAR16 ch = key.UnicodeChar;
+        // Wait for key press (or the next background refresh); discovery slices
+        // run in between and redraw only when new sensors have turned up
+        EFI_EVENT woke;
+        BOOLEAN sliced = FALSE;
+        for (;;) {
+            EFI_EVENT wait_events[6];
+            UINTN wait_count = 0;
+            UINTN index = 0;
 
-        // Fan selection (0-5)
-        if (ch >= L'0' && ch <= L'5') {
-            UINT8 fan_index = (UINT8)(ch - L'0');
-            if (fan_index < count) {
-                selected_fan = fan_index;
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"Selected fan %d (%s)",
-                             fan_index, fans[fan_index].label);
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"Invalid fan index");
+            wait_events[wait_count++] = gST->ConIn->WaitForKey;
+            if (refresh_event) {
+                wait_events[wait_count++] = refresh_event;
             }
-        }
-        // Auto mode
-        else if (ch == L'a' || ch == L'A') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                fans[selected_fan].sensor_based_enabled = FALSE;
-                status = fan_set_manual_mode(fans[selected_fan].index, FALSE);
-                if (!EFI_ERROR(status)) {
-                    fans[selected_fan].mode = FAN_MODE_AUTO;
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan %d set to AUTO mode",
-                                 selected_fan);
-                } else {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set AUTO mode");
+            if (discovery_event) {
+                wait_events[wait_count++] = discovery_event;
+            }
+            if (rpc_event) {
+                wait_events[wait_count++] = rpc_event;
+            }
+            if (status_event) {
+                wait_events[wait_count++] = status_event;
+            }
+            if (frame_event) {
+                wait_events[wait_count++] = frame_event;
+            }
+            gBS->WaitForEvent(wait_count, wait_events, &index);
+
+            woke = wait_events[index];
+            if (woke == rpc_event) {
+                rpc.sensor_count = sensor_count;
+                rpc.ap_mode = ap_mode;
+                if (serial_rpc_poll(&rpc)) {
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan settings changed remotely");
+                    sliced = TRUE;
+                    break;
+                }
+                continue;
+            }
+            if (woke == frame_event) {
+                if (dashboard_due()) {
+                    sliced = TRUE;
+                    break;
+                }
+                continue;
+            }
+            if (woke == status_event) {
+                if (++status_ticks % decimation == 0) {
+                    status_due = TRUE;
+                    sliced = TRUE;
+                    break;
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
+                continue;
+            }
+            if (woke != discovery_event) {
+                break;
+            }
+
+            if (temp_discover_step(&discovery, sensors, &sensor_count, DISCOVERY_BUDGET_US)) {
+                gBS->CloseEvent(discovery_event);
+                discovery_event = NULL;
+                sensors_ready(fans, count, sensors, sensor_count, want_ap, &ap_mode,
+                              &async_refresh, &refresh_event, status_msg, sizeof(status_msg));
+                sliced = TRUE;
+                break;
+            }
+            if (sensor_count != drawn_sensor_count &&
+                timer_now_us() - drawn_us >= (UINT64)DISCOVERY_REDRAW_MS * 1000) {
+                sliced = TRUE;
+                break;
             }
         }
-        // Manual mode
-        else if (ch == L'm' || ch == L'M') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                fans[selected_fan].sensor_based_enabled = FALSE;
-                status = fan_set_manual_mode(fans[selected_fan].index, TRUE);
-                if (!EFI_ERROR(status)) {
-                    fans[selected_fan].mode = FAN_MODE_MANUAL;
-                    // Set initial target to current RPM
-                    fans[selected_fan].target_rpm = fans[selected_fan].current_rpm;
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan %d set to MANUAL mode",
-                                 selected_fan);
-                } else {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set MANUAL mode");
+        if (sliced) {
+            continue;
+        }
+
+        // Refresh tick: act on the finished cycle and start the next one
+        if (woke == refresh_event) {
+            if (async_refresh) {
+                pull_telemetry(fans, count, sensors, sensor_count);
+                update_sensor_based_fans(fans, count, sensors, sensor_count);
+                resolve_refresh_types(fans, count, sensors, sensor_count);
+                if (refresh.complete) {
+                    refresh_begin(fans, count);
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
             }
+            continue;
         }
-        // Sensor-based mode
-        else if (ch == L's' || ch == L'S') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                if (sensor_count == 0) {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No sensors available");
+
+        // Take every key pressed since the last frame; +/- presses fold into one
+        // adjustment, applied before any other key and after the last one
+        EFI_INPUT_KEY keys[UI_INPUT_MAX];
+        UINTN key_count = ui_input_drain(keys, UI_INPUT_MAX);
+        UINT64 now_us = timer_now_us();
+        INT32 rpm_delta = 0;
+        INT32 presses = 0;
+        UINTN k;
+
+        for (k = 0; k < key_count && running; k++) {
+            CHAR16 ch = keys[k].UnicodeChar;
+
+            // Increase RPM or cycle sensor
+            if (ch == L'+' || ch == L'=') {
+                rpm_delta += RPM_STEP * (INT32)ui_input_repeat_scale(&repeat, L'+', now_us);
+                presses++;
+                continue;
+            }
+            // Decrease RPM or cycle sensor
+            if (ch == L'-' || ch == L'_') {
+                rpm_delta -= RPM_STEP * (INT32)ui_input_repeat_scale(&repeat, L'-', now_us);
+                presses--;
+                continue;
+            }
+
+            if (rpm_delta != 0 || presses != 0) {
+                adjust_selected_fan(fans, count, selected_fan, sensors, sensor_count, ap_mode,
+                                    rpm_delta, presses, status_msg, sizeof(status_msg));
+                rpm_delta = 0;
+                presses = 0;
+            }
+            ui_input_repeat_reset(&repeat);
+
+            // Fan selection (0-9)
+            if (ch >= L'0' && ch <= L'9') {
+                UINT8 fan_index = (UINT8)(ch - L'0');
+                if (fan_index < count) {
+                    selected_fan = fan_index;
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Selected fan %d (%s)",
+                                 fan_index, fans[fan_index].label);
                 } else {
-                    // Enable sensor-based mode with first sensor
-                    fans[selected_fan].mode = FAN_MODE_SENSOR_BASED;
-                    fans[selected_fan].sensor_based_enabled = TRUE;
-                    fans[selected_fan].sensor_index = 0;
-                    fans[selected_fan].min_temp = 400;  // 40.0°C
-                    fans[selected_fan].max_temp = 800;  // 80.0°C
-
-                    status = fan_set_sensor_based_mode(fans[selected_fan].index, TRUE,
-                                                       0, 400, 800);
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Invalid fan index");
+                }
+            }
+            // Next fan (reaches fans beyond index 9)
+            else if (ch == L'n' || ch == L'N') {
+                selected_fan = (selected_fan + 1) % count;
+                UnicodeSPrint(status_msg, sizeof(status_msg), L"Selected fan %d (%s)",
+                             selected_fan, fans[selected_fan].label);
+            }
+            // Auto mode
+            else if (ch == L'a' || ch == L'A') {
+                if (selected_fan >= 0 && selected_fan < count) {
+                    FAN_INFO next = fans[selected_fan];
+                    next.mode = FAN_MODE_AUTO;
+                    next.sensor_based_enabled = FALSE;
+
+                    status = apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
                     if (!EFI_ERROR(status)) {
-                        UnicodeSPrint(status_msg, sizeof(status_msg),
-                                     L"Fan %d: SENSOR mode (use +/- to select sensor)",
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan %d set to AUTO mode",
                                      selected_fan);
                     } else {
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set SENSOR mode");
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set AUTO mode");
                     }
+                } else {
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
             }
-        }
-        // Increase RPM or cycle sensor
-        else if (ch == L'+' || ch == L'=') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                if (fans[selected_fan].mode == FAN_MODE_MANUAL) {
-                    UINT16 new_rpm = fans[selected_fan].target_rpm + RPM_STEP;
-                    new_rpm = clamp_rpm(new_rpm, fans[selected_fan].min_rpm,
-                                       fans[selected_fan].max_rpm);
-
-                    status = fan_set_target_rpm(fans[selected_fan].index, new_rpm);
+            // Manual mode
+            else if (ch == L'm' || ch == L'M') {
+                if (selected_fan >= 0 && selected_fan < count) {
+                    FAN_INFO next = fans[selected_fan];
+                    next.mode = FAN_MODE_MANUAL;
+                    next.sensor_based_enabled = FALSE;
+                    // Set initial target to current RPM
+                    next.target_rpm = fans[selected_fan].current_rpm;
+
+                    status = apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
                     if (!EFI_ERROR(status)) {
-                        fans[selected_fan].target_rpm = new_rpm;
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Target RPM: %d", new_rpm);
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan %d set to MANUAL mode",
+                                     selected_fan);
                     } else {
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set RPM");
-                    }
-                } else if (fans[selected_fan].mode == FAN_MODE_SENSOR_BASED) {
-                    // Cycle to next sensor
-                    if (sensor_count > 0) {
-                        fans[selected_fan].sensor_index = (fans[selected_fan].sensor_index + 1) % sensor_count;
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Sensor: %s (%s)",
-                                     sensors[fans[selected_fan].sensor_index].label,
-                                     sensors[fans[selected_fan].sensor_index].key);
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set MANUAL mode");
                     }
                 } else {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan must be in MANUAL or SENSOR mode");
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
             }
-        }
-        // Decrease RPM or cycle sensor
-        else if (ch == L'-' || ch == L'_') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                if (fans[selected_fan].mode == FAN_MODE_MANUAL) {
-                    INT32 new_rpm = (INT32)fans[selected_fan].target_rpm - RPM_STEP;
-                    if (new_rpm < 0) new_rpm = 0;
-
-                    new_rpm = clamp_rpm((UINT16)new_rpm, fans[selected_fan].min_rpm,
-                                       fans[selected_fan].max_rpm);
-
-                    status = fan_set_target_rpm(fans[selected_fan].index, (UINT16)new_rpm);
-                    if (!EFI_ERROR(status)) {
-                        fans[selected_fan].target_rpm = (UINT16)new_rpm;
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Target RPM: %d", new_rpm);
+            // Sensor-based mode
+            else if (ch == L's' || ch == L'S') {
+                if (selected_fan >= 0 && selected_fan < count) {
+                    if (sensor_count == 0) {
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"No sensors available");
                     } else {
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set RPM");
-                    }
-                } else if (fans[selected_fan].mode == FAN_MODE_SENSOR_BASED) {
-                    // Cycle to previous sensor
-                    if (sensor_count > 0) {
-                        if (fans[selected_fan].sensor_index == 0) {
-                            fans[selected_fan].sensor_index = sensor_count - 1;
+                        // Enable sensor-based mode with first sensor
+                        FAN_INFO next = fans[selected_fan];
+                        next.mode = FAN_MODE_SENSOR_BASED;
+                        next.sensor_based_enabled = TRUE;
+                        next.sensor_index = 0;
+                        next.min_temp = 400;  // 40.0°C
+                        next.max_temp = 800;  // 80.0°C
+                        next.curve = NULL;
+
+                        status = apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
+                        if (!EFI_ERROR(status)) {
+                            UnicodeSPrint(status_msg, sizeof(status_msg),
+                                         L"Fan %d: SENSOR mode (use +/- to select sensor)",
+                                         selected_fan);
                         } else {
-                            fans[selected_fan].sensor_index--;
+                            UnicodeSPrint(status_msg, sizeof(status_msg), L"Failed to set SENSOR mode");
                         }
-                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Sensor: %s (%s)",
-                                     sensors[fans[selected_fan].sensor_index].label,
-                                     sensors[fans[selected_fan].sensor_index].key);
                     }
                 } else {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan must be in MANUAL or SENSOR mode");
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
             }
-        }
-        // Lower min temp threshold
-        else if (ch == L'<' || ch == L',') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                if (fans[selected_fan].mode == FAN_MODE_SENSOR_BASED) {
-                    fans[selected_fan].min_temp -= TEMP_STEP;
-                    if (fans[selected_fan].min_temp < 0) fans[selected_fan].min_temp = 0;
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Min temp: %d.%d°C",
-                                 fans[selected_fan].min_temp / 10,
-                                 fans[selected_fan].min_temp % 10);
+            // Lower min temp threshold
+            else if (ch == L'<' || ch == L',') {
+                if (selected_fan >= 0 && selected_fan < count) {
+                    if (fans[selected_fan].mode == FAN_MODE_SENSOR_BASED) {
+                        FAN_INFO next = fans[selected_fan];
+                        next.min_temp -= TEMP_STEP;
+                        if (next.min_temp < 0) next.min_temp = 0;
+                        next.curve = NULL;  // Back to the linear curve the thresholds define
+                        apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Min temp: %d.%d°C",
+                                     fans[selected_fan].min_temp / 10,
+                                     fans[selected_fan].min_temp % 10);
+                    } else {
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan must be in SENSOR mode");
+                    }
                 } else {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan must be in SENSOR mode");
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
             }
-        }
-        // Raise max temp threshold
-        else if (ch == L'>' || ch == L'.') {
-            if (selected_fan >= 0 && selected_fan < count) {
-                if (fans[selected_fan].mode == FAN_MODE_SENSOR_BASED) {
-                    fans[selected_fan].max_temp += TEMP_STEP;
-                    if (fans[selected_fan].max_temp > 1200) fans[selected_fan].max_temp = 1200;  // 120°C max
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Max temp: %d.%d°C",
-                                 fans[selected_fan].max_temp / 10,
-                                 fans[selected_fan].max_temp % 10);
+            // Raise max temp threshold
+            else if (ch == L'>' || ch == L'.') {
+                if (selected_fan >= 0 && selected_fan < count) {
+                    if (fans[selected_fan].mode == FAN_MODE_SENSOR_BASED) {
+                        FAN_INFO next = fans[selected_fan];
+                        next.max_temp += TEMP_STEP;
+                        if (next.max_temp > 1200) next.max_temp = 1200;  // 120°C max
+                        next.curve = NULL;
+                        apply_fan(fans, (UINT8)selected_fan, &next, ap_mode);
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Max temp: %d.%d°C",
+                                     fans[selected_fan].max_temp / 10,
+                                     fans[selected_fan].max_temp % 10);
+                    } else {
+                        UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan must be in SENSOR mode");
+                    }
                 } else {
-                    UnicodeSPrint(status_msg, sizeof(status_msg), L"Fan must be in SENSOR mode");
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
                 }
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No fan selected");
             }
-        }
-        // View temperature sensors
-        else if (ch == L't' || ch == L'T') {
-            if (sensor_count > 0) {
-                // Refresh sensors
-                temp_refresh_sensors(sensors, sensor_count);
-                display_temp_sensors(sensors, sensor_count, -1);
-
-                // Wait for key press
-                UINTN idx;
-                EFI_INPUT_KEY k;
-                gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &idx);
-                gST->ConIn->ReadKeyStroke(gST->ConIn, &k);
-            } else {
-                UnicodeSPrint(status_msg, sizeof(status_msg), L"No sensors available");
+            // Next thermal profile, for every fan
+            else if (ch == L'p' || ch == L'P') {
+                UINT8 base = pending_profile != FAN_PROFILE_NONE ? pending_profile : profile;
+                UINT8 next_profile = base == FAN_PROFILE_NONE ? 0 : (base + 1) % FAN_PROFILE_COUNT;
+
+                restoring = FALSE;  // What is still waiting would undo the new profile
+                if (discovery_event) {
+                    pending_profile = next_profile;
+                    UnicodeSPrint(status_msg, sizeof(status_msg),
+                                 L"Profile %a after sensor discovery", fan_profile_name(next_profile));
+                } else {
+                    profile = next_profile;
+                    load_profile(profile, fans, count, sensors, sensor_count, ap_mode,
+                                 status_msg, sizeof(status_msg));
+                }
+            }
+            // View temperature sensors
+            else if (ch == L't' || ch == L'T') {
+                if (sensor_count > 0) {
+                    // Refresh sensors (already current when refreshing in background)
+                    if (!async_refresh && !ap_mode) {
+                        temp_refresh_sensors(sensors, sensor_count);
+                    }
+                    display_temp_sensors(sensors, sensor_count, -1);
+
+                    // Wait for key press
+                    UINTN idx;
+                    EFI_INPUT_KEY k;
+                    gBS->WaitForEvent(1, &gST->ConIn->WaitForKey, &idx);
+                    gST->ConIn->ReadKeyStroke(gST->ConIn, &k);
+                    if (graphics) {
+                        dashboard_invalidate();
+                    }
+                } else {
+                    UnicodeSPrint(status_msg, sizeof(status_msg), L"No sensors available");
+                }
+            }
+            // Refresh
+            else if (ch == L'r' || ch == L'R') {
+                if (ap_mode) {
+                    control_engine_refresh_all();
+                } else if (!async_refresh) {
+                    refresh_fan_data(fans, count, sensors, sensor_count);
+                } else {
+                    if (refresh.complete) {
+                        refresh_begin(fans, count);
+                    }
+                    sensor_sched_refresh_all();
+                }
+                UnicodeSPrint(status_msg, sizeof(status_msg), L"Refreshed");
+            }
+            // Quit
+            else if (ch == L'q' || ch == L'Q') {
+                running = FALSE;
+                UnicodeSPrint(status_msg, sizeof(status_msg), L"Exiting...");
             }
         }
-        // Refresh
-        else if (ch == L'r' || ch == L'R') {
-            refresh_fan_data(fans, count, sensors, sensor_count);
-            UnicodeSPrint(status_msg, sizeof(status_msg), L"Refreshed");
+
+        if (rpm_delta != 0 || presses != 0) {
+            adjust_selected_fan(fans, count, selected_fan, sensors, sensor_count, ap_mode,
+                                rpm_delta, presses, status_msg, sizeof(status_msg));
         }
-        // Quit
-        else if (ch == L'q' || ch == L'Q') {
-            running = FALSE;
-            UnicodeSPrint(status_msg, sizeof(status_msg), L"Exiting...");
+    }
+
+    if (discovery_event) {
+        gBS->CloseEvent(discovery_event);
+    }
+    if (refresh_event) {
+        gBS->CloseEvent(refresh_event);
+    }
+    if (status_event) {
+        gBS->CloseEvent(status_event);
+    }
+    if (frame_event) {
+        gBS->CloseEvent(frame_event);
+        dashboard_close();
+    }
+    if (rpc_event) {
+        gBS->CloseEvent(rpc_event);
+        serial_rpc_close();
+    }
+    if (ap_mode) {
+        control_engine_stop();
+    }
+    if (async_refresh) {
+        sensor_sched_shutdown();
+        smc_async_shutdown();
+    }
+
+    // Keep this session's settings for the next launch (unless the saved ones never
+    // finished applying); the fans themselves go back to the SMC on exit
+    if (!restoring) {
+        status = fan_store_save(fans, count, sensors, sensor_count);
+        if (EFI_ERROR(status)) {
+            Print(L"Warning: Could not save fan settings (Status: 0x%x)\n", status);
         }
     }
+
+    FreePool(sensors);
 }
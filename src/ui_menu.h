@@ -13,6 +13,7 @@
 #endif
 #include "fan_control.h"
 #include "temp_sensors.h"
+#include "options.h"
 
 /**
  * UI display functions
@@ -25,7 +26,7 @@ void ui_clear_screen(void);
 void ui_display_header(void);
 
 // Display fan information table
-void ui_display_fans(FAN_INFO fans[], UINT8 count, INT8 selected_fan);
+void ui_display_fans(FAN_INFO fans[], UINT8 count, INT16 selected_fan);
 
 // Display command help
 void ui_display_help(void);
@@ -38,6 +39,6 @@ void ui_display_status(const CHAR16 *message);
  */
 
 // Run interactive menu
-void ui_menu_run(FAN_INFO fans[], UINT8 count);
+void ui_menu_run(FAN_INFO fans[], UINT8 count, const APP_OPTIONS *options);
 
 #endif // UI_MENU_H
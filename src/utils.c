@@ -27,6 +27,76 @@ void delay_milliseconds(UINT32 ms) {
     gBS->Stall(ms * 1000);
 }
 
+// Host builds (tools/) supply a virtual clock instead of the TSC
+#ifndef SMC_HOST_IO
+
+// TSC ticks per microsecond (0 until calibrated)
+static UINT64 tsc_per_us = 0;
+
+/**
+ * Read the CPU timestamp counter
+ * x86_64 specific implementation
+ */
+static UINT64 read_tsc(void) {
+    UINT32 lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((UINT64)hi << 32) | lo;
+}
+
+/**
+ * Calibrate the TSC against a 1ms Boot Services stall
+ */
+void timer_calibrate(void) {
+    UINT64 start = read_tsc();
+
+    gBS->Stall(1000);
+    tsc_per_us = (read_tsc() - start) / 1000;
+    if (tsc_per_us == 0) {
+        tsc_per_us = 1;
+    }
+}
+
+/**
+ * Microseconds since an arbitrary epoch
+ */
+UINT64 timer_now_us(void) {
+    if (tsc_per_us == 0) {
+        timer_calibrate();
+    }
+    return read_tsc() / tsc_per_us;
+}
+
+/**
+ * TSC ticks per microsecond
+ */
+UINT64 timer_ticks_per_us(void) {
+    if (tsc_per_us == 0) {
+        timer_calibrate();
+    }
+    return tsc_per_us;
+}
+
+/**
+ * Busy-wait on the TSC
+ * The timer must already be calibrated when called from an AP
+ */
+void timer_spin_us(UINT32 us) {
+    UINT64 start = timer_now_us();
+
+    while (timer_now_us() - start < us) {
+        __asm__ volatile("pause");
+    }
+}
+
+#endif // SMC_HOST_IO
+
+/**
+ * Full memory barrier
+ */
+void memory_fence(void) {
+    __asm__ volatile("mfence" : : : "memory");
+}
+
 /**
  * Clamp RPM value to safe range
  * Ensures RPM is never below min or above max
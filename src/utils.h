@@ -22,6 +22,29 @@ void delay_microseconds(UINT32 us);
 // Delay for specified milliseconds
 void delay_milliseconds(UINT32 ms);
 
+/**
+ * Monotonic time (TSC based, calibrated against Stall on first use)
+ */
+
+// Calibrate the time source
+void timer_calibrate(void);
+
+// Microseconds since an arbitrary epoch
+UINT64 timer_now_us(void);
+
+// Busy-wait on the TSC (no Boot Services; safe on application processors)
+void timer_spin_us(UINT32 us);
+
+// TSC ticks per microsecond (timer_now_us() is the TSC divided by this)
+UINT64 timer_ticks_per_us(void);
+
+/**
+ * Cross-processor ordering
+ */
+
+// Full memory barrier (also a compiler barrier)
+void memory_fence(void);
+
 /**
  * Value clamping and validation
  */
@@ -0,0 +1,11 @@
+// Stand-in OS loader for the QEMU chainload test (BOOT_MODE=1)
+// Announces itself and returns, so the boot path can be checked end to end.
+#include <efi.h>
+#include <efilib.h>
+
+EFI_STATUS EFIAPI efi_main(EFI_HANDLE ImageHandle, EFI_SYSTEM_TABLE *SystemTable) {
+    InitializeLib(ImageHandle, SystemTable);
+
+    Print(L"stub_loader: started by the fan control boot path\n");
+    return EFI_SUCCESS;
+}
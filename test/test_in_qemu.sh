@@ -3,6 +3,22 @@
 
 set -e
 
+# Options (environment):
+#   SMP=<n>     Number of CPUs (default 2)
+#   AP_MODE=1   Boot into the UEFI Shell and run "applesmc.efi --ap", which
+#               moves the control loop onto an application processor
+#   BOOT_MODE=1 Boot into the UEFI Shell and run "applesmc.efi --boot", which
+#               pins fan 0 and chainloads a stub loader (make stub_loader.efi)
+#   SERIAL_MODE=1 Boot into the UEFI Shell and run "applesmc.efi --serial=1"
+#               with a second serial port on tcp:127.0.0.1:$SERIAL_TCP_PORT for
+#               remote requests (e.g. "nc 127.0.0.1 4555", then FANS)
+
+SMP=${SMP:-2}
+AP_MODE=${AP_MODE:-0}
+BOOT_MODE=${BOOT_MODE:-0}
+SERIAL_MODE=${SERIAL_MODE:-0}
+SERIAL_TCP_PORT=${SERIAL_TCP_PORT:-4555}
+
 echo "Apple SMC Fan Control - QEMU Test Script"
 echo "========================================="
 echo ""
@@ -27,13 +43,41 @@ if ! command -v mcopy &> /dev/null; then
     exit 1
 fi
 
+if [ "$BOOT_MODE" = "1" ] && [ ! -f "../stub_loader.efi" ]; then
+    echo "ERROR: stub_loader.efi not found"
+    echo "Please build it first: make stub_loader.efi"
+    exit 1
+fi
+
 echo "Creating test environment..."
 
 # Create test directories
 mkdir -p test_env/esp/EFI/BOOT
 
-# Copy EFI application as default boot loader
-cp ../applesmc.efi test_env/esp/EFI/BOOT/BOOTX64.EFI
+rm -f test_env/esp/stub_loader.efi
+SHELL_MODE=0
+if [ "$AP_MODE" = "1" ] || [ "$BOOT_MODE" = "1" ] || [ "$SERIAL_MODE" = "1" ]; then
+    SHELL_MODE=1
+fi
+
+if [ "$SHELL_MODE" = "1" ]; then
+    # No BOOTX64.EFI: OVMF falls back to its built-in Shell, which runs startup.nsh
+    rm -f test_env/esp/EFI/BOOT/BOOTX64.EFI
+    cp ../applesmc.efi test_env/esp/applesmc.efi
+    if [ "$BOOT_MODE" = "1" ]; then
+        cp ../stub_loader.efi test_env/esp/stub_loader.efi
+        printf 'fs0:\r\napplesmc.efi --boot --fan=0:2000 --loader=\\stub_loader.efi\r\n' \
+            > test_env/esp/startup.nsh
+    elif [ "$SERIAL_MODE" = "1" ]; then
+        printf 'fs0:\r\napplesmc.efi --serial=1\r\n' > test_env/esp/startup.nsh
+    else
+        printf 'fs0:\r\napplesmc.efi --ap\r\n' > test_env/esp/startup.nsh
+    fi
+else
+    # Copy EFI application as default boot loader
+    rm -f test_env/esp/applesmc.efi test_env/esp/startup.nsh
+    cp ../applesmc.efi test_env/esp/EFI/BOOT/BOOTX64.EFI
+fi
 
 echo "Creating FAT disk image..."
 
@@ -45,8 +89,20 @@ mkfs.vfat test_env/disk.img >/dev/null 2>&1
 
 # Copy EFI directory structure
 mcopy -i test_env/disk.img -s test_env/esp/EFI :: 2>/dev/null
+if [ "$SHELL_MODE" = "1" ]; then
+    mcopy -i test_env/disk.img test_env/esp/applesmc.efi test_env/esp/startup.nsh :: 2>/dev/null
+fi
+if [ "$BOOT_MODE" = "1" ]; then
+    mcopy -i test_env/disk.img test_env/esp/stub_loader.efi :: 2>/dev/null
+fi
+
+# Remote-request port: COM2, listening on TCP
+EXTRA_SERIAL=()
+if [ "$SERIAL_MODE" = "1" ]; then
+    EXTRA_SERIAL=(-serial "tcp:127.0.0.1:$SERIAL_TCP_PORT,server,nowait")
+fi
 
-echo "Starting QEMU..."
+echo "Starting QEMU ($SMP CPUs, AP mode: $AP_MODE, boot mode: $BOOT_MODE, serial mode: $SERIAL_MODE)..."
 echo ""
 echo "NOTE: QEMU applesmc device may show dummy values"
 echo "Real hardware testing recommended for actual fan control"
@@ -59,10 +115,12 @@ echo ""
 qemu-system-x86_64 \
     -enable-kvm \
     -m 2048 \
+    -smp "$SMP" \
     -bios /usr/share/edk2/x64/OVMF_CODE.4m.fd \
     -drive file=test_env/disk.img,format=raw \
     -device isa-applesmc \
     -serial stdio \
+    "${EXTRA_SERIAL[@]}" \
     -nographic \
     -nodefaults \
     -vga none
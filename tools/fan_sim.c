@@ -0,0 +1,1071 @@
+/*
+ * fan_sim - closed-loop thermal plant simulator for the fan control code
+ *
+ * Runs the real src/fan_control.c (with smc_codec.c, smc_protocol.c and
+ * temp_sensors.c) against a simulated SMC on a virtual clock. The SMC is
+ * emulated at the port level, so every read and write goes through the
+ * same protocol code as on a Mac; with -m it is reached through the
+ * memory-mapped register window instead (src/smc_mmio.c). Behind it sits
+ * a lumped thermal model:
+ *
+ *   - Heat sources with a heat capacity C (J/K), a static conductance to
+ *     ambient G0 (W/K) and per-fan airflow coupling k_f (W/K per 1000 RPM):
+ *         C dT/dt = P(t) - (G0 + sum_f k_f * rpm_f / 1000) * (T - T_ambient)
+ *   - Each source is read by one temperature key (sp78, Gaussian noise).
+ *   - Fans follow their target with a first-order lag and a slew limit.
+ *     In auto mode the simulated firmware holds the minimum RPM.
+ *
+ * A workload script (see tools/scenarios/) declares fans, sources, fan
+ * curves and a timeline of power/ambient changes. Every control period the
+ * simulator does what the menu's refresh does: read fan RPMs, read the
+ * temperatures feeding sensor-based fans and call fan_update_sensor_based().
+ *
+ * Reported per run:
+ *   - Per source: peak temperature, and for every timeline segment the
+ *     overshoot past the segment's final temperature and the settling time
+ *     into +/- band of it (worst and mean).
+ *   - Per fan: RPM-seconds (integral of RPM, an acoustic proxy), mean RPM,
+ *     and SMC target/mode writes.
+ *   - SMC reads/writes, and per control tick the host CPU time spent in
+ *     the control code and the (virtual) SMC bus time.
+ *
+ * With -c every fan is first put through src/fan_calib.c, with the fans
+ * moving during its stalls; the thermal state is then reset, so the run
+ * differs from a plain one only by the measured models (printed).
+ *
+ * Build:  make host-tools
+ * Usage:  fan_sim [-m] [-c] [-o series.csv] scenario.sim
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "fan_control.h"
+#include "fan_calib.h"
+#include "temp_sensors.h"
+#include "smc_protocol.h"
+#include "smc_mmio.h"
+#include "utils.h"
+
+#define SIM_MAX_FANS        8
+#define SIM_MAX_SOURCES     16
+#define SIM_MAX_EVENTS      4096
+#define SIM_MAX_KEYS        (2 + SIM_MAX_FANS * 5 + SIM_MAX_SOURCES)
+
+// Simulated SMC response times
+#define SIM_ACK_US          20
+#define SIM_DATA_READY_US   60
+#define SIM_IO_NS           1000
+#define SIM_MMIO_DONE_US    20
+#define SIM_MMIO_NS         200
+
+// Where the simulated register window "lives" (only passed to smc_mmio_init)
+#define SIM_MMIO_BASE       0xFEF00000ULL
+
+/**
+ * Virtual clock and host services for src/
+ */
+
+static UINT64 clock_ns = 0;
+
+// While calibrating, stalls also run the plant (see plant_catch_up)
+static BOOLEAN calibrating = FALSE;
+static void plant_catch_up(void);
+
+static EFI_TPL host_raise_tpl(EFI_TPL new_tpl) { (void)new_tpl; return TPL_APPLICATION; }
+static void host_restore_tpl(EFI_TPL old_tpl) { (void)old_tpl; }
+
+static EFI_STATUS host_stall(UINTN us) {
+    clock_ns += (UINT64)us * 1000;
+    if (calibrating) {
+        plant_catch_up();
+    }
+    return EFI_SUCCESS;
+}
+
+static EFI_BOOT_SERVICES host_boot_services = { host_raise_tpl, host_restore_tpl, host_stall };
+EFI_BOOT_SERVICES *gBS = &host_boot_services;
+
+void timer_calibrate(void) {}
+UINT64 timer_now_us(void) { return clock_ns / 1000; }
+void timer_spin_us(UINT32 us) { clock_ns += (UINT64)us * 1000; }
+
+// Simulated port I/O is not traced
+void smc_trace_record(UINT8 op, UINT16 port, UINT8 value) { (void)op; (void)port; (void)value; }
+
+/**
+ * Simulated SMC
+ */
+
+typedef struct {
+    SMC_KEY key;
+    SMC_KEY type;
+    UINT8 size;
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    BOOLEAN writable;
+    UINT32 writes;
+} SIM_KEY;
+
+typedef enum { SMC_IDLE, SMC_ACK, SMC_OUTPUT, SMC_INPUT } SMC_STATE;
+
+static SIM_KEY sim_keys[SIM_MAX_KEYS];
+static UINTN sim_key_count = 0;
+
+static struct {
+    SMC_STATE state;
+    UINT8 cmd;
+    SMC_KEY key;
+    UINT8 key_bytes;
+    UINT64 ready_at_ns;       // ACK (SMC_ACK) or DATA_READY (SMC_OUTPUT); 0 = never
+    SIM_KEY *entry;
+    UINT8 out[SMC_MAX_DATA_LENGTH + 6];
+    UINT8 out_len;
+    UINT8 out_pos;
+    UINT8 in[SMC_MAX_DATA_LENGTH + 1];
+    UINT8 in_len;
+    UINT8 error;
+    UINT64 reads;
+    UINT64 writes;
+} smc;
+
+static SIM_KEY *sim_key_add(SMC_KEY key, SMC_KEY type, UINT8 size, BOOLEAN writable) {
+    SIM_KEY *entry = &sim_keys[sim_key_count++];
+
+    memset(entry, 0, sizeof(*entry));
+    entry->key = key;
+    entry->type = type;
+    entry->size = size;
+    entry->writable = writable;
+    return entry;
+}
+
+static SIM_KEY *sim_key_find(SMC_KEY key) {
+    UINTN i;
+
+    for (i = 0; i < sim_key_count; i++) {
+        if (sim_keys[i].key == key) {
+            return &sim_keys[i];
+        }
+    }
+    return NULL;
+}
+
+static void put_fpe2(SIM_KEY *entry, double rpm) {
+    UINT16 raw = (UINT16)(rpm < 0 ? 0 : (rpm > 16383 ? 65535 : rpm * 4 + 0.5));
+    entry->data[0] = raw >> 8;
+    entry->data[1] = raw & 0xFF;
+}
+
+static double get_fpe2(const SIM_KEY *entry) {
+    return ((entry->data[0] << 8) | entry->data[1]) / 4.0;
+}
+
+static void put_sp78(SIM_KEY *entry, double celsius) {
+    double raw = floor(celsius * 256 + 0.5);
+    INT16 value = (INT16)(raw > 32767 ? 32767 : (raw < -32768 ? -32768 : raw));
+    entry->data[0] = (UINT8)((UINT16)value >> 8);
+    entry->data[1] = (UINT8)(value & 0xFF);
+}
+
+static void smc_key_done(void) {
+    smc.entry = sim_key_find(smc.key);
+
+    if (smc.cmd == APPLESMC_WRITE_CMD) {
+        smc.state = SMC_INPUT;
+        smc.in_len = 0;
+        return;
+    }
+
+    smc.state = SMC_OUTPUT;
+    smc.out_pos = 0;
+    if (!smc.entry) {
+        smc.error = APPLESMC_ST_1E_NOEXIST;
+        smc.ready_at_ns = 0;
+        return;
+    }
+
+    if (smc.cmd == APPLESMC_READ_CMD) {
+        smc.out[0] = smc.entry->size;
+        memcpy(&smc.out[1], smc.entry->data, smc.entry->size);
+        smc.out_len = (UINT8)(1 + smc.entry->size);
+        smc.reads++;
+    } else {
+        // GET_KEY_TYPE: size, type code, attributes
+        smc.out[0] = smc.entry->size;
+        smc.out[1] = (UINT8)SMC_KEY_CHAR(smc.entry->type, 0);
+        smc.out[2] = (UINT8)SMC_KEY_CHAR(smc.entry->type, 1);
+        smc.out[3] = (UINT8)SMC_KEY_CHAR(smc.entry->type, 2);
+        smc.out[4] = (UINT8)SMC_KEY_CHAR(smc.entry->type, 3);
+        smc.out[5] = smc.entry->writable ? 0xC0 : 0x80;
+        smc.out_len = 6;
+    }
+    smc.ready_at_ns = clock_ns + SIM_DATA_READY_US * 1000ULL;
+}
+
+static void smc_input_done(void) {
+    UINT8 len = smc.in[0];
+
+    smc.state = SMC_IDLE;
+    if (!smc.entry || !smc.entry->writable || len != smc.entry->size) {
+        smc.error = APPLESMC_ST_1E_READONLY;
+        return;
+    }
+    memcpy(smc.entry->data, &smc.in[1], len);
+    smc.entry->writes++;
+    smc.writes++;
+}
+
+UINT8 smc_host_inb(UINT16 port) {
+    BOOLEAN ready = smc.ready_at_ns != 0 && clock_ns >= smc.ready_at_ns;
+    UINT8 value = 0;
+
+    clock_ns += SIM_IO_NS;
+
+    if (port == APPLESMC_ERR_PORT) {
+        return smc.error;
+    }
+    if (port == APPLESMC_CMD_PORT) {
+        switch (smc.state) {
+            case SMC_ACK:
+                return ready ? APPLESMC_ST_ACK : 0;
+            case SMC_OUTPUT:
+                return ready ? (APPLESMC_ST_ACK | APPLESMC_ST_DATA_READY) : APPLESMC_ST_ACK;
+            case SMC_INPUT:
+                return APPLESMC_ST_ACK;
+            default:
+                return APPLESMC_ST_CMD_DONE;
+        }
+    }
+    if (port != APPLESMC_DATA_PORT || smc.state != SMC_OUTPUT || !ready) {
+        return 0;
+    }
+
+    if (smc.out_pos < smc.out_len) {
+        value = smc.out[smc.out_pos++];
+    }
+    if (smc.out_pos >= smc.out_len) {
+        smc.state = SMC_IDLE;
+    }
+    return value;
+}
+
+void smc_host_outb(UINT16 port, UINT8 value) {
+    clock_ns += SIM_IO_NS;
+
+    if (port == APPLESMC_CMD_PORT) {
+        if (value == APPLESMC_READ_CMD || value == APPLESMC_WRITE_CMD ||
+            value == APPLESMC_GET_KEY_TYPE_CMD) {
+            smc.state = SMC_ACK;
+            smc.cmd = value;
+            smc.key = 0;
+            smc.key_bytes = 0;
+            smc.error = 0;
+            smc.ready_at_ns = clock_ns + SIM_ACK_US * 1000ULL;
+        } else {
+            smc.state = SMC_IDLE;
+            smc.error = 0;
+        }
+        return;
+    }
+    if (port != APPLESMC_DATA_PORT) {
+        return;
+    }
+
+    if (smc.state == SMC_ACK && clock_ns >= smc.ready_at_ns) {
+        smc.key = (smc.key << 8) | value;
+        if (++smc.key_bytes == 4) {
+            smc_key_done();
+        }
+    } else if (smc.state == SMC_INPUT && smc.in_len < sizeof(smc.in)) {
+        smc.in[smc.in_len++] = value;
+        if (smc.in_len >= 1 + (UINTN)smc.in[0]) {
+            smc_input_done();
+        }
+    }
+}
+
+/**
+ * Simulated MMIO window
+ * Writing CMD runs the command at once; STATUS reports done after
+ * SIM_MMIO_DONE_US, as the firmware would.
+ */
+
+static struct {
+    UINT8 regs[SMC_MMIO_MIN_SIZE];
+    UINT64 done_at_ns;        // 0 = no command posted
+} mmio;
+
+static UINT8 mmio_execute(UINT8 cmd) {
+    SIM_KEY *entry = sim_key_find(SMC_KEY_CONST(mmio.regs[SMC_MMIO_KEY], mmio.regs[SMC_MMIO_KEY + 1],
+                                                mmio.regs[SMC_MMIO_KEY + 2],
+                                                mmio.regs[SMC_MMIO_KEY + 3]));
+    UINT8 *data = &mmio.regs[SMC_MMIO_DATA];
+    UINT8 len = mmio.regs[SMC_MMIO_DATA_LEN];
+
+    if (cmd != APPLESMC_READ_CMD && cmd != APPLESMC_WRITE_CMD && cmd != APPLESMC_GET_KEY_TYPE_CMD) {
+        return APPLESMC_ST_1E_BAD_CMD;
+    }
+    if (!entry) {
+        return APPLESMC_ST_1E_NOEXIST;
+    }
+
+    if (cmd == APPLESMC_READ_CMD) {
+        memcpy(data, entry->data, entry->size);
+        mmio.regs[SMC_MMIO_DATA_LEN] = entry->size;
+        smc.reads++;
+    } else if (cmd == APPLESMC_WRITE_CMD) {
+        if (!entry->writable || len != entry->size) {
+            return APPLESMC_ST_1E_READONLY;
+        }
+        memcpy(entry->data, data, len);
+        entry->writes++;
+        smc.writes++;
+    } else {
+        data[SMC_MMIO_TYPE_CODE] = (UINT8)SMC_KEY_CHAR(entry->type, 0);
+        data[SMC_MMIO_TYPE_CODE + 1] = (UINT8)SMC_KEY_CHAR(entry->type, 1);
+        data[SMC_MMIO_TYPE_CODE + 2] = (UINT8)SMC_KEY_CHAR(entry->type, 2);
+        data[SMC_MMIO_TYPE_CODE + 3] = (UINT8)SMC_KEY_CHAR(entry->type, 3);
+        data[4] = 0;
+        data[SMC_MMIO_TYPE_LEN] = entry->size;
+        data[SMC_MMIO_TYPE_FLAGS] = entry->writable ? 0xC0 : 0x80;
+    }
+    return 0;
+}
+
+UINT8 smc_host_mmio_read8(UINT32 offset) {
+    clock_ns += SIM_MMIO_NS;
+
+    if (offset >= SMC_MMIO_MIN_SIZE) {
+        return 0xFF;
+    }
+    if (offset == SMC_MMIO_STATUS) {
+        return (mmio.done_at_ns != 0 && clock_ns >= mmio.done_at_ns) ? SMC_MMIO_ST_DONE : 0;
+    }
+    return mmio.regs[offset];
+}
+
+void smc_host_mmio_write8(UINT32 offset, UINT8 value) {
+    clock_ns += SIM_MMIO_NS;
+
+    if (offset >= SMC_MMIO_MIN_SIZE) {
+        return;
+    }
+    if (offset == SMC_MMIO_STATUS) {
+        mmio.done_at_ns = 0;
+        return;
+    }
+    if (offset == SMC_MMIO_CMD) {
+        mmio.regs[SMC_MMIO_CMD] = mmio_execute(value);
+        mmio.done_at_ns = clock_ns + SIM_MMIO_DONE_US * 1000ULL;
+        return;
+    }
+    mmio.regs[offset] = value;
+}
+
+/**
+ * Thermal plant
+ */
+
+typedef struct {
+    double min_rpm;
+    double max_rpm;
+    double tau_s;             // First-order lag toward the target
+    double slew;              // RPM per second limit
+    double rpm;
+    SIM_KEY *ac, *md, *tg;
+    double rpm_seconds;
+} SIM_FAN;
+
+typedef struct {
+    char name[16];
+    SMC_KEY key;
+    SIM_KEY *sensor;
+    double capacity;          // J/K
+    double conductance;       // W/K with fans stopped
+    double airflow[SIM_MAX_FANS];  // W/K per 1000 RPM
+    double temp;
+    double power;
+    double *series;           // Plant temperature per physics step
+} SIM_SOURCE;
+
+typedef enum { EVENT_POWER, EVENT_AMBIENT } EVENT_KIND;
+
+typedef struct {
+    double time_s;
+    EVENT_KIND kind;
+    int source;
+    double value;
+} SIM_EVENT;
+
+typedef struct {
+    int fan;
+    int source;
+    double min_c;
+    double max_c;
+} SIM_CURVE;
+
+static struct {
+    double duration_s;
+    UINT32 physics_ms;
+    UINT32 control_ms;
+    double ambient;
+    double noise;
+    double band;
+    UINT64 seed;
+    SIM_FAN fans[SIM_MAX_FANS];
+    int fan_count;
+    SIM_SOURCE sources[SIM_MAX_SOURCES];
+    int source_count;
+    SIM_EVENT events[SIM_MAX_EVENTS];
+    int event_count;
+    SIM_CURVE curves[SIM_MAX_FANS];
+    int curve_count;
+} sim = {
+    .duration_s = 600, .physics_ms = 10, .control_ms = 1000,
+    .ambient = 25, .noise = 0.1, .band = 1.0, .seed = 1
+};
+
+static UINT64 rng_state;
+
+static double rng_uniform(void) {
+    // xorshift64*
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return ((rng_state * 0x2545F4914F6CDD1DULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double rng_gauss(void) {
+    double u1 = rng_uniform(), u2 = rng_uniform();
+    if (u1 < 1e-300) {
+        u1 = 1e-300;
+    }
+    return sqrt(-2.0 * log(u1)) * cos(2.0 * 3.14159265358979323846 * u2);
+}
+
+static void plant_publish(void) {
+    int i;
+
+    for (i = 0; i < sim.fan_count; i++) {
+        put_fpe2(sim.fans[i].ac, sim.fans[i].rpm);
+    }
+    for (i = 0; i < sim.source_count; i++) {
+        put_sp78(sim.sources[i].sensor, sim.sources[i].temp + sim.noise * rng_gauss());
+    }
+}
+
+static void plant_step(double dt) {
+    int i, f;
+
+    for (i = 0; i < sim.fan_count; i++) {
+        SIM_FAN *fan = &sim.fans[i];
+        double target = fan->md->data[0] ? get_fpe2(fan->tg) : fan->min_rpm;
+        double step = (target - fan->rpm) * (dt / (fan->tau_s + dt));
+        double limit = fan->slew * dt;
+
+        if (step > limit) {
+            step = limit;
+        } else if (step < -limit) {
+            step = -limit;
+        }
+        fan->rpm += step;
+        fan->rpm_seconds += fan->rpm * dt;
+    }
+
+    for (i = 0; i < sim.source_count; i++) {
+        SIM_SOURCE *src = &sim.sources[i];
+        double g = src->conductance;
+
+        for (f = 0; f < sim.fan_count; f++) {
+            g += src->airflow[f] * sim.fans[f].rpm / 1000.0;
+        }
+        src->temp += dt * (src->power - g * (src->temp - sim.ambient)) / src->capacity;
+    }
+}
+
+// Virtual time the plant has been run up to while calibrating
+static UINT64 plant_ns = 0;
+
+/**
+ * Run the plant up to the virtual clock, one physics step at a time
+ */
+static void plant_catch_up(void) {
+    UINT64 step_ns = (UINT64)sim.physics_ms * 1000000;
+
+    while (clock_ns - plant_ns >= step_ns) {
+        plant_step(sim.physics_ms / 1000.0);
+        plant_publish();
+        plant_ns += step_ns;
+    }
+}
+
+/**
+ * Workload script
+ */
+
+static int find_source(const char *name) {
+    int i;
+
+    for (i = 0; i < sim.source_count; i++) {
+        if (strcmp(sim.sources[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int add_event(double time_s, EVENT_KIND kind, int source, double value) {
+    SIM_EVENT *e;
+
+    if (sim.event_count >= SIM_MAX_EVENTS) {
+        return 0;
+    }
+    e = &sim.events[sim.event_count++];
+    e->time_s = time_s;
+    e->kind = kind;
+    e->source = source;
+    e->value = value;
+    return 1;
+}
+
+static int compare_events(const void *a, const void *b) {
+    const SIM_EVENT *x = a, *y = b;
+
+    if (x->time_s != y->time_s) {
+        return (x->time_s > y->time_s) - (x->time_s < y->time_s);
+    }
+    return (x > y) - (x < y);
+}
+
+static int parse_line(char *line) {
+    char word[32], name[32], key[8], what[16];
+    double a, b, c, d, e;
+    int n, i;
+
+    if (sscanf(line, "%31s", word) != 1 || word[0] == '#') {
+        return 1;
+    }
+
+    if (strcmp(word, "duration") == 0) {
+        return sscanf(line, "%*s %lf", &sim.duration_s) == 1;
+    }
+    if (strcmp(word, "physics") == 0) {
+        return sscanf(line, "%*s %u", &sim.physics_ms) == 1 && sim.physics_ms > 0;
+    }
+    if (strcmp(word, "control") == 0) {
+        return sscanf(line, "%*s %u", &sim.control_ms) == 1 && sim.control_ms > 0;
+    }
+    if (strcmp(word, "ambient") == 0) {
+        return sscanf(line, "%*s %lf", &sim.ambient) == 1;
+    }
+    if (strcmp(word, "noise") == 0) {
+        return sscanf(line, "%*s %lf", &sim.noise) == 1;
+    }
+    if (strcmp(word, "band") == 0) {
+        return sscanf(line, "%*s %lf", &sim.band) == 1;
+    }
+    if (strcmp(word, "seed") == 0) {
+        return sscanf(line, "%*s %llu", (unsigned long long *)&sim.seed) == 1;
+    }
+
+    if (strcmp(word, "fan") == 0) {
+        // fan <min_rpm> <max_rpm> <tau_s> [slew_rpm_per_s]
+        SIM_FAN *fan = &sim.fans[sim.fan_count];
+        e = 1500;
+        n = sscanf(line, "%*s %lf %lf %lf %lf", &a, &b, &c, &e);
+        if (n < 3 || sim.fan_count >= SIM_MAX_FANS || a > b || c < 0) {
+            return 0;
+        }
+        fan->min_rpm = a;
+        fan->max_rpm = b;
+        fan->tau_s = c;
+        fan->slew = e;
+        fan->rpm = a;
+        sim.fan_count++;
+        return 1;
+    }
+
+    if (strcmp(word, "source") == 0) {
+        // source <name> <key> <capacity J/K> <conductance W/K> [initial C]
+        SIM_SOURCE *src = &sim.sources[sim.source_count];
+        d = sim.ambient;
+        n = sscanf(line, "%*s %15s %4s %lf %lf %lf", name, key, &a, &b, &d);
+        if (n < 4 || sim.source_count >= SIM_MAX_SOURCES || strlen(key) != 4 || a <= 0) {
+            return 0;
+        }
+        strcpy(src->name, name);
+        src->key = smc_key_from_chars(key);
+        src->capacity = a;
+        src->conductance = b;
+        src->temp = d;
+        sim.source_count++;
+        return 1;
+    }
+
+    if (strcmp(word, "airflow") == 0) {
+        // airflow <source> <fan> <W/K per 1000 RPM>
+        if (sscanf(line, "%*s %31s %d %lf", name, &n, &a) != 3 ||
+            (i = find_source(name)) < 0 || n < 0 || n >= sim.fan_count) {
+            return 0;
+        }
+        sim.sources[i].airflow[n] = a;
+        return 1;
+    }
+
+    if (strcmp(word, "curve") == 0) {
+        // curve <fan> <source> <min C> <max C>
+        SIM_CURVE *curve = &sim.curves[sim.curve_count];
+        if (sscanf(line, "%*s %d %31s %lf %lf", &n, name, &a, &b) != 4 ||
+            (i = find_source(name)) < 0 || n < 0 || n >= sim.fan_count ||
+            sim.curve_count >= SIM_MAX_FANS) {
+            return 0;
+        }
+        curve->fan = n;
+        curve->source = i;
+        curve->min_c = a;
+        curve->max_c = b;
+        sim.curve_count++;
+        return 1;
+    }
+
+    if (strcmp(word, "at") == 0) {
+        // at <s> power <source> <W> | at <s> ambient <C>
+        if (sscanf(line, "%*s %lf %15s", &a, what) != 2) {
+            return 0;
+        }
+        if (strcmp(what, "power") == 0) {
+            return sscanf(line, "%*s %*s %*s %31s %lf", name, &b) == 2 &&
+                   (i = find_source(name)) >= 0 && add_event(a, EVENT_POWER, i, b);
+        }
+        if (strcmp(what, "ambient") == 0) {
+            return sscanf(line, "%*s %*s %*s %lf", &b) == 1 && add_event(a, EVENT_AMBIENT, -1, b);
+        }
+        return 0;
+    }
+
+    if (strcmp(word, "square") == 0) {
+        // square <source> <low W> <high W> <period s> <from s> <to s>
+        double t;
+        if (sscanf(line, "%*s %31s %lf %lf %lf %lf %lf", name, &a, &b, &c, &d, &e) != 6 ||
+            (i = find_source(name)) < 0 || c <= 0) {
+            return 0;
+        }
+        for (t = d, n = 0; t < e; t += c / 2, n++) {
+            if (!add_event(t, EVENT_POWER, i, (n & 1) ? a : b)) {
+                return 0;
+            }
+        }
+        return add_event(e, EVENT_POWER, i, a);
+    }
+
+    return 0;
+}
+
+static int load_script(const char *path) {
+    char line[256];
+    int number = 0;
+    FILE *f = fopen(path, "r");
+
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        number++;
+        if (!parse_line(line)) {
+            fprintf(stderr, "%s:%d: bad line: %s", path, number, line);
+            fclose(f);
+            return 0;
+        }
+    }
+    fclose(f);
+
+    if (sim.fan_count == 0 || sim.source_count == 0) {
+        fprintf(stderr, "%s: need at least one fan and one source\n", path);
+        return 0;
+    }
+    qsort(sim.events, sim.event_count, sizeof(SIM_EVENT), compare_events);
+    return 1;
+}
+
+/**
+ * SMC contents for the scenario
+ */
+static void build_smc(void) {
+    SIM_KEY *fnum;
+    int i;
+
+    fnum = sim_key_add(SMC_KEY_FNUM, SMC_KEY_CONST('u', 'i', '8', ' '), 1, FALSE);
+    fnum->data[0] = (UINT8)sim.fan_count;
+
+    for (i = 0; i < sim.fan_count; i++) {
+        SIM_FAN *fan = &sim.fans[i];
+        SMC_KEY fpe2 = SMC_KEY_CONST('f', 'p', 'e', '2');
+
+        fan->ac = sim_key_add(fan_smc_key((UINT8)i, FAN_KEY_ACTUAL_RPM), fpe2, 2, FALSE);
+        put_fpe2(sim_key_add(fan_smc_key((UINT8)i, FAN_KEY_MIN_RPM), fpe2, 2, FALSE), fan->min_rpm);
+        put_fpe2(sim_key_add(fan_smc_key((UINT8)i, FAN_KEY_MAX_RPM), fpe2, 2, FALSE), fan->max_rpm);
+        fan->md = sim_key_add(fan_smc_key((UINT8)i, FAN_KEY_MODE), SMC_KEY_CONST('u', 'i', '8', ' '),
+                              1, TRUE);
+        fan->tg = sim_key_add(fan_smc_key((UINT8)i, FAN_KEY_TARGET_RPM), fpe2, 2, TRUE);
+        put_fpe2(fan->tg, fan->min_rpm);
+    }
+
+    for (i = 0; i < sim.source_count; i++) {
+        sim.sources[i].sensor = sim_key_add(sim.sources[i].key, SMC_KEY_CONST('s', 'p', '7', '8'),
+                                            2, FALSE);
+    }
+
+    plant_publish();
+}
+
+/**
+ * Response metrics for one source over one timeline segment
+ */
+typedef struct {
+    double overshoot;
+    double settling_s;
+    BOOLEAN settled;
+} SEGMENT_RESULT;
+
+static SEGMENT_RESULT segment_metrics(const double *series, UINTN start, UINTN end, double dt) {
+    SEGMENT_RESULT r = { 0, 0, TRUE };
+    double initial = series[start], final = series[end - 1];
+    double direction = (final >= initial) ? 1.0 : -1.0;
+    UINTN last_out = start;
+    UINTN tail = start + (end - start) * 9 / 10;
+    UINTN i;
+
+    for (i = start; i < end; i++) {
+        double excess = (series[i] - final) * direction;
+        if (excess > r.overshoot) {
+            r.overshoot = excess;
+        }
+        if (fabs(series[i] - final) > sim.band) {
+            last_out = i + 1;
+        }
+    }
+    r.settling_s = (last_out - start) * dt;
+
+    // Still drifting over the last tenth: the final value is not a steady state
+    if (fabs(series[end - 1] - series[tail]) > sim.band) {
+        r.settled = FALSE;
+    }
+    return r;
+}
+
+static double cpu_time_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/**
+ * Calibrate every fan, then put the plant back where it started
+ */
+static BOOLEAN calibrate_fans(FAN_INFO fans[], UINT8 fan_count) {
+    double temps[SIM_MAX_SOURCES], rpms[SIM_MAX_FANS];
+    EFI_STATUS status;
+    UINT64 start_ns;
+    int i;
+
+    for (i = 0; i < sim.source_count; i++) {
+        temps[i] = sim.sources[i].temp;
+    }
+    for (i = 0; i < sim.fan_count; i++) {
+        rpms[i] = sim.fans[i].rpm;
+    }
+
+    printf("Calibration\nFan  Reach RPM     Lag ms   Settle ms\n");
+    calibrating = TRUE;
+    plant_ns = clock_ns;
+    start_ns = clock_ns;
+    for (i = 0; i < fan_count; i++) {
+        status = fan_calibrate(&fans[i]);
+        if (EFI_ERROR(status)) {
+            fprintf(stderr, "fan %d calibration failed (status 0x%llx)\n",
+                    i, (unsigned long long)status);
+            calibrating = FALSE;
+            return FALSE;
+        }
+        printf("%-3d  %4u-%-6u  %6u   %9u\n", i, fans[i].model.reach_min,
+               fans[i].model.reach_max, fans[i].model.lag_ms, fans[i].model.settle_ms);
+    }
+    calibrating = FALSE;
+    printf("(%.1f s of virtual time)\n\n", (clock_ns - start_ns) / 1e9);
+
+    for (i = 0; i < sim.source_count; i++) {
+        sim.sources[i].temp = temps[i];
+    }
+    for (i = 0; i < sim.fan_count; i++) {
+        sim.fans[i].rpm = rpms[i];
+        sim.fans[i].rpm_seconds = 0;
+    }
+    plant_publish();
+    return TRUE;
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: fan_sim [-m] [-c] [-o series.csv] scenario.sim\n"
+                    "  -m  reach the SMC through the MMIO window instead of port I/O\n"
+                    "  -c  calibrate the fans first (src/fan_calib.c) and run with their models\n");
+}
+
+int main(int argc, char **argv) {
+    const char *script = NULL, *csv_path = NULL;
+    FILE *csv = NULL;
+    BOOLEAN use_mmio = FALSE;
+    BOOLEAN calibrate = FALSE;
+    FAN_INFO *fans = NULL;
+    UINT8 fan_count = 0;
+    UINTN steps, step, next_event = 0;
+    UINTN control_every;
+    UINTN ticks = 0;
+    UINT64 tick_bus_ns_max = 0, tick_bus_ns_sum = 0;
+    UINT64 writes_before, reads_before;
+    UINT32 target_writes[SIM_MAX_FANS], mode_writes[SIM_MAX_FANS];
+    double tick_cpu_max = 0, tick_cpu_sum = 0;
+    double dt;
+    EFI_STATUS status;
+    int i, a;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-o") == 0 && a + 1 < argc) {
+            csv_path = argv[++a];
+        } else if (strcmp(argv[a], "-m") == 0) {
+            use_mmio = TRUE;
+        } else if (strcmp(argv[a], "-c") == 0) {
+            calibrate = TRUE;
+        } else if (argv[a][0] != '-' && !script) {
+            script = argv[a];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!script) {
+        usage();
+        return 2;
+    }
+    if (!load_script(script)) {
+        return 1;
+    }
+
+    rng_state = sim.seed ? sim.seed : 1;
+    dt = sim.physics_ms / 1000.0;
+    steps = (UINTN)(sim.duration_s * 1000 / sim.physics_ms);
+    control_every = sim.control_ms / sim.physics_ms ? sim.control_ms / sim.physics_ms : 1;
+    for (i = 0; i < sim.source_count; i++) {
+        sim.sources[i].series = calloc(steps + 1, sizeof(double));
+    }
+
+    build_smc();
+
+    if (use_mmio) {
+        if (EFI_ERROR(smc_mmio_init(SIM_MMIO_BASE, SMC_MMIO_MIN_SIZE))) {
+            fprintf(stderr, "MMIO window not usable\n");
+            return 1;
+        }
+        smc_set_transport(&smc_mmio_transport);
+    }
+
+    // Bring-up exactly as the application does it
+    status = fan_init();
+    if (!EFI_ERROR(status)) {
+        status = fan_discover_all(&fans, &fan_count);
+    }
+    if (EFI_ERROR(status) || fan_count != sim.fan_count) {
+        fprintf(stderr, "fan discovery failed (status 0x%llx, %u fans)\n",
+                (unsigned long long)status, fan_count);
+        return 1;
+    }
+
+    if (calibrate && !calibrate_fans(fans, fan_count)) {
+        return 1;
+    }
+
+    for (i = 0; i < sim.curve_count; i++) {
+        const SIM_CURVE *curve = &sim.curves[i];
+        FAN_INFO config = fans[curve->fan];
+
+        config.mode = FAN_MODE_SENSOR_BASED;
+        config.sensor_based_enabled = TRUE;
+        config.sensor_index = (UINT16)curve->source;
+        config.min_temp = (INT16)(curve->min_c * 10);
+        config.max_temp = (INT16)(curve->max_c * 10);
+        fan_apply_config(&fans[curve->fan], &config);
+    }
+
+    // Bring-up traffic is not part of the control cost
+    writes_before = smc.writes;
+    reads_before = smc.reads;
+    for (i = 0; i < sim.fan_count; i++) {
+        target_writes[i] = sim.fans[i].tg->writes;
+        mode_writes[i] = sim.fans[i].md->writes;
+    }
+
+    if (csv_path) {
+        csv = fopen(csv_path, "w");
+        if (!csv) {
+            perror(csv_path);
+            return 1;
+        }
+        fprintf(csv, "time_s");
+        for (i = 0; i < sim.source_count; i++) {
+            fprintf(csv, ",%s_c", sim.sources[i].name);
+        }
+        for (i = 0; i < sim.fan_count; i++) {
+            fprintf(csv, ",fan%d_rpm,fan%d_target", i, i);
+        }
+        fprintf(csv, "\n");
+    }
+
+    for (step = 0; step < steps; step++) {
+        double now_s = step * dt;
+
+        while (next_event < (UINTN)sim.event_count && sim.events[next_event].time_s <= now_s) {
+            const SIM_EVENT *e = &sim.events[next_event++];
+            if (e->kind == EVENT_POWER) {
+                sim.sources[e->source].power = e->value;
+            } else {
+                sim.ambient = e->value;
+            }
+        }
+
+        // Physics runs on its own time base; SMC time spent by the controller
+        // is accounted on the virtual clock separately
+        plant_step(dt);
+        plant_publish();
+        for (i = 0; i < sim.source_count; i++) {
+            sim.sources[i].series[step] = sim.sources[i].temp;
+        }
+
+        if (step % control_every == 0) {
+            UINT64 bus_start = clock_ns;
+            double cpu_start = cpu_time_us(), cpu;
+            UINT8 f;
+
+            // Same work as the menu's blocking refresh
+            for (f = 0; f < fan_count; f++) {
+                fan_read_rpm(fans[f].index, &fans[f].current_rpm);
+            }
+            for (f = 0; f < fan_count; f++) {
+                INT16 temp;
+                if (fans[f].mode != FAN_MODE_SENSOR_BASED || !fans[f].sensor_based_enabled) {
+                    continue;
+                }
+                if (!EFI_ERROR(temp_read_sensor(sim.sources[fans[f].sensor_index].key, &temp))) {
+                    fan_update_sensor_based(&fans[f], temp);
+                }
+            }
+
+            cpu = cpu_time_us() - cpu_start;
+            tick_cpu_sum += cpu;
+            if (cpu > tick_cpu_max) {
+                tick_cpu_max = cpu;
+            }
+            tick_bus_ns_sum += clock_ns - bus_start;
+            if (clock_ns - bus_start > tick_bus_ns_max) {
+                tick_bus_ns_max = clock_ns - bus_start;
+            }
+            ticks++;
+
+            if (csv) {
+                fprintf(csv, "%.3f", now_s);
+                for (i = 0; i < sim.source_count; i++) {
+                    fprintf(csv, ",%.3f", sim.sources[i].temp);
+                }
+                for (i = 0; i < sim.fan_count; i++) {
+                    fprintf(csv, ",%.0f,%.0f", sim.fans[i].rpm,
+                            sim.fans[i].md->data[0] ? get_fpe2(sim.fans[i].tg) : sim.fans[i].min_rpm);
+                }
+                fprintf(csv, "\n");
+            }
+        }
+    }
+    if (csv) {
+        fclose(csv);
+    }
+
+    printf("Scenario: %s (%.0f s, physics %u ms, control %u ms, %d fans, %d sources, %s)\n\n",
+           script, sim.duration_s, sim.physics_ms, sim.control_ms, sim.fan_count, sim.source_count,
+           use_mmio ? "MMIO" : "port I/O");
+
+    printf("Source  Key    Peak C   Overshoot C (worst/mean)   Settling s (worst/mean)\n");
+    for (i = 0; i < sim.source_count; i++) {
+        SIM_SOURCE *src = &sim.sources[i];
+        double peak = -1e9, worst_os = 0, sum_os = 0, worst_st = 0, sum_st = 0;
+        BOOLEAN unsettled = FALSE;
+        UINTN seg_start = 0, segments = 0, k;
+        int e = 0;
+        CHAR8 name[5];
+
+        for (k = 0; k < steps; k++) {
+            if (src->series[k] > peak) {
+                peak = src->series[k];
+            }
+        }
+
+        // Segments split at every event time
+        while (seg_start < steps) {
+            UINTN seg_end = steps;
+            SEGMENT_RESULT r;
+
+            while (e < sim.event_count && (UINTN)(sim.events[e].time_s / dt) <= seg_start) {
+                e++;
+            }
+            if (e < sim.event_count) {
+                seg_end = (UINTN)(sim.events[e].time_s / dt);
+            }
+            if (seg_end <= seg_start + 1) {
+                seg_start = seg_end > seg_start ? seg_end : seg_start + 1;
+                continue;
+            }
+
+            r = segment_metrics(src->series, seg_start, seg_end, dt);
+            sum_os += r.overshoot;
+            sum_st += r.settling_s;
+            if (r.overshoot > worst_os) {
+                worst_os = r.overshoot;
+            }
+            if (r.settling_s > worst_st) {
+                worst_st = r.settling_s;
+            }
+            unsettled |= !r.settled;
+            segments++;
+            seg_start = seg_end;
+        }
+
+        smc_key_to_chars(src->key, name);
+        printf("%-7s %-4s  %7.1f   %8.2f / %-8.2f        %7.1f / %-7.1f%s\n",
+               src->name, name, peak, worst_os, segments ? sum_os / segments : 0,
+               worst_st, segments ? sum_st / segments : 0,
+               unsettled ? "  (not settled)" : "");
+    }
+
+    printf("\nFan  Min-Max RPM   RPM-seconds   Mean RPM   Target writes   Mode writes\n");
+    for (i = 0; i < sim.fan_count; i++) {
+        SIM_FAN *fan = &sim.fans[i];
+        printf("%-3d  %4.0f-%-6.0f  %12.0f   %8.0f   %13u   %11u\n",
+               i, fan->min_rpm, fan->max_rpm, fan->rpm_seconds,
+               fan->rpm_seconds / sim.duration_s,
+               fan->tg->writes - target_writes[i], fan->md->writes - mode_writes[i]);
+    }
+
+    printf("\nSMC: %llu writes, %llu reads during control\n",
+           (unsigned long long)(smc.writes - writes_before),
+           (unsigned long long)(smc.reads - reads_before));
+    printf("Control tick (%zu ticks): CPU %.2f us mean / %.2f us max, "
+           "SMC bus %.1f us mean / %.1f us max\n",
+           (size_t)ticks, ticks ? tick_cpu_sum / ticks : 0, tick_cpu_max,
+           ticks ? tick_bus_ns_sum / 1000.0 / ticks : 0, tick_bus_ns_max / 1000.0);
+
+    fan_restore_auto_mode_all();
+    fan_free_all(fans);
+    return 0;
+}
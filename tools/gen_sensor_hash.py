@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Generate a collision-free hash table for the sensor description map.
+
+Reads the sensor_map[] table from src/temp_sensors.c (the source of truth)
+and writes src/sensor_hash.h, which maps a FourCC SMC key to its index in
+sensor_map[] with one hash computation and one compare.
+
+Scheme (hash-and-displace):
+    bucket = (key * 0x9E3779B1) >> (32 - BUCKET_BITS)
+    slot   = ((key ^ disp[bucket]) * 0x85EBCA6B) >> (32 - SLOT_BITS)
+
+Usage: gen_sensor_hash.py <temp_sensors.c> <sensor_hash.h>
+"""
+
+import re
+import sys
+
+BUCKET_MULT = 0x9E3779B1  # must match SMC_KEY_HASH in smc_protocol.h
+SLOT_MULT = 0x85EBCA6B
+MASK32 = 0xFFFFFFFF
+
+ENTRY_RE = re.compile(r'^\s*\{\s*"([^"]+)"\s*,\s*L"[^"]*"\s*\}\s*,')
+
+
+def parse_sensor_map(path):
+    """Return FourCC keys in table order (keys longer than 4 are truncated,
+    as smc_key_from_chars() does)."""
+    keys = []
+    in_table = False
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            if "sensor_map[] = {" in line:
+                in_table = True
+                continue
+            if not in_table:
+                continue
+            if "{NULL, NULL}" in line:
+                break
+            m = ENTRY_RE.match(line)
+            if m:
+                keys.append(m.group(1))
+    if not in_table or not keys:
+        sys.exit("error: sensor_map[] not found in %s" % path)
+    return keys
+
+
+def fourcc(key):
+    raw = (key + "    ")[:4].encode("ascii")
+    return (raw[0] << 24) | (raw[1] << 16) | (raw[2] << 8) | raw[3]
+
+
+def bucket_of(key, bits):
+    return ((key * BUCKET_MULT) & MASK32) >> (32 - bits)
+
+
+def slot_of(key, disp, bits):
+    return (((key ^ disp) * SLOT_MULT) & MASK32) >> (32 - bits)
+
+
+def build(entries, bucket_bits, slot_bits, max_disp=1 << 16):
+    buckets = [[] for _ in range(1 << bucket_bits)]
+    for key, index in entries:
+        buckets[bucket_of(key, bucket_bits)].append((key, index))
+
+    slots = [None] * (1 << slot_bits)
+    disp = [0] * (1 << bucket_bits)
+
+    # Place the largest buckets first while the table is still sparse
+    order = sorted(range(len(buckets)), key=lambda b: -len(buckets[b]))
+    for b in order:
+        members = buckets[b]
+        if not members:
+            continue
+        for d in range(max_disp):
+            placed = [slot_of(k, d, slot_bits) for k, _ in members]
+            if len(set(placed)) == len(placed) and all(slots[p] is None for p in placed):
+                for p, member in zip(placed, members):
+                    slots[p] = member
+                disp[b] = d
+                break
+        else:
+            return None
+    return disp, slots
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: %s <temp_sensors.c> <sensor_hash.h>" % sys.argv[0])
+
+    names = parse_sensor_map(sys.argv[1])
+
+    # First occurrence wins, matching the old linear scan
+    entries = []
+    seen = set()
+    for index, name in enumerate(names):
+        key = fourcc(name)
+        if key in seen:
+            continue
+        seen.add(key)
+        entries.append((key, index))
+
+    slot_bits = max(4, (len(entries) * 2 - 1).bit_length())
+    bucket_bits = max(2, slot_bits - 2)
+    result = None
+    while result is None:
+        result = build(entries, bucket_bits, slot_bits)
+        if result is None:
+            slot_bits += 1
+    disp, slots = result
+
+    out = []
+    out.append("// Generated by tools/gen_sensor_hash.py from src/temp_sensors.c - do not edit")
+    out.append("#ifndef SENSOR_HASH_H")
+    out.append("#define SENSOR_HASH_H")
+    out.append("")
+    out.append("#define SENSOR_HASH_ENTRIES      %d  // sensor_map[] rows" % len(names))
+    out.append("#define SENSOR_HASH_BUCKET_BITS  %d" % bucket_bits)
+    out.append("#define SENSOR_HASH_SLOT_BITS    %d" % slot_bits)
+    out.append("#define SENSOR_HASH_SLOT_MULT    0x%08XU" % SLOT_MULT)
+    out.append("#define SENSOR_HASH_EMPTY        0xFFFF")
+    out.append("")
+    out.append("// Per-bucket displacement")
+    out.append("static const UINT16 sensor_hash_disp[%d] = {" % len(disp))
+    for i in range(0, len(disp), 12):
+        out.append("    " + ", ".join("%d" % d for d in disp[i:i + 12]) + ",")
+    out.append("};")
+    out.append("")
+    out.append("// Slot -> FourCC key and sensor_map[] index")
+    out.append("static const struct {")
+    out.append("    UINT32 key;")
+    out.append("    UINT16 index;")
+    out.append("} sensor_hash_slots[%d] = {" % len(slots))
+    for slot in slots:
+        if slot is None:
+            out.append("    {0x00000000U, SENSOR_HASH_EMPTY},")
+        else:
+            key, index = slot
+            out.append("    {0x%08XU, %3d},  // %s" % (key, index, names[index][:4]))
+    out.append("};")
+    out.append("")
+    out.append("#endif // SENSOR_HASH_H")
+
+    with open(sys.argv[2], "w", encoding="utf-8") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,86 @@
+/*
+ * Host build shim for the subset of <efi.h> used by the SMC protocol layer
+ *
+ * Lets tools/ compile src/ modules as ordinary Linux programs. Only the
+ * types, status codes and Boot Services entries those modules touch are
+ * provided; each tool defines gBS and supplies the behaviour it needs
+ * (e.g. Stall() advancing a virtual clock).
+ */
+#ifndef HOST_EFI_H
+#define HOST_EFI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint8_t  UINT8;
+typedef int8_t   INT8;
+typedef uint16_t UINT16;
+typedef int16_t  INT16;
+typedef uint32_t UINT32;
+typedef int32_t  INT32;
+typedef uint64_t UINT64;
+typedef int64_t  INT64;
+typedef uint64_t UINTN;
+typedef int64_t  INTN;
+typedef char     CHAR8;
+typedef uint16_t CHAR16;    // Build with -fshort-wchar so L"" literals match
+typedef uint8_t  BOOLEAN;
+typedef void     VOID;
+
+typedef UINTN EFI_STATUS;
+typedef UINTN EFI_TPL;
+typedef void *EFI_HANDLE;
+typedef void *EFI_EVENT;
+
+typedef struct {
+    UINT32 Data1;
+    UINT16 Data2;
+    UINT16 Data3;
+    UINT8 Data4[8];
+} EFI_GUID;
+
+#define TRUE    1
+#define FALSE   0
+#define IN
+#define OUT
+#define OPTIONAL
+#define CONST   const
+#define EFIAPI
+
+#define EFI_ERROR(status)   (((INTN)(status)) < 0)
+#define EFIERR(code)        ((EFI_STATUS)(0x8000000000000000ULL | (code)))
+
+#define EFI_SUCCESS                 0
+#define EFI_LOAD_ERROR              EFIERR(1)
+#define EFI_INVALID_PARAMETER       EFIERR(2)
+#define EFI_UNSUPPORTED             EFIERR(3)
+#define EFI_BAD_BUFFER_SIZE         EFIERR(4)
+#define EFI_BUFFER_TOO_SMALL        EFIERR(5)
+#define EFI_NOT_READY               EFIERR(6)
+#define EFI_DEVICE_ERROR            EFIERR(7)
+#define EFI_WRITE_PROTECTED         EFIERR(8)
+#define EFI_OUT_OF_RESOURCES        EFIERR(9)
+#define EFI_VOLUME_CORRUPTED        EFIERR(10)
+#define EFI_VOLUME_FULL             EFIERR(11)
+#define EFI_NOT_FOUND               EFIERR(14)
+#define EFI_ACCESS_DENIED           EFIERR(15)
+#define EFI_NO_RESPONSE             EFIERR(16)
+#define EFI_TIMEOUT                 EFIERR(18)
+#define EFI_NOT_STARTED             EFIERR(19)
+#define EFI_ALREADY_STARTED         EFIERR(20)
+#define EFI_ABORTED                 EFIERR(21)
+#define EFI_INCOMPATIBLE_VERSION    EFIERR(25)
+#define EFI_CRC_ERROR               EFIERR(27)
+
+#define TPL_APPLICATION     4
+#define TPL_CALLBACK        8
+#define TPL_NOTIFY          16
+#define TPL_HIGH_LEVEL      31
+
+typedef struct {
+    EFI_TPL (*RaiseTPL)(EFI_TPL new_tpl);
+    void (*RestoreTPL)(EFI_TPL old_tpl);
+    EFI_STATUS (*Stall)(UINTN microseconds);
+} EFI_BOOT_SERVICES;
+
+#endif // HOST_EFI_H
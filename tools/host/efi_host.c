@@ -0,0 +1,152 @@
+/*
+ * Host implementations of the library calls declared in tools/host/efilib.h
+ *
+ * Formatting follows the EFI conventions the src/ modules rely on: %d/%u/%x
+ * take 32-bit arguments unless prefixed with 'l', %s is a CHAR16 string
+ * and %a an ASCII one. Buffer sizes are in bytes.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+
+#include "efilib.h"
+
+/**
+ * Format into a CHAR16 buffer of `count` characters (always terminated)
+ */
+static UINTN format_wide(CHAR16 *out, UINTN count, const CHAR16 *fmt, va_list args) {
+    UINTN n = 0;
+
+#define EMIT(ch) do { if (n + 1 < count) { out[n] = (CHAR16)(ch); } n++; } while (0)
+
+    while (*fmt) {
+        CHAR8 digits[24];
+        BOOLEAN left = FALSE, is_long = FALSE;
+        CHAR16 pad = L' ';
+        UINTN width = 0, len = 0, total, i;
+        UINT64 value;
+        BOOLEAN negative = FALSE;
+        UINT32 base = 10;
+        const CHAR8 *hex = "0123456789abcdef";
+
+        if (*fmt != L'%') {
+            EMIT(*fmt++);
+            continue;
+        }
+        fmt++;
+
+        for (;; fmt++) {
+            if (*fmt == L'-') {
+                left = TRUE;
+            } else if (*fmt == L'0') {
+                pad = L'0';
+            } else {
+                break;
+            }
+        }
+        if (*fmt == L'*') {
+            width = (UINTN)va_arg(args, int);
+            fmt++;
+        }
+        while (*fmt >= L'0' && *fmt <= L'9') {
+            width = width * 10 + (*fmt++ - L'0');
+        }
+        while (*fmt == L'l') {
+            is_long = TRUE;
+            fmt++;
+        }
+
+        switch (*fmt) {
+            case L's': {
+                const CHAR16 *s = va_arg(args, const CHAR16 *);
+                for (len = 0; s && s[len]; len++) {}
+                for (i = len; !left && i < width; i++) EMIT(L' ');
+                for (i = 0; i < len; i++) EMIT(s[i]);
+                for (i = len; left && i < width; i++) EMIT(L' ');
+                fmt++;
+                continue;
+            }
+            case L'a': {
+                const CHAR8 *s = va_arg(args, const CHAR8 *);
+                for (len = 0; s && s[len]; len++) {}
+                for (i = len; !left && i < width; i++) EMIT(L' ');
+                for (i = 0; i < len; i++) EMIT((UINT8)s[i]);
+                for (i = len; left && i < width; i++) EMIT(L' ');
+                fmt++;
+                continue;
+            }
+            case L'c':
+                EMIT(va_arg(args, int));
+                fmt++;
+                continue;
+            case L'd': {
+                INT64 v = is_long ? va_arg(args, INT64) : va_arg(args, INT32);
+                negative = v < 0;
+                value = negative ? (UINT64)-v : (UINT64)v;
+                break;
+            }
+            case L'X':
+                hex = "0123456789ABCDEF";
+                /* fall through */
+            case L'x':
+                base = 16;
+                /* fall through */
+            case L'u':
+                value = is_long ? va_arg(args, UINT64) : va_arg(args, UINT32);
+                break;
+            case L'\0':
+                continue;
+            default:
+                EMIT(*fmt++);
+                continue;
+        }
+        fmt++;
+
+        do {
+            digits[len++] = hex[value % base];
+            value /= base;
+        } while (value);
+        if (negative && pad == L'0') {
+            EMIT(L'-');
+            width = width ? width - 1 : 0;
+        } else if (negative) {
+            digits[len++] = '-';
+        }
+        total = len;
+        for (i = total; !left && i < width; i++) EMIT(pad);
+        while (len) EMIT(digits[--len]);
+        for (i = total; left && i < width; i++) EMIT(L' ');
+    }
+
+#undef EMIT
+
+    if (count) {
+        out[n < count ? n : count - 1] = 0;
+    }
+    return n;
+}
+
+UINTN UnicodeSPrint(CHAR16 *buffer, UINTN buffer_size, const CHAR16 *fmt, ...) {
+    va_list args;
+    UINTN n;
+
+    va_start(args, fmt);
+    n = format_wide(buffer, buffer_size / sizeof(CHAR16), fmt, args);
+    va_end(args);
+    return n;
+}
+
+UINTN Print(const CHAR16 *fmt, ...) {
+    CHAR16 line[512];
+    va_list args;
+    UINTN n, i;
+
+    va_start(args, fmt);
+    n = format_wide(line, sizeof(line) / sizeof(CHAR16), fmt, args);
+    va_end(args);
+
+    // Console output is ASCII on the host
+    for (i = 0; line[i]; i++) {
+        putchar(line[i] < 0x80 ? (int)line[i] : '?');
+    }
+    return n;
+}
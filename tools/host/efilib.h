@@ -0,0 +1,25 @@
+/*
+ * Host build shim for the subset of <efilib.h> used by src/ modules
+ */
+#ifndef HOST_EFILIB_H
+#define HOST_EFILIB_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "efi.h"
+
+// Defined by each tool
+extern EFI_BOOT_SERVICES *gBS;
+
+// tools/host/efi_host.c
+UINTN Print(const CHAR16 *fmt, ...);
+UINTN UnicodeSPrint(CHAR16 *buffer, UINTN buffer_size, const CHAR16 *fmt, ...);
+
+static inline void *AllocatePool(UINTN size) { return malloc(size); }
+static inline void *AllocateZeroPool(UINTN size) { return calloc(1, size); }
+static inline void FreePool(void *buffer) { free(buffer); }
+static inline void CopyMem(void *dest, const void *src, UINTN size) { memmove(dest, src, size); }
+static inline void SetMem(void *buffer, UINTN size, UINT8 value) { memset(buffer, value, size); }
+static inline void ZeroMem(void *buffer, UINTN size) { memset(buffer, 0, size); }
+
+#endif // HOST_EFILIB_H
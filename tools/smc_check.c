@@ -0,0 +1,273 @@
+/*
+ * smc_check - host checks for the SMC support modules
+ *
+ * Links src/smc_codec.c and src/smc_health.c against a scripted SMC (the
+ * blocking transaction entries of smc_protocol.h are replaced here), so
+ * failure handling can be driven case by case without a port-level
+ * emulation:
+ *
+ *   - Key types: a definite answer (the type, or no such key) is cached;
+ *     a transient failure is not, and the access that hit it fails
+ *     instead of decoding with the fallback type. Async reads are only
+ *     decoded once their type is cached.
+ *   - Key health: absent keys (as probed by sensor discovery) take no
+ *     table slots, and keys that fail once do not keep a failing key from
+ *     being quarantined.
+ *
+ * Build:  make host-tools
+ * Usage:  smc_check           (or: make check)
+ * Exits non-zero if any check fails.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "smc_codec.h"
+#include "smc_health.h"
+#include "utils.h"
+
+static int failures = 0;
+
+#define CHECK(cond, what) \
+    do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, what); \
+            failures++; \
+        } \
+    } while (0)
+
+/**
+ * Scripted SMC
+ * One key at a time: its GET_KEY_TYPE answer and its value bytes.
+ */
+
+static struct {
+    SMC_KEY key;
+    EFI_STATUS type_status;   // Returned by smc_get_key_type
+    UINT8 size;
+    CHAR8 type[5];
+    UINT8 data[SMC_MAX_DATA_LENGTH];
+    UINT8 data_len;
+    UINT32 type_queries;
+} smc;
+
+static UINT64 clock_us = 0;
+
+UINT64 timer_now_us(void) { return clock_us; }
+
+SMC_KEY smc_key_from_chars(const CHAR8 *chars) {
+    return SMC_KEY_CONST(chars[0], chars[1], chars[2], chars[3]);
+}
+
+EFI_STATUS smc_read_key(SMC_KEY key, UINT8 *data, UINT8 *data_len) {
+    if (key != smc.key) {
+        return EFI_NOT_FOUND;
+    }
+    memcpy(data, smc.data, smc.data_len);
+    *data_len = smc.data_len;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS smc_read_key_fresh(SMC_KEY key, UINT8 *data, UINT8 *data_len) {
+    return smc_read_key(key, data, data_len);
+}
+
+EFI_STATUS smc_write_key(SMC_KEY key, const UINT8 *data, UINT8 data_len) {
+    if (key != smc.key || data_len > SMC_MAX_DATA_LENGTH) {
+        return EFI_NOT_FOUND;
+    }
+    memcpy(smc.data, data, data_len);
+    smc.data_len = data_len;
+    return EFI_SUCCESS;
+}
+
+EFI_STATUS smc_get_key_type(SMC_KEY key, UINT8 *data_size, CHAR8 type[5]) {
+    smc.type_queries++;
+    if (key != smc.key) {
+        return EFI_NOT_FOUND;
+    }
+    if (EFI_ERROR(smc.type_status)) {
+        return smc.type_status;
+    }
+    *data_size = smc.size;
+    memcpy(type, smc.type, 5);
+    return EFI_SUCCESS;
+}
+
+// A flt fan key reading 1500 RPM (little-endian IEEE 754)
+static void script_flt_key(SMC_KEY key, EFI_STATUS type_status) {
+    static const UINT8 rpm_1500[4] = { 0x00, 0x80, 0xBB, 0x44 };
+
+    memset(&smc, 0, sizeof(smc));
+    smc.key = key;
+    smc.type_status = type_status;
+    smc.size = 4;
+    memcpy(smc.type, "flt ", 5);
+    memcpy(smc.data, rpm_1500, sizeof(rpm_1500));
+    smc.data_len = sizeof(rpm_1500);
+}
+
+/**
+ * Key type cache
+ */
+static void check_type_cache(void) {
+    SMC_KEY key = SMC_KEY_CONST('F', '0', 'A', 'c');
+    SMC_VALUE_TYPE type;
+    SMC_FIXED value = 0;
+    EFI_STATUS status;
+
+    // A timed-out type query fails the read and is asked again next time
+    smc_codec_flush_types();
+    script_flt_key(key, EFI_TIMEOUT);
+    status = smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    CHECK(status == EFI_TIMEOUT, "read with a timed-out type query fails");
+    CHECK(smc_codec_peek_type(key, &type) == EFI_NOT_FOUND, "timed-out type is not cached");
+
+    smc.type_status = EFI_DEVICE_ERROR;
+    status = smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    CHECK(status == EFI_DEVICE_ERROR, "read with a failed type query fails");
+    CHECK(smc.type_queries == 2, "type is queried again after a transient failure");
+
+    // Once the SMC answers, the flt value decodes (not as the fpe2 fallback)
+    smc.type_status = EFI_SUCCESS;
+    status = smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    CHECK(!EFI_ERROR(status), "read succeeds once the type is known");
+    CHECK(value == 1500 * SMC_FIXED_ONE, "flt key decodes as flt");
+    CHECK(smc_codec_peek_type(key, &type) == EFI_SUCCESS && type == SMC_TYPE_FLT,
+          "answered type is cached");
+
+    status = smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    CHECK(!EFI_ERROR(status) && smc.type_queries == 3, "cached type costs no query");
+
+    // A key without a type record is a definite answer: cached, fallback used
+    smc_codec_flush_types();
+    script_flt_key(key, EFI_NOT_FOUND);
+    smc.data[0] = 0x17;
+    smc.data[1] = 0x70;
+    smc.data_len = 2;
+    status = smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    CHECK(!EFI_ERROR(status) && value == 1500 * SMC_FIXED_ONE, "untyped key uses the fallback");
+    CHECK(smc_codec_peek_type(key, &type) == EFI_SUCCESS && type == SMC_TYPE_UNKNOWN,
+          "missing type is cached");
+    smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    CHECK(smc.type_queries == 1, "missing type costs one query");
+
+    // A size that does not match the type is cached as unknown as well
+    smc_codec_flush_types();
+    script_flt_key(key, EFI_SUCCESS);
+    smc.size = 2;
+    CHECK(smc_codec_get_type(key, &type) == EFI_SUCCESS && type == SMC_TYPE_UNKNOWN,
+          "mismatched size reads as unknown");
+    smc_codec_get_type(key, &type);
+    CHECK(smc.type_queries == 1, "mismatched size is cached");
+
+    // Writes: no guessed encoding after a transient failure
+    smc_codec_flush_types();
+    script_flt_key(key, EFI_TIMEOUT);
+    status = smc_codec_write(key, SMC_TYPE_FPE2, 2000 * SMC_FIXED_ONE);
+    CHECK(status == EFI_TIMEOUT, "write with a timed-out type query fails");
+    CHECK(smc.data_len == 4 && smc.data[2] == 0xBB, "failed write leaves the key alone");
+}
+
+/**
+ * Decoding async reads (cached types only)
+ */
+static void check_decode_key(void) {
+    SMC_KEY key = SMC_KEY_CONST('F', '1', 'A', 'c');
+    static const UINT8 fpe2_1500[2] = { 0x17, 0x70 };
+    SMC_FIXED value = 0;
+    EFI_STATUS status;
+
+    // A flt value is not decoded as the fpe2 fallback while its type is unknown
+    smc_codec_flush_types();
+    script_flt_key(key, EFI_TIMEOUT);
+    smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    value = 0;
+    status = smc_codec_decode_key(key, SMC_TYPE_FPE2, smc.data, smc.data_len, &value);
+    CHECK(status == EFI_NOT_READY, "uncached type is not decoded");
+    CHECK(value == 0, "value is left alone");
+
+    // Once a blocking access has the type, the same bytes decode as flt
+    smc.type_status = EFI_SUCCESS;
+    smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    value = 0;
+    status = smc_codec_decode_key(key, SMC_TYPE_FPE2, smc.data, smc.data_len, &value);
+    CHECK(!EFI_ERROR(status) && value == 1500 * SMC_FIXED_ONE, "cached flt type decodes");
+
+    // A key without a type uses the fallback, but only at its exact size
+    smc_codec_flush_types();
+    script_flt_key(key, EFI_NOT_FOUND);
+    smc_codec_read(key, SMC_TYPE_FPE2, &value);
+    status = smc_codec_decode_key(key, SMC_TYPE_FPE2, fpe2_1500, sizeof(fpe2_1500), &value);
+    CHECK(!EFI_ERROR(status) && value == 1500 * SMC_FIXED_ONE, "untyped key uses the fallback");
+    status = smc_codec_decode_key(key, SMC_TYPE_FPE2, smc.data, smc.data_len, &value);
+    CHECK(status == EFI_BAD_BUFFER_SIZE, "fallback refuses data of another size");
+}
+
+// Key n of a block of made-up keys (never 0)
+static SMC_KEY made_up_key(CHAR8 first, UINT32 n) {
+    return SMC_KEY_CONST(first, 'A' + n / 676, 'A' + n / 26 % 26, 'A' + n % 26);
+}
+
+// Fail a key until it is quarantined (or the threshold is passed)
+static void fail_key(SMC_KEY key) {
+    UINT32 i;
+
+    for (i = 0; i < SMC_HEALTH_FAIL_THRESHOLD; i++) {
+        smc_health_record(key, EFI_DEVICE_ERROR);
+    }
+}
+
+/**
+ * Key health table
+ */
+static void check_health(void) {
+    UINT32 i, tracked;
+
+    // Discovery probes: far more absent keys than the table holds
+    smc_health_reset();
+    for (i = 0; i < 4 * (1 << SMC_HEALTH_TABLE_BITS); i++) {
+        smc_health_record(made_up_key('T', i), EFI_NOT_FOUND);
+    }
+    CHECK(smc_health_allow(made_up_key('T', 0)), "absent key is not quarantined");
+
+    // Every present key that keeps failing is still quarantined
+    tracked = 0;
+    for (i = 0; i < 40; i++) {
+        fail_key(made_up_key('P', i));
+        tracked += smc_health_is_quarantined(made_up_key('P', i));
+    }
+    CHECK(tracked == 40, "failing keys are quarantined after absent-key probes");
+    CHECK(!smc_health_allow(made_up_key('P', 0)), "quarantined key is refused");
+
+    // One-off failures fill the table; later failing keys take their slots
+    smc_health_reset();
+    for (i = 0; i < 4 * (1 << SMC_HEALTH_TABLE_BITS); i++) {
+        smc_health_record(made_up_key('T', i), EFI_DEVICE_ERROR);
+    }
+    tracked = 0;
+    for (i = 0; i < 40; i++) {
+        fail_key(made_up_key('P', i));
+        tracked += smc_health_is_quarantined(made_up_key('P', i));
+    }
+    CHECK(tracked == 40, "failing keys are quarantined in a full table");
+
+    // Quarantine expiry lets a probe through; success clears the key
+    clock_us += (UINT64)SMC_HEALTH_BASE_BACKOFF_MS * 1000;
+    CHECK(smc_health_allow(made_up_key('P', 0)), "probe allowed after the quarantine");
+    smc_health_record(made_up_key('P', 0), EFI_SUCCESS);
+    CHECK(!smc_health_is_quarantined(made_up_key('P', 0)), "success clears the quarantine");
+}
+
+int main(void) {
+    check_type_cache();
+    check_decode_key();
+    check_health();
+
+    if (failures) {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,553 @@
+/*
+ * smc_replay - replay a recorded SMC port-I/O trace through smc_protocol.c
+ *
+ * A trace written by `applesmc.efi --trace` (see src/smc_trace.h) holds
+ * every SMC port access with its time. This tool splits it into
+ * transactions, measures how long the real SMC took to raise ACK and
+ * DATA_READY after each trigger, and serves those timings and the recorded
+ * data from an emulated device. The recorded transactions are then issued
+ * again through the unmodified protocol layer on a virtual clock, so a
+ * change to polling, delays or batching in smc_protocol.c can be compared
+ * with the original run without the hardware.
+ *
+ * Timing model:
+ *   - Stall() and each port access advance the virtual clock (-c sets the
+ *     per-access cost, default 1000 ns; LPC I/O is about 1 us).
+ *   - A status bit becomes visible at the midpoint between the last
+ *     recorded poll that missed it and the first that saw it.
+ *   - The command ACK comes from the next recorded transaction in order;
+ *     DATA_READY and data come from the next unused recording of the same
+ *     command and key, so reordered or batched transactions still match.
+ *   - Idle gaps between transactions are kept (the clock never runs
+ *     behind the recording), so health/backoff timing lines up.
+ *
+ * Build:  make host-tools
+ * Usage:  smc_replay [-v] [-c io_ns] smc_trace.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "smc_protocol.h"
+#include "smc_health.h"
+#include "smc_trace.h"
+#include "utils.h"
+
+#define STEP_ACK        0
+#define STEP_DATA       1
+
+#define DEFAULT_IO_NS   1000
+
+// Recorded wait for one status bit
+typedef struct {
+    BOOLEAN ready;            // The bit was observed
+    UINT32 latency_us;        // Trigger to estimated assertion
+    UINT8 pending_status;     // Status before the bit appeared
+    UINT8 ready_status;       // Status once it did
+} STEP;
+
+// One recorded command, from its CMD write to the next command
+typedef struct {
+    UINT8 cmd;
+    SMC_KEY key;
+    UINT8 key_bytes;
+    UINT64 start_us;
+    UINT64 end_us;
+    UINT32 accesses;
+    STEP step[2];
+    UINT8 out[SMC_MAX_DATA_LENGTH + 2];   // Bytes read from the data port
+    UINT8 out_len;
+    UINT8 in[SMC_MAX_DATA_LENGTH + 1];    // Bytes written after the key
+    UINT8 in_len;
+    UINT8 error;                          // Last error port value
+    BOOLEAN used;                         // Consumed by the emulated device
+} TRANSACTION;
+
+// Emulated device
+typedef enum { DEV_IDLE, DEV_ACK, DEV_DATA, DEV_INPUT } DEV_STATE;
+
+static struct {
+    DEV_STATE state;
+    UINT8 cmd;
+    SMC_KEY key;
+    UINT8 key_bytes;
+    const STEP *step;         // Pending status bit
+    UINT64 ready_at_ns;       // When step becomes visible (0 = never)
+    const TRANSACTION *tx;    // Recording serving this command
+    UINT8 out_pos;
+    UINT8 in_pos;
+    UINT8 in_expect;          // Length byte + payload of a write
+    UINT8 error;
+    UINTN next_seq;           // Next recording in order (for ACK timing)
+    UINT64 accesses;
+    UINT64 data_mismatches;
+} dev;
+
+static TRANSACTION *transactions = NULL;
+static UINTN transaction_count = 0;
+
+static UINT64 clock_ns = 0;
+static UINT32 io_cost_ns = DEFAULT_IO_NS;
+
+// Used when the replay outruns the recording
+static const STEP default_ack = { TRUE, 0, 0, APPLESMC_ST_ACK };
+static const STEP never_ready = { FALSE, 0, 0, 0 };
+
+/**
+ * Host services for src/ (virtual clock, no TPLs)
+ */
+
+static EFI_TPL host_raise_tpl(EFI_TPL new_tpl) { (void)new_tpl; return TPL_APPLICATION; }
+static void host_restore_tpl(EFI_TPL old_tpl) { (void)old_tpl; }
+static EFI_STATUS host_stall(UINTN us) { clock_ns += (UINT64)us * 1000; return EFI_SUCCESS; }
+
+static EFI_BOOT_SERVICES host_boot_services = { host_raise_tpl, host_restore_tpl, host_stall };
+EFI_BOOT_SERVICES *gBS = &host_boot_services;
+
+void timer_calibrate(void) {}
+UINT64 timer_now_us(void) { return clock_ns / 1000; }
+void timer_spin_us(UINT32 us) { clock_ns += (UINT64)us * 1000; }
+void memory_fence(void) {}
+
+// Replayed I/O is not traced again
+void smc_trace_record(UINT8 op, UINT16 port, UINT8 value) { (void)op; (void)port; (void)value; }
+
+/**
+ * Arm a status step relative to now
+ */
+static void dev_arm(const STEP *step) {
+    dev.step = step;
+    dev.ready_at_ns = step->ready ? clock_ns + (UINT64)step->latency_us * 1000 : 0;
+}
+
+/**
+ * Next unused recording of a command/key (or the last used one)
+ */
+static const TRANSACTION *find_recording(UINT8 cmd, SMC_KEY key) {
+    TRANSACTION *last = NULL;
+    UINTN i;
+
+    for (i = 0; i < transaction_count; i++) {
+        TRANSACTION *tx = &transactions[i];
+        if (tx->cmd != cmd || tx->key != key || tx->key_bytes < 4) {
+            continue;
+        }
+        if (!tx->used) {
+            tx->used = TRUE;
+            return tx;
+        }
+        last = tx;
+    }
+    return last;
+}
+
+static BOOLEAN dev_step_ready(void) {
+    return dev.step && dev.ready_at_ns != 0 && clock_ns >= dev.ready_at_ns;
+}
+
+static UINT8 dev_status(void) {
+    switch (dev.state) {
+        case DEV_ACK:
+        case DEV_DATA:
+            return dev_step_ready() ? dev.step->ready_status : dev.step->pending_status;
+        case DEV_INPUT:
+            return dev.step->ready_status;
+        default:
+            return APPLESMC_ST_CMD_DONE;
+    }
+}
+
+static void dev_command(UINT8 cmd) {
+    const STEP *ack = &default_ack;
+
+    if (dev.next_seq < transaction_count) {
+        ack = &transactions[dev.next_seq++].step[STEP_ACK];
+    }
+
+    dev.state = DEV_ACK;
+    dev.cmd = cmd;
+    dev.key = 0;
+    dev.key_bytes = 0;
+    dev.tx = NULL;
+    dev.out_pos = 0;
+    dev.in_pos = 0;
+    dev.in_expect = 0;
+    dev.error = 0;
+    dev_arm(ack);
+}
+
+static void dev_key_complete(void) {
+    dev.tx = find_recording(dev.cmd, dev.key);
+
+    if (dev.cmd == APPLESMC_WRITE_CMD) {
+        dev.state = DEV_INPUT;
+        return;
+    }
+
+    dev.state = DEV_DATA;
+    if (dev.tx) {
+        dev.error = dev.tx->error;
+        dev_arm(&dev.tx->step[STEP_DATA]);
+    } else {
+        dev.error = APPLESMC_ST_1E_NOEXIST;
+        dev_arm(&never_ready);
+    }
+}
+
+UINT8 smc_host_inb(UINT16 port) {
+    UINT8 value = 0;
+
+    clock_ns += io_cost_ns;
+    dev.accesses++;
+
+    if (port == APPLESMC_CMD_PORT) {
+        return dev_status();
+    }
+    if (port == APPLESMC_ERR_PORT) {
+        return dev.error;
+    }
+    if (port != APPLESMC_DATA_PORT || dev.state != DEV_DATA || !dev_step_ready() || !dev.tx) {
+        return 0;
+    }
+
+    if (dev.out_pos < dev.tx->out_len) {
+        value = dev.tx->out[dev.out_pos++];
+    }
+    if (dev.out_pos >= dev.tx->out_len) {
+        dev.state = DEV_IDLE;
+    }
+    return value;
+}
+
+void smc_host_outb(UINT16 port, UINT8 value) {
+    clock_ns += io_cost_ns;
+    dev.accesses++;
+
+    if (port == APPLESMC_CMD_PORT) {
+        if (value >= APPLESMC_READ_CMD && value <= APPLESMC_GET_KEY_TYPE_CMD) {
+            dev_command(value);
+        } else {
+            dev.state = DEV_IDLE;  // Error clear
+            dev.error = 0;
+        }
+        return;
+    }
+    if (port != APPLESMC_DATA_PORT) {
+        return;
+    }
+
+    if (dev.state == DEV_ACK && dev_step_ready() && dev.key_bytes < 4) {
+        dev.key = (dev.key << 8) | value;
+        if (++dev.key_bytes == 4) {
+            dev_key_complete();
+        }
+        return;
+    }
+
+    if (dev.state == DEV_INPUT) {
+        if (dev.tx && (dev.in_pos >= dev.tx->in_len || dev.tx->in[dev.in_pos] != value)) {
+            dev.data_mismatches++;
+        }
+        if (dev.in_pos++ == 0) {
+            dev.in_expect = (UINT8)(1 + value);
+        }
+        if (dev.in_pos >= dev.in_expect) {
+            dev.state = DEV_IDLE;
+        }
+    }
+}
+
+/**
+ * Trace parsing
+ */
+
+static void step_observe(STEP *step, UINT8 bit, UINT8 status, UINT64 now_us,
+                         UINT64 trigger_us, UINT64 *last_miss_us, BOOLEAN *active) {
+    if (status & bit) {
+        step->ready = TRUE;
+        step->ready_status = status;
+        step->latency_us = (UINT32)((*last_miss_us + now_us) / 2 - trigger_us);
+        *active = FALSE;
+    } else {
+        step->pending_status = status;
+        *last_miss_us = now_us;
+    }
+}
+
+static BOOLEAN load_trace(const char *path, SMC_TRACE_RECORD **records, SMC_TRACE_HEADER *header) {
+    FILE *f = fopen(path, "rb");
+
+    if (!f) {
+        perror(path);
+        return FALSE;
+    }
+    if (fread(header, sizeof(*header), 1, f) != 1 || header->magic != SMC_TRACE_MAGIC ||
+        header->version != SMC_TRACE_VERSION || header->record_size != sizeof(SMC_TRACE_RECORD)) {
+        fprintf(stderr, "%s: not an SMC trace (version %d)\n", path, SMC_TRACE_VERSION);
+        fclose(f);
+        return FALSE;
+    }
+
+    *records = malloc((size_t)header->record_count * sizeof(SMC_TRACE_RECORD) + 1);
+    if (!*records ||
+        fread(*records, sizeof(SMC_TRACE_RECORD), header->record_count, f) != header->record_count) {
+        fprintf(stderr, "%s: truncated trace\n", path);
+        fclose(f);
+        return FALSE;
+    }
+
+    fclose(f);
+    return TRUE;
+}
+
+static void parse_trace(const SMC_TRACE_RECORD *records, UINT32 count) {
+    TRANSACTION *tx = NULL;
+    UINT64 time_us = 0, trigger_us = 0, last_miss_us = 0;
+    UINT32 prev_raw = 0;
+    UINT8 active_step = STEP_ACK;
+    BOOLEAN active = FALSE;
+    UINT32 i;
+
+    transactions = calloc(count + 1, sizeof(TRANSACTION));
+    transaction_count = 0;
+
+    for (i = 0; i < count; i++) {
+        const SMC_TRACE_RECORD *r = &records[i];
+
+        // Unwrap the 32-bit microsecond timestamps
+        time_us += (UINT32)(r->time_us - prev_raw);
+        prev_raw = r->time_us;
+
+        if (r->op == SMC_TRACE_OP_OUT && r->port == APPLESMC_CMD_PORT &&
+            r->value >= APPLESMC_READ_CMD && r->value <= APPLESMC_GET_KEY_TYPE_CMD) {
+            tx = &transactions[transaction_count++];
+            tx->cmd = r->value;
+            tx->start_us = time_us;
+            tx->end_us = time_us;
+            tx->accesses = 1;
+            trigger_us = last_miss_us = time_us;
+            active_step = STEP_ACK;
+            active = TRUE;
+            continue;
+        }
+        if (!tx) {
+            continue;  // Before the first command (ring wrapped, or init)
+        }
+
+        tx->end_us = time_us;
+        tx->accesses++;
+
+        if (r->port == APPLESMC_CMD_PORT && r->op == SMC_TRACE_OP_IN) {
+            if (active) {
+                step_observe(&tx->step[active_step],
+                             active_step == STEP_ACK ? APPLESMC_ST_ACK : APPLESMC_ST_DATA_READY,
+                             r->value, time_us, trigger_us, &last_miss_us, &active);
+            }
+        } else if (r->port == APPLESMC_ERR_PORT && r->op == SMC_TRACE_OP_IN) {
+            tx->error = r->value;
+        } else if (r->port == APPLESMC_DATA_PORT && r->op == SMC_TRACE_OP_OUT) {
+            if (tx->key_bytes < 4) {
+                tx->key = (tx->key << 8) | r->value;
+                active = FALSE;
+                if (++tx->key_bytes == 4 && tx->cmd != APPLESMC_WRITE_CMD) {
+                    trigger_us = last_miss_us = time_us;
+                    active_step = STEP_DATA;
+                    active = TRUE;
+                }
+            } else if (tx->in_len < sizeof(tx->in)) {
+                tx->in[tx->in_len++] = r->value;
+            }
+        } else if (r->port == APPLESMC_DATA_PORT && r->op == SMC_TRACE_OP_IN) {
+            active = FALSE;
+            if (tx->out_len < sizeof(tx->out)) {
+                tx->out[tx->out_len++] = r->value;
+            }
+        }
+    }
+}
+
+/**
+ * Replay
+ */
+
+typedef struct {
+    const char *name;
+    UINTN count;
+    UINT64 *recorded_us;
+    UINT64 *replayed_ns;
+    UINT64 recorded_io;
+    UINT64 replayed_io;
+} CMD_STATS;
+
+static BOOLEAN recorded_ok(const TRANSACTION *tx) {
+    if (!tx->step[STEP_ACK].ready || tx->key_bytes < 4) {
+        return FALSE;
+    }
+    return tx->cmd == APPLESMC_WRITE_CMD || tx->step[STEP_DATA].ready;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    UINT64 x = *(const UINT64 *)a, y = *(const UINT64 *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_stats(CMD_STATS *s) {
+    UINT64 rec_sum = 0, rep_sum = 0;
+    UINTN i;
+
+    if (s->count == 0) {
+        return;
+    }
+    for (i = 0; i < s->count; i++) {
+        rec_sum += s->recorded_us[i];
+        rep_sum += s->replayed_ns[i];
+    }
+    qsort(s->recorded_us, s->count, sizeof(UINT64), compare_u64);
+    qsort(s->replayed_ns, s->count, sizeof(UINT64), compare_u64);
+
+    printf("%-6s %7zu  %7.1f %7llu %7llu   %7.1f %7.1f %7.1f   %6.1f %6.1f\n",
+           s->name, (size_t)s->count,
+           (double)rec_sum / s->count,
+           (unsigned long long)s->recorded_us[s->count / 2],
+           (unsigned long long)s->recorded_us[s->count - 1],
+           rep_sum / 1000.0 / s->count,
+           s->replayed_ns[s->count / 2] / 1000.0,
+           s->replayed_ns[s->count - 1] / 1000.0,
+           (double)s->recorded_io / s->count,
+           (double)s->replayed_io / s->count);
+}
+
+static void usage(void) {
+    fprintf(stderr, "usage: smc_replay [-v] [-c io_ns] smc_trace.bin\n");
+}
+
+int main(int argc, char **argv) {
+    SMC_TRACE_RECORD *records = NULL;
+    SMC_TRACE_HEADER header;
+    CMD_STATS stats[3] = {
+        { .name = "read" }, { .name = "write" }, { .name = "type" }
+    };
+    UINT64 origin_us, total_rec_us = 0, total_rep_ns = 0;
+    UINTN outcome_mismatches = 0, value_mismatches = 0, skipped = 0;
+    BOOLEAN verbose = FALSE;
+    const char *path = NULL;
+    UINTN i;
+    int a;
+
+    for (a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "-v") == 0) {
+            verbose = TRUE;
+        } else if (strcmp(argv[a], "-c") == 0 && a + 1 < argc) {
+            io_cost_ns = (UINT32)strtoul(argv[++a], NULL, 0);
+        } else if (argv[a][0] != '-' && !path) {
+            path = argv[a];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!path) {
+        usage();
+        return 2;
+    }
+
+    if (!load_trace(path, &records, &header)) {
+        return 1;
+    }
+    parse_trace(records, header.record_count);
+    if (transaction_count == 0) {
+        fprintf(stderr, "%s: no SMC transactions in trace\n", path);
+        return 1;
+    }
+
+    for (i = 0; i < 3; i++) {
+        stats[i].recorded_us = calloc(transaction_count, sizeof(UINT64));
+        stats[i].replayed_ns = calloc(transaction_count, sizeof(UINT64));
+    }
+
+    origin_us = transactions[0].start_us;
+    smc_health_reset();
+
+    for (i = 0; i < transaction_count; i++) {
+        const TRANSACTION *tx = &transactions[i];
+        UINT8 data[SMC_MAX_DATA_LENGTH];
+        UINT8 data_len = 0;
+        CHAR8 type[5];
+        CHAR8 name[5];
+        UINT64 begin_ns, begin_io;
+        EFI_STATUS status;
+        CMD_STATS *s;
+
+        // Only complete read/write/type commands can be reissued
+        if (tx->key_bytes < 4 || tx->cmd == APPLESMC_GET_KEY_BY_INDEX_CMD ||
+            (tx->cmd == APPLESMC_WRITE_CMD && (tx->in_len < 2 || tx->in_len < 1 + tx->in[0]))) {
+            skipped++;
+            continue;
+        }
+
+        // Keep the recording's idle gaps; the device starts each command idle
+        if (clock_ns < (tx->start_us - origin_us) * 1000) {
+            clock_ns = (tx->start_us - origin_us) * 1000;
+        }
+        dev.next_seq = i;
+        begin_ns = clock_ns;
+        begin_io = dev.accesses;
+
+        if (tx->cmd == APPLESMC_READ_CMD) {
+            s = &stats[0];
+            status = smc_read_key(tx->key, data, &data_len);
+            if (!EFI_ERROR(status) && recorded_ok(tx) &&
+                (tx->out_len < 1 + data_len || data_len != tx->out[0] ||
+                 memcmp(data, &tx->out[1], data_len) != 0)) {
+                value_mismatches++;
+            }
+        } else if (tx->cmd == APPLESMC_WRITE_CMD) {
+            s = &stats[1];
+            status = smc_write_key(tx->key, &tx->in[1], tx->in[0]);
+        } else {
+            s = &stats[2];
+            status = smc_get_key_type(tx->key, &data_len, type);
+        }
+
+        if (EFI_ERROR(status) == recorded_ok(tx)) {
+            outcome_mismatches++;
+        }
+
+        s->recorded_us[s->count] = tx->end_us - tx->start_us;
+        s->replayed_ns[s->count] = clock_ns - begin_ns;
+        s->recorded_io += tx->accesses;
+        s->replayed_io += dev.accesses - begin_io;
+        total_rec_us += tx->end_us - tx->start_us;
+        total_rep_ns += clock_ns - begin_ns;
+
+        if (verbose) {
+            smc_key_to_chars(tx->key, name);
+            printf("%12.6f %-5s %s %-4s  rec %6llu us %4u io  rep %8.1f us %4llu io\n",
+                   (tx->start_us - origin_us) / 1e6, s->name, name,
+                   EFI_ERROR(status) ? "FAIL" : "ok",
+                   (unsigned long long)(tx->end_us - tx->start_us), tx->accesses,
+                   (clock_ns - begin_ns) / 1000.0,
+                   (unsigned long long)(dev.accesses - begin_io));
+        }
+        s->count++;
+    }
+
+    printf("Trace: %u records (%u dropped), %zu transactions over %.3f s\n",
+           header.record_count, header.dropped, (size_t)transaction_count,
+           (transactions[transaction_count - 1].end_us - origin_us) / 1e6);
+    printf("Replayed %zu (skipped %zu), %u ns per port access\n\n",
+           (size_t)(transaction_count - skipped), (size_t)skipped, io_cost_ns);
+    printf("               -- recorded (us) --       -- replayed (us) --      - port I/O -\n");
+    printf("cmd      count     avg     p50     max       avg     p50     max      rec    rep\n");
+    for (i = 0; i < 3; i++) {
+        print_stats(&stats[i]);
+    }
+    printf("\nSMC busy time: recorded %llu us, replayed %.1f us\n",
+           (unsigned long long)total_rec_us, total_rep_ns / 1000.0);
+    printf("Outcome mismatches: %zu, value mismatches: %zu, write data mismatches: %llu\n",
+           (size_t)outcome_mismatches, (size_t)value_mismatches,
+           (unsigned long long)dev.data_mismatches);
+
+    return (outcome_mismatches || value_mismatches || dev.data_mismatches) ? 1 : 0;
+}